@@ -0,0 +1,451 @@
+/* OpenSceneGraph example, osganimationbenchmark.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osg/Math>
+
+#include <osg/Geode>
+#include <osg/FrameStamp>
+
+#include <osgUtil/UpdateVisitor>
+
+#include <osgAnimation/Animation>
+#include <osgAnimation/Channel>
+#include <osgAnimation/CompressKeyframesVisitor>
+#include <osgAnimation/BasicAnimationManager>
+#include <osgAnimation/Bone>
+#include <osgAnimation/RigGeometry>
+#include <osgAnimation/RigTransformSoftware>
+#include <osgAnimation/Skeleton>
+#include <osgAnimation/StackedQuaternionElement>
+#include <osgAnimation/StackedScaleElement>
+#include <osgAnimation/StackedTranslateElement>
+#include <osgAnimation/UpdateBone>
+
+#include <iostream>
+#include <stdlib.h>
+
+std::string getBoneName(unsigned int b)
+{
+    std::string boneName = "bone";
+    boneName += char('a' + b%26);
+    boneName += char('a' + b/26);
+    return boneName;
+}
+
+// create an animation of numBones bones, each with a translate, rotate and scale channel of numKeys keys at 30Hz,
+// similar to what the exporters produce for a baked character animation.
+osgAnimation::Animation* createCharacterAnimation(unsigned int character, unsigned int numBones, unsigned int numKeys)
+{
+    osgAnimation::Animation* animation = new osgAnimation::Animation;
+    animation->setPlayMode(osgAnimation::Animation::LOOP);
+
+    for(unsigned int b=0; b<numBones; ++b)
+    {
+        std::string boneName = getBoneName(b);
+
+        osgAnimation::Vec3LinearChannel* translate = new osgAnimation::Vec3LinearChannel;
+        translate->setName("position");
+        translate->setTargetName(boneName);
+        osgAnimation::Vec3KeyframeContainer* translateKeys = translate->getOrCreateSampler()->getOrCreateKeyframeContainer();
+
+        osgAnimation::QuatSphericalLinearChannel* rotate = new osgAnimation::QuatSphericalLinearChannel;
+        rotate->setName("quaternion");
+        rotate->setTargetName(boneName);
+        osgAnimation::QuatKeyframeContainer* rotateKeys = rotate->getOrCreateSampler()->getOrCreateKeyframeContainer();
+
+        osgAnimation::Vec3LinearChannel* scale = new osgAnimation::Vec3LinearChannel;
+        scale->setName("scale");
+        scale->setTargetName(boneName);
+        osgAnimation::Vec3KeyframeContainer* scaleKeys = scale->getOrCreateSampler()->getOrCreateKeyframeContainer();
+
+        float phase = float(character*numBones + b);
+        for(unsigned int k=0; k<numKeys; ++k)
+        {
+            double time = double(k)/30.0;
+            float angle = sinf(float(time)*2.0f + phase);
+            translateKeys->push_back(osgAnimation::Vec3Keyframe(time, osg::Vec3(angle, 0.0f, 1.0f)));
+            rotateKeys->push_back(osgAnimation::QuatKeyframe(time, osg::Quat(angle, osg::Vec3(0.0f, 0.0f, 1.0f))));
+            scaleKeys->push_back(osgAnimation::Vec3Keyframe(time, osg::Vec3(1.0f, 1.0f, 1.0f)));
+        }
+
+        animation->addChannel(translate);
+        animation->addChannel(rotate);
+        animation->addChannel(scale);
+    }
+
+    animation->setWeight(1.0f);
+    return animation;
+}
+
+double runKeyframeEvaluation(osgAnimation::AnimationList& animations, unsigned int numFrames, bool randomAccess)
+{
+    srand(numFrames);
+
+    osg::ElapsedTime elapsedTime;
+    for(unsigned int f=0; f<numFrames; ++f)
+    {
+        for(osgAnimation::AnimationList::iterator itr = animations.begin(); itr != animations.end(); ++itr)
+        {
+            osgAnimation::Animation* animation = itr->get();
+            double time = randomAccess ? animation->getStartTime() + animation->getDuration()*double(rand())/double(RAND_MAX) :
+                                         10.0 + double(f)/60.0;
+
+            animation->resetTargets();
+            animation->update(time);
+        }
+    }
+    return elapsedTime.elapsedTime();
+}
+
+// create a skeleton of numBones bones posed away from their bind pose, skinning a mesh of numVertices vertices
+// each influenced by up to four bones.
+osgAnimation::Skeleton* createSkinnedCharacter(unsigned int numBones, unsigned int numVertices, osgAnimation::RigTransformSoftware::BlendMethod blendMethod)
+{
+    osgAnimation::Skeleton* skeleton = new osgAnimation::Skeleton;
+
+    std::vector<std::string> boneNames;
+    for(unsigned int b=0; b<numBones; ++b)
+    {
+        std::string boneName = getBoneName(b);
+        boneNames.push_back(boneName);
+
+        osgAnimation::Bone* bone = new osgAnimation::Bone(boneName);
+        bone->setInvBindMatrixInSkeletonSpace(osg::Matrix::translate(0.0f, 0.0f, -float(b)));
+        bone->setMatrixInSkeletonSpace(osg::Matrix::rotate(0.1f*float(b), osg::Vec3(1.0f, 0.0f, 0.0f))*osg::Matrix::translate(0.0f, 0.0f, float(b)));
+        skeleton->addChild(bone);
+    }
+
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    osg::Vec3Array* normals = new osg::Vec3Array;
+    osgAnimation::VertexInfluenceMap* influenceMap = new osgAnimation::VertexInfluenceMap;
+    for(unsigned int i=0; i<numVertices; ++i)
+    {
+        float height = float(numBones)*float(i)/float(numVertices);
+        float angle = float(i)*0.1f;
+        vertices->push_back(osg::Vec3(cosf(angle), sinf(angle), height));
+        normals->push_back(osg::Vec3(cosf(angle), sinf(angle), 0.0f));
+
+        unsigned int bone = osg::minimum(static_cast<unsigned int>(height), numBones-1);
+        unsigned int numInfluences = 1 + i%4;
+        for(unsigned int j=0; j<numInfluences; ++j)
+        {
+            const std::string& boneName = boneNames[(bone+j)%numBones];
+            osgAnimation::VertexInfluence& influence = (*influenceMap)[boneName];
+            influence.setName(boneName);
+            influence.push_back(osgAnimation::VertexIndexWeight(i, 1.0f/float(numInfluences)));
+        }
+    }
+
+    osg::Geometry* source = new osg::Geometry;
+    source->setVertexArray(vertices);
+    source->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+    source->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, numVertices));
+
+    osgAnimation::RigTransformSoftware* rigTransform = new osgAnimation::RigTransformSoftware;
+    rigTransform->setBlendMethod(blendMethod);
+
+    osgAnimation::RigGeometry* rigGeometry = new osgAnimation::RigGeometry;
+    rigGeometry->setSourceGeometry(source);
+    rigGeometry->setInfluenceMap(influenceMap);
+    rigGeometry->setRigTransformImplementation(rigTransform);
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(rigGeometry);
+    skeleton->addChild(geode);
+
+    return skeleton;
+}
+
+double runSkinning(osg::Node* root, unsigned int numFrames)
+{
+    osg::ref_ptr<osgUtil::UpdateVisitor> updateVisitor = new osgUtil::UpdateVisitor;
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    updateVisitor->setFrameStamp(frameStamp.get());
+
+    // the first traversal sets up the RigGeometry so leave it out of the timing
+    root->accept(*updateVisitor);
+
+    osg::ElapsedTime elapsedTime;
+    for(unsigned int f=1; f<=numFrames; ++f)
+    {
+        frameStamp->setFrameNumber(f);
+        frameStamp->setSimulationTime(double(f)/60.0);
+        updateVisitor->setTraversalNumber(f);
+        root->accept(*updateVisitor);
+    }
+    return elapsedTime.elapsedTime();
+}
+
+// create a character animated by its own manager playing a copy of clip, with the second half of
+// its bones, such as the fingers and face of a real character, marked as less important.
+osg::Group* createAnimatedCharacter(osgAnimation::Animation* clip, unsigned int numBones, unsigned int numVertices)
+{
+    osgAnimation::Skeleton* skeleton = createSkinnedCharacter(numBones, numVertices, osgAnimation::RigTransformSoftware::LINEAR_BLEND);
+    skeleton->setDefaultUpdateCallback();
+    for(unsigned int i=0; i<skeleton->getNumChildren(); ++i)
+    {
+        osgAnimation::Bone* bone = dynamic_cast<osgAnimation::Bone*>(skeleton->getChild(i));
+        if (!bone) continue;
+
+        osgAnimation::UpdateBone* updateBone = new osgAnimation::UpdateBone(bone->getName());
+        updateBone->getStackedTransforms().push_back(new osgAnimation::StackedTranslateElement("position"));
+        updateBone->getStackedTransforms().push_back(new osgAnimation::StackedQuaternionElement("quaternion"));
+        updateBone->getStackedTransforms().push_back(new osgAnimation::StackedScaleElement("scale"));
+        bone->setUpdateCallback(updateBone);
+        bone->setImportance(i<numBones/2 ? 1.0f : 0.25f);
+    }
+
+    osgAnimation::Animation* animation = new osgAnimation::Animation(*clip, osg::CopyOp::SHALLOW_COPY);
+    osgAnimation::BasicAnimationManager* manager = new osgAnimation::BasicAnimationManager;
+    manager->registerAnimation(animation);
+    manager->playAnimation(animation);
+
+    osg::Group* character = new osg::Group;
+    character->setUpdateCallback(manager);
+    character->addChild(skeleton);
+    return character;
+}
+
+// update the characters as if they were spread out in front of the camera, the nearest covering a few hundred
+// pixels down to a few pixels for the furthest, with one in three out of view.
+double runAnimationLOD(osg::Group* root, unsigned int numFrames, osgAnimation::AnimationManagerBase::LODStatistics& statistics)
+{
+    osg::ref_ptr<osgUtil::UpdateVisitor> updateVisitor = new osgUtil::UpdateVisitor;
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    updateVisitor->setFrameStamp(frameStamp.get());
+
+    osg::ElapsedTime elapsedTime;
+    for(unsigned int f=0; f<=numFrames; ++f)
+    {
+        // the first frame sets up the RigGeometry so leave it out of the timing
+        if (f==1) elapsedTime.reset();
+
+        // stand in for the cull traversal of the previous frame
+        for(unsigned int c=0; c<root->getNumChildren(); ++c)
+        {
+            osg::Group* character = root->getChild(c)->asGroup();
+            osgAnimation::Skeleton* skeleton = dynamic_cast<osgAnimation::Skeleton*>(character->getChild(0));
+            if (f>0 && c%3!=2) skeleton->setCullPixelSize(f-1, 2000.0f/float(c+1));
+        }
+
+        frameStamp->setFrameNumber(f);
+        frameStamp->setSimulationTime(double(f)/60.0);
+        updateVisitor->setTraversalNumber(f);
+        root->accept(*updateVisitor);
+    }
+    double duration = elapsedTime.elapsedTime();
+
+    statistics.reset();
+    for(unsigned int c=0; c<root->getNumChildren(); ++c)
+    {
+        const osgAnimation::AnimationManagerBase* manager = dynamic_cast<const osgAnimation::AnimationManagerBase*>(root->getChild(c)->getUpdateCallback());
+        const osgAnimation::AnimationManagerBase::LODStatistics& managerStatistics = manager->getLODStatistics();
+        statistics.numUpdates += managerStatistics.numUpdates;
+        statistics.numSkippedUpdates += managerStatistics.numSkippedUpdates;
+        statistics.numBoneUpdates += managerStatistics.numBoneUpdates;
+        statistics.numSkippedBoneUpdates += managerStatistics.numSkippedBoneUpdates;
+        statistics.numSkinnings += managerStatistics.numSkinnings;
+        statistics.numSkippedSkinnings += managerStatistics.numSkippedSkinnings;
+    }
+    return duration;
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" measures the cost of updating many osgAnimation characters, without rendering them.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("--characters <num>","Number of animated characters, default 500.");
+    arguments.getApplicationUsage()->addCommandLineOption("--clips <num>","Number of distinct animations shared by the characters, default 10.");
+    arguments.getApplicationUsage()->addCommandLineOption("--bones <num>","Number of bones per character, default 80.");
+    arguments.getApplicationUsage()->addCommandLineOption("--keys <num>","Number of keys per channel, default 300.");
+    arguments.getApplicationUsage()->addCommandLineOption("--frames <num>","Number of frames to update, default 100.");
+    arguments.getApplicationUsage()->addCommandLineOption("--vertices <num>","Number of skinned vertices per character, default 2000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--compress","Also measure the keyframe evaluation once the keys are reduced and quantized.");
+    arguments.getApplicationUsage()->addCommandLineOption("--lod","Also measure the update of animated characters with and without animation levels of detail.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numCharacters = 500;
+    unsigned int numClips = 10;
+    unsigned int numBones = 80;
+    unsigned int numKeys = 300;
+    unsigned int numFrames = 100;
+    unsigned int numVertices = 2000;
+    while (arguments.read("--characters", numCharacters)) {}
+    while (arguments.read("--clips", numClips)) {}
+    if (numClips<1) numClips = 1;
+    while (arguments.read("--bones", numBones)) {}
+    while (arguments.read("--keys", numKeys)) {}
+    while (arguments.read("--frames", numFrames)) {}
+    while (arguments.read("--vertices", numVertices)) {}
+    bool compress = false;
+    while (arguments.read("--compress")) { compress = true; }
+    bool lod = false;
+    while (arguments.read("--lod")) { lod = true; }
+    if (numBones<1) numBones = 1;
+
+    osgAnimation::AnimationList clips;
+    for(unsigned int c=0; c<numClips; ++c)
+    {
+        clips.push_back(createCharacterAnimation(c, numBones, numKeys));
+    }
+
+    // each character plays its own copy of a clip, sharing the keyframes but with its own targets
+    osgAnimation::AnimationList animations;
+    for(unsigned int c=0; c<numCharacters; ++c)
+    {
+        osgAnimation::Animation* animation = new osgAnimation::Animation(*clips[c%numClips], osg::CopyOp::SHALLOW_COPY);
+        animation->setStartTime(double(c)*0.1);
+        animations.push_back(animation);
+    }
+
+    unsigned int numChannels = numCharacters*numBones*3;
+    std::cout<<numCharacters<<" characters playing "<<numClips<<" clips, "<<numBones<<" bones, "<<numChannels<<" channels of "<<numKeys<<" keys, "<<numFrames<<" frames"<<std::endl;
+
+    double duration = runKeyframeEvaluation(animations, numFrames, false);
+    std::cout<<"  keyframe evaluation, playback : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+             <<double(numChannels)*double(numFrames)/duration/1.0e6<<" million channels/s"<<std::endl;
+
+    duration = runKeyframeEvaluation(animations, numFrames, true);
+    std::cout<<"  keyframe evaluation, random times : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+             <<double(numChannels)*double(numFrames)/duration/1.0e6<<" million channels/s"<<std::endl;
+
+    // the same characters with each clip's channels updated through a ChannelBatch shared by its copies
+    {
+        osgAnimation::AnimationList batchedClips;
+        for(unsigned int c=0; c<numClips; ++c)
+        {
+            osgAnimation::Animation* clip = new osgAnimation::Animation(*clips[c], osg::CopyOp::SHALLOW_COPY);
+            clip->setUseChannelBatch(true);
+            batchedClips.push_back(clip);
+        }
+
+        osgAnimation::AnimationList batchedAnimations;
+        for(unsigned int c=0; c<numCharacters; ++c)
+        {
+            osgAnimation::Animation* animation = new osgAnimation::Animation(*batchedClips[c%numClips], osg::CopyOp::SHALLOW_COPY);
+            animation->setStartTime(double(c)*0.1);
+            batchedAnimations.push_back(animation);
+        }
+
+        duration = runKeyframeEvaluation(batchedAnimations, numFrames, false);
+        std::cout<<"  batched keyframe evaluation, playback : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+                 <<double(numChannels)*double(numFrames)/duration/1.0e6<<" million channels/s"<<std::endl;
+
+        duration = runKeyframeEvaluation(batchedAnimations, numFrames, true);
+        std::cout<<"  batched keyframe evaluation, random times : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+                 <<double(numChannels)*double(numFrames)/duration/1.0e6<<" million channels/s"<<std::endl;
+    }
+
+    if (compress)
+    {
+        osgAnimation::CompressKeyframesVisitor compressor;
+        osg::ElapsedTime elapsedTime;
+        for(osgAnimation::AnimationList::iterator itr = animations.begin(); itr != animations.end(); ++itr)
+        {
+            compressor.compress(*(itr->get()));
+        }
+        std::cout<<"  compression : "<<elapsedTime.elapsedTime_m()<<"ms, "
+                 <<compressor.getNumKeysBefore()<<" keys of "<<compressor.getMemoryBefore()/1024<<"KB reduced to "
+                 <<compressor.getNumKeysAfter()<<" keys of "<<compressor.getMemoryAfter()/1024<<"KB"<<std::endl;
+
+        duration = runKeyframeEvaluation(animations, numFrames, false);
+        std::cout<<"  compressed keyframe evaluation, playback : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+                 <<double(numChannels)*double(numFrames)/duration/1.0e6<<" million channels/s"<<std::endl;
+
+        duration = runKeyframeEvaluation(animations, numFrames, true);
+        std::cout<<"  compressed keyframe evaluation, random times : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+                 <<double(numChannels)*double(numFrames)/duration/1.0e6<<" million channels/s"<<std::endl;
+    }
+
+    if (numVertices>0)
+    {
+        std::cout<<numCharacters<<" characters skinning "<<numVertices<<" vertices with "<<numBones<<" bones"<<std::endl;
+
+        double numSkinnedVertices = double(numCharacters)*double(numVertices)*double(numFrames);
+        for(unsigned int method=0; method<2; ++method)
+        {
+            osgAnimation::RigTransformSoftware::BlendMethod blendMethod = method==0 ? osgAnimation::RigTransformSoftware::LINEAR_BLEND :
+                                                                                      osgAnimation::RigTransformSoftware::DUAL_QUATERNION_BLEND;
+
+            osg::ref_ptr<osgAnimation::BasicAnimationManager> manager = new osgAnimation::BasicAnimationManager;
+            osg::ref_ptr<osg::Group> root = new osg::Group;
+            for(unsigned int c=0; c<numCharacters; ++c)
+            {
+                root->addChild(createSkinnedCharacter(numBones, numVertices, blendMethod));
+            }
+
+            // without an AnimationManagerBase each RigGeometry is skinned as it's traversed
+            duration = runSkinning(root.get(), numFrames);
+            std::cout<<"  "<<(method==0 ? "linear" : "dual quaternion")<<" skinning, one by one : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+                     <<numSkinnedVertices/duration/1.0e6<<" million vertices/s"<<std::endl;
+
+            root->setUpdateCallback(manager.get());
+            duration = runSkinning(root.get(), numFrames);
+            std::cout<<"  "<<(method==0 ? "linear" : "dual quaternion")<<" skinning, queued : "<<duration*1000.0/double(numFrames)<<"ms per frame, "
+                     <<numSkinnedVertices/duration/1.0e6<<" million vertices/s"<<std::endl;
+        }
+    }
+
+    if (lod)
+    {
+        std::cout<<numCharacters<<" animated characters of "<<numBones<<" bones, skinning "<<numVertices<<" vertices"<<std::endl;
+
+        for(unsigned int useLOD=0; useLOD<2; ++useLOD)
+        {
+            osgAnimation::AnimationManagerBase::LODLevelList levels;
+            if (useLOD)
+            {
+                levels.push_back(osgAnimation::AnimationManagerBase::LODLevel(200.0f, 1, 0.0f));
+                levels.push_back(osgAnimation::AnimationManagerBase::LODLevel(50.0f, 2, 0.5f));
+                levels.push_back(osgAnimation::AnimationManagerBase::LODLevel(0.0f, 4, 0.5f));
+            }
+
+            osg::ref_ptr<osg::Group> root = new osg::Group;
+            for(unsigned int c=0; c<numCharacters; ++c)
+            {
+                osg::Group* character = createAnimatedCharacter(clips[c%numClips].get(), numBones, numVertices);
+                dynamic_cast<osgAnimation::AnimationManagerBase*>(character->getUpdateCallback())->setLODLevels(levels);
+                root->addChild(character);
+            }
+
+            osgAnimation::AnimationManagerBase::LODStatistics statistics;
+            duration = runAnimationLOD(root.get(), numFrames, statistics);
+            std::cout<<"  "<<(useLOD ? "with" : "without")<<" levels of detail : "<<duration*1000.0/double(numFrames)<<"ms per frame"<<std::endl;
+            if (useLOD)
+            {
+                std::cout<<"    animations updated "<<statistics.numUpdates<<", skipped "<<statistics.numSkippedUpdates<<std::endl;
+                std::cout<<"    bones updated "<<statistics.numBoneUpdates<<", skipped "<<statistics.numSkippedBoneUpdates<<std::endl;
+                std::cout<<"    skeletons skinned "<<statistics.numSkinnings<<", skipped "<<statistics.numSkippedSkinnings<<std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+/* OpenSceneGraph example, osgparticlebenchmark.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+#include <osg/Geode>
+
+#include <osgParticle/ParticleSystem>
+#include <osgParticle/ModularProgram>
+#include <osgParticle/AccelOperator>
+#include <osgParticle/ForceOperator>
+#include <osgParticle/FluidFrictionOperator>
+#include <osgParticle/DampingOperator>
+#include <osgParticle/BounceOperator>
+#include <osgParticle/ParticleSystemUpdater>
+
+#include <osgUtil/CullVisitor>
+#include <osgUtil/WorkerThreadPool>
+
+#include <osgViewer/Viewer>
+
+#include <iostream>
+#include <stdlib.h>
+
+// ModularProgram::execute() is normally called during the cull traversal, expose it to run the operators directly
+class BenchmarkProgram : public osgParticle::ModularProgram
+{
+public:
+    void run(double dt) { execute(dt); }
+};
+
+// an operator without a particle arrays implementation, as written by users
+class SwirlOperator : public osgParticle::Operator
+{
+public:
+    SwirlOperator() {}
+    SwirlOperator(const SwirlOperator& copy, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY) : osgParticle::Operator(copy, copyop) {}
+
+    META_Object(osgParticlebenchmark, SwirlOperator);
+
+    void operate(osgParticle::Particle* P, double dt)
+    {
+        const osg::Vec3& p = P->getPosition();
+        P->addVelocity(osg::Vec3(-p.y(), p.x(), 0.0f) * (0.1 * dt));
+    }
+};
+
+float random(float min, float max) { return min + (max-min)*float(rand())/float(RAND_MAX); }
+
+osgParticle::ParticleSystem* createParticleSystem(unsigned int numParticles)
+{
+    srand(numParticles);
+
+    osgParticle::ParticleSystem* ps = new osgParticle::ParticleSystem;
+    for(unsigned int i=0; i<numParticles; ++i)
+    {
+        osgParticle::Particle* P = ps->createParticle(0);
+        P->setPosition(osg::Vec3(random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(0.0f, 10.0f)));
+        P->setVelocity(osg::Vec3(random(-5.0f, 5.0f), random(-5.0f, 5.0f), random(-5.0f, 5.0f)));
+        P->setRadius(random(0.05f, 0.2f));
+        P->setMass(random(0.05f, 0.2f));
+    }
+    return ps;
+}
+
+BenchmarkProgram* createProgram(osgParticle::ParticleSystem* ps, bool useParticleArrays, bool userOperator)
+{
+    BenchmarkProgram* program = new BenchmarkProgram;
+    program->setParticleSystem(ps);
+    program->setReferenceFrame(osgParticle::ParticleProcessor::ABSOLUTE_RF);
+    program->setUseParticleArrays(useParticleArrays);
+
+    osgParticle::AccelOperator* accel = new osgParticle::AccelOperator;
+    accel->setToGravity();
+    program->addOperator(accel);
+
+    osgParticle::ForceOperator* force = new osgParticle::ForceOperator;
+    force->setForce(osg::Vec3(0.1f, 0.0f, 0.0f));
+    program->addOperator(force);
+
+    if (userOperator) program->addOperator(new SwirlOperator);
+
+    osgParticle::FluidFrictionOperator* friction = new osgParticle::FluidFrictionOperator;
+    friction->setFluidToAir();
+    friction->setWind(osg::Vec3(1.0f, 0.0f, 0.0f));
+    program->addOperator(friction);
+
+    osgParticle::DampingOperator* damping = new osgParticle::DampingOperator;
+    damping->setDamping(0.9f);
+    damping->setCutoff(1.0f, 100.0f);
+    program->addOperator(damping);
+
+    osgParticle::BounceOperator* bounce = new osgParticle::BounceOperator;
+    bounce->setFriction(0.2f);
+    bounce->setResilience(0.5f);
+    bounce->addPlaneDomain(osg::Plane(0.0f, 0.0f, 1.0f, 0.0f));
+    program->addOperator(bounce);
+
+    return program;
+}
+
+// emit particles living from a fraction of a second to forever, each frame, as emitters do before the update
+void emitParticles(osgParticle::ParticleSystem* ps, unsigned int numParticles)
+{
+    for(unsigned int i=0; i<numParticles; ++i)
+    {
+        osgParticle::Particle* P = ps->createParticle(0);
+        if (!P) return;
+        P->setPosition(osg::Vec3(random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(0.0f, 10.0f)));
+        P->setVelocity(osg::Vec3(random(-5.0f, 5.0f), random(-5.0f, 5.0f), random(-5.0f, 5.0f)));
+        P->setLifeTime(i%4==0 ? 0.0 : random(0.5f, 2.0f));
+        P->setSizeRange(osgParticle::rangef(0.1f, 0.5f));
+    }
+}
+
+// update the particle systems through a ParticleSystemUpdater, returning a checksum of the state of the particles
+double runUpdater(unsigned int numSystems, unsigned int numParticles, unsigned int numFrames, bool useWorkerThreads, double& duration)
+{
+    srand(numParticles);
+
+    osg::ref_ptr<osgParticle::ParticleSystemUpdater> updater = new osgParticle::ParticleSystemUpdater;
+    updater->setUseWorkerThreads(useWorkerThreads);
+    for(unsigned int i=0; i<numSystems; ++i)
+    {
+        osgParticle::ParticleSystem* ps = new osgParticle::ParticleSystem;
+        emitParticles(ps, numParticles);
+        updater->addParticleSystem(ps);
+    }
+
+    osg::ref_ptr<osgUtil::CullVisitor> cv = new osgUtil::CullVisitor;
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    cv->setFrameStamp(frameStamp.get());
+
+    duration = 0.0;
+    for(unsigned int f=0; f<=numFrames; ++f)
+    {
+        for(unsigned int i=0; i<numSystems; ++i)
+        {
+            emitParticles(updater->getParticleSystem(i), numParticles/100);
+        }
+
+        frameStamp->setFrameNumber(f+1);
+        frameStamp->setSimulationTime(double(f)/60.0);
+
+        osg::ElapsedTime elapsedTime;
+        updater->traverse(*cv);
+        duration += elapsedTime.elapsedTime_m();
+    }
+
+    double checksum = 0.0;
+    for(unsigned int i=0; i<numSystems; ++i)
+    {
+        osgParticle::ParticleSystem* ps = updater->getParticleSystem(i);
+        for(int j=0; j<ps->numParticles(); ++j)
+        {
+            const osgParticle::Particle* P = ps->getParticle(j);
+            if (!P->isAlive()) continue;
+            const osg::Vec3& p = P->getPosition();
+            checksum += double(j) * (p.x() + p.y() + p.z() + P->getCurrentSize() + P->getCurrentAlpha());
+        }
+    }
+    return checksum;
+}
+
+// time spent by the draw traversal submitting the particles to OpenGL
+class DrawTimeCallback : public osg::Drawable::DrawCallback
+{
+public:
+    DrawTimeCallback() : _duration(0.0) {}
+
+    virtual void drawImplementation(osg::RenderInfo& renderInfo, const osg::Drawable* drawable) const
+    {
+        osg::ElapsedTime elapsedTime;
+        drawable->drawImplementation(renderInfo);
+        _duration += elapsedTime.elapsedTime_m();
+    }
+
+    mutable double _duration;
+};
+
+// draw the particles in a pbuffer, as quads generated by the CPU or as instanced quads, returning false without a pbuffer
+bool runDraw(unsigned int numParticles, unsigned int numFrames, bool useInstancing, double& duration)
+{
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = 512;
+    traits->height = 512;
+    traits->pbuffer = true;
+    traits->doubleBuffer = false;
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer)
+    {
+        std::cout<<"  pixel buffer has not been created, particles not drawn"<<std::endl;
+        return false;
+    }
+
+    srand(numParticles);
+
+    osg::ref_ptr<osgParticle::ParticleSystem> ps = new osgParticle::ParticleSystem;
+    if (useInstancing) ps->setDefaultAttributesUsingInstancing("", false);
+    else ps->setDefaultAttributes("", false, false);
+    emitParticles(ps.get(), numParticles);
+    for(int i=0; i<ps->numParticles(); ++i)
+    {
+        ps->getParticle(i)->setAngularVelocity(osg::Vec3(0.0f, 0.0f, random(-3.0f, 3.0f)));
+    }
+
+    osg::ref_ptr<DrawTimeCallback> drawTime = new DrawTimeCallback;
+    ps->setDrawCallback(drawTime.get());
+
+    osg::ref_ptr<osgParticle::ParticleSystemUpdater> updater = new osgParticle::ParticleSystemUpdater;
+    updater->addParticleSystem(ps.get());
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    geode->addDrawable(ps.get());
+
+    osg::ref_ptr<osg::Group> root = new osg::Group;
+    root->addChild(geode.get());
+    root->addChild(updater.get());
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+    viewer.getCamera()->setGraphicsContext(pbuffer.get());
+    viewer.getCamera()->setViewport(new osg::Viewport(0, 0, traits->width, traits->height));
+    viewer.getCamera()->setDrawBuffer(GL_FRONT);
+    viewer.getCamera()->setReadBuffer(GL_FRONT);
+    viewer.getCamera()->setProjectionMatrixAsPerspective(60.0, 1.0, 1.0, 100.0);
+    viewer.getCamera()->setViewMatrixAsLookAt(osg::Vec3(0.0f, -30.0f, 5.0f), osg::Vec3(0.0f, 0.0f, 5.0f), osg::Vec3(0.0f, 0.0f, 1.0f));
+    viewer.setSceneData(root.get());
+    viewer.realize();
+
+    for(unsigned int f=0; f<=numFrames; ++f)
+    {
+        if (f==1) drawTime->_duration = 0.0;
+        viewer.frame(double(f)/60.0);
+    }
+
+    duration = drawTime->_duration/double(numFrames);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" measures the cost of applying the osgParticle operators, without rendering the particles.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("--particles <num>","Number of particles, default 100000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--frames <num>","Number of frames to update, default 100.");
+    arguments.getApplicationUsage()->addCommandLineOption("--systems <num>","Number of particle systems updated by the ParticleSystemUpdater, default 16.");
+    arguments.getApplicationUsage()->addCommandLineOption("--draw","Also measure the time spent drawing the particles in a pixel buffer, as quads or as instanced quads.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numParticles = 100000;
+    unsigned int numFrames = 100;
+    while (arguments.read("--particles", numParticles)) {}
+    while (arguments.read("--frames", numFrames)) {}
+    unsigned int numSystems = 16;
+    while (arguments.read("--systems", numSystems)) {}
+    bool draw = arguments.read("--draw");
+
+    std::cout<<numParticles<<" particles, "<<numFrames<<" frames, accel, force, fluid friction, damping and bounce operators"<<std::endl;
+
+    for(unsigned int userOperator=0; userOperator<2; ++userOperator)
+    {
+        if (userOperator) std::cout<<"with a user operator between the force and fluid friction operators"<<std::endl;
+
+        for(unsigned int useParticleArrays=0; useParticleArrays<2; ++useParticleArrays)
+        {
+            osg::ref_ptr<osgParticle::ParticleSystem> ps = createParticleSystem(numParticles);
+            osg::ref_ptr<BenchmarkProgram> program = createProgram(ps.get(), useParticleArrays!=0, userOperator!=0);
+
+            osg::ElapsedTime elapsedTime;
+            for(unsigned int f=0; f<numFrames; ++f)
+            {
+                program->run(1.0/60.0);
+            }
+            double duration = elapsedTime.elapsedTime_m();
+
+            std::cout<<"  "<<(useParticleArrays ? "particle arrays" : "particle by particle")<<" : "<<duration/double(numFrames)<<"ms per frame, "
+                     <<double(numParticles)*double(numFrames)/duration<<" particles/ms"<<std::endl;
+        }
+    }
+
+    std::cout<<numSystems<<" particle systems of "<<numParticles<<" particles, "<<numFrames<<" frames, ParticleSystemUpdater, "
+             <<osgUtil::WorkerThreadPool::instance()->getNumThreads()<<" worker threads"<<std::endl;
+
+    double serialDuration, concurrentDuration;
+    double serialChecksum = runUpdater(numSystems, numParticles, numFrames, false, serialDuration);
+    double concurrentChecksum = runUpdater(numSystems, numParticles, numFrames, true, concurrentDuration);
+
+    std::cout<<"  serial : "<<serialDuration/double(numFrames)<<"ms per frame"<<std::endl;
+    std::cout<<"  worker threads : "<<concurrentDuration/double(numFrames)<<"ms per frame, "
+             <<(serialChecksum==concurrentChecksum ? "same particles as the serial update" : "particles differ from the serial update")<<std::endl;
+
+    if (draw)
+    {
+        std::cout<<numParticles<<" particles drawn, "<<numFrames<<" frames"<<std::endl;
+        double duration;
+        if (runDraw(numParticles, numFrames, false, duration))
+            std::cout<<"  quads : "<<duration<<"ms per frame"<<std::endl;
+        if (runDraw(numParticles, numFrames, true, duration))
+            std::cout<<"  instanced quads : "<<duration<<"ms per frame"<<std::endl;
+    }
+
+    return 0;
+}
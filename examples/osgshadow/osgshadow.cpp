@@ -962,6 +962,11 @@ int main(int argc, char** argv)
         if (arguments.read("--parallel-split") || arguments.read("--ps") ) settings->setMultipleShadowMapHint(osgShadow::ShadowSettings::PARALLEL_SPLIT);
         if (arguments.read("--cascaded")) settings->setMultipleShadowMapHint(osgShadow::ShadowSettings::CASCADED);
 
+        double cascadeSplitWeight;
+        if (arguments.read("--cascade-split-weight",cascadeSplitWeight)) settings->setCascadeSplitWeight(cascadeSplitWeight);
+
+        if (arguments.read("--static-shadow-casters")) settings->setStaticShadowCastersHint(osgShadow::ShadowSettings::STATIC_SHADOW_CASTERS_BY_DATA_VARIANCE);
+
 
         int mapres = 1024;
         while (arguments.read("--mapres", mapres))
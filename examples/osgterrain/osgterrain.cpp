@@ -35,6 +35,7 @@
 #include <osgTerrain/GeometryTechnique>
 #include <osgTerrain/DisplacementMappingTechnique>
 #include <osgTerrain/Layer>
+#include <osgTerrain/TileCache>
 
 #include <osgFX/MultiTextureControl>
 
@@ -306,7 +307,8 @@ int main(int argc, char** argv)
     viewer.addEventHandler( new osgGA::StateSetManipulator(viewer.getCamera()->getOrCreateStateSet()) );
 
     // add the stats handler
-    viewer.addEventHandler(new osgViewer::StatsHandler);
+    osg::ref_ptr<osgViewer::StatsHandler> statsHandler = new osgViewer::StatsHandler;
+    viewer.addEventHandler(statsHandler.get());
 
     // add the record camera path handler
     viewer.addEventHandler(new osgViewer::RecordCameraPathHandler);
@@ -338,6 +340,14 @@ int main(int argc, char** argv)
         osgDB::Registry::instance()->setReadFileCallback(new CleanTechniqueReadFileCallback());
     }
 
+    // obtain the proportion of each LOD range over which the displacement mapped tiles morph to their parent's heights
+    float lodMorphRatio = 0.25f;
+    while(arguments.read("--lod-morph-ratio", lodMorphRatio)) {}
+
+    // obtain the size, in MB, of the cache of tile geometry that is reused when tiles are paged back in
+    unsigned int tileCacheSize = 0;
+    while(arguments.read("--tile-cache", tileCacheSize)) {}
+
     bool setDatabaseThreadAffinity = false;
     unsigned int cpuNum = 0;
     while(arguments.read("--db-affinity", cpuNum)) { setDatabaseThreadAffinity = true; }
@@ -380,9 +390,21 @@ int main(int argc, char** argv)
     terrain->setBlendingPolicy(blendingPolicy);
 
 
+    if (tileCacheSize>0)
+    {
+        osg::ref_ptr<osgTerrain::TileCache> tileCache = new osgTerrain::TileCache;
+        tileCache->setMaximumMemory(size_t(tileCacheSize)*1024*1024);
+        tileCache->setStats(viewer.getViewerStats());
+        terrain->setTileCache(tileCache.get());
+
+        statsHandler->addUserStatsLine("Tile cache hit %", osg::Vec4(0.6f,1.0f,0.6f,1.0f), osg::Vec4(0.6f,1.0f,0.6f,0.5f),
+                                       "TileCache hit ratio", 100.0f, false, false, "", "", 100.0f);
+    }
+
     if (useDisplacementMappingTechnique)
     {
         terrain->setTerrainTechniquePrototype(new osgTerrain::DisplacementMappingTechnique());
+        terrain->getGeometryPool()->setLODMorphRatio(lodMorphRatio);
     }
 
 
@@ -0,0 +1,239 @@
+/* OpenSceneGraph example, osgterrainbuild.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/Shape>
+#include <osg/Timer>
+
+#include <osgTerrain/Terrain>
+#include <osgTerrain/TerrainTile>
+#include <osgTerrain/GeometryTechnique>
+#include <osgTerrain/Layer>
+#include <osgTerrain/TileCache>
+
+#include <osgUtil/WorkerThreadPool>
+
+#include <iostream>
+#include <iomanip>
+
+// height of the generated terrain
+float terrainHeight(double x, double y)
+{
+    return 50.0*sin(x*0.01)*cos(y*0.013) + 10.0*sin(x*0.07+y*0.05);
+}
+
+// value of the samples punched out of the terrain by --no-data-holes
+const float noDataValue = -9999.0f;
+
+// whether the sample falls in one of the circular holes of no data that dot the terrain
+bool inNoDataHole(double x, double y)
+{
+    double dx = fmod(x, 700.0)-350.0;
+    double dy = fmod(y, 900.0)-450.0;
+    return dx*dx+dy*dy < 120.0*120.0;
+}
+
+osgTerrain::TerrainTile* createTile(unsigned int tx, unsigned int ty, unsigned int numSamples, double tileSize, bool geocentric, bool colorLayer, bool noDataHoles)
+{
+    osg::ref_ptr<osgTerrain::Locator> locator = new osgTerrain::Locator;
+    if (geocentric)
+    {
+        // tiles of a tenth of a degree from the equator
+        double tileAngle = osg::DegreesToRadians(0.1);
+        locator->setCoordinateSystemType(osgTerrain::Locator::GEOCENTRIC);
+        locator->setTransformAsExtents(double(tx)*tileAngle, double(ty)*tileAngle, double(tx+1)*tileAngle, double(ty+1)*tileAngle);
+    }
+    else
+    {
+        locator->setCoordinateSystemType(osgTerrain::Locator::PROJECTED);
+        locator->setTransformAsExtents(double(tx)*tileSize, double(ty)*tileSize, double(tx+1)*tileSize, double(ty+1)*tileSize);
+    }
+
+    osg::ref_ptr<osg::HeightField> heightField = new osg::HeightField;
+    heightField->allocate(numSamples, numSamples);
+    heightField->setSkirtHeight(tileSize*0.01);
+    double interval = tileSize/double(numSamples-1);
+
+    // with holes, the odd tile has no data at all and so no geometry
+    bool emptyTile = noDataHoles && (tx*7+ty*3)%17==0;
+    for(unsigned int r=0; r<numSamples; ++r)
+    {
+        for(unsigned int c=0; c<numSamples; ++c)
+        {
+            double x = double(tx)*tileSize+double(c)*interval;
+            double y = double(ty)*tileSize+double(r)*interval;
+            heightField->setHeight(c, r, (noDataHoles && (emptyTile || inNoDataHole(x, y))) ? noDataValue : terrainHeight(x, y));
+        }
+    }
+
+    osg::ref_ptr<osgTerrain::HeightFieldLayer> elevationLayer = new osgTerrain::HeightFieldLayer(heightField.get());
+    elevationLayer->setLocator(locator.get());
+    if (noDataHoles) elevationLayer->setValidDataOperator(new osgTerrain::NoDataValue(noDataValue));
+
+    osgTerrain::TerrainTile* tile = new osgTerrain::TerrainTile;
+    tile->setTileID(osgTerrain::TileID(0, tx, ty));
+    tile->setLocator(locator.get());
+    tile->setElevationLayer(elevationLayer.get());
+
+    if (colorLayer)
+    {
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        image->allocateImage(16, 16, 1, GL_RGB, GL_UNSIGNED_BYTE);
+        memset(image->data(), 128, image->getTotalSizeInBytes());
+
+        osg::ref_ptr<osgTerrain::ImageLayer> imageLayer = new osgTerrain::ImageLayer(image.get());
+        imageLayer->setLocator(locator.get());
+        tile->setColorLayer(0, imageLayer.get());
+    }
+
+    return tile;
+}
+
+// sum up the vertices, normals and indices of the built tile so that different builds can be checked to give the same geometry.
+class ChecksumVisitor : public osg::NodeVisitor
+{
+public:
+    ChecksumVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        checksum(0.0) {}
+
+    virtual void apply(osg::Geode& geode)
+    {
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+            if (!geometry) continue;
+
+            const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+            const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>(geometry->getNormalArray());
+            for(unsigned int vi=0; vertices && vi<vertices->size(); ++vi)
+            {
+                checksum += double((*vertices)[vi].x()+(*vertices)[vi].y()+(*vertices)[vi].z())*double(vi%7+1);
+                if (normals && vi<normals->size()) checksum += double((*normals)[vi].x()+(*normals)[vi].y()+(*normals)[vi].z())*double(vi%5+1);
+            }
+
+            for(unsigned int pi=0; pi<geometry->getNumPrimitiveSets(); ++pi)
+            {
+                osg::DrawElements* elements = geometry->getPrimitiveSet(pi)->getDrawElements();
+                for(unsigned int ei=0; elements && ei<elements->getNumIndices(); ++ei)
+                {
+                    checksum += double(elements->getElement(ei)*(ei%3+1));
+                }
+            }
+        }
+    }
+
+    double checksum;
+};
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" measures how long osgTerrain::GeometryTechnique takes to build the geometry of generated terrain tiles.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options]");
+    arguments.getApplicationUsage()->addCommandLineOption("--tiles <num>","Number of tiles to build, default 1000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--samples <num>","Number of height samples along each side of a tile, default 257.");
+    arguments.getApplicationUsage()->addCommandLineOption("--geocentric","Generate geocentric rather than projected tiles.");
+    arguments.getApplicationUsage()->addCommandLineOption("--color-layer","Give each tile a color layer so that texture coordinates are generated too.");
+    arguments.getApplicationUsage()->addCommandLineOption("--no-data-holes","Punch holes of no data values into the terrain, and leave some tiles without any data at all.");
+    arguments.getApplicationUsage()->addCommandLineOption("--equalize-boundaries","Equalize the boundaries between neighbouring tiles.");
+    arguments.getApplicationUsage()->addCommandLineOption("--tile-cache <MB>","Cache the tile geometry in an osgTerrain::TileCache of the given size and build the tiles a second time.");
+    arguments.getApplicationUsage()->addEnvironmentalVariable("OSG_NUM_WORKER_THREADS <num>","Number of threads the building of each tile is spread across.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numTiles = 1000;
+    unsigned int numSamples = 257;
+    while (arguments.read("--tiles", numTiles)) {}
+    while (arguments.read("--samples", numSamples)) {}
+    bool geocentric = arguments.read("--geocentric");
+    bool colorLayer = arguments.read("--color-layer");
+    bool noDataHoles = arguments.read("--no-data-holes");
+    bool equalizeBoundaries = arguments.read("--equalize-boundaries");
+    unsigned int tileCacheSize = 0;
+    while (arguments.read("--tile-cache", tileCacheSize)) {}
+
+    if (numSamples<2)
+    {
+        std::cout<<"Need at least 2 samples along each side of a tile."<<std::endl;
+        return 1;
+    }
+
+    osg::ref_ptr<osgTerrain::Terrain> terrain = new osgTerrain::Terrain;
+    terrain->setEqualizeBoundaries(equalizeBoundaries);
+
+    osg::ref_ptr<osgTerrain::TileCache> tileCache;
+    if (tileCacheSize>0)
+    {
+        tileCache = new osgTerrain::TileCache;
+        tileCache->setMaximumMemory(size_t(tileCacheSize)*1024*1024);
+        terrain->setTileCache(tileCache.get());
+    }
+
+    std::cout<<"building "<<numTiles<<" tiles of "<<numSamples<<"x"<<numSamples<<" samples with "<<osgUtil::WorkerThreadPool::instance()->getNumThreads()<<" threads"<<std::endl;
+
+    // when there is a TileCache build the tiles a second time, as a pager would on revisiting an area
+    unsigned int numPasses = tileCache.valid() ? 2 : 1;
+    for(unsigned int pass=0; pass<numPasses; ++pass)
+    {
+        terrain->removeChildren(0, terrain->getNumChildren());
+
+        // lay the tiles out on a square grid so that they have neighbours to equalize boundaries with
+        unsigned int numColumns = static_cast<unsigned int>(ceil(sqrt(static_cast<double>(numTiles))));
+        std::vector< osg::ref_ptr<osgTerrain::TerrainTile> > tiles;
+        for(unsigned int i=0; i<numTiles; ++i)
+        {
+            osgTerrain::TerrainTile* tile = createTile(i%numColumns, i/numColumns, numSamples, 1000.0, geocentric, colorLayer, noDataHoles);
+            tile->setTerrainTechnique(new osgTerrain::GeometryTechnique);
+            tile->setTerrain(terrain.get());
+            terrain->addChild(tile);
+            tiles.push_back(tile);
+        }
+
+        osg::ElapsedTime elapsedTime;
+        for(unsigned int i=0; i<tiles.size(); ++i)
+        {
+            tiles[i]->init(osgTerrain::TerrainTile::ALL_DIRTY, true);
+        }
+        double buildTime = elapsedTime.elapsedTime_m();
+
+        ChecksumVisitor checksumVisitor;
+        terrain->accept(checksumVisitor);
+
+        std::cout<<"built in "<<buildTime<<"ms, "<<buildTime/double(numTiles)<<"ms per tile, checksum "<<std::setprecision(15)<<checksumVisitor.checksum<<std::setprecision(6);
+        if (tileCache.valid())
+        {
+            std::cout<<", tile cache hits "<<tileCache->getNumHits()<<" misses "<<tileCache->getNumMisses()<<" memory "<<tileCache->getMemoryUsed()/(1024*1024)<<"MB";
+            tileCache->resetStats();
+        }
+        std::cout<<std::endl;
+    }
+
+    return 0;
+}
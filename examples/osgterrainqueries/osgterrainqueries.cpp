@@ -0,0 +1,224 @@
+/* OpenSceneGraph example, osgterrainqueries.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/KdTree>
+#include <osg/Timer>
+
+#include <osgDB/ReadFile>
+
+#include <osgSim/ElevationSlice>
+#include <osgSim/HeightAboveTerrain>
+#include <osgSim/LineOfSight>
+
+#include <osgUtil/LineSegmentIntersector>
+#include <osgUtil/WorkerThreadPool>
+
+#include <iostream>
+#include <stdlib.h>
+
+// height of the generated terrain
+double terrainHeight(double x, double y)
+{
+    return 50.0*sin(x*0.01)*cos(y*0.013) + 10.0*sin(x*0.07+y*0.05);
+}
+
+// create a square grid of terrain tiles of size*size metres, each of resolution*resolution quads
+osg::Node* createTerrain(unsigned int numTiles, double size, unsigned int resolution)
+{
+    osg::Group* group = new osg::Group;
+    double tileSize = size/double(numTiles);
+    for(unsigned int ty=0; ty<numTiles; ++ty)
+    {
+        for(unsigned int tx=0; tx<numTiles; ++tx)
+        {
+            osg::Geometry* geometry = new osg::Geometry;
+            osg::Vec3Array* vertices = new osg::Vec3Array;
+            for(unsigned int r=0; r<=resolution; ++r)
+            {
+                for(unsigned int c=0; c<=resolution; ++c)
+                {
+                    double x = (double(tx) + double(c)/double(resolution))*tileSize;
+                    double y = (double(ty) + double(r)/double(resolution))*tileSize;
+                    vertices->push_back(osg::Vec3(x, y, terrainHeight(x,y)));
+                }
+            }
+            geometry->setVertexArray(vertices);
+
+            osg::DrawElementsUInt* triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+            for(unsigned int r=0; r<resolution; ++r)
+            {
+                for(unsigned int c=0; c<resolution; ++c)
+                {
+                    unsigned int i = r*(resolution+1)+c;
+                    triangles->push_back(i); triangles->push_back(i+1); triangles->push_back(i+resolution+2);
+                    triangles->push_back(i); triangles->push_back(i+resolution+2); triangles->push_back(i+resolution+1);
+                }
+            }
+            geometry->addPrimitiveSet(triangles);
+
+            osg::Geode* geode = new osg::Geode;
+            geode->addDrawable(geometry);
+            group->addChild(geode);
+        }
+    }
+    return group;
+}
+
+// intersect all the segments with a single IntersectionVisitor, as LineOfSight and HeightAboveTerrain used to.
+void computeWithSingleVisitor(osg::Node* scene, const std::vector<osg::Vec3d>& points, double lowestHeight)
+{
+    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    for(std::vector<osg::Vec3d>::const_iterator itr = points.begin(); itr != points.end(); ++itr)
+    {
+        intersectorGroup->addIntersector(new osgUtil::LineSegmentIntersector(*itr, osg::Vec3d(itr->x(), itr->y(), lowestHeight)));
+    }
+
+    osgUtil::IntersectionVisitor intersectionVisitor(intersectorGroup.get());
+    scene->accept(intersectionVisitor);
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" measures the number of osgSim::HeightAboveTerrain and osgSim::LineOfSight queries per second against a model or a generated terrain.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options] [model]");
+    arguments.getApplicationUsage()->addCommandLineOption("--queries <num>","Number of queries per tick, default 50000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ticks <num>","Number of ticks, each with new query points, default 5.");
+    arguments.getApplicationUsage()->addCommandLineOption("--tiles <num>","Number of tiles along each side of the generated terrain, default 16.");
+    arguments.getApplicationUsage()->addCommandLineOption("--slices <num>","Number of osgSim::ElevationSlice across the whole terrain per tick, default 10.");
+    arguments.getApplicationUsage()->addCommandLineOption("--slice-spans <num>","Number of spans each ElevationSlice is split into, default 0 to let ElevationSlice choose.");
+    arguments.getApplicationUsage()->addCommandLineOption("--height-tolerance <height>","Height tolerance within which points of the ElevationSlices are left out, default 0.");
+    arguments.getApplicationUsage()->addCommandLineOption("--no-kdtrees","Don't build KdTrees for the generated terrain.");
+    arguments.getApplicationUsage()->addCommandLineOption("--single-visitor","Also time the queries done with a single IntersectionVisitor on the calling thread.");
+    arguments.getApplicationUsage()->addEnvironmentalVariable("OSG_NUM_WORKER_THREADS <num>","Number of threads the queries are spread across.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numQueries = 50000;
+    unsigned int numTicks = 5;
+    unsigned int numTiles = 16;
+    while (arguments.read("--queries", numQueries)) {}
+    while (arguments.read("--ticks", numTicks)) {}
+    while (arguments.read("--tiles", numTiles)) {}
+    unsigned int numSlices = 10;
+    unsigned int numSliceSpans = 0;
+    double heightTolerance = 0.0;
+    while (arguments.read("--slices", numSlices)) {}
+    while (arguments.read("--slice-spans", numSliceSpans)) {}
+    while (arguments.read("--height-tolerance", heightTolerance)) {}
+    bool buildKdTrees = !arguments.read("--no-kdtrees");
+    bool singleVisitor = arguments.read("--single-visitor");
+
+    osg::ref_ptr<osg::Node> scene = osgDB::readNodeFiles(arguments);
+    if (!scene)
+    {
+        scene = createTerrain(numTiles, 10000.0, 64);
+        if (buildKdTrees)
+        {
+            osg::ref_ptr<osg::KdTreeBuilder> kdTreeBuilder = new osg::KdTreeBuilder;
+            scene->accept(*kdTreeBuilder);
+        }
+    }
+
+    osg::BoundingSphere bs = scene->getBound();
+    double lowestHeight = bs.center().z()-bs.radius();
+
+    std::cout<<numQueries<<" queries per tick spread across "<<osgUtil::WorkerThreadPool::instance()->getNumThreads()<<" threads"<<std::endl;
+
+    osgSim::HeightAboveTerrain hat;
+    hat.setLowestHeight(lowestHeight);
+    osgSim::LineOfSight los;
+    los.setDatabaseCacheReadCallback(hat.getDatabaseCacheReadCallback());
+
+    osgSim::ElevationSlice es;
+    es.setDatabaseCacheReadCallback(hat.getDatabaseCacheReadCallback());
+    es.setNumSpans(numSliceSpans);
+    es.setHeightTolerance(heightTolerance);
+
+    double hatTime = 0.0, losTime = 0.0, singleVisitorTime = 0.0, sliceTime = 0.0;
+    unsigned int numSlicePoints = 0;
+    for(unsigned int tick=0; tick<numTicks; ++tick)
+    {
+        // random points above the terrain, in no particular order as entities in a simulation would be
+        std::vector<osg::Vec3d> points;
+        hat.clear();
+        los.clear();
+        for(unsigned int i=0; i<numQueries; ++i)
+        {
+            double x = bs.center().x() + bs.radius()*(2.0*double(rand())/double(RAND_MAX)-1.0)*0.7;
+            double y = bs.center().y() + bs.radius()*(2.0*double(rand())/double(RAND_MAX)-1.0)*0.7;
+            osg::Vec3d point(x, y, bs.center().z()+bs.radius());
+            points.push_back(point);
+            hat.addPoint(point);
+            los.addLOS(point, point + osg::Vec3d(bs.radius()*0.05, bs.radius()*0.05, -bs.radius()*1.5));
+        }
+
+        osg::ElapsedTime elapsedTime;
+        hat.computeIntersections(scene.get());
+        hatTime += elapsedTime.elapsedTime();
+
+        elapsedTime.reset();
+        los.computeIntersections(scene.get());
+        losTime += elapsedTime.elapsedTime();
+
+        for(unsigned int i=0; i<numSlices; ++i)
+        {
+            // long profiles from one side of the terrain to the other
+            double angle = osg::PI*double(rand())/double(RAND_MAX);
+            osg::Vec3d direction(cos(angle)*bs.radius()*0.7, sin(angle)*bs.radius()*0.7, 0.0);
+            es.setStartPoint(bs.center()-direction);
+            es.setEndPoint(bs.center()+direction);
+
+            elapsedTime.reset();
+            es.computeIntersections(scene.get());
+            sliceTime += elapsedTime.elapsedTime();
+
+            numSlicePoints += es.getIntersections().size();
+        }
+
+        if (singleVisitor)
+        {
+            elapsedTime.reset();
+            computeWithSingleVisitor(scene.get(), points, lowestHeight);
+            singleVisitorTime += elapsedTime.elapsedTime();
+        }
+    }
+
+    double totalQueries = double(numQueries)*double(numTicks);
+    std::cout<<"HeightAboveTerrain: "<<totalQueries/hatTime<<" queries/sec"<<std::endl;
+    std::cout<<"LineOfSight: "<<totalQueries/losTime<<" queries/sec"<<std::endl;
+    if (numSlices>0)
+    {
+        double totalSlices = double(numSlices)*double(numTicks);
+        std::cout<<"ElevationSlice: "<<totalSlices/sliceTime<<" slices/sec, "<<double(numSlicePoints)/totalSlices<<" points per slice"<<std::endl;
+    }
+    if (singleVisitor) std::cout<<"single IntersectionVisitor: "<<totalQueries/singleVisitorTime<<" queries/sec"<<std::endl;
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+/* OpenSceneGraph example, osgtextbatch.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Geode>
+#include <osg/Timer>
+
+#include <osgText/Text>
+#include <osgText/TextBatch>
+
+#include <osgViewer/Viewer>
+#include <osgViewer/ViewerEventHandlers>
+
+#include <osgGA/TrackballManipulator>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+typedef std::vector< osg::ref_ptr<osgText::Text> > TextList;
+
+// Changes the text of a few labels each frame, as a map showing live values would, and updates the batch.
+class UpdateLabelsCallback : public osg::NodeCallback
+{
+public:
+    UpdateLabelsCallback(const TextList& texts, osgText::TextBatch* batch, unsigned int numUpdates):
+        _texts(texts),
+        _batch(batch),
+        _numUpdates(numUpdates),
+        _next(0),
+        _frameNumber(0),
+        _updateTime(0.0) {}
+
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        osg::ElapsedTime elapsedTime;
+
+        for(unsigned int i=0; i<_numUpdates && !_texts.empty(); ++i)
+        {
+            osgText::Text* text = _texts[_next].get();
+            _next = (_next+1)%_texts.size();
+
+            std::ostringstream os;
+            os<<"label "<<_next<<" frame "<<_frameNumber;
+            text->setText(os.str());
+
+            if (_batch.valid()) _batch->dirtyText(text);
+        }
+
+        _updateTime += elapsedTime.elapsedTime_m();
+        ++_frameNumber;
+
+        traverse(node, nv);
+    }
+
+    double getAverageUpdateTime() const { return _frameNumber>0 ? _updateTime/double(_frameNumber) : 0.0; }
+
+protected:
+
+    TextList                            _texts;
+    osg::ref_ptr<osgText::TextBatch>    _batch;
+    unsigned int                        _numUpdates;
+    unsigned int                        _next;
+    unsigned int                        _frameNumber;
+    double                              _updateTime;
+};
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" compares drawing many osgText::Text labels each as its own drawable with drawing them through an osgText::TextBatch.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options] [fontfile]");
+    arguments.getApplicationUsage()->addCommandLineOption("--labels <num>","Number of labels, default 20000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--updates <num>","Number of labels changed each frame, default 100.");
+    arguments.getApplicationUsage()->addCommandLineOption("--frames <num>","Number of frames to render before reporting the frame times and exiting, default 0 to run until the viewer is closed.");
+    arguments.getApplicationUsage()->addCommandLineOption("--no-batch","Add each label to the scene graph rather than to a TextBatch.");
+    arguments.getApplicationUsage()->addCommandLineOption("--sdf","Use signed distance field glyphs.");
+    arguments.getApplicationUsage()->addCommandLineOption("--threaded","Use the DrawThreadPerContext threading model, so the labels are updated while the previous frame is drawn.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numLabels = 20000;
+    unsigned int numUpdates = 100;
+    unsigned int numFrames = 0;
+    while (arguments.read("--labels", numLabels)) {}
+    while (arguments.read("--updates", numUpdates)) {}
+    while (arguments.read("--frames", numFrames)) {}
+    bool batched = !arguments.read("--no-batch");
+    bool sdf = arguments.read("--sdf");
+    bool threaded = arguments.read("--threaded");
+
+    osgViewer::Viewer viewer(arguments);
+    if (threaded) viewer.setThreadingModel(osgViewer::Viewer::DrawThreadPerContext);
+
+    std::string fontFile("fonts/arial.ttf");
+    for(int pos=1; pos<arguments.argc(); ++pos)
+    {
+        if (!arguments.isOption(pos)) fontFile = arguments[pos];
+    }
+
+    osg::ref_ptr<osgText::Font> font = osgText::readFontFile(fontFile);
+    if (!font) font = osgText::Font::getDefaultFont();
+    if (sdf) font->setGlyphImageMode(osgText::Font::SIGNED_DISTANCE_FIELD);
+
+    osg::ElapsedTime elapsedTime;
+
+    // lay the labels out on a square grid
+    unsigned int numColumns = static_cast<unsigned int>(ceilf(sqrtf(static_cast<float>(numLabels))));
+    TextList texts;
+    for(unsigned int i=0; i<numLabels; ++i)
+    {
+        std::ostringstream os;
+        os<<"label "<<i;
+
+        osgText::Text* text = new osgText::Text;
+        text->setFont(font.get());
+        text->setCharacterSize(1.0f);
+        text->setPosition(osg::Vec3(float(i%numColumns)*6.0f, float(i/numColumns)*2.0f, 0.0f));
+        text->setColor(osg::Vec4(1.0f, 1.0f, float(i%3)*0.5f, 1.0f));
+        text->setText(os.str());
+        texts.push_back(text);
+
+        // labels drawn directly are changed in the update traversal just as the TextBatch is, so with
+        // the threaded models they need to be DYNAMIC too, a TextBatch is DYNAMIC by default.
+        if (numUpdates>0) text->setDataVariance(osg::Object::DYNAMIC);
+    }
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    osg::ref_ptr<osgText::TextBatch> batch;
+    if (batched)
+    {
+        batch = new osgText::TextBatch;
+        for(TextList::iterator itr = texts.begin(); itr != texts.end(); ++itr)
+        {
+            batch->addText(itr->get());
+        }
+        geode->addDrawable(batch.get());
+    }
+    else
+    {
+        for(TextList::iterator itr = texts.begin(); itr != texts.end(); ++itr)
+        {
+            geode->addDrawable(itr->get());
+        }
+    }
+
+    std::cout<<numLabels<<" labels created in "<<elapsedTime.elapsedTime_m()<<"ms";
+    if (batch.valid()) std::cout<<", "<<batch->getNumGlyphs()<<" glyphs drawn with "<<batch->getNumDrawCalls()<<" draw calls";
+    std::cout<<std::endl;
+
+    osg::ref_ptr<UpdateLabelsCallback> updateCallback = new UpdateLabelsCallback(texts, batch.get(), numUpdates);
+    geode->setUpdateCallback(updateCallback.get());
+
+    viewer.setSceneData(geode.get());
+    viewer.setCameraManipulator(new osgGA::TrackballManipulator);
+    viewer.addEventHandler(new osgViewer::StatsHandler);
+
+    if (numFrames==0) return viewer.run();
+
+    viewer.realize();
+
+    // skip the first frame which compiles the GL objects
+    viewer.frame();
+
+    osg::ElapsedTime frameTime;
+    for(unsigned int i=0; i<numFrames && !viewer.done(); ++i)
+    {
+        viewer.frame();
+    }
+
+    std::cout<<(threaded ? "DrawThreadPerContext, " : "")
+             <<"average frame time "<<frameTime.elapsedTime_m()/double(numFrames)<<"ms, "
+             <<"average update time "<<updateCallback->getAverageUpdateTime()<<"ms for "<<numUpdates<<" labels changed per frame"<<std::endl;
+
+    return 0;
+}
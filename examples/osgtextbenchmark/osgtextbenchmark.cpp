@@ -0,0 +1,198 @@
+/* OpenSceneGraph example, osgtextbenchmark.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Timer>
+
+#include <osgText/Font>
+#include <osgText/Text>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Barrier>
+
+#include <iostream>
+#include <vector>
+
+// first and number of charcodes of the CJK unified ideographs block
+const unsigned int CJK_FIRST = 0x4E00;
+const unsigned int CJK_RANGE = 0x5200;
+
+// Creates labels of random CJK characters, as a database pager thread loading a labels layer would.
+class LayoutThread : public OpenThreads::Thread
+{
+public:
+    LayoutThread(osgText::Font* font, OpenThreads::Barrier* barrier, unsigned int seed,
+                 unsigned int numLabels, unsigned int numCharacters, unsigned int numDistinctCharacters, unsigned int numResolutions):
+        _font(font),
+        _barrier(barrier),
+        _seed(seed),
+        _numLabels(numLabels),
+        _numCharacters(numCharacters),
+        _numDistinctCharacters(numDistinctCharacters),
+        _numResolutions(numResolutions),
+        _numGlyphs(0) {}
+
+    virtual void run()
+    {
+        _barrier->block();
+
+        for(unsigned int i=0; i<_numLabels; ++i)
+        {
+            osgText::String label;
+            for(unsigned int c=0; c<_numCharacters; ++c)
+            {
+                label.push_back(CJK_FIRST + random()%_numDistinctCharacters);
+            }
+
+            osg::ref_ptr<osgText::Text> text = new osgText::Text;
+            text->setFont(_font.get());
+            text->setCharacterSize(10.0f);
+            // labels of different sizes each use their own font resolution, 16, 24, 32...
+            unsigned int resolution = 16+8*(i%_numResolutions);
+            text->setFontResolution(resolution,resolution);
+            text->setText(label);
+
+            const osgText::Text::TextureGlyphQuadMap& quads = text->getTextureGlyphQuadMap();
+            for(osgText::Text::TextureGlyphQuadMap::const_iterator itr = quads.begin(); itr != quads.end(); ++itr)
+            {
+                _numGlyphs += itr->second._glyphs.size();
+            }
+        }
+    }
+
+    unsigned int getNumGlyphs() const { return _numGlyphs; }
+
+protected:
+
+    // small linear congruential generator, rand() isn't thread safe
+    unsigned int random()
+    {
+        _seed = _seed*1103515245u + 12345u;
+        return _seed>>8;
+    }
+
+    osg::ref_ptr<osgText::Font> _font;
+    OpenThreads::Barrier*       _barrier;
+    unsigned int                _seed;
+    unsigned int                _numLabels;
+    unsigned int                _numCharacters;
+    unsigned int                _numDistinctCharacters;
+    unsigned int                _numResolutions;
+    unsigned int                _numGlyphs;
+};
+
+// lay out the labels from numThreads threads at once, return the time taken in milliseconds
+double runLayout(osgText::Font* font, unsigned int numThreads, unsigned int numLabels, unsigned int numCharacters,
+                 unsigned int numDistinctCharacters, unsigned int numResolutions, unsigned int& numGlyphs)
+{
+    OpenThreads::Barrier barrier(numThreads+1);
+
+    std::vector<LayoutThread*> threads;
+    for(unsigned int t=0; t<numThreads; ++t)
+    {
+        LayoutThread* thread = new LayoutThread(font, &barrier, t+1, numLabels, numCharacters, numDistinctCharacters, numResolutions);
+        thread->start();
+        threads.push_back(thread);
+    }
+
+    barrier.block();
+    osg::ElapsedTime elapsedTime;
+
+    numGlyphs = 0;
+    for(unsigned int t=0; t<numThreads; ++t)
+    {
+        threads[t]->join();
+        numGlyphs += threads[t]->getNumGlyphs();
+        delete threads[t];
+    }
+
+    return elapsedTime.elapsedTime_m();
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" measures the cost of laying out osgText::Text labels of CJK characters from several threads sharing a font.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options] [fontfile]");
+    arguments.getApplicationUsage()->addCommandLineOption("--threads <num>","Number of threads creating labels, default 8.");
+    arguments.getApplicationUsage()->addCommandLineOption("--labels <num>","Number of labels created by each thread, default 2000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--characters <num>","Number of characters of each label, default 12.");
+    arguments.getApplicationUsage()->addCommandLineOption("--distinct <num>","Number of distinct characters the labels are made of, default 3000.");
+    arguments.getApplicationUsage()->addCommandLineOption("--resolutions <num>","Number of font resolutions the labels are laid out at, default 1.");
+    arguments.getApplicationUsage()->addCommandLineOption("--sdf","Create signed distance field glyphs, shared by all the font resolutions.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int numThreads = 8;
+    unsigned int numLabels = 2000;
+    unsigned int numCharacters = 12;
+    unsigned int numDistinctCharacters = 3000;
+    while (arguments.read("--threads", numThreads)) {}
+    while (arguments.read("--labels", numLabels)) {}
+    while (arguments.read("--characters", numCharacters)) {}
+    while (arguments.read("--distinct", numDistinctCharacters)) {}
+    unsigned int numResolutions = 1;
+    while (arguments.read("--resolutions", numResolutions)) {}
+    if (numResolutions<1) numResolutions = 1;
+    bool sdf = arguments.read("--sdf");
+    if (numDistinctCharacters<1 || numDistinctCharacters>CJK_RANGE) numDistinctCharacters = CJK_RANGE;
+
+    std::string fontFile("fonts/arial.ttf");
+    for(int pos=1; pos<arguments.argc(); ++pos)
+    {
+        if (!arguments.isOption(pos)) fontFile = arguments[pos];
+    }
+
+    osg::ref_ptr<osgText::Font> font = osgText::readFontFile(fontFile);
+    if (!font)
+    {
+        std::cout<<"Unable to load "<<fontFile<<", using the default font which only provides ASCII glyphs."<<std::endl;
+        font = osgText::Font::getDefaultFont();
+    }
+
+    if (sdf) font->setGlyphImageMode(osgText::Font::SIGNED_DISTANCE_FIELD);
+
+    std::cout<<numThreads<<" threads each creating "<<numLabels<<" labels of "<<numCharacters<<" characters out of "<<numDistinctCharacters<<" distinct characters"<<std::endl;
+
+    // the first pass rasterizes the glyphs, the second one finds them all in the font's glyph cache.
+    const char* passes[] = { "glyphs created", "glyphs cached" };
+    for(unsigned int pass=0; pass<2; ++pass)
+    {
+        unsigned int numGlyphs = 0;
+        double duration = runLayout(font.get(), numThreads, numLabels, numCharacters, numDistinctCharacters, numResolutions, numGlyphs);
+        std::cout<<"  "<<passes[pass]<<": "<<duration<<"ms, "<<numGlyphs<<" glyphs laid out"<<std::endl;
+    }
+
+    const osgText::Font::GlyphTextureList& glyphTextures = font->getGlyphTextureList();
+    unsigned int textureMemory = 0;
+    for(osgText::Font::GlyphTextureList::const_iterator itr = glyphTextures.begin(); itr != glyphTextures.end(); ++itr)
+    {
+        textureMemory += (*itr)->getTextureWidth()*(*itr)->getTextureHeight();
+    }
+    std::cout<<glyphTextures.size()<<" glyph textures, "<<textureMemory/(1024*1024)<<"MB"<<std::endl;
+
+    return 0;
+}
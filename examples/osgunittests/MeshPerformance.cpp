@@ -0,0 +1,383 @@
+/* -*-c++-*- 
+*
+*  OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "MeshPerformance.h"
+
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osg/TriangleFunctor>
+#include <osg/Math>
+
+#include <osgUtil/SmoothingVisitor>
+#include <osgUtil/DelaunayTriangulator>
+#include <osgUtil/Tessellator>
+#include <osgUtil/TangentSpaceGenerator>
+#include <osgUtil/WorkerThreadPool>
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+// create a bumpy grid with a sharp ridge down the middle, either as indexed triangles or as
+// separate triangles with duplicated vertices.
+static osg::Geometry* createGrid(unsigned int numTriangles, bool indexed)
+{
+    unsigned int numColumns = static_cast<unsigned int>(sqrt(double(numTriangles)*0.5));
+    if (numColumns<2) numColumns = 2;
+    unsigned int numRows = numColumns;
+
+    osg::ref_ptr<osg::Vec3Array> grid = new osg::Vec3Array;
+    grid->reserve((numColumns+1)*(numRows+1));
+    for(unsigned int r=0; r<=numRows; ++r)
+    {
+        for(unsigned int c=0; c<=numColumns; ++c)
+        {
+            float x = float(c)/float(numColumns);
+            float y = float(r)/float(numRows);
+            float z = 0.02f*sinf(x*40.0f)*cosf(y*40.0f) + 0.5f*fabsf(x-0.5f);
+            grid->push_back(osg::Vec3(x, y, z));
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    osg::ref_ptr<osg::DrawElementsUInt> elements = new osg::DrawElementsUInt(GL_TRIANGLES);
+    elements->reserve(numRows*numColumns*6);
+    for(unsigned int r=0; r<numRows; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            unsigned int i = r*(numColumns+1)+c;
+            elements->push_back(i);
+            elements->push_back(i+1);
+            elements->push_back(i+numColumns+2);
+            elements->push_back(i);
+            elements->push_back(i+numColumns+2);
+            elements->push_back(i+numColumns+1);
+        }
+    }
+
+    if (indexed)
+    {
+        geometry->setVertexArray(grid.get());
+        geometry->addPrimitiveSet(elements.get());
+    }
+    else
+    {
+        osg::Vec3Array* vertices = new osg::Vec3Array;
+        vertices->reserve(elements->size());
+        for(osg::DrawElementsUInt::iterator itr = elements->begin(); itr != elements->end(); ++itr)
+        {
+            vertices->push_back((*grid)[*itr]);
+        }
+        geometry->setVertexArray(vertices);
+        geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, vertices->size()));
+    }
+
+    return geometry;
+}
+
+static void runSmoothingTest(const char* name, unsigned int numTriangles, bool indexed, double creaseAngle)
+{
+    osg::ref_ptr<osg::Geometry> geometry = createGrid(numTriangles, indexed);
+    unsigned int numVertices = geometry->getVertexArray()->getNumElements();
+
+    osg::ElapsedTime elapsedTime;
+    osgUtil::SmoothingVisitor::smooth(*geometry, creaseAngle);
+    double duration = elapsedTime.elapsedTime();
+
+    std::cout<<"  "<<name<<" : "<<numVertices<<" vertices in, "<<geometry->getVertexArray()->getNumElements()<<" out, "
+             <<duration*1000.0<<"ms, "<<double(numTriangles)/duration/1.0e6<<" million triangles/s"<<std::endl;
+}
+
+void runSmoothingPerformanceTests(unsigned int numTriangles)
+{
+    std::cout<<"**** SmoothingVisitor performance tests, "<<numTriangles<<" triangles, "
+             <<osgUtil::WorkerThreadPool::instance()->getNumThreads()<<" threads ******"<<std::endl;
+
+    runSmoothingTest("smooth indexed", numTriangles, true, osg::PI);
+    runSmoothingTest("smooth separate triangles", numTriangles, false, osg::PI);
+    runSmoothingTest("crease angle 45 indexed", numTriangles, true, osg::DegreesToRadians(45.0));
+    runSmoothingTest("crease angle 45 separate triangles", numTriangles, false, osg::DegreesToRadians(45.0));
+}
+
+static void runDelaunayTest(unsigned int numPoints, bool regular, bool constrained)
+{
+    osg::ref_ptr<osg::Vec3Array> points = new osg::Vec3Array;
+    points->reserve(numPoints);
+    if (regular)
+    {
+        unsigned int numColumns = static_cast<unsigned int>(sqrt(double(numPoints)));
+        for(unsigned int i=0; i<numPoints; ++i)
+        {
+            float x = float(i%numColumns)/float(numColumns);
+            float y = float(i/numColumns)/float(numColumns);
+            points->push_back(osg::Vec3(x, y, 0.02f*sinf(x*40.0f)*cosf(y*40.0f)));
+        }
+    }
+    else
+    {
+        srand(numPoints);
+        for(unsigned int i=0; i<numPoints; ++i)
+        {
+            float x = float(rand())/float(RAND_MAX);
+            float y = float(rand())/float(RAND_MAX);
+            points->push_back(osg::Vec3(x, y, 0.02f*sinf(x*40.0f)*cosf(y*40.0f)));
+        }
+    }
+
+    osg::ref_ptr<osgUtil::DelaunayTriangulator> triangulator = new osgUtil::DelaunayTriangulator(points.get());
+
+    if (constrained)
+    {
+        // a closed loop, like a lake outline, crossing many of the unconstrained triangles
+        osg::ref_ptr<osgUtil::DelaunayConstraint> constraint = new osgUtil::DelaunayConstraint;
+        osg::Vec3Array* vertices = new osg::Vec3Array;
+        unsigned int numSegments = 256;
+        for(unsigned int i=0; i<numSegments; ++i)
+        {
+            float angle = float(i)*2.0f*osg::PI/float(numSegments);
+            vertices->push_back(osg::Vec3(0.5013f+0.3f*cosf(angle), 0.4987f+0.3f*sinf(angle), 0.0f));
+        }
+        constraint->setVertexArray(vertices);
+        constraint->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::LINE_LOOP, 0, vertices->size()));
+        triangulator->addInputConstraint(constraint.get());
+    }
+
+    osg::ElapsedTime elapsedTime;
+    triangulator->triangulate();
+    double duration = elapsedTime.elapsedTime();
+
+    unsigned int numTriangles = triangulator->getTriangles() ? triangulator->getTriangles()->getNumPrimitives() : 0;
+    std::cout<<"  "<<(regular ? "regular" : "random")<<(constrained ? " constrained " : " ")<<numPoints<<" points : "
+             <<numTriangles<<" triangles, "<<duration*1000.0<<"ms, "<<double(numPoints)/duration/1.0e6<<" million points/s"<<std::endl;
+}
+
+void runDelaunayPerformanceTests(unsigned int maxNumPoints)
+{
+    std::cout<<"**** DelaunayTriangulator performance tests, up to "<<maxNumPoints<<" points ******"<<std::endl;
+
+    for(unsigned int numPoints=10000; numPoints<=maxNumPoints; numPoints*=10)
+    {
+        runDelaunayTest(numPoints, false, false);
+        runDelaunayTest(numPoints, true, false);
+        runDelaunayTest(numPoints, false, true);
+    }
+}
+
+// create polygons like those read from shapefiles, a mix of rectangular building footprints,
+// concave L and U shaped buildings, land parcels with a few more vertices, and occasional lakes
+// with hundreds of vertices and an island, one POLYGON primitive per ring.  The number of rings of
+// each feature is appended to numRings, so that the island can be tessellated as a hole of its lake.
+static osg::Geometry* createShapes(unsigned int numPolygons, std::vector<unsigned int>& numRings)
+{
+    osg::Geometry* geometry = new osg::Geometry;
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    geometry->setVertexArray(vertices);
+
+    srand(numPolygons);
+    for(unsigned int p=0; p<numPolygons; ++p)
+    {
+        osg::Vec3 origin(float(p%1000)*10.0f, float(p/1000)*10.0f, 0.0f);
+        unsigned int first = vertices->size();
+        numRings.push_back(1);
+        unsigned int type = p%10;
+        if (type<5)
+        {
+            float w = 2.0f+float(rand()%5), h = 2.0f+float(rand()%5);
+            vertices->push_back(origin);
+            vertices->push_back(origin+osg::Vec3(0.0f,h,0.0f));
+            vertices->push_back(origin+osg::Vec3(w,h,0.0f));
+            vertices->push_back(origin+osg::Vec3(w,0.0f,0.0f));
+        }
+        else if (type<8)
+        {
+            // U shaped outline
+            float offsets[][2] = { {0,0}, {0,6}, {2,6}, {2,2}, {4,2}, {4,6}, {6,6}, {6,0} };
+            for(unsigned int i=0; i<8; ++i) vertices->push_back(origin+osg::Vec3(offsets[i][0], offsets[i][1], 0.0f));
+        }
+        else if (type<9 || p%100!=99)
+        {
+            // parcel with jittered outline
+            unsigned int numVertices = 12 + rand()%20;
+            for(unsigned int i=0; i<numVertices; ++i)
+            {
+                float angle = -float(i)*2.0f*osg::PI/float(numVertices);
+                float radius = 3.0f + float(rand())/float(RAND_MAX);
+                vertices->push_back(origin+osg::Vec3(4.0f+radius*cosf(angle), 4.0f+radius*sinf(angle), 0.0f));
+            }
+        }
+        else
+        {
+            // lake with an island
+            unsigned int numVertices = 500;
+            for(unsigned int i=0; i<numVertices; ++i)
+            {
+                float angle = -float(i)*2.0f*osg::PI/float(numVertices);
+                float radius = 3.0f + 0.5f*sinf(angle*7.0f) + 0.3f*float(rand())/float(RAND_MAX);
+                vertices->push_back(origin+osg::Vec3(4.0f+radius*cosf(angle), 4.0f+radius*sinf(angle), 0.0f));
+            }
+            geometry->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POLYGON, first, numVertices));
+            first = vertices->size();
+            numRings.back() = 2;
+            for(unsigned int i=0; i<20; ++i)
+            {
+                float angle = float(i)*2.0f*osg::PI/20.0f;
+                vertices->push_back(origin+osg::Vec3(4.0f+cosf(angle), 4.0f+sinf(angle), 0.0f));
+            }
+        }
+        geometry->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POLYGON, first, vertices->size()-first));
+    }
+    return geometry;
+}
+
+struct TriangleArea
+{
+    TriangleArea(): area(0.0) {}
+
+    void operator() (const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3, bool)
+    {
+        area += ((v2-v1)^(v3-v1)).length()*0.5;
+    }
+
+    double area;
+};
+
+static double computeTriangulatedArea(osg::Geometry& geometry)
+{
+    osg::TriangleFunctor<TriangleArea> functor;
+    geometry.accept(functor);
+    return functor.area;
+}
+
+static double runTessellatorTest(const char* name, unsigned int numPolygons, bool perFeature, bool fastPath)
+{
+    std::vector<unsigned int> numRings;
+    osg::ref_ptr<osg::Geometry> shapes = createShapes(numPolygons, numRings);
+    unsigned int numVertices = shapes->getVertexArray()->getNumElements();
+    double duration = 0.0;
+    double area = 0.0;
+
+    if (perFeature)
+    {
+        // as the shp and ogr plugins, a geometry per feature with all its rings tessellated together,
+        // so the lakes' islands are holes, which are left to glu by the fast path
+        std::vector< osg::ref_ptr<osg::Geometry> > features;
+        osg::Vec3Array* allVertices = static_cast<osg::Vec3Array*>(shapes->getVertexArray());
+        unsigned int ring = 0;
+        for(unsigned int f=0; f<numRings.size(); ++f)
+        {
+            osg::Geometry* feature = new osg::Geometry;
+            osg::Vec3Array* vertices = new osg::Vec3Array;
+            feature->setVertexArray(vertices);
+            for(unsigned int r=0; r<numRings[f]; ++r, ++ring)
+            {
+                osg::DrawArrays* drawArrays = static_cast<osg::DrawArrays*>(shapes->getPrimitiveSet(ring));
+                feature->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POLYGON, vertices->size(), drawArrays->getCount()));
+                vertices->insert(vertices->end(), allVertices->begin()+drawArrays->getFirst(), allVertices->begin()+drawArrays->getFirst()+drawArrays->getCount());
+            }
+            features.push_back(feature);
+        }
+
+        // a TESS_TYPE_GEOMETRY Tessellator keeps the number of vertices of the first geometry it is
+        // applied to, so like the plugins a new one is used for each feature
+        osg::ElapsedTime elapsedTime;
+        for(unsigned int i=0; i<features.size(); ++i)
+        {
+            osg::ref_ptr<osgUtil::Tessellator> tessellator = new osgUtil::Tessellator;
+            tessellator->setSimplePolygonFastPath(fastPath);
+            tessellator->setTessellationType(osgUtil::Tessellator::TESS_TYPE_GEOMETRY);
+            tessellator->setBoundaryOnly(false);
+            tessellator->setWindingType(osgUtil::Tessellator::TESS_WINDING_ODD);
+            tessellator->retessellatePolygons(*features[i]);
+        }
+        duration = elapsedTime.elapsedTime();
+
+        for(unsigned int i=0; i<features.size(); ++i)
+        {
+            area += computeTriangulatedArea(*features[i]);
+        }
+    }
+    else
+    {
+        // each ring is tessellated on its own, so the lakes' islands are filled rather than holes
+        osg::ref_ptr<osgUtil::Tessellator> tessellator = new osgUtil::Tessellator;
+        tessellator->setSimplePolygonFastPath(fastPath);
+
+        osg::ElapsedTime elapsedTime;
+        tessellator->retessellatePolygons(*shapes);
+        duration = elapsedTime.elapsedTime();
+
+        area = computeTriangulatedArea(*shapes);
+    }
+
+    std::cout<<"  "<<name<<(fastPath ? " simple polygon fast path : " : " glu only : ")<<numVertices<<" vertices, "
+             <<duration*1000.0<<"ms, "<<double(numPolygons)/duration/1.0e6<<" million polygons/s, triangulated area "<<area<<std::endl;
+    return duration;
+}
+
+void runTessellatorPerformanceTests(unsigned int numPolygons)
+{
+    std::cout<<"**** Tessellator performance tests, "<<numPolygons<<" shapefile like polygons ******"<<std::endl;
+
+    double glu = runTessellatorTest("per feature geometry", numPolygons, true, false);
+    double fast = runTessellatorTest("per feature geometry", numPolygons, true, true);
+    std::cout<<"    speed up "<<glu/fast<<std::endl;
+
+    glu = runTessellatorTest("all polygons in one geometry", numPolygons, false, false);
+    fast = runTessellatorTest("all polygons in one geometry", numPolygons, false, true);
+    std::cout<<"    speed up "<<glu/fast<<std::endl;
+}
+
+static void runTangentSpaceTest(const char* name, osg::Geometry* geometry, unsigned int numTriangles, bool mikktspace, bool useWorkerThreads)
+{
+    osg::ref_ptr<osgUtil::TangentSpaceGenerator> tsg = new osgUtil::TangentSpaceGenerator;
+    tsg->setMikkTSpaceCompatible(mikktspace);
+    tsg->setUseWorkerThreads(useWorkerThreads);
+
+    osg::ElapsedTime elapsedTime;
+    tsg->generate(geometry, 0);
+    double duration = elapsedTime.elapsedTime();
+
+    std::cout<<"  "<<name<<" : "<<tsg->getTangentArray()->size()<<" tangents, "
+             <<duration*1000.0<<"ms, "<<double(numTriangles)/duration/1.0e6<<" million triangles/s"<<std::endl;
+}
+
+void runTangentSpacePerformanceTests(unsigned int numTriangles)
+{
+    std::cout<<"**** TangentSpaceGenerator performance tests, "<<numTriangles<<" triangles, "
+             <<osgUtil::WorkerThreadPool::instance()->getNumThreads()<<" threads ******"<<std::endl;
+
+    osg::ref_ptr<osg::Geometry> geometry = createGrid(numTriangles, true);
+    osgUtil::SmoothingVisitor::smooth(*geometry);
+
+    const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+    osg::ref_ptr<osg::Vec2Array> texcoords = new osg::Vec2Array;
+    texcoords->reserve(vertices->size());
+    for(osg::Vec3Array::const_iterator itr = vertices->begin(); itr != vertices->end(); ++itr)
+    {
+        texcoords->push_back(osg::Vec2(itr->x()*16.0f, itr->y()*16.0f));
+    }
+    geometry->setTexCoordArray(0, texcoords.get());
+
+    runTangentSpaceTest("original basis", geometry.get(), numTriangles, false, true);
+    runTangentSpaceTest("original basis single threaded", geometry.get(), numTriangles, false, false);
+    runTangentSpaceTest("MikkTSpace basis", geometry.get(), numTriangles, true, true);
+    runTangentSpaceTest("MikkTSpace basis single threaded", geometry.get(), numTriangles, true, false);
+}
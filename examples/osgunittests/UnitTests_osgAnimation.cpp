@@ -0,0 +1,397 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "UnitTestFramework.h"
+
+#include <osg/Geode>
+
+#include <osgAnimation/Animation>
+#include <osgAnimation/Bone>
+#include <osgAnimation/RigGeometry>
+#include <osgAnimation/RigTransformSoftware>
+#include <osgAnimation/Skeleton>
+#include <osgAnimation/SkinningQueue>
+
+#include <sstream>
+
+namespace osgAnimation
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  RigTransformSoftware Tests
+//
+class RigTransformSoftwareTestFixture
+{
+public:
+
+    void testRigidBlend(const osgUtx::TestContext& ctx);
+    void testDualQuaternionBlend(const osgUtx::TestContext& ctx);
+    void testDoubleBuffered(const osgUtx::TestContext& ctx);
+    void testSkinningQueueSharedRigGeometry(const osgUtx::TestContext& ctx);
+
+private:
+
+    // skin a ring of vertices around the z axis, each influenced equally by two bones with the given matrices,
+    // the RigGeometry only observing its Skeleton, the fixture keeps the last one created
+    osg::ref_ptr<RigGeometry> skin(const osg::Matrix& matrix0, const osg::Matrix& matrix1, RigTransformSoftware::BlendMethod blendMethod, bool doubleBuffered=false);
+
+    // set the matrices of the two bones of a RigGeometry created by skin()
+    static void setBoneMatrices(RigGeometry* geom, const osg::Matrix& matrix0, const osg::Matrix& matrix1);
+
+    static const unsigned int s_numVertices = 16;
+
+    osg::ref_ptr<Skeleton> _skeleton;
+};
+
+osg::ref_ptr<RigGeometry> RigTransformSoftwareTestFixture::skin(const osg::Matrix& matrix0, const osg::Matrix& matrix1, RigTransformSoftware::BlendMethod blendMethod, bool doubleBuffered)
+{
+    osg::ref_ptr<Skeleton> skeleton = new Skeleton;
+    _skeleton = skeleton;
+
+    Bone* bone0 = new Bone("bone0");
+    bone0->setMatrixInSkeletonSpace(matrix0);
+    skeleton->addChild(bone0);
+
+    Bone* bone1 = new Bone("bone1");
+    bone1->setMatrixInSkeletonSpace(matrix1);
+    skeleton->addChild(bone1);
+
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    osg::Vec3Array* normals = new osg::Vec3Array;
+    VertexInfluenceMap* influenceMap = new VertexInfluenceMap;
+    (*influenceMap)["bone0"].setName("bone0");
+    (*influenceMap)["bone1"].setName("bone1");
+    for(unsigned int i=0; i<s_numVertices; ++i)
+    {
+        float angle = 2.0f*osg::PI*float(i)/float(s_numVertices);
+        vertices->push_back(osg::Vec3(cosf(angle), sinf(angle), 1.0f));
+        normals->push_back(osg::Vec3(cosf(angle), sinf(angle), 0.0f));
+
+        (*influenceMap)["bone0"].push_back(VertexIndexWeight(i, 0.5f));
+        (*influenceMap)["bone1"].push_back(VertexIndexWeight(i, 0.5f));
+    }
+
+    osg::Geometry* source = new osg::Geometry;
+    source->setVertexArray(vertices);
+    source->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+    source->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, s_numVertices));
+
+    RigTransformSoftware* rigTransform = new RigTransformSoftware;
+    rigTransform->setBlendMethod(blendMethod);
+    rigTransform->setDoubleBuffered(doubleBuffered);
+
+    osg::ref_ptr<RigGeometry> rigGeometry = new RigGeometry;
+    rigGeometry->setSourceGeometry(source);
+    rigGeometry->setInfluenceMap(influenceMap);
+    rigGeometry->setRigTransformImplementation(rigTransform);
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(rigGeometry.get());
+    skeleton->addChild(geode);
+
+    rigGeometry->buildVertexInfluenceSet();
+    rigGeometry->setSkeleton(skeleton.get());
+    rigGeometry->computeMatrixFromRootSkeleton();
+    rigGeometry->update();
+
+    return rigGeometry;
+}
+
+void RigTransformSoftwareTestFixture::setBoneMatrices(RigGeometry* geom, const osg::Matrix& matrix0, const osg::Matrix& matrix1)
+{
+    static_cast<Bone*>(geom->getSkeleton()->getChild(0))->setMatrixInSkeletonSpace(matrix0);
+    static_cast<Bone*>(geom->getSkeleton()->getChild(1))->setMatrixInSkeletonSpace(matrix1);
+}
+
+void RigTransformSoftwareTestFixture::testRigidBlend(const osgUtx::TestContext&)
+{
+    // bones moved alike move the vertices rigidly, whatever the blend method
+    osg::Matrix matrix = osg::Matrix::rotate(osg::PI_2, osg::Vec3(0.0f, 0.0f, 1.0f))*osg::Matrix::translate(1.0f, 2.0f, 3.0f);
+
+    for(unsigned int method=0; method<2; ++method)
+    {
+        osg::ref_ptr<RigGeometry> geom = skin(matrix, matrix, method==0 ? RigTransformSoftware::LINEAR_BLEND : RigTransformSoftware::DUAL_QUATERNION_BLEND);
+
+        const osg::Vec3Array* source = static_cast<const osg::Vec3Array*>(geom->getSourceGeometry()->getVertexArray());
+        const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geom->getVertexArray());
+        const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>(geom->getNormalArray());
+        OSGUTX_TEST_F( vertices && vertices->size()==s_numVertices && normals && normals->size()==s_numVertices )
+
+        for(unsigned int i=0; i<s_numVertices; ++i)
+        {
+            OSGUTX_TEST_F( ((*vertices)[i] - (*source)[i]*matrix).length()<1e-5f )
+
+            osg::Vec3 sourceNormal = (*static_cast<const osg::Vec3Array*>(geom->getSourceGeometry()->getNormalArray()))[i];
+            OSGUTX_TEST_F( ((*normals)[i] - osg::Matrix::transform3x3(sourceNormal, matrix)).length()<1e-5f )
+        }
+    }
+}
+
+void RigTransformSoftwareTestFixture::testDualQuaternionBlend(const osgUtx::TestContext&)
+{
+    // half way between an unrotated bone and one turned by 90 degrees, dual quaternions turn the
+    // vertices by 45 degrees, keeping their distance to the axis, where the linear blend pulls them in
+    osg::Matrix matrix1 = osg::Matrix::rotate(osg::PI_2, osg::Vec3(0.0f, 0.0f, 1.0f));
+    osg::Matrix halfway = osg::Matrix::rotate(osg::PI_4, osg::Vec3(0.0f, 0.0f, 1.0f));
+
+    osg::ref_ptr<RigGeometry> dualQuaternion = skin(osg::Matrix::identity(), matrix1, RigTransformSoftware::DUAL_QUATERNION_BLEND);
+    osg::ref_ptr<RigGeometry> linear = skin(osg::Matrix::identity(), matrix1, RigTransformSoftware::LINEAR_BLEND);
+
+    const osg::Vec3Array* source = static_cast<const osg::Vec3Array*>(dualQuaternion->getSourceGeometry()->getVertexArray());
+    const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(dualQuaternion->getVertexArray());
+    const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>(dualQuaternion->getNormalArray());
+    const osg::Vec3Array* linearVertices = dynamic_cast<const osg::Vec3Array*>(linear->getVertexArray());
+    OSGUTX_TEST_F( vertices && vertices->size()==s_numVertices && normals && normals->size()==s_numVertices )
+    OSGUTX_TEST_F( linearVertices && linearVertices->size()==s_numVertices )
+
+    for(unsigned int i=0; i<s_numVertices; ++i)
+    {
+        osg::Vec3 expected = (*source)[i]*halfway;
+        OSGUTX_TEST_F( ((*vertices)[i] - expected).length()<1e-5f )
+        OSGUTX_TEST_F( fabsf((*normals)[i].length()-1.0f)<1e-5f )
+
+        osg::Vec3 radial((*linearVertices)[i].x(), (*linearVertices)[i].y(), 0.0f);
+        OSGUTX_TEST_F( fabsf(radial.length()-sqrtf(0.5f))<1e-5f )
+    }
+}
+
+void RigTransformSoftwareTestFixture::testDoubleBuffered(const osgUtx::TestContext&)
+{
+    osg::Matrix matrix0 = osg::Matrix::translate(1.0f, 0.0f, 0.0f);
+    osg::Matrix matrix1 = osg::Matrix::translate(0.0f, 1.0f, 0.0f);
+
+    osg::ref_ptr<RigGeometry> geom = skin(matrix0, matrix0, RigTransformSoftware::LINEAR_BLEND, true);
+    const osg::Vec3Array* source = static_cast<const osg::Vec3Array*>(geom->getSourceGeometry()->getVertexArray());
+
+    // the skinned vertices are drawn from the front buffer, chosen at draw time, so the RigGeometry is left alone
+    RigTransformSoftware::BufferedDrawCallback* callback = dynamic_cast<RigTransformSoftware::BufferedDrawCallback*>(geom->getDrawCallback());
+    OSGUTX_TEST_F( callback!=0 )
+    if (!callback) return;
+    OSGUTX_TEST_F( geom->getVertexArray()==source )
+
+    const osg::Geometry* front = callback->getFrontBuffer();
+    const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(front->getVertexArray());
+    OSGUTX_TEST_F( vertices && vertices->size()==s_numVertices && front->getPrimitiveSetList()==geom->getPrimitiveSetList() )
+
+    // skinning the next frame leaves the buffer drawn the frame before untouched, and doesn't need a DYNAMIC RigGeometry
+    geom->setDataVariance(osg::Object::STATIC);
+    setBoneMatrices(geom.get(), matrix1, matrix1);
+    geom->update();
+    OSGUTX_TEST_F( geom->getDataVariance()==osg::Object::STATIC )
+
+    const osg::Geometry* nextFront = callback->getFrontBuffer();
+    const osg::Vec3Array* nextVertices = dynamic_cast<const osg::Vec3Array*>(nextFront->getVertexArray());
+    OSGUTX_TEST_F( nextFront!=front && nextVertices && nextVertices->size()==s_numVertices )
+
+    for(unsigned int i=0; i<s_numVertices && vertices && nextVertices; ++i)
+    {
+        OSGUTX_TEST_F( ((*vertices)[i] - (*source)[i]*matrix0).length()<1e-5f )
+        OSGUTX_TEST_F( ((*nextVertices)[i] - (*source)[i]*matrix1).length()<1e-5f )
+    }
+
+    // each buffer is drawn in turn
+    geom->update();
+    OSGUTX_TEST_F( callback->getFrontBuffer()!=front && callback->getFrontBuffer()!=nextFront )
+    geom->update();
+    OSGUTX_TEST_F( callback->getFrontBuffer()==front )
+}
+
+void RigTransformSoftwareTestFixture::testSkinningQueueSharedRigGeometry(const osgUtx::TestContext&)
+{
+    osg::Matrix matrix = osg::Matrix::translate(0.0f, 0.0f, 1.0f);
+    osg::ref_ptr<RigGeometry> geom = skin(osg::Matrix::identity(), osg::Matrix::identity(), RigTransformSoftware::LINEAR_BLEND);
+
+    osg::ref_ptr<osg::Geode> secondParent = new osg::Geode;
+    secondParent->addDrawable(geom.get());
+
+    // visited through both parents, the RigGeometry is skinned once
+    osg::ref_ptr<SkinningQueue> queue = new SkinningQueue;
+    setBoneMatrices(geom.get(), matrix, matrix);
+    queue->add(geom.get());
+    queue->add(geom.get());
+    OSGUTX_TEST_F( queue->size()==1 )
+    queue->run();
+    OSGUTX_TEST_F( queue->empty() )
+
+    const osg::Vec3Array* source = static_cast<const osg::Vec3Array*>(geom->getSourceGeometry()->getVertexArray());
+    const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geom->getVertexArray());
+    for(unsigned int i=0; i<s_numVertices && vertices; ++i)
+    {
+        OSGUTX_TEST_F( ((*vertices)[i] - (*source)[i]*matrix).length()<1e-5f )
+    }
+
+    // and is queued again the next frame
+    queue->add(geom.get());
+    OSGUTX_TEST_F( queue->size()==1 )
+    queue->run();
+}
+
+OSGUTX_BEGIN_TESTSUITE(RigTransformSoftware)
+    OSGUTX_ADD_TESTCASE(RigTransformSoftwareTestFixture, testRigidBlend)
+    OSGUTX_ADD_TESTCASE(RigTransformSoftwareTestFixture, testDualQuaternionBlend)
+    OSGUTX_ADD_TESTCASE(RigTransformSoftwareTestFixture, testDoubleBuffered)
+    OSGUTX_ADD_TESTCASE(RigTransformSoftwareTestFixture, testSkinningQueueSharedRigGeometry)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(RigTransformSoftware, root.osgAnimation)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  ChannelBatch Tests
+//
+class ChannelBatchTestFixture
+{
+public:
+
+    void testChannelBatch(const osgUtx::TestContext& ctx);
+
+private:
+
+    osg::ref_ptr<Animation> createAnimation();
+    void update(Animation* animation, double time);
+    bool equivalent(const Animation* lhs, const Animation* rhs);
+};
+
+// two groups of linear Vec3 and spherical linear Quat channels sharing their key times, and a FloatLinearChannel left to Channel::update()
+osg::ref_ptr<Animation> ChannelBatchTestFixture::createAnimation()
+{
+    osg::ref_ptr<Animation> animation = new Animation;
+    animation->setPlayMode(Animation::LOOP);
+    animation->setWeight(1.0f);
+
+    const double times[2][4] = { {0.0, 0.5, 1.2, 2.0}, {0.0, 0.25, 2.5, 0.0} };
+    const unsigned int numKeys[2] = { 4, 3 };
+    for(unsigned int g=0; g<2; ++g)
+    {
+        for(unsigned int c=0; c<2; ++c)
+        {
+            Vec3LinearChannel* channel = new Vec3LinearChannel;
+            for(unsigned int k=0; k<numKeys[g]; ++k)
+                channel->getOrCreateSampler()->getOrCreateKeyframeContainer()->push_back(Vec3Keyframe(times[g][k], osg::Vec3(float(k+c), float(g)-float(k*k), 0.5f*float(k))));
+            animation->addChannel(channel);
+
+            QuatSphericalLinearChannel* quatChannel = new QuatSphericalLinearChannel;
+            for(unsigned int k=0; k<numKeys[g]; ++k)
+                quatChannel->getOrCreateSampler()->getOrCreateKeyframeContainer()->push_back(QuatKeyframe(times[g][k], osg::Quat(0.7*double(k+c+g), osg::Vec3(1.0f, float(c), 2.0f))));
+            animation->addChannel(quatChannel);
+        }
+    }
+
+    FloatLinearChannel* floatChannel = new FloatLinearChannel;
+    floatChannel->getOrCreateSampler()->getOrCreateKeyframeContainer()->push_back(FloatKeyframe(0.0, 1.0f));
+    floatChannel->getOrCreateSampler()->getOrCreateKeyframeContainer()->push_back(FloatKeyframe(2.0, 3.0f));
+    animation->addChannel(floatChannel);
+
+    return animation;
+}
+
+void ChannelBatchTestFixture::update(Animation* animation, double time)
+{
+    animation->resetTargets();
+    animation->update(time);
+}
+
+bool ChannelBatchTestFixture::equivalent(const Animation* lhs, const Animation* rhs)
+{
+    const ChannelList& lhsChannels = lhs->getChannels();
+    const ChannelList& rhsChannels = rhs->getChannels();
+    for(unsigned int i=0; i<lhsChannels.size(); ++i)
+    {
+        Target* lhsTarget = const_cast<Channel*>(lhsChannels[i].get())->getTarget();
+        Target* rhsTarget = const_cast<Channel*>(rhsChannels[i].get())->getTarget();
+        if (TemplateTarget<osg::Vec3>* target = dynamic_cast<TemplateTarget<osg::Vec3>*>(lhsTarget))
+        {
+            if ((target->getValue() - static_cast<TemplateTarget<osg::Vec3>*>(rhsTarget)->getValue()).length()>1e-6f) return false;
+        }
+        else if (TemplateTarget<osg::Quat>* target = dynamic_cast<TemplateTarget<osg::Quat>*>(lhsTarget))
+        {
+            if ((target->getValue().asVec4() - static_cast<TemplateTarget<osg::Quat>*>(rhsTarget)->getValue().asVec4()).length()>1e-6) return false;
+        }
+        else if (TemplateTarget<float>* target = dynamic_cast<TemplateTarget<float>*>(lhsTarget))
+        {
+            if (fabsf(target->getValue() - static_cast<TemplateTarget<float>*>(rhsTarget)->getValue())>1e-6f) return false;
+        }
+        else return false;
+    }
+    return true;
+}
+
+void ChannelBatchTestFixture::testChannelBatch(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<Animation> reference = createAnimation();
+
+    osg::ref_ptr<Animation> clip = new Animation(*reference, osg::CopyOp::SHALLOW_COPY);
+    clip->setUseChannelBatch(true);
+    const ChannelBatch* batch = clip->getChannelBatch();
+    OSGUTX_TEST_F( batch && batch->getNumGroups()==2 && batch->getNumBatchedChannels()==8 && !batch->isBatched(8) )
+
+    // copies share the batch but evaluate with their own key hints and targets
+    osg::ref_ptr<Animation> batched = new Animation(*clip, osg::CopyOp::SHALLOW_COPY);
+    OSGUTX_TEST_F( batched->getUseChannelBatch() && batched->getChannelBatch()==batch )
+
+    bool matched = true;
+
+    // playback, including wrapping around the loop
+    for(unsigned int f=0; f<360; ++f)
+    {
+        double time = double(f)/60.0;
+        update(reference.get(), time);
+        update(batched.get(), time);
+        matched = matched && equivalent(reference.get(), batched.get());
+    }
+    OSGUTX_TEST_F( matched )
+
+    // random times
+    unsigned int seed = 1;
+    for(unsigned int f=0; f<200; ++f)
+    {
+        seed = seed*1664525u + 1013904223u;
+        double time = 3.0*double(seed>>8)/double(1u<<24);
+        update(reference.get(), time);
+        update(batched.get(), time);
+        matched = matched && equivalent(reference.get(), batched.get());
+    }
+    OSGUTX_TEST_F( matched )
+
+    // the first and last keys and the key times in between
+    const double boundaries[] = { 0.0, 2.5, 0.25, 0.5, 1.2, 2.0, 1.2, 0.0 };
+    reference->setPlayMode(Animation::STAY);
+    batched->setPlayMode(Animation::STAY);
+    for(unsigned int i=0; i<sizeof(boundaries)/sizeof(double); ++i)
+    {
+        update(reference.get(), boundaries[i]);
+        update(batched.get(), boundaries[i]);
+        matched = matched && equivalent(reference.get(), batched.get());
+    }
+    OSGUTX_TEST_F( matched )
+
+    // adding a channel discards the batch and the next update rebuilds it
+    batched->addChannel(new Vec3LinearChannel(*static_cast<Vec3LinearChannel*>(batched->getChannels()[0].get())));
+    OSGUTX_TEST_F( batched->getChannelBatch()==0 )
+    update(batched.get(), 1.0);
+    OSGUTX_TEST_F( batched->getChannelBatch() && batched->getChannelBatch()->getNumBatchedChannels()==9 )
+}
+
+OSGUTX_BEGIN_TESTSUITE(ChannelBatch)
+    OSGUTX_ADD_TESTCASE(ChannelBatchTestFixture, testChannelBatch)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(ChannelBatch, root.osgAnimation)
+
+}
@@ -0,0 +1,141 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "UnitTestFramework.h"
+
+#include <osgShadow/ShadowedScene>
+#include <osgShadow/ViewDependentShadowMap>
+
+#include <sstream>
+
+namespace osgShadow
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  ViewDependentShadowMap Tests
+//
+class StaticShadowMapTestFixture
+{
+public:
+
+    StaticShadowMapTestFixture();
+
+    void testStaticShadowMapCache(const osgUtx::TestContext& ctx);
+
+private:
+
+    // gives access to the static shadow map set up of the shadow maps
+    class TestShadowMap : public ViewDependentShadowMap
+    {
+    public:
+
+        TestShadowMap()
+        {
+            _viewDependentData = new ViewDependentData(this);
+            _lightData = new LightData(_viewDependentData.get());
+            _lightData->directionalLight = true;
+            _lightData->lightDir.set(0.0, 0.0, -1.0);
+        }
+
+        ViewDependentShadowMap::StaticShadowMap* getStaticShadowMap() { return _shadowData.valid() ? _shadowData->_staticShadowMap.get() : 0; }
+
+        void setLightDirection(const osg::Vec3d& lightDir) { _lightData->lightDir = lightDir; }
+
+        // set up the static shadow map for a light space frustum of the given size about center, and return the projection used
+        osg::Matrixd setUp(const osg::Vec3d& center, double size)
+        {
+            if (!_shadowData) _shadowData = new ShadowData(_viewDependentData.get());
+
+            osg::Matrixd viewMatrix = osg::Matrixd::lookAt(center+osg::Vec3d(0.0, 0.0, 100.0), center, osg::Vec3d(0.0, 1.0, 0.0));
+            osg::Matrixd projectionMatrix = osg::Matrixd::ortho(-size*0.5, size*0.5, -size*0.5, size*0.5, 1.0, 200.0);
+            setUpStaticShadowMap(*_shadowData, *_lightData, projectionMatrix, viewMatrix);
+            return projectionMatrix;
+        }
+
+    protected:
+
+        osg::ref_ptr<ViewDependentData> _viewDependentData;
+        osg::ref_ptr<LightData>         _lightData;
+        osg::ref_ptr<ShadowData>        _shadowData;
+    };
+
+    static double getWidth(const osg::Matrixd& projectionMatrix);
+
+    osg::ref_ptr<ShadowedScene> _shadowedScene;
+    osg::ref_ptr<TestShadowMap> _shadowMap;
+};
+
+StaticShadowMapTestFixture::StaticShadowMapTestFixture()
+{
+    _shadowMap = new TestShadowMap;
+    _shadowedScene = new ShadowedScene(_shadowMap.get());
+    _shadowedScene->getShadowSettings()->setStaticShadowMapMargin(0.25);
+}
+
+double StaticShadowMapTestFixture::getWidth(const osg::Matrixd& projectionMatrix)
+{
+    double left, right, bottom, top, zNear, zFar;
+    projectionMatrix.getOrtho(left, right, bottom, top, zNear, zFar);
+    return right-left;
+}
+
+void StaticShadowMapTestFixture::testStaticShadowMapCache(const osgUtx::TestContext&)
+{
+    // the first frame renders the static shadow map, enlarged by the margin
+    osg::Matrixd projectionMatrix = _shadowMap->setUp(osg::Vec3d(0.0, 0.0, 0.0), 100.0);
+    ViewDependentShadowMap::StaticShadowMap* ssm = _shadowMap->getStaticShadowMap();
+    OSGUTX_TEST_F( ssm && ssm->_active && ssm->_refresh )
+    OSGUTX_TEST_F( osg::equivalent(getWidth(projectionMatrix), 125.0, 1e-6) )
+
+    // moving within the margin reuses it, with its projection
+    projectionMatrix = _shadowMap->setUp(osg::Vec3d(5.0, -5.0, 0.0), 100.0);
+    OSGUTX_TEST_F( !ssm->_refresh )
+    OSGUTX_TEST_F( osg::equivalent(getWidth(projectionMatrix), 125.0, 1e-6) )
+
+    // zooming in a little still reuses it
+    projectionMatrix = _shadowMap->setUp(osg::Vec3d(0.0, 0.0, 0.0), 60.0);
+    OSGUTX_TEST_F( !ssm->_refresh )
+    OSGUTX_TEST_F( osg::equivalent(getWidth(projectionMatrix), 125.0, 1e-6) )
+
+    // zooming in to less than half of the frustum it was rendered for renders it again at the higher resolution
+    projectionMatrix = _shadowMap->setUp(osg::Vec3d(0.0, 0.0, 0.0), 40.0);
+    OSGUTX_TEST_F( ssm->_refresh )
+    OSGUTX_TEST_F( osg::equivalent(getWidth(projectionMatrix), 50.0, 1e-6) )
+
+    // moving out of it renders it again
+    _shadowMap->setUp(osg::Vec3d(0.0, 0.0, 0.0), 40.0);
+    OSGUTX_TEST_F( !ssm->_refresh )
+    _shadowMap->setUp(osg::Vec3d(20.0, 0.0, 0.0), 40.0);
+    OSGUTX_TEST_F( ssm->_refresh )
+
+    // as does turning the light
+    _shadowMap->setUp(osg::Vec3d(20.0, 0.0, 0.0), 40.0);
+    OSGUTX_TEST_F( !ssm->_refresh )
+    _shadowMap->setLightDirection(osg::Vec3d(0.0, 0.6, -0.8));
+    _shadowMap->setUp(osg::Vec3d(20.0, 0.0, 0.0), 40.0);
+    OSGUTX_TEST_F( ssm->_refresh )
+}
+
+OSGUTX_BEGIN_TESTSUITE(ViewDependentShadowMap)
+    OSGUTX_ADD_TESTCASE(StaticShadowMapTestFixture, testStaticShadowMapCache)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(ViewDependentShadowMap, root.osgShadow)
+
+}
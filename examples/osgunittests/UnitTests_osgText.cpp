@@ -0,0 +1,176 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "UnitTestFramework.h"
+
+#include <osgText/TextBatch>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace osgText
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  TextBatch Tests
+//
+class TextBatchTestFixture
+{
+public:
+
+    void testRemoveText(const osgUtx::TestContext& ctx);
+
+private:
+
+    // the corners and texture coordinates of a glyph quad
+    typedef std::vector<float> Quad;
+    typedef std::vector<Quad> QuadList;
+
+    struct CollectQuads : public osg::Drawable::ConstAttributeFunctor
+    {
+        CollectQuads(QuadList& quads) : _quads(quads), _vertices(0), _numVertices(0) {}
+
+        virtual void apply(osg::Drawable::AttributeType type, unsigned int num, const osg::Vec3* vertices)
+        {
+            if (type==osg::Drawable::VERTICES) { _vertices = vertices; _numVertices = num; }
+        }
+
+        virtual void apply(osg::Drawable::AttributeType type, unsigned int num, const osg::Vec2* texcoords)
+        {
+            if (type!=osg::Drawable::TEXTURE_COORDS_0 || num!=_numVertices) return;
+
+            // the quads of removed Text are collapsed to the origin
+            for(unsigned int i=0; i+4<=num; i+=4)
+            {
+                if (_vertices[i]==osg::Vec3() && _vertices[i+1]==osg::Vec3() && _vertices[i+2]==osg::Vec3()) continue;
+                _quads.push_back(makeQuad(&_vertices[i], &texcoords[i]));
+            }
+        }
+
+        QuadList&           _quads;
+        const osg::Vec3*    _vertices;
+        unsigned int        _numVertices;
+    };
+
+    struct GreaterAddress
+    {
+        bool operator() (const osg::ref_ptr<Text>& lhs, const osg::ref_ptr<Text>& rhs) const { return lhs.get() > rhs.get(); }
+    };
+
+    static Quad makeQuad(const osg::Vec3* vertices, const osg::Vec2* texcoords);
+
+    // the quads of the Text themselves, sorted
+    static QuadList getTextQuads(const std::vector< osg::ref_ptr<Text> >& texts);
+
+    // the quads drawn by the batch, sorted
+    static QuadList getBatchQuads(const TextBatch& batch);
+};
+
+TextBatchTestFixture::Quad TextBatchTestFixture::makeQuad(const osg::Vec3* vertices, const osg::Vec2* texcoords)
+{
+    Quad quad;
+    for(unsigned int i=0; i<4; ++i)
+    {
+        quad.push_back(vertices[i].x()); quad.push_back(vertices[i].y()); quad.push_back(vertices[i].z());
+        quad.push_back(texcoords[i].x()); quad.push_back(texcoords[i].y());
+    }
+    return quad;
+}
+
+TextBatchTestFixture::QuadList TextBatchTestFixture::getTextQuads(const std::vector< osg::ref_ptr<Text> >& texts)
+{
+    QuadList quads;
+    for(unsigned int t=0; t<texts.size(); ++t)
+    {
+        const Text::TextureGlyphQuadMap& glyphQuadMap = texts[t]->getTextureGlyphQuadMap();
+        for(Text::TextureGlyphQuadMap::const_iterator itr = glyphQuadMap.begin();
+            itr != glyphQuadMap.end();
+            ++itr)
+        {
+            const Text::GlyphQuads& glyphQuads = itr->second;
+            const osg::Vec3Array* vertices = glyphQuads.getTransformedCoords(0).get();
+            const osg::Vec2Array* texcoords = glyphQuads.getTexCoords().get();
+            for(unsigned int i=0; i<glyphQuads._glyphs.size(); ++i)
+            {
+                quads.push_back(makeQuad(&(*vertices)[i*4], &(*texcoords)[i*4]));
+            }
+        }
+    }
+    std::sort(quads.begin(), quads.end());
+    return quads;
+}
+
+TextBatchTestFixture::QuadList TextBatchTestFixture::getBatchQuads(const TextBatch& batch)
+{
+    QuadList quads;
+    CollectQuads collectQuads(quads);
+    batch.accept(collectQuads);
+    std::sort(quads.begin(), quads.end());
+    return quads;
+}
+
+void TextBatchTestFixture::testRemoveText(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<TextBatch> batch = new TextBatch;
+    OSGUTX_TEST_F( batch->getDataVariance()==osg::Object::DYNAMIC )
+
+    std::vector< osg::ref_ptr<Text> > texts;
+    for(unsigned int i=0; i<8; ++i)
+    {
+        std::ostringstream label;
+        label<<"label "<<i<<" "<<std::string(i+1, char('a'+i));
+
+        Text* text = new Text;
+        text->setText(label.str());
+        text->setPosition(osg::Vec3(0.0f, float(i)*10.0f, 0.0f));
+        texts.push_back(text);
+    }
+
+    // add the Text in decreasing address order, so that their quads are laid out in the reverse of the order
+    // the batch keeps them in
+    std::sort(texts.begin(), texts.end(), GreaterAddress());
+    for(unsigned int i=0; i<texts.size(); ++i)
+    {
+        OSGUTX_TEST_F( batch->addText(texts[i].get()) )
+    }
+
+    OSGUTX_TEST_F( getBatchQuads(*batch)==getTextQuads(texts) )
+
+    // removing the Text in the middle frees more than half the quads, so the batch is compacted on the way,
+    // and the quads of the Text that remain must come through unchanged
+    while(texts.size()>2)
+    {
+        osg::ref_ptr<Text> text = texts[texts.size()/2];
+        texts.erase(texts.begin()+texts.size()/2);
+
+        OSGUTX_TEST_F( batch->removeText(text.get()) )
+        OSGUTX_TEST_F( !batch->containsText(text.get()) )
+        OSGUTX_TEST_F( getBatchQuads(*batch)==getTextQuads(texts) )
+        OSGUTX_TEST_F( batch->getNumGlyphs()==getTextQuads(texts).size() )
+    }
+}
+
+OSGUTX_BEGIN_TESTSUITE(TextBatch)
+    OSGUTX_ADD_TESTCASE(TextBatchTestFixture, testRemoveText)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(TextBatch, root.osgText)
+
+}
@@ -0,0 +1,746 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "UnitTestFramework.h"
+
+#include <osg/Geometry>
+#include <osg/ShaderAttribute>
+
+#include <osgUtil/DelaunayTriangulator>
+#include <osgUtil/MeshOptimizers>
+#include <osgUtil/SmoothingVisitor>
+#include <osgUtil/TangentSpaceGenerator>
+#include <osgUtil/WorkerThreadPool>
+
+#include <algorithm>
+#include <stdlib.h>
+#include <sstream>
+
+namespace osgUtil
+{
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  VertexQuantizationVisitor Tests
+//
+class VertexQuantizationTestFixture
+{
+public:
+
+    VertexQuantizationTestFixture();
+
+    void testRoundTrip(const osgUtx::TestContext& ctx);
+    void testNormalDecoding(const osgUtx::TestContext& ctx);
+    void testSharedStateSet(const osgUtx::TestContext& ctx);
+
+private:
+
+    osg::Geometry* createGeometry(bool withNormals) const;
+
+    // decode as the dequantization vertex shader does
+    static osg::Vec3 decodeOctahedral(const osg::Vec2s& e);
+
+    static std::string getShaderSource(const osg::Geometry& geom);
+
+    osg::ref_ptr<osg::Vec3Array> _vertices;
+    osg::ref_ptr<osg::Vec3Array> _normals;
+    osg::ref_ptr<osg::Vec2Array> _texcoords;
+};
+
+VertexQuantizationTestFixture::VertexQuantizationTestFixture():
+    _vertices(new osg::Vec3Array),
+    _normals(new osg::Vec3Array),
+    _texcoords(new osg::Vec2Array)
+{
+    srand(26);
+    for(unsigned int i=0; i<1000; ++i)
+    {
+        float r0 = float(rand())/float(RAND_MAX);
+        float r1 = float(rand())/float(RAND_MAX);
+        float r2 = float(rand())/float(RAND_MAX);
+
+        _vertices->push_back(osg::Vec3(-100.0f+300.0f*r0, 5.0f+2.0f*r1, -1000.0f*r2));
+
+        osg::Vec3 n(r1-0.5f, r2-0.5f, r0-0.5f);
+        if (n.normalize()==0.0f) n.set(0.0f, 0.0f, -1.0f);
+        _normals->push_back(n);
+
+        _texcoords->push_back(osg::Vec2(r2*4.0f, 1.0f-r0));
+    }
+}
+
+osg::Geometry* VertexQuantizationTestFixture::createGeometry(bool withNormals) const
+{
+    osg::Geometry* geom = new osg::Geometry;
+    geom->setVertexArray(new osg::Vec3Array(*_vertices));
+    if (withNormals) geom->setNormalArray(new osg::Vec3Array(*_normals), osg::Array::BIND_PER_VERTEX);
+    geom->setTexCoordArray(0, new osg::Vec2Array(*_texcoords), osg::Array::BIND_PER_VERTEX);
+    geom->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, _vertices->size()));
+    return geom;
+}
+
+osg::Vec3 VertexQuantizationTestFixture::decodeOctahedral(const osg::Vec2s& e)
+{
+    osg::Vec3 v(float(e.x())/32767.0f, float(e.y())/32767.0f, 0.0f);
+    v.z() = 1.0f - fabsf(v.x()) - fabsf(v.y());
+    if (v.z()<0.0f)
+    {
+        float x = (1.0f-fabsf(v.y())) * (v.x()>=0.0f ? 1.0f : -1.0f);
+        float y = (1.0f-fabsf(v.x())) * (v.y()>=0.0f ? 1.0f : -1.0f);
+        v.x() = x;
+        v.y() = y;
+    }
+    v.normalize();
+    return v;
+}
+
+std::string VertexQuantizationTestFixture::getShaderSource(const osg::Geometry& geom)
+{
+    const osg::ShaderAttribute* sa = dynamic_cast<const osg::ShaderAttribute*>(geom.getStateSet()->getAttribute(osg::StateAttribute::Type(VertexQuantizationVisitor::DEFAULT_SHADER_ATTRIBUTE_TYPE)));
+    if (!sa || sa->getNumShaders()==0) return std::string();
+
+    std::string source;
+    const osg::Shader::CodeInjectionMap& cim = sa->getShader(0)->getCodeInjectionMap();
+    for(osg::Shader::CodeInjectionMap::const_iterator itr = cim.begin(); itr != cim.end(); ++itr)
+    {
+        source += itr->second;
+    }
+    return source;
+}
+
+void VertexQuantizationTestFixture::testRoundTrip(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<osg::Geometry> geom = createGeometry(true);
+
+    VertexQuantizationVisitor vqv;
+    vqv.quantize(*geom);
+
+    osg::Vec3sArray* vertices = dynamic_cast<osg::Vec3sArray*>(geom->getVertexArray());
+    osg::Vec2sArray* normals = dynamic_cast<osg::Vec2sArray*>(geom->getTexCoordArray(vqv.getNormalTextureUnit()));
+    osg::Vec2sArray* texcoords = dynamic_cast<osg::Vec2sArray*>(geom->getTexCoordArray(0));
+    OSGUTX_TEST_F( vertices && vertices->size()==_vertices->size() )
+    OSGUTX_TEST_F( normals && normals->size()==_normals->size() )
+    OSGUTX_TEST_F( texcoords && texcoords->size()==_texcoords->size() )
+    OSGUTX_TEST_F( geom->getNormalArray()==0 )
+
+    osg::Vec3 positionScale, positionOffset;
+    osg::Vec4 texcoordScaleOffset;
+    const osg::StateSet* stateset = geom->getStateSet();
+    OSGUTX_TEST_F( stateset->getUniform("osg_QuantizedPositionScale")->get(positionScale) )
+    OSGUTX_TEST_F( stateset->getUniform("osg_QuantizedPositionOffset")->get(positionOffset) )
+    OSGUTX_TEST_F( stateset->getUniform("osg_QuantizedTexCoordScaleOffset")->get(texcoordScaleOffset) )
+
+    // each component should be within one quantization step, half a step plus float rounding, of the original
+    for(unsigned int i=0; i<_vertices->size(); ++i)
+    {
+        const osg::Vec3s& q = (*vertices)[i];
+        osg::Vec3 v(float(q.x())*positionScale.x()+positionOffset.x(),
+                    float(q.y())*positionScale.y()+positionOffset.y(),
+                    float(q.z())*positionScale.z()+positionOffset.z());
+        osg::Vec3 d = v-(*_vertices)[i];
+        OSGUTX_TEST_F( fabsf(d.x())<=positionScale.x() && fabsf(d.y())<=positionScale.y() && fabsf(d.z())<=positionScale.z() )
+
+        const osg::Vec2s& qt = (*texcoords)[i];
+        osg::Vec2 t(float(qt.x())*texcoordScaleOffset.x()+texcoordScaleOffset.z(),
+                    float(qt.y())*texcoordScaleOffset.y()+texcoordScaleOffset.w());
+        osg::Vec2 dt = t-(*_texcoords)[i];
+        OSGUTX_TEST_F( fabsf(dt.x())<=texcoordScaleOffset.x() && fabsf(dt.y())<=texcoordScaleOffset.y() )
+
+        // 16 bit octahedral encoding is accurate to well under a hundredth of a degree
+        osg::Vec3 n = decodeOctahedral((*normals)[i]);
+        OSGUTX_TEST_F( n*(*_normals)[i] > 0.99999f )
+    }
+}
+
+void VertexQuantizationTestFixture::testNormalDecoding(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<osg::Geometry> withNormals = createGeometry(true);
+    osg::ref_ptr<osg::Geometry> withoutNormals = createGeometry(false);
+
+    VertexQuantizationVisitor vqv;
+    vqv.quantize(*withNormals);
+    vqv.quantize(*withoutNormals);
+
+    std::string withNormalsSource = getShaderSource(*withNormals);
+    std::string withoutNormalsSource = getShaderSource(*withoutNormals);
+
+    OSGUTX_TEST_F( withNormalsSource.find("osg_decodeOctahedralNormal")!=std::string::npos )
+    OSGUTX_TEST_F( withoutNormalsSource.find("osg_decodeOctahedralNormal")==std::string::npos )
+    OSGUTX_TEST_F( withoutNormalsSource.find("gl_Normal")!=std::string::npos )
+    OSGUTX_TEST_F( withoutNormals->getTexCoordArray(vqv.getNormalTextureUnit())==0 )
+}
+
+void VertexQuantizationTestFixture::testSharedStateSet(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<osg::Geometry> geom0 = createGeometry(true);
+    osg::ref_ptr<osg::Geometry> geom1 = createGeometry(true);
+    (*static_cast<osg::Vec3Array*>(geom1->getVertexArray()))[0] *= 2.0f;
+
+    osg::ref_ptr<osg::StateSet> shared = new osg::StateSet;
+    shared->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+    geom0->setStateSet(shared.get());
+    geom1->setStateSet(shared.get());
+
+    VertexQuantizationVisitor vqv;
+    vqv.quantize(*geom0);
+    vqv.quantize(*geom1);
+
+    // the first Geometry gets a copy of the shared StateSet, leaving the original to the second, now its only user
+    OSGUTX_TEST_F( geom0->getStateSet()!=shared.get() && geom1->getStateSet()==shared.get() )
+    OSGUTX_TEST_F( shared->getNumParents()==1 && geom0->getStateSet()->getNumParents()==1 )
+    OSGUTX_TEST_F( geom0->getStateSet()->getMode(GL_LIGHTING)==osg::StateAttribute::OFF )
+    OSGUTX_TEST_F( geom1->getStateSet()->getMode(GL_LIGHTING)==osg::StateAttribute::OFF )
+
+    osg::Vec3 scale0, scale1;
+    OSGUTX_TEST_F( geom0->getStateSet()->getUniform("osg_QuantizedPositionScale")->get(scale0) )
+    OSGUTX_TEST_F( geom1->getStateSet()->getUniform("osg_QuantizedPositionScale")->get(scale1) )
+    OSGUTX_TEST_F( scale0!=scale1 )
+
+    // a StateSet used by just the one Geometry is added to in place
+    osg::ref_ptr<osg::Geometry> geom2 = createGeometry(false);
+    osg::ref_ptr<osg::StateSet> own = new osg::StateSet;
+    geom2->setStateSet(own.get());
+    vqv.quantize(*geom2);
+    OSGUTX_TEST_F( geom2->getStateSet()==own.get() && own->getUniform("osg_QuantizedPositionScale")!=0 )
+}
+
+OSGUTX_BEGIN_TESTSUITE(VertexQuantization)
+    OSGUTX_ADD_TESTCASE(VertexQuantizationTestFixture, testRoundTrip)
+    OSGUTX_ADD_TESTCASE(VertexQuantizationTestFixture, testNormalDecoding)
+    OSGUTX_ADD_TESTCASE(VertexQuantizationTestFixture, testSharedStateSet)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(VertexQuantization, root.osgUtil)
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  WorkerThreadPool Tests
+//
+class WorkerThreadPoolTestFixture
+{
+public:
+
+    WorkerThreadPoolTestFixture();
+
+    void testRun(const osgUtx::TestContext& ctx);
+    void testNestedRun(const osgUtx::TestContext& ctx);
+
+private:
+
+    // write i*i to each item of the range
+    struct SquareOperation : public WorkerThreadPool::RangeOperation
+    {
+        SquareOperation(std::vector<unsigned int>& results) : _results(results) {}
+
+        virtual void operator() (unsigned int begin, unsigned int end)
+        {
+            for(unsigned int i=begin; i<end; ++i) _results[i] = i*i;
+        }
+
+        std::vector<unsigned int>& _results;
+    };
+
+    // each item runs a SquareOperation of its own on the same pool, and stores the sum of its results
+    struct NestedOperation : public WorkerThreadPool::RangeOperation
+    {
+        NestedOperation(WorkerThreadPool* pool, std::vector<unsigned int>& sums) : _pool(pool), _sums(sums) {}
+
+        virtual void operator() (unsigned int begin, unsigned int end)
+        {
+            for(unsigned int i=begin; i<end; ++i)
+            {
+                std::vector<unsigned int> results(100+i, 0);
+                SquareOperation operation(results);
+                _pool->run(operation, results.size(), 8);
+
+                unsigned int sum = 0;
+                for(unsigned int j=0; j<results.size(); ++j) sum += results[j];
+                _sums[i] = sum;
+            }
+        }
+
+        WorkerThreadPool*           _pool;
+        std::vector<unsigned int>&  _sums;
+    };
+
+    osg::ref_ptr<WorkerThreadPool> _pool;
+};
+
+WorkerThreadPoolTestFixture::WorkerThreadPoolTestFixture():
+    _pool(new WorkerThreadPool(4))
+{
+}
+
+void WorkerThreadPoolTestFixture::testRun(const osgUtx::TestContext&)
+{
+    std::vector<unsigned int> results(1000, 0);
+    SquareOperation operation(results);
+    _pool->run(operation, results.size(), 10);
+
+    for(unsigned int i=0; i<results.size(); ++i)
+    {
+        OSGUTX_TEST_F( results[i]==i*i )
+    }
+}
+
+void WorkerThreadPoolTestFixture::testNestedRun(const osgUtx::TestContext&)
+{
+    // runs from within the blocks of another run must complete without taking on the outer run's blocks
+    std::vector<unsigned int> sums(64, 0);
+    NestedOperation operation(_pool.get(), sums);
+    _pool->run(operation, sums.size());
+
+    for(unsigned int i=0; i<sums.size(); ++i)
+    {
+        unsigned int n = 100+i;
+        OSGUTX_TEST_F( sums[i]==(n-1)*n*(2*n-1)/6 )
+    }
+}
+
+OSGUTX_BEGIN_TESTSUITE(WorkerThreadPool)
+    OSGUTX_ADD_TESTCASE(WorkerThreadPoolTestFixture, testRun)
+    OSGUTX_ADD_TESTCASE(WorkerThreadPoolTestFixture, testNestedRun)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(WorkerThreadPool, root.osgUtil)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  SmoothingVisitor Tests
+//
+class SmoothingVisitorTestFixture
+{
+public:
+
+    void testSmooth(const osgUtx::TestContext& ctx);
+    void testCreaseAngle(const osgUtx::TestContext& ctx);
+
+private:
+
+    // a unit cube of 8 shared vertices and 12 triangles
+    static osg::Geometry* createCube();
+};
+
+osg::Geometry* SmoothingVisitorTestFixture::createCube()
+{
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    for(unsigned int i=0; i<8; ++i)
+    {
+        vertices->push_back(osg::Vec3((i&1) ? 1.0f : 0.0f, (i&2) ? 1.0f : 0.0f, (i&4) ? 1.0f : 0.0f));
+    }
+
+    // the four corners of each face, counter clockwise seen from outside
+    const unsigned int faces[6][4] = { {0,2,3,1}, {4,5,7,6}, {0,1,5,4}, {2,6,7,3}, {0,4,6,2}, {1,3,7,5} };
+
+    osg::DrawElementsUShort* triangles = new osg::DrawElementsUShort(GL_TRIANGLES);
+    for(unsigned int f=0; f<6; ++f)
+    {
+        triangles->push_back(faces[f][0]); triangles->push_back(faces[f][1]); triangles->push_back(faces[f][2]);
+        triangles->push_back(faces[f][0]); triangles->push_back(faces[f][2]); triangles->push_back(faces[f][3]);
+    }
+
+    osg::Geometry* geom = new osg::Geometry;
+    geom->setVertexArray(vertices);
+    geom->addPrimitiveSet(triangles);
+    return geom;
+}
+
+void SmoothingVisitorTestFixture::testSmooth(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<osg::Geometry> geom = createCube();
+    SmoothingVisitor::smooth(*geom);
+
+    // without a crease angle the corners are shared by all their triangles, and their normals point out of the cube
+    osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom->getVertexArray());
+    osg::Vec3Array* normals = dynamic_cast<osg::Vec3Array*>(geom->getNormalArray());
+    OSGUTX_TEST_F( vertices->size()==8 && normals && normals->size()==8 )
+    for(unsigned int i=0; i<8; ++i)
+    {
+        osg::Vec3 outwards = (*vertices)[i]-osg::Vec3(0.5f,0.5f,0.5f);
+        outwards.normalize();
+        OSGUTX_TEST_F( fabsf((*normals)[i].length()-1.0f)<1e-5f )
+        OSGUTX_TEST_F( (*normals)[i]*outwards>0.9f )
+    }
+}
+
+void SmoothingVisitorTestFixture::testCreaseAngle(const osgUtx::TestContext&)
+{
+    osg::ref_ptr<osg::Geometry> geom = createCube();
+    SmoothingVisitor::smooth(*geom, osg::DegreesToRadians(45.0));
+
+    // every corner is shared by the triangles of three faces, each face's triangles get their own
+    // duplicate of the corner, leaving the original 8 vertices unused.
+    osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom->getVertexArray());
+    osg::Vec3Array* normals = dynamic_cast<osg::Vec3Array*>(geom->getNormalArray());
+    OSGUTX_TEST_F( vertices->size()==32 && normals && normals->size()==32 )
+
+    osg::DrawElements* triangles = geom->getPrimitiveSet(0)->getDrawElements();
+    OSGUTX_TEST_F( triangles && triangles->getNumIndices()==36 )
+
+    for(unsigned int t=0; t<12; ++t)
+    {
+        unsigned int p1 = triangles->index(t*3), p2 = triangles->index(t*3+1), p3 = triangles->index(t*3+2);
+        OSGUTX_TEST_F( p1>=8 && p2>=8 && p3>=8 )
+
+        osg::Vec3 faceNormal = ((*vertices)[p2]-(*vertices)[p1])^((*vertices)[p3]-(*vertices)[p1]);
+        faceNormal.normalize();
+        OSGUTX_TEST_F( ((*normals)[p1]-faceNormal).length()<1e-5f )
+        OSGUTX_TEST_F( ((*normals)[p2]-faceNormal).length()<1e-5f )
+        OSGUTX_TEST_F( ((*normals)[p3]-faceNormal).length()<1e-5f )
+    }
+}
+
+OSGUTX_BEGIN_TESTSUITE(SmoothingVisitor)
+    OSGUTX_ADD_TESTCASE(SmoothingVisitorTestFixture, testSmooth)
+    OSGUTX_ADD_TESTCASE(SmoothingVisitorTestFixture, testCreaseAngle)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(SmoothingVisitor, root.osgUtil)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  DelaunayTriangulator Tests
+//
+//  The expected triangles were produced by the Bowyer-Watson implementation DelaunayTriangulator used before
+//  the incremental insertion one, each triangle as its sorted indices into the sorted point array.
+//
+class DelaunayTriangulatorTestFixture
+{
+public:
+
+    void testRandomPoints(const osgUtx::TestContext& ctx);
+    void testCollinearAndDuplicatePoints(const osgUtx::TestContext& ctx);
+    void testConstraints(const osgUtx::TestContext& ctx);
+
+private:
+
+    typedef std::vector< std::vector<unsigned int> > TriangleSet;
+
+    // pseudo random points in the 10x10 square, independent of the platform's rand()
+    static osg::Vec3Array* createRandomPoints(unsigned int numPoints, unsigned int seed);
+
+    static TriangleSet getTriangleSet(const osg::DrawElementsUInt* triangles);
+    static TriangleSet getTriangleSet(const unsigned int* indices, unsigned int numIndices);
+};
+
+osg::Vec3Array* DelaunayTriangulatorTestFixture::createRandomPoints(unsigned int numPoints, unsigned int seed)
+{
+    osg::Vec3Array* points = new osg::Vec3Array;
+    for(unsigned int i=0; i<numPoints; ++i)
+    {
+        float values[3];
+        for(unsigned int j=0; j<3; ++j)
+        {
+            seed = seed*1664525u + 1013904223u;
+            values[j] = float(seed>>8)/float(1u<<24);
+        }
+        points->push_back(osg::Vec3(values[0]*10.0f, values[1]*10.0f, values[2]));
+    }
+    return points;
+}
+
+DelaunayTriangulatorTestFixture::TriangleSet DelaunayTriangulatorTestFixture::getTriangleSet(const osg::DrawElementsUInt* triangles)
+{
+    return (triangles && !triangles->empty()) ? getTriangleSet(&(triangles->front()), triangles->size()) : TriangleSet();
+}
+
+DelaunayTriangulatorTestFixture::TriangleSet DelaunayTriangulatorTestFixture::getTriangleSet(const unsigned int* indices, unsigned int numIndices)
+{
+    TriangleSet result;
+    for(unsigned int i=0; i+2<numIndices; i+=3)
+    {
+        std::vector<unsigned int> triangle(indices+i, indices+i+3);
+        std::sort(triangle.begin(), triangle.end());
+        result.push_back(triangle);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void DelaunayTriangulatorTestFixture::testRandomPoints(const osgUtx::TestContext&)
+{
+    const unsigned int expected[] = {
+        0, 1, 2, 0, 2, 3, 0, 3, 20, 1, 2, 4, 1, 4, 9, 2, 3, 5, 2, 4, 6, 2, 5, 6,
+        3, 5, 7, 3, 7, 8, 3, 8, 15, 3, 15, 20, 4, 6, 12, 4, 9, 10, 4, 10, 12, 5, 6, 7,
+        6, 7, 14, 6, 12, 14, 7, 8, 14, 8, 13, 14, 8, 13, 15, 9, 10, 11, 9, 11, 16, 10, 11, 12,
+        11, 12, 16, 12, 14, 17, 12, 16, 22, 12, 17, 22, 13, 14, 19, 13, 15, 21, 13, 19, 21, 14, 17, 18,
+        14, 18, 19, 15, 20, 21, 17, 18, 23, 17, 22, 23, 18, 19, 23, 19, 21, 23,
+    };
+
+    osg::ref_ptr<osg::Vec3Array> points = createRandomPoints(24, 1);
+    osg::ref_ptr<DelaunayTriangulator> triangulator = new DelaunayTriangulator(points.get());
+    OSGUTX_TEST_F( triangulator->triangulate() )
+    OSGUTX_TEST_F( points->size()==24 )
+    OSGUTX_TEST_F( getTriangleSet(triangulator->getTriangles())==getTriangleSet(expected, sizeof(expected)/sizeof(unsigned int)) )
+}
+
+void DelaunayTriangulatorTestFixture::testCollinearAndDuplicatePoints(const osgUtx::TestContext&)
+{
+    const unsigned int expected[] = {
+        0, 1, 2, 0, 2, 3, 1, 2, 5, 1, 5, 6, 1, 6, 15, 2, 3, 4, 2, 4, 5, 3, 4, 7,
+        3, 7, 13, 4, 5, 8, 4, 7, 8, 5, 6, 8, 6, 8, 10, 6, 10, 15, 7, 8, 11, 7, 11, 13,
+        8, 9, 10, 8, 9, 11, 9, 10, 12, 9, 11, 12, 10, 12, 15, 11, 12, 14, 11, 13, 14, 12, 14, 15,
+    };
+
+    // a row of collinear points across random points, with duplicates of three points, one of them at another height
+    osg::ref_ptr<osg::Vec3Array> points = createRandomPoints(10, 7);
+    for(unsigned int i=0; i<6; ++i) points->push_back(osg::Vec3(1.0f+1.5f*float(i), 5.0f, 0.0f));
+    points->push_back(osg::Vec3(2.5f, 5.0f, 1.0f));
+    points->push_back((*points)[0]);
+    points->push_back((*points)[3]);
+
+    osg::ref_ptr<DelaunayTriangulator> triangulator = new DelaunayTriangulator(points.get());
+    OSGUTX_TEST_F( triangulator->triangulate() )
+    OSGUTX_TEST_F( points->size()==16 )
+    OSGUTX_TEST_F( getTriangleSet(triangulator->getTriangles())==getTriangleSet(expected, sizeof(expected)/sizeof(unsigned int)) )
+
+    // points that all lie on a line give no triangles
+    osg::ref_ptr<osg::Vec3Array> line = new osg::Vec3Array;
+    for(unsigned int i=0; i<5; ++i) line->push_back(osg::Vec3(float(i), 2.0f*float(i), 0.0f));
+    triangulator = new DelaunayTriangulator(line.get());
+    triangulator->triangulate();
+    OSGUTX_TEST_F( getTriangleSet(triangulator->getTriangles()).empty() )
+}
+
+void DelaunayTriangulatorTestFixture::testConstraints(const osgUtx::TestContext&)
+{
+    const unsigned int expectedConstrained[] = {
+        0, 1, 2, 0, 2, 3, 0, 3, 5, 0, 5, 9, 1, 2, 7, 1, 4, 7, 1, 4, 19, 1, 6, 35,
+        1, 19, 35, 2, 3, 10, 2, 7, 8, 2, 8, 10, 3, 5, 10, 4, 7, 16, 4, 16, 19, 5, 9, 14,
+        5, 10, 11, 5, 11, 14, 6, 30, 35, 7, 8, 12, 7, 12, 16, 8, 10, 12, 9, 14, 15, 9, 15, 18,
+        9, 18, 27, 10, 11, 13, 10, 12, 13, 11, 13, 14, 12, 13, 16, 13, 14, 15, 13, 15, 16, 15, 16, 17,
+        15, 17, 20, 15, 18, 25, 15, 20, 22, 15, 22, 25, 16, 17, 20, 16, 19, 21, 16, 20, 24, 16, 21, 24,
+        18, 25, 28, 18, 27, 28, 19, 21, 26, 19, 26, 32, 19, 32, 35, 20, 22, 23, 20, 23, 24, 21, 24, 26,
+        22, 23, 25, 23, 24, 25, 24, 25, 29, 24, 26, 34, 24, 29, 34, 25, 28, 31, 25, 29, 31, 26, 32, 34,
+        27, 28, 31, 29, 31, 33, 29, 33, 34, 31, 33, 34, 32, 34, 35,
+    };
+
+    const unsigned int expectedRemoved[] = {
+        0, 1, 2, 0, 2, 3, 0, 3, 5, 0, 5, 9, 1, 2, 7, 1, 4, 7, 1, 4, 19, 1, 6, 35,
+        1, 19, 35, 2, 3, 10, 2, 7, 8, 2, 8, 10, 3, 5, 10, 4, 7, 16, 4, 16, 19, 5, 9, 14,
+        5, 10, 11, 5, 11, 14, 6, 30, 35, 7, 8, 12, 7, 12, 16, 8, 10, 12, 9, 14, 15, 9, 15, 18,
+        9, 18, 27, 10, 11, 13, 10, 12, 13, 11, 13, 14, 12, 13, 16, 13, 14, 15, 13, 15, 16, 15, 18, 25,
+        16, 19, 21, 16, 21, 24, 18, 25, 28, 18, 27, 28, 19, 21, 26, 19, 26, 32, 19, 32, 35, 21, 24, 26,
+        24, 25, 29, 24, 26, 34, 24, 29, 34, 25, 28, 31, 25, 29, 31, 26, 32, 34, 27, 28, 31, 29, 31, 33,
+        29, 33, 34, 31, 33, 34, 32, 34, 35,
+    };
+
+    const unsigned int expectedInterior[] = {
+        15, 16, 17, 15, 17, 20, 15, 20, 22, 15, 22, 25, 16, 17, 20, 16, 20, 24, 20, 22, 23, 20, 23, 24,
+        22, 23, 25, 23, 24, 25,
+    };
+
+    osg::ref_ptr<osg::Vec3Array> points = createRandomPoints(30, 3);
+    osg::ref_ptr<DelaunayTriangulator> triangulator = new DelaunayTriangulator(points.get());
+
+    // a closed loop whose inside is removed, and a line across the top
+    osg::ref_ptr<DelaunayConstraint> loop = new DelaunayConstraint;
+    osg::Vec3Array* loopVertices = new osg::Vec3Array;
+    loopVertices->push_back(osg::Vec3(3.1f, 2.9f, 0.0f));
+    loopVertices->push_back(osg::Vec3(7.2f, 3.3f, 0.0f));
+    loopVertices->push_back(osg::Vec3(6.8f, 7.1f, 0.0f));
+    loopVertices->push_back(osg::Vec3(3.3f, 6.6f, 0.0f));
+    loop->setVertexArray(loopVertices);
+    loop->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::LINE_LOOP, 0, loopVertices->size()));
+    triangulator->addInputConstraint(loop.get());
+
+    osg::ref_ptr<DelaunayConstraint> line = new DelaunayConstraint;
+    osg::Vec3Array* lineVertices = new osg::Vec3Array;
+    lineVertices->push_back(osg::Vec3(0.4f, 8.7f, 0.0f));
+    lineVertices->push_back(osg::Vec3(9.3f, 9.1f, 0.0f));
+    line->setVertexArray(lineVertices);
+    line->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::LINE_STRIP, 0, lineVertices->size()));
+    triangulator->addInputConstraint(line.get());
+
+    // the constraint vertices are added to the points
+    OSGUTX_TEST_F( triangulator->triangulate() )
+    OSGUTX_TEST_F( points->size()==36 )
+    OSGUTX_TEST_F( getTriangleSet(triangulator->getTriangles())==getTriangleSet(expectedConstrained, sizeof(expectedConstrained)/sizeof(unsigned int)) )
+
+    triangulator->removeInternalTriangles(loop.get());
+    loop->makeDrawable();
+    OSGUTX_TEST_F( getTriangleSet(triangulator->getTriangles())==getTriangleSet(expectedRemoved, sizeof(expectedRemoved)/sizeof(unsigned int)) )
+    OSGUTX_TEST_F( getTriangleSet(loop->getTriangles())==getTriangleSet(expectedInterior, sizeof(expectedInterior)/sizeof(unsigned int)) )
+}
+
+OSGUTX_BEGIN_TESTSUITE(DelaunayTriangulator)
+    OSGUTX_ADD_TESTCASE(DelaunayTriangulatorTestFixture, testRandomPoints)
+    OSGUTX_ADD_TESTCASE(DelaunayTriangulatorTestFixture, testCollinearAndDuplicatePoints)
+    OSGUTX_ADD_TESTCASE(DelaunayTriangulatorTestFixture, testConstraints)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(DelaunayTriangulator, root.osgUtil)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  TangentSpaceGenerator Tests
+//
+//  The expected bases were produced by the TangentSpaceGenerator implementation used before the triangles were
+//  gathered into a single index list.
+//
+class TangentSpaceGeneratorTestFixture
+{
+public:
+
+    void testNonIndexedQuads(const osgUtx::TestContext& ctx);
+    void testIndexedQuads(const osgUtx::TestContext& ctx);
+    void testMirroredTexCoords(const osgUtx::TestContext& ctx);
+
+private:
+
+    // a strip of two quads folded along x=1, with per vertex normals tilted away from the fold, and u running 0, 0.5, 1
+    // across the three columns of vertices, or 0, 1, 0 when mirrored so the texture is flipped on the second quad
+    static osg::Geometry* createFoldedQuads(bool indexed, bool mirrored);
+
+    static bool equivalent(const osg::Vec4Array* array, const float expected[][4], unsigned int numExpected);
+};
+
+osg::Geometry* TangentSpaceGeneratorTestFixture::createFoldedQuads(bool indexed, bool mirrored)
+{
+    // the corners of each quad as column and row, counter clockwise seen from above
+    const unsigned int corners[8][2] = { {0,0}, {1,0}, {1,1}, {0,1}, {1,0}, {2,0}, {2,1}, {1,1} };
+
+    osg::Vec3Array* vertices = new osg::Vec3Array;
+    osg::Vec3Array* normals = new osg::Vec3Array;
+    osg::Vec2Array* texcoords = new osg::Vec2Array;
+    for(unsigned int i=0; i<(indexed ? 6u : 8u); ++i)
+    {
+        unsigned int column = indexed ? i%3 : corners[i][0];
+        unsigned int row = indexed ? i/3 : corners[i][1];
+
+        vertices->push_back(osg::Vec3(float(column), float(row), column==1 ? 0.5f : 0.0f));
+
+        osg::Vec3 normal(0.5f*(float(column)-1.0f), 0.0f, 1.0f);
+        normal.normalize();
+        normals->push_back(normal);
+
+        texcoords->push_back(osg::Vec2(mirrored ? float(column%2) : 0.5f*float(column), float(row)));
+    }
+
+    osg::Geometry* geom = new osg::Geometry;
+    geom->setVertexArray(vertices);
+    geom->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+    geom->setTexCoordArray(0, texcoords, osg::Array::BIND_PER_VERTEX);
+
+    if (indexed)
+    {
+        osg::DrawElementsUShort* quads = new osg::DrawElementsUShort(GL_QUADS);
+        for(unsigned int i=0; i<8; ++i) quads->push_back(corners[i][0] + corners[i][1]*3);
+        geom->addPrimitiveSet(quads);
+    }
+    else
+    {
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_QUADS, 0, 8));
+    }
+    return geom;
+}
+
+bool TangentSpaceGeneratorTestFixture::equivalent(const osg::Vec4Array* array, const float expected[][4], unsigned int numExpected)
+{
+    if (!array || array->size()!=numExpected) return false;
+    for(unsigned int i=0; i<numExpected; ++i)
+    {
+        if (((*array)[i] - osg::Vec4(expected[i][0], expected[i][1], expected[i][2], expected[i][3])).length()>1e-5f) return false;
+    }
+    return true;
+}
+
+void TangentSpaceGeneratorTestFixture::testNonIndexedQuads(const osgUtx::TestContext&)
+{
+    const float tangents[][4] = {
+        {0.894427f, 0.0f, 0.447214f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.894427f, 0.0f, 0.447214f, 1.0f},
+        {1.0f, 0.0f, 0.0f, 1.0f}, {0.894427f, 0.0f, -0.447214f, 1.0f}, {0.894427f, 0.0f, -0.447214f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f},
+    };
+    const float binormals[][4] = {
+        {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f},
+        {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f},
+    };
+    const float normals[][4] = {
+        {-0.447214f, 0.0f, 0.894427f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {-0.447214f, 0.0f, 0.894427f, 0.0f},
+        {0.0f, 0.0f, 1.0f, 0.0f}, {0.447214f, 0.0f, 0.894427f, 0.0f}, {0.447214f, 0.0f, 0.894427f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f},
+    };
+
+    osg::ref_ptr<osg::Geometry> geom = createFoldedQuads(false, false);
+    osg::ref_ptr<TangentSpaceGenerator> tsg = new TangentSpaceGenerator;
+    tsg->generate(geom.get(), 0);
+
+    OSGUTX_TEST_F( equivalent(tsg->getTangentArray(), tangents, 8) )
+    OSGUTX_TEST_F( equivalent(tsg->getBinormalArray(), binormals, 8) )
+    OSGUTX_TEST_F( equivalent(tsg->getNormalArray(), normals, 8) )
+}
+
+void TangentSpaceGeneratorTestFixture::testIndexedQuads(const osgUtx::TestContext&)
+{
+    const float tangents[][4] = {
+        {0.894427f, 0.0f, 0.447214f, 1.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.894427f, 0.0f, -0.447214f, 1.0f}, {0.894427f, 0.0f, 0.447214f, 1.0f},
+        {1.0f, 0.0f, 0.0f, 1.0f}, {0.894427f, 0.0f, -0.447214f, 1.0f},
+    };
+    const float binormals[][4] = {
+        {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f},
+        {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f},
+    };
+    const float normals[][4] = {
+        {-0.447214f, 0.0f, 0.894427f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {0.447214f, 0.0f, 0.894427f, 0.0f}, {-0.447214f, 0.0f, 0.894427f, 0.0f},
+        {0.0f, 0.0f, 1.0f, 0.0f}, {0.447214f, 0.0f, 0.894427f, 0.0f},
+    };
+
+    osg::ref_ptr<osg::Geometry> geom = createFoldedQuads(true, false);
+    osg::ref_ptr<TangentSpaceGenerator> tsg = new TangentSpaceGenerator;
+    tsg->generate(geom.get(), 0);
+
+    OSGUTX_TEST_F( equivalent(tsg->getTangentArray(), tangents, 6) )
+    OSGUTX_TEST_F( equivalent(tsg->getBinormalArray(), binormals, 6) )
+    OSGUTX_TEST_F( equivalent(tsg->getNormalArray(), normals, 6) )
+}
+
+void TangentSpaceGeneratorTestFixture::testMirroredTexCoords(const osgUtx::TestContext&)
+{
+    // the tangents of the second quad point back along x, with negative handedness, and the vertices along the
+    // fold take the direction of the quad that has more of their triangles
+    const float tangents[][4] = {
+        {0.894427f, 0.0f, 0.447214f, 1.0f}, {-1.0f, 0.0f, 0.0f, -1.0f}, {-0.894427f, 0.0f, 0.447214f, -1.0f}, {0.894427f, 0.0f, 0.447214f, 1.0f},
+        {1.0f, 0.0f, 0.0f, 1.0f}, {-0.894427f, 0.0f, 0.447214f, -1.0f},
+    };
+    const float binormals[][4] = {
+        {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f},
+        {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f},
+    };
+    const float normals[][4] = {
+        {-0.447214f, 0.0f, 0.894427f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {0.447214f, 0.0f, 0.894427f, 0.0f}, {-0.447214f, 0.0f, 0.894427f, 0.0f},
+        {0.0f, 0.0f, 1.0f, 0.0f}, {0.447214f, 0.0f, 0.894427f, 0.0f},
+    };
+
+    osg::ref_ptr<osg::Geometry> geom = createFoldedQuads(true, true);
+    osg::ref_ptr<TangentSpaceGenerator> tsg = new TangentSpaceGenerator;
+    tsg->generate(geom.get(), 0);
+
+    OSGUTX_TEST_F( equivalent(tsg->getTangentArray(), tangents, 6) )
+    OSGUTX_TEST_F( equivalent(tsg->getBinormalArray(), binormals, 6) )
+    OSGUTX_TEST_F( equivalent(tsg->getNormalArray(), normals, 6) )
+}
+
+OSGUTX_BEGIN_TESTSUITE(TangentSpaceGenerator)
+    OSGUTX_ADD_TESTCASE(TangentSpaceGeneratorTestFixture, testNonIndexedQuads)
+    OSGUTX_ADD_TESTCASE(TangentSpaceGeneratorTestFixture, testIndexedQuads)
+    OSGUTX_ADD_TESTCASE(TangentSpaceGeneratorTestFixture, testMirroredTexCoords)
+OSGUTX_END_TESTSUITE
+
+OSGUTX_AUTOREGISTER_TESTSUITE_AT(TangentSpaceGenerator, root.osgUtil)
+
+}
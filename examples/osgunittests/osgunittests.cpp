@@ -30,6 +30,7 @@
 #include "UnitTestFramework.h"
 #include "performance.h"
 #include "MultiThreadRead.h"
+#include "MeshPerformance.h"
 
 #include <iostream>
 
@@ -573,6 +574,10 @@ int main( int argc, char** argv )
     arguments.getApplicationUsage()->addCommandLineOption("matrix","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("performance","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("read-threads <numthreads>","Run multi-thread reading test.");
+    arguments.getApplicationUsage()->addCommandLineOption("smoothing <numtriangles>","Run SmoothingVisitor performance tests.");
+    arguments.getApplicationUsage()->addCommandLineOption("delaunay <maxnumpoints>","Run DelaunayTriangulator performance tests from 10000 points up to maxnumpoints.");
+    arguments.getApplicationUsage()->addCommandLineOption("tessellator <numpolygons>","Run Tessellator performance tests on shapefile like polygons.");
+    arguments.getApplicationUsage()->addCommandLineOption("tangentspace <numtriangles>","Run TangentSpaceGenerator performance tests.");
 
 
     if (arguments.argc()<=1)
@@ -611,6 +616,18 @@ int main( int argc, char** argv )
     bool performanceTest = false;
     while (arguments.read("p") || arguments.read("performance")) performanceTest = true;
 
+    unsigned int numSmoothingTriangles = 0;
+    while (arguments.read("smoothing", numSmoothingTriangles)) {}
+
+    unsigned int maxDelaunayPoints = 0;
+    while (arguments.read("delaunay", maxDelaunayPoints)) {}
+
+    unsigned int numTessellatorPolygons = 0;
+    while (arguments.read("tessellator", numTessellatorPolygons)) {}
+
+    unsigned int numTangentSpaceTriangles = 0;
+    while (arguments.read("tangentspace", numTangentSpaceTriangles)) {}
+
     // if user request help write it out to cout.
     if (arguments.read("-h") || arguments.read("--help"))
     {
@@ -681,6 +698,26 @@ int main( int argc, char** argv )
         runPerformanceTests();
     }
 
+    if (numSmoothingTriangles>0)
+    {
+        runSmoothingPerformanceTests(numSmoothingTriangles);
+    }
+
+    if (maxDelaunayPoints>0)
+    {
+        runDelaunayPerformanceTests(maxDelaunayPoints);
+    }
+
+    if (numTessellatorPolygons>0)
+    {
+        runTessellatorPerformanceTests(numTessellatorPolygons);
+    }
+
+    if (numTangentSpaceTriangles>0)
+    {
+        runTangentSpacePerformanceTests(numTangentSpaceTriangles);
+    }
+
     if (numReadThreads>0)
     {
         runMultiThreadReadTests(numReadThreads, arguments);
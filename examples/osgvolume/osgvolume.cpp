@@ -430,6 +430,8 @@ int main( int argc, char **argv )
     arguments.getApplicationUsage()->addCommandLineOption("--sd <num>","Short hand for --sequence-length");
     arguments.getApplicationUsage()->addCommandLineOption("--sdwm <num>","Set the SampleDensityWhenMovingProperty to specified value");
     arguments.getApplicationUsage()->addCommandLineOption("--lod","Enable techniques to reduce the level of detail when moving.");
+    arguments.getApplicationUsage()->addCommandLineOption("--brick-size <size>","Set the size of the bricks the RayTracedTechnique uses to skip empty space, 0 to disable, default 8.");
+    arguments.getApplicationUsage()->addCommandLineOption("--opacity-cutoff <value>","Set the accumulated opacity at which the RayTracedTechnique stops marching rays, default 0 to disable.");
 //    arguments.getApplicationUsage()->addCommandLineOption("--raw <sizeX> <sizeY> <sizeZ> <numberBytesPerComponent> <numberOfComponents> <endian> <filename>","read a raw image data");
 
     // construct the viewer.
@@ -592,6 +594,12 @@ int main( int argc, char **argv )
     bool useMultipass = false;
     while(arguments.read("--multi-pass")) useMultipass = true;
 
+    unsigned int brickSize = 8;
+    while(arguments.read("--brick-size", brickSize)) {}
+
+    float opacityCutoff = 0.0f;
+    while(arguments.read("--opacity-cutoff", opacityCutoff)) {}
+
     std::string filename;
     osg::ref_ptr<osg::Group> models;
     while(arguments.read("--model",filename))
@@ -1125,7 +1133,10 @@ int main( int argc, char **argv )
         }
         else
         {
-            tile->setVolumeTechnique(new osgVolume::RayTracedTechnique);
+            osgVolume::RayTracedTechnique* rayTracedTechnique = new osgVolume::RayTracedTechnique;
+            rayTracedTechnique->setBrickSize(brickSize);
+            rayTracedTechnique->setOpacityCutoff(opacityCutoff);
+            tile->setVolumeTechnique(rayTracedTechnique);
         }
     }
     else
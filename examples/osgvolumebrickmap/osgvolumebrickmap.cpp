@@ -0,0 +1,204 @@
+/* OpenSceneGraph example, osgvolumebrickmap.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Image>
+#include <osg/ImageUtils>
+#include <osg/Timer>
+#include <osg/TransferFunction>
+
+#include <osgDB/ReadFile>
+
+#include <osgVolume/BrickMap>
+
+#include <iostream>
+#include <stdlib.h>
+
+// generate a sparse volume of randomly placed blobs in otherwise empty space, as a CT scan of an object in air would be
+osg::Image* createSparseVolume(unsigned int size, unsigned int numBlobs, GLenum dataType)
+{
+    osg::Image* image = new osg::Image;
+    image->allocateImage(size, size, size, GL_LUMINANCE, dataType);
+    memset(image->data(), 0, image->getTotalSizeInBytes());
+
+    for(unsigned int b=0; b<numBlobs; ++b)
+    {
+        double radius = double(size)*(0.03+0.07*double(rand())/double(RAND_MAX));
+        osg::Vec3d center(radius+(double(size)-2.0*radius)*double(rand())/double(RAND_MAX),
+                          radius+(double(size)-2.0*radius)*double(rand())/double(RAND_MAX),
+                          radius+(double(size)-2.0*radius)*double(rand())/double(RAND_MAX));
+
+        for(int k=int(center.z()-radius); k<=int(center.z()+radius); ++k)
+        {
+            for(int j=int(center.y()-radius); j<=int(center.y()+radius); ++j)
+            {
+                for(int i=int(center.x()-radius); i<=int(center.x()+radius); ++i)
+                {
+                    double d = (osg::Vec3d(i,j,k)-center).length()/radius;
+                    if (d>=1.0) continue;
+
+                    double v = 1.0-d;
+                    if (dataType==GL_UNSIGNED_SHORT) *reinterpret_cast<unsigned short*>(image->data(i,j,k)) = static_cast<unsigned short>(v*65535.0);
+                    else if (dataType==GL_FLOAT) *reinterpret_cast<float*>(image->data(i,j,k)) = static_cast<float>(v);
+                    else *image->data(i,j,k) = static_cast<unsigned char>(v*255.0);
+                }
+            }
+        }
+    }
+
+    return image;
+}
+
+// check the brick map against the minimum and maximum of each brick computed directly from the image
+bool verifyBrickMap(const osgVolume::BrickMap& brickMap, const osg::Image* image)
+{
+    int brickSize = brickMap.getBrickSize();
+    for(unsigned int bk=0; bk<brickMap.getNumBricksR(); ++bk)
+    {
+        for(unsigned int bj=0; bj<brickMap.getNumBricksT(); ++bj)
+        {
+            for(unsigned int bi=0; bi<brickMap.getNumBricksS(); ++bi)
+            {
+                float minimum = 1.0e10f, maximum = -1.0e10f;
+                for(int k=int(bk)*brickSize-1; k<=int(bk+1)*brickSize; ++k)
+                {
+                    for(int j=int(bj)*brickSize-1; j<=int(bj+1)*brickSize; ++j)
+                    {
+                        for(int i=int(bi)*brickSize-1; i<=int(bi+1)*brickSize; ++i)
+                        {
+                            // voxels outside the image take the zero border color
+                            float v = 0.0f;
+                            if (i>=0 && j>=0 && k>=0 && i<image->s() && j<image->t() && k<image->r())
+                            {
+                                osg::Vec4 color = image->getColor(i,j,k);
+                                v = image->getPixelFormat()==GL_LUMINANCE ? color.r() : color.a();
+                            }
+                            else if (i<-1 || j<-1 || k<-1 || i>image->s() || j>image->t() || k>image->r())
+                            {
+                                continue;
+                            }
+
+                            minimum = osg::minimum(minimum, v);
+                            maximum = osg::maximum(maximum, v);
+                        }
+                    }
+                }
+
+                if (minimum!=brickMap.getMinimum(bi,bj,bk) || maximum!=brickMap.getMaximum(bi,bj,bk))
+                {
+                    std::cout<<"brick "<<bi<<" "<<bj<<" "<<bk<<" has range "<<brickMap.getMinimum(bi,bj,bk)<<" to "<<brickMap.getMaximum(bi,bj,bk)
+                             <<", expected "<<minimum<<" to "<<maximum<<std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" measures how long osgVolume::BrickMap takes to compute and classify the brick map that osgVolume::RayTracedTechnique uses to skip empty space.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options] [3d image]");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <num>","Size of the generated sparse volume along each side, default 256.");
+    arguments.getApplicationUsage()->addCommandLineOption("--blobs <num>","Number of blobs in the generated sparse volume, default 20.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ushort","Generate the volume with unsigned short rather than unsigned byte voxels.");
+    arguments.getApplicationUsage()->addCommandLineOption("--float","Generate the volume with float rather than unsigned byte voxels.");
+    arguments.getApplicationUsage()->addCommandLineOption("--brick-size <num>","Size of the bricks, default 8.");
+    arguments.getApplicationUsage()->addCommandLineOption("--iterations <num>","Number of times to compute the brick map, default 5.");
+    arguments.getApplicationUsage()->addCommandLineOption("--verify","Check the brick map against the range of each brick computed directly from the image.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int size = 256;
+    unsigned int numBlobs = 20;
+    unsigned int brickSize = 8;
+    unsigned int numIterations = 5;
+    while (arguments.read("--size", size)) {}
+    while (arguments.read("--blobs", numBlobs)) {}
+    while (arguments.read("--brick-size", brickSize)) {}
+    while (arguments.read("--iterations", numIterations)) {}
+    GLenum dataType = GL_UNSIGNED_BYTE;
+    while (arguments.read("--ushort")) dataType = GL_UNSIGNED_SHORT;
+    while (arguments.read("--float")) dataType = GL_FLOAT;
+    bool verify = arguments.read("--verify");
+
+    osg::ref_ptr<osg::Image> image;
+    for(int pos=1; pos<arguments.argc() && !image; ++pos)
+    {
+        if (!arguments.isOption(pos)) image = osgDB::readRefImageFile(arguments[pos]);
+    }
+    if (!image) image = createSparseVolume(size, numBlobs, dataType);
+
+    if (!osgVolume::BrickMap::isSupported(image.get()) || brickSize==0 || numIterations==0)
+    {
+        std::cout<<"Unable to compute a brick map for the image."<<std::endl;
+        return 1;
+    }
+
+    // a transfer function that leaves the lower values fully transparent, as is typical for hiding the air around a scanned object
+    osg::ref_ptr<osg::TransferFunction1D> tf = new osg::TransferFunction1D;
+    tf->setColor(0.0, osg::Vec4(0.0,0.0,0.0,0.0));
+    tf->setColor(0.25, osg::Vec4(0.0,0.0,0.0,0.0));
+    tf->setColor(0.5, osg::Vec4(1.0,0.5,0.2,0.3));
+    tf->setColor(1.0, osg::Vec4(1.0,1.0,1.0,1.0));
+
+    osg::ref_ptr<osgVolume::BrickMap> brickMap = new osgVolume::BrickMap;
+
+    double computeTime = 0.0, classifyTime = 0.0;
+    unsigned int numEmptyBricksWithoutTransferFunction = 0;
+    for(unsigned int i=0; i<numIterations; ++i)
+    {
+        osg::ElapsedTime elapsedTime;
+        brickMap->compute(image.get(), brickSize);
+        computeTime += elapsedTime.elapsedTime_m();
+
+        numEmptyBricksWithoutTransferFunction = brickMap->getNumEmptyBricks();
+
+        elapsedTime.reset();
+        brickMap->classify(tf.get());
+        classifyTime += elapsedTime.elapsedTime_m();
+    }
+
+    double numVoxels = double(image->s())*double(image->t())*double(image->r());
+    double numBricks = double(brickMap->getNumBricksS())*double(brickMap->getNumBricksT())*double(brickMap->getNumBricksR());
+
+    std::cout<<image->s()<<"x"<<image->t()<<"x"<<image->r()<<" volume in "
+             <<brickMap->getNumBricksS()<<"x"<<brickMap->getNumBricksT()<<"x"<<brickMap->getNumBricksR()<<" bricks of "<<brickSize<<" voxels"<<std::endl;
+    std::cout<<"compute: "<<computeTime/double(numIterations)<<"ms, "<<numVoxels*double(numIterations)/(computeTime*1000.0)<<" million voxels/sec"<<std::endl;
+    std::cout<<"classify: "<<classifyTime/double(numIterations)<<"ms"<<std::endl;
+    std::cout<<"empty bricks: "<<100.0*double(numEmptyBricksWithoutTransferFunction)/numBricks<<"% without transfer function, "
+             <<100.0*double(brickMap->getNumEmptyBricks())/numBricks<<"% with"<<std::endl;
+
+    if (verify)
+    {
+        if (verifyBrickMap(*brickMap, image.get())) std::cout<<"brick map verified"<<std::endl;
+        else return 1;
+    }
+
+    return 0;
+}
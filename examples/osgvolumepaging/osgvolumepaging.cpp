@@ -0,0 +1,234 @@
+/* OpenSceneGraph example, osgvolumepaging.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include <osg/ArgumentParser>
+#include <osg/ApplicationUsage>
+#include <osg/Image>
+#include <osg/Timer>
+#include <osg/TransferFunction>
+
+#include <osgDB/DatabasePager>
+#include <osgDB/FileNameUtils>
+#include <osgDB/ReadFile>
+
+#include <osgGA/TrackballManipulator>
+
+#include <osgViewer/Viewer>
+#include <osgViewer/ViewerEventHandlers>
+
+#include <osgVolume/BrickedVolumeFile>
+#include <osgVolume/MultipassTechnique>
+#include <osgVolume/RayTracedTechnique>
+#include <osgVolume/Volume>
+#include <osgVolume/VolumeScene>
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+// generate a sparse volume of randomly placed blobs in otherwise empty space, as a CT scan of an object in air would be
+osg::Image* createSparseVolume(unsigned int size, unsigned int numBlobs)
+{
+    osg::Image* image = new osg::Image;
+    image->allocateImage(size, size, size, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+    memset(image->data(), 0, image->getTotalSizeInBytes());
+
+    for(unsigned int b=0; b<numBlobs; ++b)
+    {
+        double radius = double(size)*(0.03+0.07*double(rand())/double(RAND_MAX));
+        osg::Vec3d center(radius+(double(size)-2.0*radius)*double(rand())/double(RAND_MAX),
+                          radius+(double(size)-2.0*radius)*double(rand())/double(RAND_MAX),
+                          radius+(double(size)-2.0*radius)*double(rand())/double(RAND_MAX));
+
+        for(int k=int(center.z()-radius); k<=int(center.z()+radius); ++k)
+        {
+            for(int j=int(center.y()-radius); j<=int(center.y()+radius); ++j)
+            {
+                for(int i=int(center.x()-radius); i<=int(center.x()+radius); ++i)
+                {
+                    double d = (osg::Vec3d(i,j,k)-center).length()/radius;
+                    if (d>=1.0) continue;
+
+                    *image->data(i,j,k) = static_cast<unsigned char>((1.0-d)*255.0);
+                }
+            }
+        }
+    }
+
+    return image;
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setApplicationName(arguments.getApplicationName());
+    arguments.getApplicationUsage()->setDescription(arguments.getApplicationName()+" converts a volume to the .bvol bricked volume format and views it with its bricks paged in and out by distance.");
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName()+" [options] [3d image or .bvol file]");
+    arguments.getApplicationUsage()->addCommandLineOption("--raw <file> <s> <t> <r>","Convert the raw unsigned byte volume file of s*t*r voxels, which can be far larger than memory.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ushort","The raw volume file has unsigned short voxels.");
+    arguments.getApplicationUsage()->addCommandLineOption("--float","The raw volume file has float voxels.");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <num>","Size of the generated sparse volume along each side, when no volume is given, default 256.");
+    arguments.getApplicationUsage()->addCommandLineOption("--blobs <num>","Number of blobs in the generated sparse volume, default 20.");
+    arguments.getApplicationUsage()->addCommandLineOption("--brick-size <num>","Size of the bricks, default 64.");
+    arguments.getApplicationUsage()->addCommandLineOption("-o <file>","Name of the .bvol file to convert the volume to, default volume.bvol.");
+    arguments.getApplicationUsage()->addCommandLineOption("--convert-only","Exit once the volume has been converted.");
+    arguments.getApplicationUsage()->addCommandLineOption("--range-factor <value>","Multiple of a brick's radius within which its finer bricks are paged in, default 4.");
+    arguments.getApplicationUsage()->addCommandLineOption("--brick-cache <MB>","Memory budget of the cache of brick images, default 256.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ray-traced","Render the bricks with RayTracedTechnique rather than MultipassTechnique.");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help","Display this information.");
+
+    osgViewer::Viewer viewer(arguments);
+
+    if (arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    std::string rawFileName;
+    unsigned int s = 0, t = 0, r = 0;
+    while (arguments.read("--raw", rawFileName, s, t, r)) {}
+    GLenum dataType = GL_UNSIGNED_BYTE;
+    while (arguments.read("--ushort")) dataType = GL_UNSIGNED_SHORT;
+    while (arguments.read("--float")) dataType = GL_FLOAT;
+
+    unsigned int size = 256;
+    unsigned int numBlobs = 20;
+    unsigned int brickSize = 64;
+    while (arguments.read("--size", size)) {}
+    while (arguments.read("--blobs", numBlobs)) {}
+    while (arguments.read("--brick-size", brickSize)) {}
+
+    std::string fileName = "volume.bvol";
+    while (arguments.read("-o", fileName)) {}
+    bool convertOnly = arguments.read("--convert-only");
+
+    double rangeFactor = 4.0;
+    unsigned int brickCacheSize = 256;
+    while (arguments.read("--range-factor", rangeFactor)) {}
+    while (arguments.read("--brick-cache", brickCacheSize)) {}
+    bool rayTraced = arguments.read("--ray-traced");
+
+    std::string inputFileName;
+    for(int pos=1; pos<arguments.argc() && inputFileName.empty(); ++pos)
+    {
+        if (!arguments.isOption(pos)) inputFileName = arguments[pos];
+    }
+
+    // convert the volume, unless given a .bvol file to view
+    if (osgDB::getLowerCaseFileExtension(inputFileName)=="bvol")
+    {
+        fileName = inputFileName;
+    }
+    else
+    {
+        osg::ElapsedTime elapsedTime;
+        bool result = false;
+        if (!rawFileName.empty())
+        {
+            result = osgVolume::BrickedVolumeFile::write(rawFileName, s, t, r, GL_LUMINANCE, dataType, osg::Matrixd::identity(), brickSize, fileName);
+        }
+        else
+        {
+            osg::ref_ptr<osg::Image> image;
+            if (!inputFileName.empty()) image = osgDB::readRefImageFile(inputFileName);
+            else image = createSparseVolume(size, numBlobs);
+
+            result = image.valid() && osgVolume::BrickedVolumeFile::write(image.get(), osg::Matrixd::identity(), brickSize, fileName);
+        }
+
+        if (!result)
+        {
+            std::cout<<"Unable to convert the volume to "<<fileName<<std::endl;
+            return 1;
+        }
+
+        std::cout<<"converted to "<<fileName<<" in "<<elapsedTime.elapsedTime_m()<<"ms"<<std::endl;
+    }
+
+    if (convertOnly) return 0;
+
+    osgVolume::BrickCache::instance()->setMaximumMemory(size_t(brickCacheSize)*1024*1024);
+
+    std::ostringstream optionString;
+    optionString<<"RangeFactor "<<rangeFactor;
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options(optionString.str());
+
+    osg::ref_ptr<osgVolume::Volume> volume = dynamic_cast<osgVolume::Volume*>(osgDB::readRefNodeFile(fileName, options.get()).get());
+    if (!volume)
+    {
+        std::cout<<"Unable to read "<<fileName<<std::endl;
+        return 1;
+    }
+
+    // a transfer function that leaves the lower values fully transparent, as is typical for hiding the air around a scanned object
+    osg::ref_ptr<osg::TransferFunction1D> tf = new osg::TransferFunction1D;
+    tf->setColor(0.0, osg::Vec4(0.0,0.0,0.0,0.0));
+    tf->setColor(0.25, osg::Vec4(0.0,0.0,0.0,0.0));
+    tf->setColor(0.5, osg::Vec4(1.0,0.5,0.2,0.3));
+    tf->setColor(1.0, osg::Vec4(1.0,1.0,1.0,1.0));
+
+    // the property and technique are shared by all the bricks as they're paged in
+    osg::ref_ptr<osgVolume::CompositeProperty> cp = new osgVolume::CompositeProperty;
+    cp->addProperty(new osgVolume::SampleDensityProperty(0.005));
+    cp->addProperty(new osgVolume::TransparencyProperty(1.0));
+    cp->addProperty(new osgVolume::AlphaFuncProperty(0.02));
+    cp->addProperty(new osgVolume::TransferFunctionProperty(tf.get()));
+    volume->setProperty(cp.get());
+
+    osg::ref_ptr<osg::Node> root = volume.get();
+    if (rayTraced)
+    {
+        volume->setVolumeTechniquePrototype(new osgVolume::RayTracedTechnique);
+    }
+    else
+    {
+        volume->setVolumeTechniquePrototype(new osgVolume::MultipassTechnique);
+
+        osg::ref_ptr<osgVolume::VolumeScene> volumeScene = new osgVolume::VolumeScene;
+        volumeScene->addChild(volume.get());
+        root = volumeScene.get();
+    }
+
+    viewer.setSceneData(root.get());
+    viewer.setCameraManipulator(new osgGA::TrackballManipulator);
+    viewer.addEventHandler(new osgViewer::StatsHandler);
+
+    // keep about as many bricks in the scene graph as the brick cache can hold, so that the bricks expired by the pager
+    // are still cached when the viewer returns to them
+    osg::ref_ptr<osgVolume::BrickedVolumeFile> volumeFile = new osgVolume::BrickedVolumeFile;
+    if (volumeFile->open(fileName) && viewer.getDatabasePager())
+    {
+        size_t brickMemory = (volumeFile->getBrickSize()+2)*(volumeFile->getBrickSize()+2)*(volumeFile->getBrickSize()+2)*
+                             size_t(osg::Image::computePixelSizeInBits(volumeFile->getPixelFormat(), volumeFile->getDataType()))/8;
+        unsigned int maximumNumBricks = static_cast<unsigned int>(osg::maximum(osgVolume::BrickCache::instance()->getMaximumMemory()/brickMemory, size_t(1)));
+        viewer.getDatabasePager()->setTargetMaximumNumberOfPageLOD(maximumNumBricks);
+        std::cout<<volumeFile->getS()<<"x"<<volumeFile->getT()<<"x"<<volumeFile->getR()<<" volume in "<<volumeFile->getNumLevels()
+                 <<" levels of bricks of "<<volumeFile->getBrickSize()<<" voxels, paging up to "<<maximumNumBricks<<" bricks"<<std::endl;
+    }
+
+    int result = viewer.run();
+
+    osgVolume::BrickCache* brickCache = osgVolume::BrickCache::instance();
+    std::cout<<"brick cache: "<<brickCache->getNumImages()<<" images, "<<brickCache->getMemoryUsed()/(1024*1024)<<"MB, "
+             <<brickCache->getNumHits()<<" hits, "<<brickCache->getNumMisses()<<" misses"<<std::endl;
+
+    return result;
+}
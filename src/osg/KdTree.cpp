@@ -789,7 +789,8 @@ bool KdTree::intersect(const osg::Vec3d& start, const osg::Vec3d& end, LineSegme
 //
 // KdTreeBuilder
 KdTreeBuilder::KdTreeBuilder():
-    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    _keepHeightFieldShapes(false)
 {
     _kdTreePrototype = new osg::KdTree;
 }
@@ -797,7 +798,8 @@ KdTreeBuilder::KdTreeBuilder():
 KdTreeBuilder::KdTreeBuilder(const KdTreeBuilder& rhs):
     osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
     _buildOptions(rhs._buildOptions),
-    _kdTreePrototype(rhs._kdTreePrototype)
+    _kdTreePrototype(rhs._kdTreePrototype),
+    _keepHeightFieldShapes(rhs._keepHeightFieldShapes)
 {
 }
 
@@ -806,6 +808,9 @@ void KdTreeBuilder::apply(osg::Geometry& geometry)
     osg::KdTree* previous = dynamic_cast<osg::KdTree*>(geometry.getShape());
     if (previous) return;
 
+    // LineSegmentIntersector walks the cells of a HeightField assigned to the geometry, so it may be kept instead
+    if (_keepHeightFieldShapes && dynamic_cast<osg::HeightField*>(geometry.getShape())) return;
+
     osg::ref_ptr<osg::KdTree> kdTree = osg::clone(_kdTreePrototype.get());
 
     if (kdTree->build(_buildOptions, &geometry))
@@ -21,19 +21,24 @@ Animation::Animation(const osgAnimation::Animation& anim, const osg::CopyOp& cop
     _originalDuration(anim._originalDuration),
     _weight(anim._weight),
     _startTime(anim._startTime),
-    _playmode(anim._playmode)
+    _playmode(anim._playmode),
+    _useChannelBatch(anim._useChannelBatch)
 {
     const ChannelList& cl = anim.getChannels();
     for (ChannelList::const_iterator it = cl.begin(); it != cl.end(); ++it)
     {
         addChannel(it->get()->clone());
     }
+
+    // the cloned channels are in the same order with the same keys, so the batch can be shared
+    _channelBatch = anim._channelBatch;
 }
 
 
 void Animation::addChannel(Channel* pChannel)
 {
     _channels.push_back(pChannel);
+    _channelBatch = 0;
     if (_duration == _originalDuration)
         computeDuration();
     else
@@ -52,6 +57,7 @@ void Animation::removeChannel(Channel* pChannel)
     if (it != _channels.end())
     {
         _channels.erase(it);
+        _channelBatch = 0;
     }
     computeDuration();
 }
@@ -114,6 +120,44 @@ void Animation::setWeight (float weight)
     _weight = weight;
 }
 
+void Animation::setUseChannelBatch(bool flag)
+{
+    _useChannelBatch = flag;
+    if (!_useChannelBatch)
+    {
+        _channelBatch = 0;
+        _channelBatchState = ChannelBatch::State();
+    }
+    else if (!_channelBatch && !_channels.empty())
+    {
+        _channelBatch = new ChannelBatch(_channels);
+    }
+}
+
+void Animation::updateChannels(double time, int priority)
+{
+    if (_useChannelBatch)
+    {
+        // channels added or removed through getChannels() invalidate the batch
+        if (!_channelBatch || _channelBatch->getNumChannels()!=_channels.size())
+            _channelBatch = new ChannelBatch(_channels);
+
+        _channelBatch->update(_channels, _channelBatchState, time, _weight, priority);
+
+        for (unsigned int i=0; i<_channels.size(); ++i)
+        {
+            if (!_channelBatch->isBatched(i)) _channels[i]->update(time, _weight, priority);
+        }
+        return;
+    }
+
+    ChannelList::const_iterator chan;
+    for( chan=_channels.begin(); chan!=_channels.end(); ++chan)
+    {
+        (*chan)->update(time, _weight, priority);
+    }
+}
+
 bool Animation::update (double time, int priority)
 {
     if (!_duration) // if not initialized then do it
@@ -127,10 +171,7 @@ bool Animation::update (double time, int priority)
     case ONCE:
         if (t > _originalDuration)
         {
-            for (ChannelList::const_iterator chan = _channels.begin();
-                     chan != _channels.end(); ++chan)
-                (*chan)->update(_originalDuration, _weight, priority);
-
+            updateChannels(_originalDuration, priority);
             return false;
         }
         break;
@@ -158,11 +199,7 @@ bool Animation::update (double time, int priority)
         break;
     }
 
-    ChannelList::const_iterator chan;
-    for( chan=_channels.begin(); chan!=_channels.end(); ++chan)
-    {
-        (*chan)->update(t, _weight, priority);
-    }
+    updateChannels(t, priority);
     return true;
 }
 
@@ -14,16 +14,81 @@
 
 #include <osgAnimation/AnimationManagerBase>
 #include <osgAnimation/LinkVisitor>
+#include <osgAnimation/Bone>
+#include <osgAnimation/UpdateBone>
+#include <OpenThreads/Atomic>
 #include <algorithm>
 
 using namespace osgAnimation;
 
+namespace
+{
+
+struct CollectSkeletonsVisitor : public osg::NodeVisitor
+{
+    CollectSkeletonsVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+    void apply(osg::Transform& node)
+    {
+        Skeleton* skeleton = dynamic_cast<Skeleton*>(&node);
+        if (skeleton)
+            _skeletons.push_back(skeleton);
+        else
+            traverse(node);
+    }
+
+    std::vector<Skeleton*> _skeletons;
+};
+
+struct BoneImportanceVisitor : public osg::NodeVisitor
+{
+    BoneImportanceVisitor(float minImportance) :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _minImportance(minImportance),
+        _numBones(0),
+        _numFrozenBones(0) {}
+
+    void apply(osg::Transform& node)
+    {
+        Bone* bone = dynamic_cast<Bone*>(&node);
+        if (bone)
+        {
+            bool enabled = bone->getImportance() >= _minImportance;
+            UpdateBone* updateBone = dynamic_cast<UpdateBone*>(bone->getUpdateCallback());
+            if (updateBone)
+                updateBone->setEnabled(enabled);
+
+            ++_numBones;
+            if (!enabled)
+                ++_numFrozenBones;
+        }
+        traverse(node);
+    }
+
+    float _minImportance;
+    unsigned int _numBones;
+    unsigned int _numFrozenBones;
+};
+
+// spread the frames that the managers update on, so that characters using the same level of detail
+// don't all update in the same frame
+OpenThreads::Atomic s_lodPhase;
+
+}
+
 AnimationManagerBase::~AnimationManagerBase() {}
 
-AnimationManagerBase::AnimationManagerBase()
+AnimationManagerBase::AnimationManagerBase():
+    _lodSkeletonsDirty(true),
+    _lodPhase(++s_lodPhase),
+    _lodMinBoneImportance(0.0f),
+    _lodNumBones(0),
+    _lodNumFrozenBones(0),
+    _lodSkinningDirty(false)
 {
     _needToLink = false;
     _automaticLink = true;
+    _skinningQueue = new SkinningQueue;
 }
 
 void AnimationManagerBase::clearTargets()
@@ -35,6 +100,7 @@ void AnimationManagerBase::clearTargets()
 void AnimationManagerBase::dirty()
 {
     _needToLink = true;
+    _lodSkeletonsDirty = true;
 }
 
 void AnimationManagerBase::setAutomaticLink(bool state) { _automaticLink = state; }
@@ -56,13 +122,28 @@ void AnimationManagerBase::operator()(osg::Node* node, osg::NodeVisitor* nv)
             link(node);
         }
         const osg::FrameStamp* fs = nv->getFrameStamp();
-        update(fs->getSimulationTime());
+        if (_lodLevels.empty() || updateLOD(node, fs->getFrameNumber()))
+            update(fs->getSimulationTime());
+
+        traverse(node,nv);
+
+        // the bones are all up to date now so skin the RigGeometry collected during the traversal
+        if (_skinningQueue.valid())
+            _skinningQueue->run();
+        return;
     }
     traverse(node,nv);
 }
 
 
-AnimationManagerBase::AnimationManagerBase(const AnimationManagerBase& b, const osg::CopyOp& copyop) : osg::Callback(b, copyop), osg::NodeCallback(b,copyop) // TODO check this
+AnimationManagerBase::AnimationManagerBase(const AnimationManagerBase& b, const osg::CopyOp& copyop) : osg::Callback(b, copyop), osg::NodeCallback(b,copyop), // TODO check this
+    _lodLevels(b._lodLevels),
+    _lodSkeletonsDirty(true),
+    _lodPhase(++s_lodPhase),
+    _lodMinBoneImportance(0.0f),
+    _lodNumBones(0),
+    _lodNumFrozenBones(0),
+    _lodSkinningDirty(false)
 {
     const AnimationList& animationList = b.getAnimationList();
     for (AnimationList::const_iterator it = animationList.begin();
@@ -74,6 +155,8 @@ AnimationManagerBase::AnimationManagerBase(const AnimationManagerBase& b, const
     }
     _needToLink = true;
     _automaticLink = b._automaticLink;
+    if (b._skinningQueue.valid())
+        _skinningQueue = new SkinningQueue;
     buildTargetReference();
 }
 
@@ -133,3 +216,121 @@ void AnimationManagerBase::link(osg::Node* subgraph)
     _needToLink = false;
     buildTargetReference();
 }
+
+void AnimationManagerBase::setLODLevels(const LODLevelList& levels)
+{
+    _lodLevels = levels;
+    if (_lodLevels.empty())
+    {
+        // back to updating everything at full detail
+        setMinBoneImportance(0.0f);
+        for (SkeletonList::iterator it = _lodSkeletons.begin(); it != _lodSkeletons.end(); ++it)
+        {
+            if (it->valid())
+            {
+                (*it)->setUpdateBones(true);
+                (*it)->setUpdateSkinning(true);
+            }
+        }
+    }
+}
+
+void AnimationManagerBase::setMinBoneImportance(float minBoneImportance)
+{
+    _lodMinBoneImportance = minBoneImportance;
+    _lodNumBones = 0;
+    _lodNumFrozenBones = 0;
+    for (SkeletonList::iterator it = _lodSkeletons.begin(); it != _lodSkeletons.end(); ++it)
+    {
+        if (!it->valid())
+            continue;
+
+        BoneImportanceVisitor visitor(minBoneImportance);
+        (*it)->accept(visitor);
+        _lodNumBones += visitor._numBones;
+        _lodNumFrozenBones += visitor._numFrozenBones;
+    }
+}
+
+bool AnimationManagerBase::updateLOD(osg::Node* node, unsigned int frameNumber)
+{
+    if (_lodSkeletonsDirty || _lodNode.get() != node)
+    {
+        CollectSkeletonsVisitor collector;
+        node->accept(collector);
+        _lodSkeletons.assign(collector._skeletons.begin(), collector._skeletons.end());
+        _lodNode = node;
+        _lodSkeletonsDirty = false;
+        setMinBoneImportance(_lodMinBoneImportance);
+    }
+
+    // the cull traversal of the previous frame tells how large the skeletons are on screen
+    bool visible = false;
+    float pixelSize = 0.0f;
+    for (SkeletonList::iterator it = _lodSkeletons.begin(); it != _lodSkeletons.end(); ++it)
+    {
+        if (!it->valid())
+            continue;
+
+        unsigned int cullFrameNumber = (*it)->getCullFrameNumber();
+        if (cullFrameNumber != osg::UNINITIALIZED_FRAME_NUMBER && cullFrameNumber + 1 >= frameNumber)
+        {
+            visible = true;
+            pixelSize = osg::maximum(pixelSize, (*it)->getCullPixelSize());
+        }
+    }
+
+    unsigned int level = _lodLevels.size() - 1;
+    if (visible)
+    {
+        for (unsigned int i = 0; i < _lodLevels.size(); ++i)
+        {
+            if (pixelSize >= _lodLevels[i]._minPixelSize)
+            {
+                level = i;
+                break;
+            }
+        }
+    }
+    const LODLevel& lod = _lodLevels[level];
+
+    if (lod._minBoneImportance != _lodMinBoneImportance)
+        setMinBoneImportance(lod._minBoneImportance);
+
+    unsigned int updatePeriod = osg::maximum(lod._updatePeriod, 1u);
+    bool updateBones = (frameNumber + _lodPhase) % updatePeriod == 0;
+
+    // skin when the bones have moved since the last skinning and the skeletons can be seen
+    bool updateSkinning = visible && (updateBones || _lodSkinningDirty);
+    _lodSkinningDirty = (updateBones || _lodSkinningDirty) && !updateSkinning;
+
+    unsigned int numSkeletons = 0;
+    for (SkeletonList::iterator it = _lodSkeletons.begin(); it != _lodSkeletons.end(); ++it)
+    {
+        if (it->valid())
+        {
+            (*it)->setUpdateBones(updateBones);
+            (*it)->setUpdateSkinning(updateSkinning);
+            ++numSkeletons;
+        }
+    }
+
+    if (updateBones)
+    {
+        ++_lodStatistics.numUpdates;
+        _lodStatistics.numBoneUpdates += _lodNumBones - _lodNumFrozenBones;
+        _lodStatistics.numSkippedBoneUpdates += _lodNumFrozenBones;
+    }
+    else
+    {
+        ++_lodStatistics.numSkippedUpdates;
+        _lodStatistics.numSkippedBoneUpdates += _lodNumBones;
+    }
+
+    if (updateSkinning)
+        _lodStatistics.numSkinnings += numSkeletons;
+    else
+        _lodStatistics.numSkippedSkinnings += numSkeletons;
+
+    return updateBones;
+}
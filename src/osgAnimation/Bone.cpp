@@ -18,11 +18,11 @@
 
 using namespace osgAnimation;
 
-Bone::Bone(const Bone& b, const osg::CopyOp& copyop) : osg::MatrixTransform(b,copyop), _invBindInSkeletonSpace(b._invBindInSkeletonSpace), _boneInSkeletonSpace(b._boneInSkeletonSpace)
+Bone::Bone(const Bone& b, const osg::CopyOp& copyop) : osg::MatrixTransform(b,copyop), _invBindInSkeletonSpace(b._invBindInSkeletonSpace), _boneInSkeletonSpace(b._boneInSkeletonSpace), _importance(b._importance)
 {
 }
 
-Bone::Bone(const std::string& name)
+Bone::Bone(const std::string& name) : _importance(1.0f)
 {
     if (!name.empty())
         setName(name);
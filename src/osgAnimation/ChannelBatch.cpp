@@ -0,0 +1,190 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+ */
+
+#include <osgAnimation/ChannelBatch>
+#include <osg/Notify>
+#include <map>
+
+using namespace osgAnimation;
+
+namespace
+{
+
+template<class ChannelType>
+const typename ChannelType::KeyframeContainerType* getKeyframes(const Channel* channel)
+{
+    const ChannelType* typed = dynamic_cast<const ChannelType*>(channel);
+    if (!typed || !typed->getSamplerTyped() || !typed->getTargetTyped()) return 0;
+
+    const typename ChannelType::KeyframeContainerType* keyframes = typed->getSamplerTyped()->getKeyframeContainerTyped();
+    return (keyframes && !keyframes->empty()) ? keyframes : 0;
+}
+
+template<class KeyframeContainerType>
+std::vector<double> getTimes(const KeyframeContainerType& keyframes)
+{
+    std::vector<double> times(keyframes.size());
+    for(unsigned int i=0; i<keyframes.size(); ++i) times[i] = keyframes[i].getTime();
+    return times;
+}
+
+}
+
+ChannelBatch::ChannelBatch(const ChannelList& channels):
+    _batched(channels.size(), false),
+    _numBatchedChannels(0),
+    _numVec3Channels(0),
+    _numQuatChannels(0)
+{
+    typedef std::map<std::vector<double>, unsigned int> GroupMap;
+    GroupMap groupMap;
+
+    for(unsigned int i=0; i<channels.size(); ++i)
+    {
+        const Channel* channel = channels[i].get();
+        const Vec3LinearChannel::KeyframeContainerType* vec3Keyframes = getKeyframes<Vec3LinearChannel>(channel);
+        const QuatSphericalLinearChannel::KeyframeContainerType* quatKeyframes = vec3Keyframes ? 0 : getKeyframes<QuatSphericalLinearChannel>(channel);
+        if (!vec3Keyframes && !quatKeyframes) continue;
+
+        std::vector<double> times = vec3Keyframes ? getTimes(*vec3Keyframes) : getTimes(*quatKeyframes);
+        GroupMap::iterator itr = groupMap.find(times);
+        if (itr == groupMap.end())
+        {
+            itr = groupMap.insert(GroupMap::value_type(times, static_cast<unsigned int>(_groups.size()))).first;
+            _groups.push_back(Group());
+            _groups.back().times.swap(times);
+        }
+
+        Group& group = _groups[itr->second];
+        if (vec3Keyframes) { group.vec3Channels.push_back(i); ++_numVec3Channels; }
+        else { group.quatChannels.push_back(i); ++_numQuatChannels; }
+
+        _batched[i] = true;
+        ++_numBatchedChannels;
+    }
+
+    // store the values of each group key by key, so the values interpolated together are next to each other
+    for(GroupList::iterator itr = _groups.begin(); itr != _groups.end(); ++itr)
+    {
+        Group& group = *itr;
+        unsigned int numKeys = group.times.size();
+
+        unsigned int numVec3 = group.vec3Channels.size();
+        group.vec3Values.resize(numKeys*numVec3);
+        for(unsigned int c=0; c<numVec3; ++c)
+        {
+            const Vec3LinearChannel::KeyframeContainerType& keyframes = *getKeyframes<Vec3LinearChannel>(channels[group.vec3Channels[c]].get());
+            for(unsigned int k=0; k<numKeys; ++k) group.vec3Values[k*numVec3+c] = keyframes[k].getValue();
+        }
+
+        unsigned int numQuat = group.quatChannels.size();
+        group.quatValues.resize(numKeys*numQuat);
+        for(unsigned int c=0; c<numQuat; ++c)
+        {
+            const QuatSphericalLinearChannel::KeyframeContainerType& keyframes = *getKeyframes<QuatSphericalLinearChannel>(channels[group.quatChannels[c]].get());
+            for(unsigned int k=0; k<numKeys; ++k) group.quatValues[k*numQuat+c] = keyframes[k].getValue();
+        }
+    }
+
+    OSG_INFO<<"ChannelBatch::ChannelBatch() batched "<<_numBatchedChannels<<" of "<<channels.size()<<" channels in "<<_groups.size()<<" groups"<<std::endl;
+}
+
+ChannelBatch::~ChannelBatch()
+{
+}
+
+void ChannelBatch::update(const ChannelList& channels, State& state, double time, float weight, int priority) const
+{
+    // skip if weight == 0, as Channel::update() does
+    if (weight < 1e-4) return;
+
+    state.keyHints.resize(_groups.size(), 0);
+    state.vec3Values.resize(_numVec3Channels);
+    state.quatValues.resize(_numQuatChannels);
+
+    osg::Vec3* vec3Result = state.vec3Values.empty() ? 0 : &state.vec3Values.front();
+    osg::Quat* quatResult = state.quatValues.empty() ? 0 : &state.quatValues.front();
+
+    for(unsigned int g=0; g<_groups.size(); ++g)
+    {
+        const Group& group = _groups[g];
+        const double* times = &group.times.front();
+        unsigned int numKeys = group.times.size();
+        unsigned int numVec3 = group.vec3Channels.size();
+        unsigned int numQuat = group.quatChannels.size();
+
+        if (time >= times[numKeys-1] || time <= times[0])
+        {
+            unsigned int k = (time >= times[numKeys-1]) ? numKeys-1 : 0;
+            for(unsigned int c=0; c<numVec3; ++c) vec3Result[c] = group.vec3Values[k*numVec3+c];
+            for(unsigned int c=0; c<numQuat; ++c) quatResult[c] = group.quatValues[k*numQuat+c];
+        }
+        else
+        {
+            // same search as TemplateInterpolatorBase::getKeyIndexFromTime(), with the hint kept in the State
+            unsigned int& hint = state.keyHints[g];
+            int last = static_cast<int>(hint) - 1;
+            int k = -1;
+            if (last >= 0 && last+1 < static_cast<int>(numKeys) && times[last] < time)
+            {
+                if (time <= times[last+1])
+                {
+                    k = last;
+                }
+                else if (last+2 < static_cast<int>(numKeys) && time <= times[last+2])
+                {
+                    k = last+1;
+                    hint = k+1;
+                }
+            }
+
+            if (k<0)
+            {
+                int l = numKeys;
+                int mid = numKeys/2;
+                k = 0;
+                while(mid != k)
+                {
+                    if (times[mid] < time) k = mid;
+                    else l = mid;
+                    mid = (l+k)/2;
+                }
+                hint = k+1;
+            }
+
+            float blend = (time - times[k]) / (times[k+1] - times[k]);
+
+            const osg::Vec3* v1 = numVec3 ? &group.vec3Values[k*numVec3] : 0;
+            const osg::Vec3* v2 = v1 + numVec3;
+            for(unsigned int c=0; c<numVec3; ++c) vec3Result[c] = v1[c]*(1-blend) + v2[c]*blend;
+
+            const osg::Quat* q1 = numQuat ? &group.quatValues[k*numQuat] : 0;
+            const osg::Quat* q2 = q1 + numQuat;
+            for(unsigned int c=0; c<numQuat; ++c) quatResult[c].slerp(blend, q1[c], q2[c]);
+        }
+
+        for(unsigned int c=0; c<numVec3; ++c)
+        {
+            Vec3LinearChannel::TargetType* target = static_cast<Vec3LinearChannel*>(channels[group.vec3Channels[c]].get())->getTargetTyped();
+            if (target->getEnabled()) target->update(weight, vec3Result[c], priority);
+        }
+        for(unsigned int c=0; c<numQuat; ++c)
+        {
+            QuatSphericalLinearChannel::TargetType* target = static_cast<QuatSphericalLinearChannel*>(channels[group.quatChannels[c]].get())->getTargetTyped();
+            if (target->getEnabled()) target->update(weight, quatResult[c], priority);
+        }
+
+        vec3Result += numVec3;
+        quatResult += numQuat;
+    }
+}
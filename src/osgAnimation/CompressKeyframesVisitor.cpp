@@ -0,0 +1,227 @@
+/*  -*-c++-*-
+ *  Copyright (C) 2008 Cedric Pinson <cedric.pinson@plopbyte.net>
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+ */
+
+#include <osgAnimation/CompressKeyframesVisitor>
+#include <osgAnimation/AnimationManagerBase>
+#include <osgAnimation/Channel>
+#include <osg/Notify>
+
+using namespace osgAnimation;
+
+namespace
+{
+    // longest run of keys replaced by a single segment, bounds the cost of the reduction
+    const unsigned int MAX_SEGMENT_KEYS = 1024;
+
+    double keyError(float a, float b) { return fabs(a - b); }
+    double keyError(double a, double b) { return fabs(a - b); }
+    double keyError(const osg::Vec3& a, const osg::Vec3& b) { return (a - b).length(); }
+    double keyError(const osg::Quat& a, const osg::Quat& b)
+    {
+        double length = a.length() * b.length();
+        if (length == 0.0)
+            return 0.0;
+        double d = osg::minimum(fabs(a.asVec4() * b.asVec4()) / length, 1.0);
+        return 2.0 * acos(d);
+    }
+
+    template <class T>
+    T interpolate(const T& a, const T& b, float t) { return a*(1-t) + b*t; }
+
+    osg::Quat interpolate(const osg::Quat& a, const osg::Quat& b, float t)
+    {
+        osg::Quat q;
+        q.slerp(t, a, b);
+        return q;
+    }
+
+    // Remove the keys the interpolation of the kept keys reproduces within the tolerance. Each segment is
+    // extended greedily while every key it spans stays within the tolerance, as the channels are linear
+    // the error between two keys is bounded by the error on the keys themselves.
+    template <class ContainerType>
+    void reduceKeys(ContainerType& keys, double tolerance)
+    {
+        unsigned int numKeys = keys.size();
+        if (numKeys < 3)
+            return;
+
+        typename ContainerType::VectorType reduced;
+        reduced.push_back(keys[0]);
+        unsigned int start = 0;
+        for (unsigned int end = 2; end < numKeys; ++end)
+        {
+            bool fits = end - start <= MAX_SEGMENT_KEYS;
+            double startTime = keys[start].getTime();
+            double duration = keys[end].getTime() - startTime;
+            for (unsigned int i = start + 1; i < end && fits; ++i)
+            {
+                float t = duration > 0.0 ? (keys[i].getTime() - startTime) / duration : 0.0f;
+                fits = keyError(interpolate(keys[start].getValue(), keys[end].getValue(), t), keys[i].getValue()) <= tolerance;
+            }
+
+            if (!fits)
+            {
+                start = end - 1;
+                reduced.push_back(keys[start]);
+            }
+        }
+        reduced.push_back(keys[numKeys - 1]);
+        keys.swap(reduced);
+    }
+
+    template <class ChannelType>
+    typename ChannelType::KeyframeContainerType* getKeys(ChannelType* channel)
+    {
+        if (!channel->getSamplerTyped())
+            return 0;
+        return channel->getSamplerTyped()->getKeyframeContainerTyped();
+    }
+}
+
+CompressKeyframesVisitor::CompressKeyframesVisitor() :
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    _translationTolerance(1e-3),
+    _rotationTolerance(1e-3),
+    _scaleTolerance(1e-3),
+    _scalarTolerance(1e-3),
+    _quantize(true)
+{
+    reset();
+}
+
+void CompressKeyframesVisitor::reset()
+{
+    _compressed.clear();
+    _reduced.clear();
+    _quantized.clear();
+    _numKeysBefore = 0;
+    _numKeysAfter = 0;
+    _memoryBefore = 0;
+    _memoryAfter = 0;
+}
+
+void CompressKeyframesVisitor::apply(osg::Node& node)
+{
+    osg::Callback* cb = node.getUpdateCallback();
+    while (cb)
+    {
+        AnimationManagerBase* manager = dynamic_cast<AnimationManagerBase*>(cb);
+        if (manager)
+        {
+            AnimationList& animations = manager->getAnimationList();
+            for (AnimationList::iterator it = animations.begin(); it != animations.end(); ++it)
+            {
+                if (it->valid())
+                    compress(*(it->get()));
+            }
+        }
+        cb = cb->getNestedCallback();
+    }
+    traverse(node);
+}
+
+void CompressKeyframesVisitor::compress(Animation& animation)
+{
+    if (!_compressed.insert(&animation).second)
+        return;
+
+    ChannelList& channels = animation.getChannels();
+    for (ChannelList::iterator it = channels.begin(); it != channels.end(); ++it)
+    {
+        if (it->valid())
+            *it = compress(it->get());
+    }
+
+    OSG_INFO << "CompressKeyframesVisitor compressed animation \"" << animation.getName() << "\"" << std::endl;
+}
+
+template <class ContainerType>
+void CompressKeyframesVisitor::reduce(ContainerType* keys, double tolerance, unsigned int compressedKeySize)
+{
+    if (!_reduced.insert(keys).second)
+        return;
+
+    _numKeysBefore += keys->size();
+    _memoryBefore += keys->size() * sizeof(typename ContainerType::value_type);
+
+    reduceKeys(*keys, tolerance);
+
+    _numKeysAfter += keys->size();
+    _memoryAfter += keys->size() * compressedKeySize;
+}
+
+template <class CompressedChannelType, class ChannelType>
+Channel* CompressKeyframesVisitor::quantize(ChannelType* channel)
+{
+    typedef typename CompressedChannelType::KeyframeContainerType CompressedContainerType;
+
+    typename ChannelType::KeyframeContainerType* keys = getKeys(channel);
+    osg::ref_ptr<KeyframeContainer>& compressedKeys = _quantized[keys];
+    if (!compressedKeys.valid())
+    {
+        CompressedContainerType* container = new CompressedContainerType;
+        container->assign(*keys);
+        compressedKeys = container;
+    }
+
+    CompressedChannelType* compressed = new CompressedChannelType;
+    compressed->setName(channel->getName());
+    compressed->setTargetName(channel->getTargetName());
+    compressed->setTarget(channel->getTargetTyped());
+    compressed->getOrCreateSampler()->setKeyframeContainer(static_cast<CompressedContainerType*>(compressedKeys.get()));
+    return compressed;
+}
+
+Channel* CompressKeyframesVisitor::compress(Channel* channel)
+{
+    if (Vec3LinearChannel* vec3Channel = dynamic_cast<Vec3LinearChannel*>(channel))
+    {
+        Vec3KeyframeContainer* keys = getKeys(vec3Channel);
+        if (!keys)
+            return channel;
+
+        reduce(keys, channel->getName() == "scale" ? _scaleTolerance : _translationTolerance,
+               _quantize ? sizeof(Vec3QuantizedKeyframeContainer::value_type) : sizeof(Vec3Keyframe));
+        return _quantize ? quantize<Vec3QuantizedLinearChannel>(vec3Channel) : channel;
+    }
+
+    if (QuatSphericalLinearChannel* quatChannel = dynamic_cast<QuatSphericalLinearChannel*>(channel))
+    {
+        QuatKeyframeContainer* keys = getKeys(quatChannel);
+        if (!keys)
+            return channel;
+
+        reduce(keys, _rotationTolerance,
+               _quantize ? sizeof(QuatPackedKeyframeContainer::value_type) : sizeof(QuatKeyframe));
+        return _quantize ? quantize<QuatPackedSphericalLinearChannel>(quatChannel) : channel;
+    }
+
+    if (FloatLinearChannel* floatChannel = dynamic_cast<FloatLinearChannel*>(channel))
+    {
+        FloatKeyframeContainer* keys = getKeys(floatChannel);
+        if (keys)
+            reduce(keys, _scalarTolerance, sizeof(FloatKeyframe));
+        return channel;
+    }
+
+    if (DoubleLinearChannel* doubleChannel = dynamic_cast<DoubleLinearChannel*>(channel))
+    {
+        DoubleKeyframeContainer* keys = getKeys(doubleChannel);
+        if (keys)
+            reduce(keys, _scalarTolerance, sizeof(DoubleKeyframe));
+        return channel;
+    }
+
+    return channel;
+}
@@ -18,9 +18,85 @@
 #include <osgAnimation/BoneMapVisitor>
 #include <osgAnimation/RigGeometry>
 
+#include <osgUtil/WorkerThreadPool>
+
 using namespace osgAnimation;
 
-RigTransformSoftware::RigTransformSoftware()
+namespace
+{
+
+// below this number of vertices splitting a mesh across threads costs more than it saves
+const unsigned int s_minVerticesForWorkerThreads = 8192;
+
+// product of the quaternions a and b, with w the scalar part
+inline osg::Quat multiply(const osg::Quat& a, const osg::Quat& b)
+{
+    return osg::Quat(a.w()*b.x() + a.x()*b.w() + a.y()*b.z() - a.z()*b.y(),
+                     a.w()*b.y() - a.x()*b.z() + a.y()*b.w() + a.z()*b.x(),
+                     a.w()*b.z() + a.x()*b.y() - a.y()*b.x() + a.z()*b.w(),
+                     a.w()*b.w() - a.x()*b.x() - a.y()*b.y() - a.z()*b.z());
+}
+
+// affine matrix in float, laid out as the three rows x' = m[0..3].(x,y,z,1) etc. so that
+// transforming a vertex is three independent dot products
+struct SkinMatrix
+{
+    SkinMatrix(const osg::Matrix& matrix)
+    {
+        for(unsigned int r=0; r<3; ++r)
+        {
+            for(unsigned int c=0; c<4; ++c)
+            {
+                m[r*4+c] = static_cast<float>(matrix(c,r));
+            }
+        }
+    }
+
+    inline void transform(const osg::Vec3* src, osg::Vec3* dst, const int* indices, unsigned int numIndices) const
+    {
+        for(unsigned int i=0; i<numIndices; ++i)
+        {
+            const osg::Vec3& v = src[indices[i]];
+            osg::Vec3& d = dst[indices[i]];
+            d.x() = m[0]*v.x() + m[1]*v.y() + m[2]*v.z() + m[3];
+            d.y() = m[4]*v.x() + m[5]*v.y() + m[6]*v.z() + m[7];
+            d.z() = m[8]*v.x() + m[9]*v.y() + m[10]*v.z() + m[11];
+        }
+    }
+
+    inline void transform3x3(const osg::Vec3* src, osg::Vec3* dst, const int* indices, unsigned int numIndices) const
+    {
+        for(unsigned int i=0; i<numIndices; ++i)
+        {
+            const osg::Vec3& v = src[indices[i]];
+            osg::Vec3& d = dst[indices[i]];
+            d.x() = m[0]*v.x() + m[1]*v.y() + m[2]*v.z();
+            d.y() = m[4]*v.x() + m[5]*v.y() + m[6]*v.z();
+            d.z() = m[8]*v.x() + m[9]*v.y() + m[10]*v.z();
+        }
+    }
+
+    float m[12];
+};
+
+}
+
+struct RigTransformSoftware::SkinVertexSetsOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+    SkinVertexSetsOperation(RigTransformSoftware& rig) : _rig(rig) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        _rig.skinVertexSets(begin, end);
+    }
+
+    RigTransformSoftware& _rig;
+};
+
+RigTransformSoftware::RigTransformSoftware():
+    _blendMethod(LINEAR_BLEND),
+    _doubleBuffered(false),
+    _identityTransform(true)
 {
     _needInit = true;
 }
@@ -40,68 +116,308 @@ bool RigTransformSoftware::init(RigGeometry& geom)
     geom.setVertexArray(0);
     geom.setNormalArray(0);
 
+    initBuffers(geom);
+
     _needInit = false;
     return true;
 }
 
 void RigTransformSoftware::operator()(RigGeometry& geom)
+{
+    if (!prepare(geom))
+        return;
+
+    skin(true);
+    finish(geom);
+}
+
+void RigTransformSoftware::BufferedDrawCallback::swapBuffers()
+{
+    // only the update traversal changes the front buffer, so the XOR moves it on to the back buffer, and being a
+    // full barrier, unlike exchange(), the draw threads see the skinned vertices once they see the new front buffer.
+    unsigned int frontBuffer = _frontBuffer;
+    _frontBuffer.XOR(frontBuffer ^ getBackBuffer());
+}
+
+void RigTransformSoftware::BufferedDrawCallback::drawImplementation(osg::RenderInfo& renderInfo, const osg::Drawable*) const
+{
+    const osg::Geometry* geometry = getFrontBuffer();
+    if (geometry)
+        geometry->drawImplementation(renderInfo);
+}
+
+void RigTransformSoftware::initBuffers(RigGeometry& geom)
+{
+    if (!_doubleBuffered)
+    {
+        if (_bufferedDrawCallback.valid() && geom.getDrawCallback() == _bufferedDrawCallback.get())
+            geom.setDrawCallback(0);
+        _bufferedDrawCallback = 0;
+        return;
+    }
+
+    osg::Geometry* source = geom.getSourceGeometry();
+    osg::Vec3Array* positionSrc = source ? dynamic_cast<osg::Vec3Array*>(source->getVertexArray()) : 0;
+    osg::Vec3Array* normalSrc = source ? dynamic_cast<osg::Vec3Array*>(source->getNormalArray()) : 0;
+
+    _bufferedDrawCallback = new BufferedDrawCallback;
+    for (unsigned int i = 0; i < BufferedDrawCallback::NUM_BUFFERS; ++i)
+    {
+        // only the arrays and primitives of the buffers are drawn, the state and callbacks are those of the RigGeometry
+        osg::Geometry* buffer = new osg::Geometry(geom, osg::CopyOp::SHALLOW_COPY);
+        buffer->setStateSet(0);
+        buffer->setUpdateCallback(0);
+        buffer->setCullCallback(0);
+        buffer->setDrawCallback(0);
+        buffer->setComputeBoundingBoxCallback(0);
+
+        // each buffer has a buffer object of its own, so skinning the back buffer doesn't dirty the front buffer
+        osg::ref_ptr<osg::VertexBufferObject> vbo = buffer->getUseVertexBufferObjects() ? new osg::VertexBufferObject : 0;
+        if (positionSrc)
+        {
+            osg::Vec3Array* positions = new osg::Vec3Array(*positionSrc);
+            positions->setVertexBufferObject(vbo.get());
+            buffer->setVertexArray(positions);
+        }
+        if (normalSrc)
+        {
+            osg::Vec3Array* normals = new osg::Vec3Array(*normalSrc);
+            normals->setVertexBufferObject(vbo.get());
+            buffer->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+        }
+
+        _bufferedDrawCallback->_buffers[i] = buffer;
+    }
+
+    // the arrays of the RigGeometry aren't drawn, so give it the bind pose for intersections rather than changing them each frame
+    geom.setVertexArray(positionSrc);
+    geom.setNormalArray(normalSrc, osg::Array::BIND_PER_VERTEX);
+    geom.setDrawCallback(_bufferedDrawCallback.get());
+}
+
+osg::Vec3Array* RigTransformSoftware::getOutputArray(osg::Vec3Array* src, osg::Vec3Array* current)
+{
+    if (!src)
+        return 0;
+
+    osg::Vec3Array* dst = current;
+    if (!dst)
+    {
+        dst = new osg::Vec3Array;
+        dst->setDataVariance(osg::Object::DYNAMIC);
+    }
+
+    if (dst->size() != src->size())
+        *dst = *src;
+
+    return dst;
+}
+
+bool RigTransformSoftware::prepare(RigGeometry& geom)
 {
     if (_needInit)
         if (!init(geom))
-            return;
+            return false;
 
     if (!geom.getSourceGeometry()) {
         OSG_WARN << this << " RigTransformSoftware no source geometry found on RigGeometry" << std::endl;
-        return;
+        return false;
     }
     osg::Geometry& source = *geom.getSourceGeometry();
     osg::Geometry& destination = geom;
 
-    osg::Vec3Array* positionSrc = dynamic_cast<osg::Vec3Array*>(source.getVertexArray());
-    osg::Vec3Array* positionDst = dynamic_cast<osg::Vec3Array*>(destination.getVertexArray());
-    if (positionSrc && (!positionDst || (positionDst->size() != positionSrc->size()) ) )
+    _positionSrc = dynamic_cast<osg::Vec3Array*>(source.getVertexArray());
+    _normalSrc = dynamic_cast<osg::Vec3Array*>(source.getNormalArray());
+
+    if (_bufferedDrawCallback.valid())
+    {
+        // skin into the back buffer, which is neither drawn now nor was drawn the frame before
+        osg::Geometry* buffer = _bufferedDrawCallback->getBuffer(_bufferedDrawCallback->getBackBuffer());
+        _positionDst = getOutputArray(_positionSrc.get(), dynamic_cast<osg::Vec3Array*>(buffer->getVertexArray()));
+        _normalDst = getOutputArray(_normalSrc.get(), dynamic_cast<osg::Vec3Array*>(buffer->getNormalArray()));
+    }
+    else
+    {
+        _positionDst = getOutputArray(_positionSrc.get(), dynamic_cast<osg::Vec3Array*>(destination.getVertexArray()));
+        if (_positionDst.valid() && destination.getVertexArray() != _positionDst.get())
+            destination.setVertexArray(_positionDst.get());
+
+        _normalDst = getOutputArray(_normalSrc.get(), dynamic_cast<osg::Vec3Array*>(destination.getNormalArray()));
+        if (_normalDst.valid() && destination.getNormalArray() != _normalDst.get())
+            destination.setNormalArray(_normalDst.get(), osg::Array::BIND_PER_VERTEX);
+    }
+
+    _transform = geom.getMatrixFromSkeletonToGeometry();
+    _invTransform = geom.getInvMatrixFromSkeletonToGeometry();
+    _identityTransform = _transform.isIdentity() && _invTransform.isIdentity();
+
+    return true;
+}
+
+void RigTransformSoftware::computePalette()
+{
+    unsigned int numBones = _paletteBones.size();
+    _palette.resize(numBones);
+    if (_blendMethod == DUAL_QUATERNION_BLEND)
     {
-        if (!positionDst)
+        _paletteReal.resize(numBones);
+        _paletteDual.resize(numBones);
+    }
+
+    for (unsigned int i = 0; i < numBones; i++)
+    {
+        const Bone* bone = _paletteBones[i].get();
+        if (!bone)
         {
-            positionDst = new osg::Vec3Array;
-            positionDst->setDataVariance(osg::Object::DYNAMIC);
-            destination.setVertexArray(positionDst);
+            OSG_WARN << this << " RigTransformSoftware::computePalette Warning a bone is null, skip it" << std::endl;
+            // a zero matrix or dual quaternion drops the bone from the blend
+            _palette[i].set(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+            if (_blendMethod == DUAL_QUATERNION_BLEND)
+                _paletteReal[i] = _paletteDual[i] = osg::Quat(0, 0, 0, 0);
+            continue;
+        }
+
+        _palette[i] = bone->getInvBindMatrixInSkeletonSpace() * bone->getMatrixInSkeletonSpace();
+
+        if (_blendMethod == DUAL_QUATERNION_BLEND)
+        {
+            osg::Vec3d translation, scale;
+            osg::Quat rotation, scaleOrientation;
+            _palette[i].decompose(translation, rotation, scale, scaleOrientation);
+            _paletteReal[i] = rotation;
+            _paletteDual[i] = multiply(osg::Quat(translation.x(), translation.y(), translation.z(), 0.0), rotation) * 0.5;
         }
-        *positionDst = *positionSrc;
     }
+}
 
-    osg::Vec3Array* normalSrc = dynamic_cast<osg::Vec3Array*>(source.getNormalArray());
-    osg::Vec3Array* normalDst = dynamic_cast<osg::Vec3Array*>(destination.getNormalArray());
-    if (normalSrc && (!normalDst || (normalDst->size() != normalSrc->size()) ) )
+void RigTransformSoftware::computeMatrixForVertexSet(unsigned int set, osg::Matrix& matrix) const
+{
+    const PaletteWeightList& weights = _boneSetPaletteWeights[set];
+    unsigned int numBones = weights.size();
+    if (numBones == 0)
+    {
+        matrix.makeIdentity();
+    }
+    else if (_blendMethod == DUAL_QUATERNION_BLEND)
     {
-        if (!normalDst)
+        // blend the dual quaternions, flipping those on the other hemisphere to the first one so that
+        // the blend takes the shortest path, then convert the normalized result back to a matrix
+        const osg::Quat& pivot = _paletteReal[weights[0]._index];
+        osg::Quat real(0, 0, 0, 0);
+        osg::Quat dual(0, 0, 0, 0);
+        for (unsigned int i = 0; i < numBones; i++)
+        {
+            double w = weights[i]._weight;
+            if (_paletteReal[weights[i]._index].asVec4() * pivot.asVec4() < 0.0) w = -w;
+            real += _paletteReal[weights[i]._index] * w;
+            dual += _paletteDual[weights[i]._index] * w;
+        }
+
+        double length = real.length();
+        if (length > 0.0)
+        {
+            real /= length;
+            dual /= length;
+            osg::Quat translation = multiply(dual, real.conj()) * 2.0;
+            matrix.makeRotate(real);
+            matrix.setTrans(translation.x(), translation.y(), translation.z());
+        }
+        else
         {
-            normalDst = new osg::Vec3Array;
-            normalDst->setDataVariance(osg::Object::DYNAMIC);
-            destination.setNormalArray(normalDst, osg::Array::BIND_PER_VERTEX);
+            matrix.makeIdentity();
         }
-        *normalDst = *normalSrc;
     }
+    else
+    {
+        matrix.set(0, 0, 0, 0,
+                   0, 0, 0, 0,
+                   0, 0, 0, 0,
+                   0, 0, 0, 1);
+        osg::Matrix::value_type* ptrresult = matrix.ptr();
+        for (unsigned int i = 0; i < numBones; i++)
+        {
+            const osg::Matrix::value_type* ptr = _palette[weights[i]._index].ptr();
+            osg::Matrix::value_type weight = weights[i]._weight;
+            ptrresult[0] += ptr[0] * weight;
+            ptrresult[1] += ptr[1] * weight;
+            ptrresult[2] += ptr[2] * weight;
+
+            ptrresult[4] += ptr[4] * weight;
+            ptrresult[5] += ptr[5] * weight;
+            ptrresult[6] += ptr[6] * weight;
+
+            ptrresult[8] += ptr[8] * weight;
+            ptrresult[9] += ptr[9] * weight;
+            ptrresult[10] += ptr[10] * weight;
+
+            ptrresult[12] += ptr[12] * weight;
+            ptrresult[13] += ptr[13] * weight;
+            ptrresult[14] += ptr[14] * weight;
+        }
+    }
+
+    if (!_identityTransform)
+        matrix = _transform * matrix * _invTransform;
+}
 
-    if (positionDst && !positionDst->empty())
+void RigTransformSoftware::skinVertexSets(unsigned int begin, unsigned int end)
+{
+    const osg::Vec3* positionSrc = _positionDst.valid() && !_positionDst->empty() ? &_positionSrc->front() : 0;
+    osg::Vec3* positionDst = positionSrc ? &_positionDst->front() : 0;
+    const osg::Vec3* normalSrc = _normalDst.valid() && !_normalDst->empty() ? &_normalSrc->front() : 0;
+    osg::Vec3* normalDst = normalSrc ? &_normalDst->front() : 0;
+
+    osg::Matrix matrix;
+    for (unsigned int i = begin; i < end; i++)
     {
-        compute<osg::Vec3>(geom.getMatrixFromSkeletonToGeometry(),
-                           geom.getInvMatrixFromSkeletonToGeometry(),
-                           &positionSrc->front(),
-                           &positionDst->front());
-        positionDst->dirty();
+        computeMatrixForVertexSet(i, matrix);
+        SkinMatrix skinMatrix(matrix);
+
+        const VertexList& vertexes = _boneSetVertexSet[i].getVertexes();
+        if (vertexes.empty())
+            continue;
+
+        if (positionDst)
+            skinMatrix.transform(positionSrc, positionDst, &vertexes.front(), vertexes.size());
+        if (normalDst)
+            skinMatrix.transform3x3(normalSrc, normalDst, &vertexes.front(), vertexes.size());
     }
+}
+
+void RigTransformSoftware::skin(bool useWorkerThreads)
+{
+    if (!_positionDst.valid() && !_normalDst.valid())
+        return;
 
-    if (normalDst && !normalDst->empty())
+    computePalette();
+
+    unsigned int numVertices = _positionDst.valid() ? _positionDst->size() : _normalDst->size();
+    unsigned int numSets = _boneSetVertexSet.size();
+    SkinVertexSetsOperation operation(*this);
+    if (useWorkerThreads && numVertices >= s_minVerticesForWorkerThreads)
+    {
+        // the vertex sets don't share vertices so they can be skinned concurrently
+        osgUtil::WorkerThreadPool* pool = osgUtil::WorkerThreadPool::instance();
+        pool->run(operation, numSets, osg::maximum(1u, numSets*s_minVerticesForWorkerThreads/(numVertices*4)));
+    }
+    else
     {
-        computeNormal<osg::Vec3>(geom.getMatrixFromSkeletonToGeometry(),
-                           geom.getInvMatrixFromSkeletonToGeometry(),
-                           &normalSrc->front(),
-                           &normalDst->front());
-        normalDst->dirty();
+        operation(0, numSets);
     }
 }
 
+void RigTransformSoftware::finish(RigGeometry&)
+{
+    if (_positionDst.valid())
+        _positionDst->dirty();
+
+    if (_normalDst.valid())
+        _normalDst->dirty();
+
+    if (_bufferedDrawCallback.valid())
+        _bufferedDrawCallback->swapBuffers();
+}
+
 void RigTransformSoftware::initVertexSetFromBones(const BoneMap& map, const VertexInfluenceSet::UniqVertexSetToBoneSetList& influence)
 {
     _boneSetVertexSet.clear();
@@ -143,4 +459,24 @@ void RigTransformSoftware::initVertexSetFromBones(const BoneMap& map, const Vert
         }
         _boneSetVertexSet[i].getVertexes() = inf.getVertexes();
     }
+
+    // gather the bones used into a palette so that their matrices are computed once per frame rather than once per vertex set
+    _paletteBones.clear();
+    _boneSetPaletteWeights.clear();
+    _boneSetPaletteWeights.resize(size);
+    std::map<const Bone*, unsigned int> paletteIndices;
+    for (int i = 0; i < size; i++)
+    {
+        const BoneWeightList& boneList = _boneSetVertexSet[i].getBones();
+        for (BoneWeightList::const_iterator itr = boneList.begin(); itr != boneList.end(); ++itr)
+        {
+            std::map<const Bone*, unsigned int>::iterator pitr = paletteIndices.find(itr->getBone());
+            if (pitr == paletteIndices.end())
+            {
+                pitr = paletteIndices.insert(std::make_pair(itr->getBone(), static_cast<unsigned int>(_paletteBones.size()))).first;
+                _paletteBones.push_back(const_cast<Bone*>(itr->getBone()));
+            }
+            _boneSetPaletteWeights[i].push_back(PaletteWeight(pitr->second, itr->getWeight()));
+        }
+    }
 }
@@ -14,13 +14,74 @@
 
 #include <osgAnimation/Skeleton>
 #include <osgAnimation/Bone>
+#include <osg/CullStack>
 #include <osg/Notify>
+#include <OpenThreads/ScopedLock>
 
 using namespace osgAnimation;
 
-Skeleton::Skeleton() {}
+Skeleton::Skeleton():
+    _cullFrameNumber(osg::UNINITIALIZED_FRAME_NUMBER),
+    _cullPixelSize(0.0f),
+    _updateBones(true),
+    _updateSkinning(true)
+{
+}
 
-Skeleton::Skeleton(const Skeleton& b, const osg::CopyOp& copyop) : osg::MatrixTransform(b,copyop) {}
+Skeleton::Skeleton(const Skeleton& b, const osg::CopyOp& copyop):
+    osg::MatrixTransform(b,copyop),
+    _cullFrameNumber(osg::UNINITIALIZED_FRAME_NUMBER),
+    _cullPixelSize(0.0f),
+    _updateBones(b._updateBones),
+    _updateSkinning(b._updateSkinning)
+{
+}
+
+void Skeleton::traverse(osg::NodeVisitor& nv)
+{
+    if (nv.getVisitorType() == osg::NodeVisitor::UPDATE_VISITOR && !_updateBones)
+    {
+        for (unsigned int i = 0; i < getNumChildren(); ++i)
+        {
+            osg::Node* child = getChild(i);
+            if (!dynamic_cast<Bone*>(child))
+                child->accept(nv);
+        }
+        return;
+    }
+
+    if (nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR && nv.getFrameStamp())
+    {
+        osg::CullStack* cullStack = dynamic_cast<osg::CullStack*>(&nv);
+        if (cullStack)
+        {
+            // the skeleton's own matrix is already on the modelview stack so use the bound of the children
+            osg::BoundingSphere bs;
+            for (unsigned int i = 0; i < getNumChildren(); ++i)
+                bs.expandBy(getChild(i)->getBound());
+
+            if (bs.valid())
+                setCullPixelSize(nv.getFrameStamp()->getFrameNumber(), cullStack->clampedPixelSize(bs));
+        }
+    }
+
+    osg::MatrixTransform::traverse(nv);
+}
+
+void Skeleton::setCullPixelSize(unsigned int frameNumber, float pixelSize)
+{
+    // cameras may be culled in parallel
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_cullMutex);
+    if (_cullFrameNumber != frameNumber)
+    {
+        _cullFrameNumber = frameNumber;
+        _cullPixelSize = pixelSize;
+    }
+    else if (pixelSize > _cullPixelSize)
+    {
+        _cullPixelSize = pixelSize;
+    }
+}
 
 Skeleton::UpdateSkeleton::UpdateSkeleton() : _needValidate(true) {}
 
@@ -0,0 +1,127 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+ */
+
+#include <osgAnimation/SkinningQueue>
+#include <osgAnimation/AnimationManagerBase>
+#include <osgAnimation/RigGeometry>
+#include <osgAnimation/RigTransformSoftware>
+
+#include <osgUtil/WorkerThreadPool>
+
+using namespace osgAnimation;
+
+namespace
+{
+
+struct SkinOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+    SkinOperation(std::vector<RigTransformSoftware*>& rigs) : _rigs(rigs) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            _rigs[i]->skin(false);
+        }
+    }
+
+    std::vector<RigTransformSoftware*>& _rigs;
+};
+
+}
+
+SkinningQueue::Entry::Entry(RigGeometry* geom, RigTransformSoftware* rig):
+    _geom(geom),
+    _rig(rig)
+{
+}
+
+SkinningQueue::SkinningQueue()
+{
+}
+
+SkinningQueue::~SkinningQueue()
+{
+}
+
+SkinningQueue* SkinningQueue::find(osg::NodeVisitor* nv)
+{
+    if (!nv)
+        return 0;
+
+    const osg::NodePath& nodePath = nv->getNodePath();
+    for (osg::NodePath::const_reverse_iterator itr = nodePath.rbegin(); itr != nodePath.rend(); ++itr)
+    {
+        for (osg::Callback* callback = (*itr)->getUpdateCallback(); callback; callback = callback->getNestedCallback())
+        {
+            AnimationManagerBase* manager = dynamic_cast<AnimationManagerBase*>(callback);
+            if (manager)
+                return manager->getSkinningQueue();
+        }
+    }
+    return 0;
+}
+
+void SkinningQueue::add(RigGeometry* geom)
+{
+    // a RigGeometry with several parents is visited once per parent, but mustn't be skinned twice at once
+    if (!_queued.insert(geom).second)
+        return;
+
+    if (!geom->getRigTransformImplementation())
+        geom->setRigTransformImplementation(new RigTransformSoftware);
+
+    RigTransformSoftware* rig = dynamic_cast<RigTransformSoftware*>(geom->getRigTransformImplementation());
+    if (!rig)
+    {
+        geom->update();
+        return;
+    }
+
+    if (rig->prepare(*geom))
+        _rigGeometries.push_back(Entry(geom, rig));
+}
+
+void SkinningQueue::run()
+{
+    _queued.clear();
+
+    if (_rigGeometries.empty())
+        return;
+
+    std::vector<RigTransformSoftware*> rigs;
+    rigs.reserve(_rigGeometries.size());
+    for (EntryList::iterator itr = _rigGeometries.begin(); itr != _rigGeometries.end(); ++itr)
+    {
+        rigs.push_back(itr->_rig.get());
+    }
+
+    // a single large mesh is better split up across the threads on its own
+    if (rigs.size() == 1)
+    {
+        rigs[0]->skin(true);
+    }
+    else
+    {
+        SkinOperation operation(rigs);
+        osgUtil::WorkerThreadPool::instance()->run(operation, rigs.size());
+    }
+
+    // dirtying the arrays touches the buffer objects, which can be shared between RigGeometry
+    for (EntryList::iterator itr = _rigGeometries.begin(); itr != _rigGeometries.end(); ++itr)
+    {
+        itr->_rig->finish(*(itr->_geom));
+    }
+
+    _rigGeometries.clear();
+}
@@ -18,4 +18,4 @@
 
 using namespace osgAnimation;
 
-Target::Target() : _weight(0), _priorityWeight(0), _lastPriority(0) {}
+Target::Target() : _weight(0), _priorityWeight(0), _lastPriority(0), _enabled(true) {}
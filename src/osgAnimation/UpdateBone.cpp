@@ -15,18 +15,33 @@
 #include <osg/NodeVisitor>
 #include <osgAnimation/Bone>
 #include <osgAnimation/UpdateBone>
+#include <osgAnimation/Target>
 
 using namespace osgAnimation;
 
 
-UpdateBone::UpdateBone(const std::string& name) : UpdateMatrixTransform(name)
+UpdateBone::UpdateBone(const std::string& name) : UpdateMatrixTransform(name), _enabled(true)
 {
 }
 
-UpdateBone::UpdateBone(const UpdateBone& apc,const osg::CopyOp& copyop) : osg::Object(apc,copyop), UpdateMatrixTransform(apc, copyop)
+UpdateBone::UpdateBone(const UpdateBone& apc,const osg::CopyOp& copyop) : osg::Object(apc,copyop), UpdateMatrixTransform(apc, copyop), _enabled(true)
 {
 }
 
+void UpdateBone::setEnabled(bool enabled)
+{
+    if (_enabled == enabled)
+        return;
+
+    _enabled = enabled;
+    for (StackedTransform::iterator it = _transforms.begin(); it != _transforms.end(); ++it)
+    {
+        Target* target = it->valid() ? (*it)->getTarget() : 0;
+        if (target)
+            target->setEnabled(enabled);
+    }
+}
+
 /** Callback method called by the NodeVisitor when visiting a node.*/
 void UpdateBone::operator()(osg::Node* node, osg::NodeVisitor* nv)
 {
@@ -40,9 +55,12 @@ void UpdateBone::operator()(osg::Node* node, osg::NodeVisitor* nv)
         }
 
         // here we would prefer to have a flag inside transform stack in order to avoid update and a dirty state in matrixTransform if it's not require.
-        _transforms.update();
-        const osg::Matrix& matrix = _transforms.getMatrix();
-        b->setMatrix(matrix);
+        if (_enabled)
+        {
+            _transforms.update();
+            b->setMatrix(_transforms.getMatrix());
+        }
+        const osg::Matrix& matrix = b->getMatrix();
 
         Bone* parent = b->getBoneParent();
         if (parent)
@@ -16,6 +16,8 @@
 #include <osgParticle/ModularProgram>
 #include <osgParticle/BounceOperator>
 
+#include <typeinfo>
+
 using namespace osgParticle;
 
 void BounceOperator::handleTriangle( const Domain& domain, Particle* P, double dt )
@@ -82,6 +84,54 @@ void BounceOperator::handlePlane( const Domain& domain, Particle* P, double dt )
     else P->setVelocity( vt*(1.0f-_friction) - vn*_resilience );
 }
 
+bool BounceOperator::supportsParticleArrays() const
+{
+    // a derived class may handle the domains differently
+    if ( typeid(*this)!=typeid(BounceOperator) ) return false;
+
+    for ( std::vector<Domain>::const_iterator itr=_domains.begin(); itr!=_domains.end(); ++itr )
+    {
+        if ( itr->type!=Domain::PLANE_DOMAIN ) return false;
+    }
+    return true;
+}
+
+void BounceOperator::operateParticleArrays( ParticleArrays& particles, double dt )
+{
+    unsigned int n = particles.size();
+    if ( n==0 ) return;
+
+    const float fdt = dt;
+    const float tangentFriction = 1.0f - _friction;
+    const float resilience = _resilience;
+    const float cutoff = _cutoff;
+    const float* px = &particles.px.front();
+    const float* py = &particles.py.front();
+    const float* pz = &particles.pz.front();
+    float* vx = &particles.vx.front();
+    float* vy = &particles.vy.front();
+    float* vz = &particles.vz.front();
+    for ( std::vector<Domain>::const_iterator itr=_domains.begin(); itr!=_domains.end(); ++itr )
+    {
+        const float nx = itr->plane[0], ny = itr->plane[1], nz = itr->plane[2], d = itr->plane[3];
+        for ( unsigned int i=0; i<n; ++i )
+        {
+            // same as handlePlane(), computing the new velocity of every particle and keeping it only
+            // for those crossing the plane so that the loop is vectorized
+            float distance = nx*px[i] + ny*py[i] + nz*pz[i] + d;
+            float nv = nx*vx[i] + ny*vy[i] + nz*vz[i];
+            bool crossing = distance*(distance + nv*fdt)<0.0f;
+
+            float vnx = nx*nv, vny = ny*nv, vnz = nz*nv;
+            float vtx = vx[i]-vnx, vty = vy[i]-vny, vtz = vz[i]-vnz;
+            float tangentScale = (vtx*vtx + vty*vty + vtz*vtz)<=cutoff ? 1.0f : tangentFriction;
+            vx[i] = crossing ? vtx*tangentScale - vnx*resilience : vx[i];
+            vy[i] = crossing ? vty*tangentScale - vny*resilience : vy[i];
+            vz[i] = crossing ? vtz*tangentScale - vnz*resilience : vz[i];
+        }
+    }
+}
+
 void BounceOperator::handleSphere( const Domain& domain, Particle* P, double dt )
 {
     osg::Vec3 nextpos = P->getPosition() + P->getVelocity() * dt;
@@ -54,3 +54,35 @@ void osgParticle::FluidFrictionOperator::operate(Particle* P, double dt)
 
     P->addVelocity(dv);
 }
+
+void osgParticle::FluidFrictionOperator::operateParticleArrays(ParticleArrays& particles, double dt)
+{
+    unsigned int n = particles.size();
+    if (n == 0) return;
+
+    const float fdt = dt;
+    const float coeffA = _coeff_A;
+    const float coeffB = _coeff_B;
+    const float ovrRadius = _ovr_rad;
+    const osg::Vec3 wind = _wind;
+    const float* radius = &particles.radius.front();
+    const float* massInv = &particles.massInv.front();
+    float* vx = &particles.vx.front();
+    float* vy = &particles.vy.front();
+    float* vz = &particles.vz.front();
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        float r = (ovrRadius > 0)? ovrRadius : radius[i];
+        float wx = vx[i] - wind.x();
+        float wy = vy[i] - wind.y();
+        float wz = vz[i] - wind.z();
+        float vm = sqrtf(wx*wx + wy*wy + wz*wz);
+
+        // same as operate() without normalizing the relative velocity : the velocity increment is
+        // -v * R / (vm * m) * dt, clamped to -v so that the friction never reverses the velocity
+        float k = osg::minimum((coeffA * r + coeffB * r * r * vm) * massInv[i] * fdt, 1.0f);
+        vx[i] -= wx * k;
+        vy[i] -= wy * k;
+        vz[i] -= wz * k;
+    }
+}
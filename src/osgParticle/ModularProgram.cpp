@@ -4,12 +4,14 @@
 #include <osgParticle/Particle>
 
 osgParticle::ModularProgram::ModularProgram()
-: Program()
+: Program(),
+  _useParticleArrays(true)
 {
 }
 
 osgParticle::ModularProgram::ModularProgram(const ModularProgram& copy, const osg::CopyOp& copyop)
-: Program(copy, copyop)
+: Program(copy, copyop),
+  _useParticleArrays(copy._useParticleArrays)
 {
     Operator_vector::const_iterator ci;
     for (ci=copy._operators.begin(); ci!=copy._operators.end(); ++ci) {
@@ -23,9 +25,30 @@ void osgParticle::ModularProgram::execute(double dt)
     Operator_vector::iterator ci_end = _operators.end();
 
     ParticleSystem* ps = getParticleSystem();
+
+    // consecutive operators supporting particle arrays share a single gather of the particles,
+    // the velocities are scattered back before an operator working on the particles themselves
+    bool gathered = false;
     for (ci=_operators.begin(); ci!=ci_end; ++ci) {
-        (*ci)->beginOperate(this);
-        (*ci)->operateParticles(ps, dt);
-        (*ci)->endOperate();
+        Operator* op = ci->get();
+        op->beginOperate(this);
+        if (_useParticleArrays && op->supportsParticleArrays()) {
+            if (op->isEnabled()) {
+                if (!gathered) {
+                    _particleArrays.gather(ps);
+                    gathered = true;
+                }
+                op->operateParticleArrays(_particleArrays, dt);
+            }
+        } else {
+            if (gathered) {
+                _particleArrays.scatter(ps);
+                gathered = false;
+            }
+            op->operateParticles(ps, dt);
+        }
+        op->endOperate();
     }
+
+    if (gathered) _particleArrays.scatter(ps);
 }
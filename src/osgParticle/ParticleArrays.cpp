@@ -0,0 +1,55 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgParticle/ParticleArrays>
+#include <osgParticle/ParticleSystem>
+
+using namespace osgParticle;
+
+void ParticleArrays::gather(const ParticleSystem* ps)
+{
+    unsigned int n = static_cast<unsigned int>(ps->numParticles());
+    if (indices.size()<n)
+    {
+        indices.resize(n);
+        px.resize(n); py.resize(n); pz.resize(n);
+        vx.resize(n); vy.resize(n); vz.resize(n);
+        radius.resize(n);
+        massInv.resize(n);
+    }
+
+    unsigned int j = 0;
+    for (unsigned int i=0; i<n; ++i)
+    {
+        const Particle* P = ps->getParticle(i);
+        if (!P->isAlive()) continue;
+
+        const osg::Vec3& position = P->getPosition();
+        const osg::Vec3& velocity = P->getVelocity();
+        indices[j] = i;
+        px[j] = position.x(); py[j] = position.y(); pz[j] = position.z();
+        vx[j] = velocity.x(); vy[j] = velocity.y(); vz[j] = velocity.z();
+        radius[j] = P->getRadius();
+        massInv[j] = P->getMassInv();
+        ++j;
+    }
+    _size = j;
+}
+
+void ParticleArrays::scatter(ParticleSystem* ps) const
+{
+    for (unsigned int j=0; j<_size; ++j)
+    {
+        ps->getParticle(indices[j])->setVelocity(osg::Vec3(vx[j], vy[j], vz[j]));
+    }
+}
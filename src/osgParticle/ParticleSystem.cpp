@@ -16,6 +16,8 @@
 #include <osg/Program>
 #include <osg/Notify>
 #include <osg/io_utils>
+#include <osg/GLExtensions>
+#include <osg/BufferObject>
 
 #include <osgDB/FileUtils>
 #include <osgDB/ReadFile>
@@ -38,6 +40,7 @@ osgParticle::ParticleSystem::ParticleSystem()
     _particleScaleReferenceFrame(WORLD_COORDINATES),
     _useVertexArray(false),
     _useShaders(false),
+    _useInstancing(false),
     _dirty_uniforms(false),
     _doublepass(false),
     _frozen(false),
@@ -54,7 +57,9 @@ osgParticle::ParticleSystem::ParticleSystem()
     _detail(1),
     _sortMode(NO_SORT),
     _visibilityDistance(-1.0),
-    _draw_count(0)
+    _draw_count(0),
+    _numInstances(0),
+    _packInstancesInUpdate(false)
 {
     // we don't support display lists because particle systems
     // are dynamic, and they always changes between frames
@@ -70,6 +75,7 @@ osgParticle::ParticleSystem::ParticleSystem(const ParticleSystem& copy, const os
     _particleScaleReferenceFrame(copy._particleScaleReferenceFrame),
     _useVertexArray(copy._useVertexArray),
     _useShaders(copy._useShaders),
+    _useInstancing(copy._useInstancing),
     _dirty_uniforms(copy._dirty_uniforms),
     _doublepass(copy._doublepass),
     _frozen(copy._frozen),
@@ -86,7 +92,9 @@ osgParticle::ParticleSystem::ParticleSystem(const ParticleSystem& copy, const os
     _detail(copy._detail),
     _sortMode(copy._sortMode),
     _visibilityDistance(copy._visibilityDistance),
-    _draw_count(0)
+    _draw_count(0),
+    _numInstances(0),
+    _packInstancesInUpdate(false)
 {
 }
 
@@ -95,11 +103,21 @@ osgParticle::ParticleSystem::~ParticleSystem()
 }
 
 void osgParticle::ParticleSystem::update(double dt, osg::NodeVisitor& nv)
+{
+    beginUpdate();
+
+    ParticleRangeList ranges(1, ParticleRange(0, _particles.size()));
+    updateParticleRange(dt, ranges.front(), false);
+
+    endUpdate(dt, nv, ranges);
+}
+
+void osgParticle::ParticleSystem::beginUpdate()
 {
     // reset bounds
     _reset_bounds_flag = true;
 
-    if (_useShaders)
+    if (_useShaders || _useInstancing)
     {
         // Update shader uniforms
         // This slightly reduces the consumption of traversing the particle vector, because we
@@ -116,19 +134,138 @@ void osgParticle::ParticleSystem::update(double dt, osg::NodeVisitor& nv)
         }
     }
 
-    for(unsigned int i=0; i<_particles.size(); ++i)
+    if (_useInstancing)
+    {
+        // the alignment may be changed at any time, so keep the uniforms of the instancing shader in sync
+        osg::StateSet* stateset = getOrCreateStateSet();
+        osg::Uniform* u = stateset->getUniform("particleAlignVectorX");
+        if (u) u->set(_align_X_axis);
+        u = stateset->getUniform("particleAlignVectorY");
+        if (u) u->set(_align_Y_axis);
+        u = stateset->getUniform("particleBillboard");
+        if (u) u->set(_alignment==BILLBOARD);
+        u = stateset->getUniform("particleLocalScale");
+        if (u) u->set(_particleScaleReferenceFrame==LOCAL_COORDINATES);
+
+        if (!_instancePositions) create_instance_arrays();
+
+        // without sorting nor level of detail each particle is packed at its own index as it's updated,
+        // saving another pass over the particles, the dead ones being left as empty quads
+        _packInstancesInUpdate = (_sortMode == NO_SORT && _detail == 1);
+        if (_packInstancesInUpdate)
+        {
+            _instancePositions->resize(_particles.size());
+            _instanceColors->resize(_particles.size());
+            _instanceAngles->resize(_particles.size());
+            _instanceTexCoords->resize(_particles.size());
+        }
+    }
+    else
+    {
+        _packInstancesInUpdate = false;
+    }
+}
+
+inline void osgParticle::ParticleSystem::set_instance(unsigned int i, const Particle& particle, bool visible)
+{
+    if (visible && particle._shape != Particle::USER)
+    {
+        const osg::Vec3& p = particle._position;
+        const osg::Vec4& c = particle._current_color;
+        const osg::Vec3& a = particle._angle;
+        (*_instancePositions)[i].set(p.x(), p.y(), p.z(), particle._current_size);
+        (*_instanceColors)[i].set(c.x(), c.y(), c.z(), c.w() * particle._current_alpha);
+        (*_instanceAngles)[i].set(a.x(), a.y(), a.z(), 0.0f);
+        (*_instanceTexCoords)[i].set(particle._s_coord, particle._t_coord, particle._s_tile, particle._t_tile);
+    }
+    else
+    {
+        (*_instancePositions)[i].set(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+void osgParticle::ParticleSystem::updateParticleRange(double dt, ParticleRange& range, bool deferRandom)
+{
+    range.hasBounds = false;
+    range.deadParticles.clear();
+    range.deferredParticles.clear();
+
+    for(unsigned int i=range.begin; i<range.end; ++i)
     {
         Particle& particle = _particles[i];
+        bool visible = false;
         if (particle.isAlive())
         {
-            if (particle.update(dt, _useShaders))
+            // the first update of a particle living forever draws its size, alpha and color
+            if (deferRandom && particle._lifeTime <= 0 && particle._t0 + dt == dt)
+            {
+                range.deferredParticles.push_back(i);
+                continue;
+            }
+            else if (particle.update(dt, _useShaders))
+            {
+                visible = true;
+
+                const osg::Vec3& p = particle.getPosition();
+                float r = particle.getCurrentSize();
+                if (!range.hasBounds)
+                {
+                    range.hasBounds = true;
+                    range.bmin = p - osg::Vec3(r,r,r);
+                    range.bmax = p + osg::Vec3(r,r,r);
+                }
+                else
+                {
+                    range.bmin.set(osg::minimum(range.bmin.x(), p.x() - r), osg::minimum(range.bmin.y(), p.y() - r), osg::minimum(range.bmin.z(), p.z() - r));
+                    range.bmax.set(osg::maximum(range.bmax.x(), p.x() + r), osg::maximum(range.bmax.y(), p.y() + r), osg::maximum(range.bmax.z(), p.z() + r));
+                }
+            }
+            else
+            {
+                range.deadParticles.push_back(i);
+            }
+        }
+
+        if (_packInstancesInUpdate) set_instance(i, particle, visible);
+    }
+}
+
+void osgParticle::ParticleSystem::endUpdate(double dt, osg::NodeVisitor& nv, ParticleRangeList& ranges)
+{
+    std::vector<unsigned int> deferredDead;
+    std::vector<unsigned int> dead;
+    for(ParticleRangeList::iterator itr = ranges.begin(); itr != ranges.end(); ++itr)
+    {
+        ParticleRange& range = *itr;
+        if (range.hasBounds)
+        {
+            update_bounds(range.bmin, 0.0f);
+            update_bounds(range.bmax, 0.0f);
+        }
+
+        deferredDead.clear();
+        for(std::vector<unsigned int>::iterator ditr = range.deferredParticles.begin(); ditr != range.deferredParticles.end(); ++ditr)
+        {
+            Particle& particle = _particles[*ditr];
+            bool visible = particle.update(dt, _useShaders);
+            if (visible)
             {
                 update_bounds(particle.getPosition(), particle.getCurrentSize());
             }
             else
             {
-                reuseParticle(i);
+                deferredDead.push_back(*ditr);
             }
+
+            if (_packInstancesInUpdate) set_instance(*ditr, particle, visible);
+        }
+
+        // recycle the dead particles in the order update() would have
+        dead.resize(range.deadParticles.size() + deferredDead.size());
+        std::merge(range.deadParticles.begin(), range.deadParticles.end(), deferredDead.begin(), deferredDead.end(), dead.begin());
+        for(std::vector<unsigned int>::iterator ditr = dead.begin(); ditr != dead.end(); ++ditr)
+        {
+            reuseParticle(*ditr);
         }
     }
 
@@ -169,6 +306,8 @@ void osgParticle::ParticleSystem::update(double dt, osg::NodeVisitor& nv)
         }
     }
 
+    if (_useInstancing) pack_instances();
+
     // force recomputing of bounding box on next frame
     dirtyBound();
 }
@@ -198,7 +337,9 @@ void osgParticle::ParticleSystem::drawImplementation(osg::RenderInfo& renderInfo
     glDepthMask(GL_FALSE);
 
     // render, first pass
-    if (_useVertexArray)
+    if (_useInstancing)
+        render_instanced(renderInfo);
+    else if (_useVertexArray)
         render_vertex_array(renderInfo);
     else
         single_pass_render(renderInfo, modelview);
@@ -217,7 +358,9 @@ void osgParticle::ParticleSystem::drawImplementation(osg::RenderInfo& renderInfo
         glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
         // render the particles onto the depth buffer
-        if (_useVertexArray)
+        if (_useInstancing)
+            render_instanced(renderInfo);
+        else if (_useVertexArray)
             render_vertex_array(renderInfo);
         else
             single_pass_render(renderInfo, modelview);
@@ -363,6 +506,124 @@ void osgParticle::ParticleSystem::setDefaultAttributesUsingShaders(const std::st
     setUseShaders(true);
 }
 
+void osgParticle::ParticleSystem::setDefaultAttributesUsingInstancing(const std::string& texturefile, bool emissive_particles, int texture_unit)
+{
+    osg::StateSet *stateset = new osg::StateSet;
+    stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+
+    if (!texturefile.empty())
+    {
+        osg::Texture2D *texture = new osg::Texture2D;
+        texture->setImage(osgDB::readImageFile(texturefile));
+        texture->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR);
+        texture->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
+        texture->setWrap(osg::Texture2D::WRAP_S, osg::Texture2D::MIRROR);
+        texture->setWrap(osg::Texture2D::WRAP_T, osg::Texture2D::MIRROR);
+        stateset->setTextureAttributeAndModes(texture_unit, texture, osg::StateAttribute::ON);
+    }
+
+    osg::BlendFunc *blend = new osg::BlendFunc;
+    if (emissive_particles)
+    {
+        blend->setFunction(osg::BlendFunc::SRC_ALPHA, osg::BlendFunc::ONE);
+    }
+    else
+    {
+        blend->setFunction(osg::BlendFunc::SRC_ALPHA, osg::BlendFunc::ONE_MINUS_SRC_ALPHA);
+    }
+    stateset->setAttributeAndModes(blend, osg::StateAttribute::ON);
+
+    // each instance is a quad, whose corners are the vertices, expanded around the particle like
+    // single_pass_render() does, rotating the alignment vectors the way osg::Matrix::transform3x3() does
+    char vertexShaderSource[] =
+        "#version 120\n"
+        "uniform float visibilityDistance;\n"
+        "uniform vec3 particleAlignVectorX;\n"
+        "uniform vec3 particleAlignVectorY;\n"
+        "uniform bool particleBillboard;\n"
+        "uniform bool particleLocalScale;\n"
+        "attribute vec4 particlePositionSize;\n"
+        "attribute vec4 particleColor;\n"
+        "attribute vec4 particleAngle;\n"
+        "attribute vec4 particleTexCoord;\n"
+        "varying float visible;\n"
+        "\n"
+        "vec3 rotate(vec3 v, vec3 angle)\n"
+        "{\n"
+        "    vec3 c = cos(angle);\n"
+        "    vec3 s = sin(angle);\n"
+        "    v = vec3(v.x*c.z + v.y*s.z, v.y*c.z - v.x*s.z, v.z);\n"
+        "    v = vec3(v.x*c.y - v.z*s.y, v.y, v.x*s.y + v.z*c.y);\n"
+        "    return vec3(v.x, v.y*c.x + v.z*s.x, v.z*c.x - v.y*s.x);\n"
+        "}\n"
+        "\n"
+        "void main(void)\n"
+        "{\n"
+        "    vec3 xAxis = particleAlignVectorX;\n"
+        "    vec3 yAxis = particleAlignVectorY;\n"
+        "    mat3 modelview = mat3(gl_ModelViewMatrix);\n"
+        "    if (particleBillboard)\n"
+        "    {\n"
+        "        vec3 x = xAxis * modelview;\n"
+        "        vec3 y = yAxis * modelview;\n"
+        "        float lengthX2 = dot(x, x);\n"
+        "        float lengthY2 = dot(y, y);\n"
+        "        xAxis *= particleLocalScale ? inversesqrt(lengthX2) : 1.0/lengthX2;\n"
+        "        yAxis *= particleLocalScale ? inversesqrt(lengthY2) : 1.0/lengthY2;\n"
+        "        xAxis = rotate(xAxis, particleAngle.xyz) * modelview;\n"
+        "        yAxis = rotate(yAxis, particleAngle.xyz) * modelview;\n"
+        "    }\n"
+        "    else\n"
+        "    {\n"
+        "        xAxis = rotate(xAxis, particleAngle.xyz);\n"
+        "        yAxis = rotate(yAxis, particleAngle.xyz);\n"
+        "    }\n"
+        "    \n"
+        "    vec2 corner = gl_Vertex.xy;\n"
+        "    vec4 position = vec4(particlePositionSize.xyz + (xAxis*corner.x + yAxis*corner.y)*particlePositionSize.w, 1.0);\n"
+        "    \n"
+        "    float ecDepth = -(gl_ModelViewMatrix * vec4(particlePositionSize.xyz, 1.0)).z;\n"
+        "    visible = (visibilityDistance > 0.0 && (ecDepth <= 0.0 || ecDepth >= visibilityDistance)) ? -1.0 : 1.0;\n"
+        "    \n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * position;\n"
+        "    gl_ClipVertex = gl_ModelViewMatrix * position;\n"
+        "    gl_TexCoord[0] = vec4(particleTexCoord.xy + (corner*0.5 + 0.5)*particleTexCoord.zw, 0.0, 1.0);\n"
+        "    gl_FrontColor = particleColor;\n"
+        "    gl_BackColor = gl_FrontColor;\n"
+        "}\n";
+    std::string fragmentShaderSource =
+        "uniform sampler2D baseTexture;\n"
+        "varying float visible;\n"
+        "\n"
+        "void main(void)\n"
+        "{\n"
+        "    if (visible < 0.0) discard;\n";
+    fragmentShaderSource += texturefile.empty() ?
+        "    gl_FragColor = gl_Color;\n" :
+        "    gl_FragColor = gl_Color * texture2D(baseTexture, gl_TexCoord[0].xy);\n";
+    fragmentShaderSource += "}\n";
+
+    osg::Program *program = new osg::Program;
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, vertexShaderSource));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, fragmentShaderSource));
+    program->addBindAttribLocation("particlePositionSize", INSTANCE_POSITION_SIZE);
+    program->addBindAttribLocation("particleColor", INSTANCE_COLOR);
+    program->addBindAttribLocation("particleAngle", INSTANCE_ANGLE);
+    program->addBindAttribLocation("particleTexCoord", INSTANCE_TEXCOORD);
+    stateset->setAttributeAndModes(program, osg::StateAttribute::ON);
+
+    stateset->addUniform(new osg::Uniform("visibilityDistance", (float)_visibilityDistance));
+    stateset->addUniform(new osg::Uniform("baseTexture", texture_unit));
+    stateset->addUniform(new osg::Uniform("particleAlignVectorX", _align_X_axis));
+    stateset->addUniform(new osg::Uniform("particleAlignVectorY", _align_Y_axis));
+    stateset->addUniform(new osg::Uniform("particleBillboard", _alignment==BILLBOARD));
+    stateset->addUniform(new osg::Uniform("particleLocalScale", _particleScaleReferenceFrame==LOCAL_COORDINATES));
+    setStateSet(stateset);
+
+    setUseVertexArray(false);
+    setUseShaders(false);
+    setUseInstancing(true);
+}
 
 void osgParticle::ParticleSystem::single_pass_render(osg::RenderInfo& renderInfo, const osg::Matrix& modelview) const
 {
@@ -528,6 +789,122 @@ void osgParticle::ParticleSystem::render_vertex_array(osg::RenderInfo& renderInf
     glDrawArrays(GL_POINTS, 0, _particles.size());
 }
 
+void osgParticle::ParticleSystem::create_instance_arrays()
+{
+    // the corners of the quad, as a triangle strip
+    _instanceCorners = new osg::Vec2Array;
+    _instanceCorners->push_back(osg::Vec2(-1.0f, -1.0f));
+    _instanceCorners->push_back(osg::Vec2(1.0f, -1.0f));
+    _instanceCorners->push_back(osg::Vec2(-1.0f, 1.0f));
+    _instanceCorners->push_back(osg::Vec2(1.0f, 1.0f));
+    _instanceCorners->setVertexBufferObject(new osg::VertexBufferObject);
+
+    // the per particle arrays share a buffer object streamed each update
+    osg::VertexBufferObject* vbo = new osg::VertexBufferObject;
+    vbo->setUsage(GL_STREAM_DRAW_ARB);
+    _instancePositions = new osg::Vec4Array;
+    _instancePositions->setVertexBufferObject(vbo);
+    _instanceColors = new osg::Vec4Array;
+    _instanceColors->setVertexBufferObject(vbo);
+    _instanceAngles = new osg::Vec4Array;
+    _instanceAngles->setVertexBufferObject(vbo);
+    _instanceTexCoords = new osg::Vec4Array;
+    _instanceTexCoords->setVertexBufferObject(vbo);
+}
+
+void osgParticle::ParticleSystem::pack_instances()
+{
+    if (!_packInstancesInUpdate)
+    {
+        // the visible particles, in the order they're sorted
+        float scale = sqrtf(static_cast<float>(_detail));
+
+        unsigned int maxInstances = (_particles.size() + _detail - 1) / _detail;
+        _instancePositions->clear();
+        _instancePositions->reserve(maxInstances);
+        _instanceColors->clear();
+        _instanceColors->reserve(maxInstances);
+        _instanceAngles->clear();
+        _instanceAngles->reserve(maxInstances);
+        _instanceTexCoords->clear();
+        _instanceTexCoords->reserve(maxInstances);
+
+        for(unsigned int i=0; i<_particles.size(); i+=_detail)
+        {
+            const Particle& particle = _particles[i];
+            if (!particle.isAlive() || particle._shape == Particle::USER) continue;
+
+            const osg::Vec3& p = particle._position;
+            const osg::Vec4& c = particle._current_color;
+            const osg::Vec3& a = particle._angle;
+            _instancePositions->push_back(osg::Vec4(p.x(), p.y(), p.z(), particle._current_size * scale));
+            _instanceColors->push_back(osg::Vec4(c.x(), c.y(), c.z(), c.w() * particle._current_alpha));
+            _instanceAngles->push_back(osg::Vec4(a.x(), a.y(), a.z(), 0.0f));
+            _instanceTexCoords->push_back(osg::Vec4(particle._s_coord, particle._t_coord, particle._s_tile, particle._t_tile));
+        }
+    }
+
+    _numInstances = _instancePositions->size();
+
+    _instancePositions->dirty();
+    _instanceColors->dirty();
+    _instanceAngles->dirty();
+    _instanceTexCoords->dirty();
+}
+
+void osgParticle::ParticleSystem::render_instanced(osg::RenderInfo& renderInfo) const
+{
+    _draw_count = 0;
+    if (_numInstances == 0) return;
+
+    osg::State& state = *renderInfo.getState();
+    const osg::GLExtensions* extensions = state.get<osg::GLExtensions>();
+    if (!extensions->glVertexAttribDivisor)
+    {
+        OSG_NOTICE<<"Warning: ParticleSystem::render_instanced(..) requires instanced arrays, particles not drawn."<<std::endl;
+        return;
+    }
+
+    state.lazyDisablingOfVertexAttributes();
+    state.setVertexPointer(_instanceCorners.get());
+    state.setVertexAttribPointer(INSTANCE_POSITION_SIZE, _instancePositions.get());
+    state.setVertexAttribPointer(INSTANCE_COLOR, _instanceColors.get());
+    state.setVertexAttribPointer(INSTANCE_ANGLE, _instanceAngles.get());
+    state.setVertexAttribPointer(INSTANCE_TEXCOORD, _instanceTexCoords.get());
+    state.applyDisablingOfVertexAttributes();
+
+    extensions->glVertexAttribDivisor(INSTANCE_POSITION_SIZE, 1);
+    extensions->glVertexAttribDivisor(INSTANCE_COLOR, 1);
+    extensions->glVertexAttribDivisor(INSTANCE_ANGLE, 1);
+    extensions->glVertexAttribDivisor(INSTANCE_TEXCOORD, 1);
+
+    state.glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _numInstances);
+    _draw_count = _numInstances;
+
+    // leave the attributes as other drawables expect them
+    extensions->glVertexAttribDivisor(INSTANCE_POSITION_SIZE, 0);
+    extensions->glVertexAttribDivisor(INSTANCE_COLOR, 0);
+    extensions->glVertexAttribDivisor(INSTANCE_ANGLE, 0);
+    extensions->glVertexAttribDivisor(INSTANCE_TEXCOORD, 0);
+    state.unbindVertexBufferObject();
+}
+
+void osgParticle::ParticleSystem::resizeGLObjectBuffers(unsigned int maxSize)
+{
+    Drawable::resizeGLObjectBuffers(maxSize);
+
+    if (_instanceCorners.valid()) _instanceCorners->resizeGLObjectBuffers(maxSize);
+    if (_instancePositions.valid()) _instancePositions->resizeGLObjectBuffers(maxSize);
+}
+
+void osgParticle::ParticleSystem::releaseGLObjects(osg::State* state) const
+{
+    Drawable::releaseGLObjects(state);
+
+    if (_instanceCorners.valid()) _instanceCorners->releaseGLObjects(state);
+    if (_instancePositions.valid()) _instancePositions->releaseGLObjects(state);
+}
+
 osg::BoundingBox osgParticle::ParticleSystem::computeBoundingBox() const
 {
     if (!_bounds_computed)
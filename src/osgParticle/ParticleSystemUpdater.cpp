@@ -3,16 +3,18 @@
 #include <osg/CopyOp>
 #include <osg/Geode>
 
+#include <osgUtil/WorkerThreadPool>
+
 using namespace osg;
 
 osgParticle::ParticleSystemUpdater::ParticleSystemUpdater()
-: osg::Node(), _t0(-1), _frameNumber(0)
+: osg::Node(), _t0(-1), _frameNumber(0), _useWorkerThreads(false)
 {
     setCullingActive(false);
 }
 
 osgParticle::ParticleSystemUpdater::ParticleSystemUpdater(const ParticleSystemUpdater& copy, const osg::CopyOp& copyop)
-: osg::Node(copy, copyop), _t0(copy._t0), _frameNumber(0)
+: osg::Node(copy, copyop), _t0(copy._t0), _frameNumber(0), _useWorkerThreads(copy._useWorkerThreads)
 {
     ParticleSystem_Vector::const_iterator i;
     for (i=copy._psv.begin(); i!=copy._psv.end(); ++i) {
@@ -32,7 +34,11 @@ void osgParticle::ParticleSystemUpdater::traverse(osg::NodeVisitor& nv)
                 _frameNumber = nv.getFrameStamp()->getFrameNumber();
 
                 double t = nv.getFrameStamp()->getSimulationTime();
-                if (_t0 != -1.0)
+                if (_t0 != -1.0 && _useWorkerThreads)
+                {
+                    updateConcurrently(t - _t0, nv);
+                }
+                else if (_t0 != -1.0)
                 {
                     ParticleSystem_Vector::iterator i;
                     for (i=_psv.begin(); i!=_psv.end(); ++i)
@@ -60,6 +66,91 @@ void osgParticle::ParticleSystemUpdater::traverse(osg::NodeVisitor& nv)
     Node::traverse(nv);
 }
 
+namespace
+{
+    // particles updated by a task, small enough for the large particle systems to be spread over the threads
+    const unsigned int PARTICLES_PER_RANGE = 4096;
+
+    struct ParticleRangeTask
+    {
+        ParticleRangeTask(osgParticle::ParticleSystem* ps, osgParticle::ParticleSystem::ParticleRange* range) : _ps(ps), _range(range) {}
+
+        osgParticle::ParticleSystem* _ps;
+        osgParticle::ParticleSystem::ParticleRange* _range;
+    };
+
+    struct UpdateParticleRangesOperation : public osgUtil::WorkerThreadPool::RangeOperation
+    {
+        UpdateParticleRangesOperation(double dt, std::vector<ParticleRangeTask>& tasks) : _dt(dt), _tasks(tasks) {}
+
+        virtual void operator () (unsigned int begin, unsigned int end)
+        {
+            for(unsigned int i=begin; i<end; ++i)
+            {
+                _tasks[i]._ps->updateParticleRange(_dt, *(_tasks[i]._range), true);
+            }
+        }
+
+        double _dt;
+        std::vector<ParticleRangeTask>& _tasks;
+    };
+}
+
+void osgParticle::ParticleSystemUpdater::updateConcurrently(double dt, osg::NodeVisitor& nv)
+{
+    // the particle systems stay locked until all their ranges are updated
+    std::vector<ParticleSystem*> active;
+    std::vector<ParticleSystem::ScopedWriteLock*> locks;
+    for(ParticleSystem_Vector::iterator i=_psv.begin(); i!=_psv.end(); ++i)
+    {
+        ParticleSystem* ps = i->get();
+
+        ParticleSystem::ScopedWriteLock* lock = new ParticleSystem::ScopedWriteLock(*(ps->getReadWriteMutex()));
+
+        if (!ps->isFrozen() && (ps->getLastFrameNumber() >= (nv.getFrameStamp()->getFrameNumber() - 1) || !ps->getFreezeOnCull()))
+        {
+            active.push_back(ps);
+            locks.push_back(lock);
+        }
+        else
+        {
+            delete lock;
+        }
+    }
+
+    std::vector<ParticleSystem::ParticleRangeList> ranges(active.size());
+    std::vector<ParticleRangeTask> tasks;
+    for(unsigned int i=0; i<active.size(); ++i)
+    {
+        ParticleSystem* ps = active[i];
+        ps->beginUpdate();
+
+        unsigned int numParticles = ps->numParticles();
+        for(unsigned int begin=0; begin<numParticles; begin+=PARTICLES_PER_RANGE)
+        {
+            ranges[i].push_back(ParticleSystem::ParticleRange(begin, osg::minimum(begin+PARTICLES_PER_RANGE, numParticles)));
+        }
+    }
+
+    for(unsigned int i=0; i<active.size(); ++i)
+    {
+        for(ParticleSystem::ParticleRangeList::iterator itr=ranges[i].begin(); itr!=ranges[i].end(); ++itr)
+        {
+            tasks.push_back(ParticleRangeTask(active[i], &(*itr)));
+        }
+    }
+
+    UpdateParticleRangesOperation operation(dt, tasks);
+    osgUtil::WorkerThreadPool::instance()->run(operation, tasks.size(), 1);
+
+    // the particle systems are finished in order so the random values are drawn as by serial updates
+    for(unsigned int i=0; i<active.size(); ++i)
+    {
+        active[i]->endUpdate(dt, nv, ranges[i]);
+        delete locks[i];
+    }
+}
+
 osg::BoundingSphere osgParticle::ParticleSystemUpdater::computeBound() const
 {
     return osg::BoundingSphere();
@@ -0,0 +1,247 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2014 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/BoundingBox>
+#include <osg/Notify>
+#include <osg/observer_ptr>
+#include <osg/PagedLOD>
+
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/Registry>
+
+#include <osgVolume/BrickedVolumeFile>
+#include <osgVolume/RayTracedTechnique>
+#include <osgVolume/Volume>
+
+#include <OpenThreads/ScopedLock>
+
+#include <float.h>
+#include <stdio.h>
+#include <sstream>
+
+/** Reads .bvol bricked volume files as an osgVolume::Volume over a hierarchy of PagedLOD, each brick a VolumeTile
+  * whose finer bricks are paged in by the DatabasePager as the viewer comes within range of it.  The finer bricks
+  * are read through pseudo file names of the form volume.bvol.level_x_y_z.bvol, each giving the group of the
+  * bricks of the next level that cover the brick (level, x, y, z).*/
+class ReaderWriterBVol : public osgDB::ReaderWriter
+{
+    public:
+
+        ReaderWriterBVol()
+        {
+            supportsExtension("bvol","OpenSceneGraph bricked volume format");
+            supportsOption("RangeFactor <value>","Multiple of a brick's radius within which its finer bricks are paged in, default 4.");
+            supportsOption("BrickSize <value>","(Write option) Size of the bricks, default 64.");
+        }
+
+        virtual const char* className() const { return "Bricked Volume ReaderWriter"; }
+
+        virtual ReadResult readNode(const std::string& file, const Options* options) const
+        {
+            std::string ext = osgDB::getLowerCaseFileExtension(file);
+            if (!acceptsExtension(ext)) return ReadResult::FILE_NOT_HANDLED;
+
+            // check for the pseudo file name of the finer bricks of a brick
+            std::string nameLessExtension = osgDB::getNameLessExtension(file);
+            osgVolume::TileID tileID;
+            if (sscanf(osgDB::getFileExtension(nameLessExtension).c_str(), "%d_%d_%d_%d", &tileID.level, &tileID.x, &tileID.y, &tileID.z)==4)
+            {
+                osg::ref_ptr<osgVolume::BrickedVolumeFile> volumeFile = getBrickedVolumeFile(osgDB::getNameLessExtension(nameLessExtension));
+                if (!volumeFile) return ReadResult::FILE_NOT_FOUND;
+
+                return readChildBricks(volumeFile.get(), tileID, options);
+            }
+
+            std::string fileName = osgDB::findDataFile(file, options);
+            if (fileName.empty()) return ReadResult::FILE_NOT_FOUND;
+
+            osg::ref_ptr<osgVolume::BrickedVolumeFile> volumeFile = getBrickedVolumeFile(fileName);
+            if (!volumeFile) return ReadResult::ERROR_IN_READING_FILE;
+
+            osg::ref_ptr<osgVolume::Volume> volume = new osgVolume::Volume;
+            volume->setVolumeTechniquePrototype(new osgVolume::RayTracedTechnique);
+
+            osg::ref_ptr<osg::Node> node = createBrickNode(volumeFile.get(), osgVolume::TileID(0,0,0,0), options);
+            if (node.valid()) volume->addChild(node.get());
+
+            return volume.release();
+        }
+
+        virtual WriteResult writeImage(const osg::Image& image, const std::string& fileName, const Options* options) const
+        {
+            std::string ext = osgDB::getLowerCaseFileExtension(fileName);
+            if (!acceptsExtension(ext)) return WriteResult::FILE_NOT_HANDLED;
+
+            unsigned int brickSize = 64;
+            if (options)
+            {
+                std::istringstream iss(options->getOptionString());
+                std::string opt;
+                while (iss >> opt)
+                {
+                    if (opt=="BrickSize") iss >> brickSize;
+                }
+            }
+
+            if (!osgVolume::BrickedVolumeFile::write(&image, osg::Matrixd::identity(), brickSize, fileName))
+            {
+                return WriteResult::ERROR_IN_WRITING_FILE;
+            }
+
+            return WriteResult::FILE_SAVED;
+        }
+
+    protected:
+
+        osg::ref_ptr<osgVolume::BrickedVolumeFile> getBrickedVolumeFile(const std::string& fileName) const
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_volumeFileMapMutex);
+
+            // the files are only kept open by the PagedLOD of the volumes read from them, so forget those no longer in use
+            for(VolumeFileMap::iterator itr = _volumeFileMap.begin(); itr != _volumeFileMap.end();)
+            {
+                if (!itr->second.valid()) _volumeFileMap.erase(itr++);
+                else ++itr;
+            }
+
+            osg::ref_ptr<osgVolume::BrickedVolumeFile> volumeFile;
+            VolumeFileMap::iterator itr = _volumeFileMap.find(fileName);
+            if (itr != _volumeFileMap.end() && itr->second.lock(volumeFile)) return volumeFile;
+
+            volumeFile = new osgVolume::BrickedVolumeFile;
+            if (!volumeFile->open(fileName)) return 0;
+
+            _volumeFileMap[fileName] = volumeFile.get();
+            return volumeFile;
+        }
+
+        static double getRangeFactor(const Options* options)
+        {
+            double rangeFactor = 4.0;
+            if (options)
+            {
+                std::istringstream iss(options->getOptionString());
+                std::string opt;
+                while (iss >> opt)
+                {
+                    if (opt=="RangeFactor") iss >> rangeFactor;
+                }
+            }
+            return rangeFactor;
+        }
+
+        ReadResult readChildBricks(osgVolume::BrickedVolumeFile* volumeFile, const osgVolume::TileID& tileID, const Options* options) const
+        {
+            if (tileID.level+1>=static_cast<int>(volumeFile->getNumLevels())) return ReadResult::FILE_NOT_FOUND;
+
+            osg::ref_ptr<osg::Group> group = new osg::Group;
+
+            const osgVolume::BrickedVolumeFile::Level& level = volumeFile->getLevel(tileID.level+1);
+            for(int z=tileID.z*2; z<osg::minimum(tileID.z*2+2, static_cast<int>(level.numBricksR)); ++z)
+            {
+                for(int y=tileID.y*2; y<osg::minimum(tileID.y*2+2, static_cast<int>(level.numBricksT)); ++y)
+                {
+                    for(int x=tileID.x*2; x<osg::minimum(tileID.x*2+2, static_cast<int>(level.numBricksS)); ++x)
+                    {
+                        osg::ref_ptr<osg::Node> node = createBrickNode(volumeFile, osgVolume::TileID(tileID.level+1, x, y, z), options);
+                        if (node.valid()) group->addChild(node.get());
+                    }
+                }
+            }
+
+            return group.release();
+        }
+
+        osg::Node* createBrickNode(osgVolume::BrickedVolumeFile* volumeFile, const osgVolume::TileID& tileID, const Options* options) const
+        {
+            const osgVolume::BrickedVolumeFile::BrickInfo* info = volumeFile->getBrickInfo(tileID);
+            if (!info || info->flags==0) return 0;
+
+            osg::ref_ptr<osg::Node> tile;
+            if (info->flags & osgVolume::BrickedVolumeFile::HAS_DATA)
+            {
+                tile = createVolumeTile(volumeFile, tileID);
+            }
+
+            if ((info->flags & osgVolume::BrickedVolumeFile::CHILDREN_HAVE_DATA)==0) return tile.release();
+
+            osg::Vec3d bottomLeft, topRight;
+            volumeFile->computeBrickExtents(tileID, bottomLeft, topRight);
+
+            osg::BoundingBox bb;
+            for(unsigned int i=0; i<8; ++i)
+            {
+                osg::Vec3d corner((i&1) ? topRight.x() : bottomLeft.x(),
+                                  (i&2) ? topRight.y() : bottomLeft.y(),
+                                  (i&4) ? topRight.z() : bottomLeft.z());
+                bb.expandBy(corner * volumeFile->getTransform());
+            }
+
+            double cutOffDistance = bb.radius()*getRangeFactor(options);
+
+            osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD;
+            plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+            plod->setCenter(bb.center());
+            plod->setRadius(bb.radius());
+
+            // the brick itself is loaded with the PagedLOD, so mustn't be expired
+            plod->addChild(tile.valid() ? tile.get() : new osg::Group, cutOffDistance, FLT_MAX);
+            plod->setNumChildrenThatCannotBeExpired(1);
+
+            std::ostringstream childFileName;
+            childFileName<<volumeFile->getFileName()<<"."<<tileID.level<<"_"<<tileID.x<<"_"<<tileID.y<<"_"<<tileID.z<<".bvol";
+            plod->setFileName(1, childFileName.str());
+            plod->setRange(1, 0.0f, cutOffDistance);
+
+            if (options) plod->setDatabaseOptions(const_cast<Options*>(options));
+
+            // keep the file open for reading the finer bricks for as long as the PagedLOD is in the scene graph
+            plod->setUserData(volumeFile);
+
+            return plod.release();
+        }
+
+        osgVolume::VolumeTile* createVolumeTile(osgVolume::BrickedVolumeFile* volumeFile, const osgVolume::TileID& tileID) const
+        {
+            osg::ref_ptr<osg::Image> image = volumeFile->readBrick(tileID);
+            if (!image) return 0;
+
+            // the tile covers the brick while the image extends over the voxels bordering it
+            osg::Vec3d bottomLeft, topRight;
+            volumeFile->computeBrickExtents(tileID, bottomLeft, topRight);
+            osg::Matrixd tileMatrix = osg::Matrixd::scale(topRight-bottomLeft) * osg::Matrixd::translate(bottomLeft) * volumeFile->getTransform();
+
+            volumeFile->computeImageExtents(tileID, bottomLeft, topRight);
+            osg::Matrixd imageMatrix = osg::Matrixd::scale(topRight-bottomLeft) * osg::Matrixd::translate(bottomLeft) * volumeFile->getTransform();
+
+            osg::ref_ptr<osgVolume::ImageLayer> layer = new osgVolume::ImageLayer(image.get());
+            layer->setLocator(new osgVolume::Locator(imageMatrix));
+
+            osg::ref_ptr<osgVolume::VolumeTile> tile = new osgVolume::VolumeTile;
+            tile->setTileID(tileID);
+            tile->setLocator(new osgVolume::Locator(tileMatrix));
+            tile->setLayer(layer.get());
+
+            return tile.release();
+        }
+
+        typedef std::map< std::string, osg::observer_ptr<osgVolume::BrickedVolumeFile> > VolumeFileMap;
+
+        mutable OpenThreads::Mutex      _volumeFileMapMutex;
+        mutable VolumeFileMap           _volumeFileMap;
+};
+
+// now register with Registry to instantiate the above
+// reader/writer.
+REGISTER_OSGPLUGIN(bvol, ReaderWriterBVol)
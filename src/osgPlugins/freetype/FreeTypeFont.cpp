@@ -229,6 +229,8 @@ FreeTypeFont::~FreeTypeFont()
         FreeTypeLibrary* freeTypeLibrary = FreeTypeLibrary::instance();
         if (freeTypeLibrary)
         {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(freeTypeLibrary->getMutex());
+
             // remove myself from the local registry to ensure that
             // not dangling pointers remain
             freeTypeLibrary->removeFontImplmentation(this);
@@ -295,9 +297,18 @@ void FreeTypeFont::setFontResolution(const osgText::FontResolution& fontSize)
 
 }
 
+OpenThreads::Mutex& FreeTypeFont::getFaceMutex() const
+{
+#if FREETYPE_MAJOR>2 || (FREETYPE_MAJOR==2 && FREETYPE_MINOR>=6)
+    return _faceMutex;
+#else
+    return FreeTypeLibrary::instance()->getMutex();
+#endif
+}
+
 osgText::Glyph* FreeTypeFont::getGlyph(const osgText::FontResolution& fontRes, unsigned int charcode)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(FreeTypeLibrary::instance()->getMutex());
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getFaceMutex());
 
     setFontResolution(fontRes);
 
@@ -415,7 +426,7 @@ osgText::Glyph* FreeTypeFont::getGlyph(const osgText::FontResolution& fontRes, u
 
 osgText::Glyph3D * FreeTypeFont::getGlyph3D(unsigned int charcode)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(FreeTypeLibrary::instance()->getMutex());
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getFaceMutex());
 
     //
     // GT: fix for symbol fonts (i.e. the Webdings font) as the wrong character are being
@@ -517,7 +528,7 @@ osgText::Glyph3D * FreeTypeFont::getGlyph3D(unsigned int charcode)
 
 osg::Vec2 FreeTypeFont::getKerning(unsigned int leftcharcode,unsigned int rightcharcode, osgText::KerningType kerningType)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(FreeTypeLibrary::instance()->getMutex());
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getFaceMutex());
 
     if (!FT_HAS_KERNING(_face) || (kerningType == osgText::KERNING_NONE)) return osg::Vec2(0.0f,0.0f);
 
@@ -549,13 +560,13 @@ osg::Vec2 FreeTypeFont::getKerning(unsigned int leftcharcode,unsigned int rightc
 
 bool FreeTypeFont::hasVertical() const
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(FreeTypeLibrary::instance()->getMutex());
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getFaceMutex());
     return FT_HAS_VERTICAL(_face)!=0;
 }
 
 bool FreeTypeFont::getVerticalSize(float & ascender, float & descender) const
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(FreeTypeLibrary::instance()->getMutex());
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(getFaceMutex());
 #if 0
     if(_face->units_per_EM != 0)
     {
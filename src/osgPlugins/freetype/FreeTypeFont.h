@@ -51,6 +51,11 @@ protected:
 
     void setFontResolution(const osgText::FontResolution& fontSize);
 
+    /** Mutex serializing the use of the face. FreeType 2.6 and later allow different faces of a library to be used
+      * concurrently, so each font has its own mutex, older versions share the renderer pool of the library so the
+      * library mutex is used.*/
+    OpenThreads::Mutex& getFaceMutex() const;
+
     osgText::FontResolution _currentRes;
 
     long ft_round( long x ) { return (( x + 32 ) & -64); }
@@ -61,6 +66,8 @@ protected:
     FT_Byte*                _buffer;
     FT_Face                 _face;
     unsigned int            _flags;
+
+    mutable OpenThreads::Mutex  _faceMutex;
 };
 
 #endif
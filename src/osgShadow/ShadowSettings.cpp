@@ -30,6 +30,10 @@ ShadowSettings::ShadowSettings():
     _perspectiveShadowMapCutOffAngle(2.0),
     _numShadowMapsPerLight(1),
     _multipleShadowMapHint(PARALLEL_SPLIT),
+    _cascadeSplitWeight(0.75),
+    _staticShadowCastersHint(NO_STATIC_SHADOW_CASTERS),
+    _staticCastsShadowTraversalMask(0xffffffff),
+    _staticShadowMapMargin(0.25),
     _shaderHint(NO_SHADERS),
 //    _shaderHint(PROVIDE_FRAGMENT_SHADER),
     _debugDraw(false)
@@ -53,6 +57,10 @@ ShadowSettings::ShadowSettings(const ShadowSettings& ss, const osg::CopyOp& copy
     _perspectiveShadowMapCutOffAngle(ss._perspectiveShadowMapCutOffAngle),
     _numShadowMapsPerLight(ss._numShadowMapsPerLight),
     _multipleShadowMapHint(ss._multipleShadowMapHint),
+    _cascadeSplitWeight(ss._cascadeSplitWeight),
+    _staticShadowCastersHint(ss._staticShadowCastersHint),
+    _staticCastsShadowTraversalMask(ss._staticCastsShadowTraversalMask),
+    _staticShadowMapMargin(ss._staticShadowMapMargin),
     _shaderHint(ss._shaderHint),
     _debugDraw(ss._debugDraw)
 {
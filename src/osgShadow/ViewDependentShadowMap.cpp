@@ -14,8 +14,19 @@
 #include <osgShadow/ViewDependentShadowMap>
 #include <osgShadow/ShadowedScene>
 #include <osg/CullFace>
+#include <osg/Depth>
 #include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Billboard>
+#include <osg/ClipNode>
+#include <osg/TexGenNode>
+#include <osg/Projection>
+#include <osg/Switch>
+#include <osg/LOD>
+#include <osg/OccluderNode>
+#include <osg/OcclusionQueryNode>
 #include <osg/io_utils>
+#include <osgUtil/WorkerThreadPool>
 
 #include <sstream>
 
@@ -70,6 +81,41 @@ static const char fragmentShaderSource_withBaseTexture_twoShadowMaps[] =
         "} \n";
 #endif
 
+// fragment shader for CASCADED shadow maps, selecting the shadow map of the cascade the fragment is in
+// from the distance of the fragment to the eye.
+static std::string createFragmentShaderSource_withBaseTexture_cascadedShadowMaps(unsigned int numShadowMaps)
+{
+    std::stringstream sstr;
+    sstr<<"uniform sampler2D baseTexture;\n";
+    sstr<<"uniform int baseTextureUnit;\n";
+    for(unsigned int sm_i=0; sm_i<numShadowMaps; ++sm_i)
+    {
+        sstr<<"uniform sampler2DShadow shadowTexture"<<sm_i<<";\n";
+        sstr<<"uniform int shadowTextureUnit"<<sm_i<<";\n";
+    }
+    sstr<<"uniform float shadowSplitDistances["<<numShadowMaps-1<<"];\n";
+    sstr<<"varying vec4 gl_TexCoord[gl_MaxTextureCoords];\n";
+    sstr<<"\n";
+    sstr<<"void main(void)\n";
+    sstr<<"{\n";
+    sstr<<"  vec4 colorAmbientEmissive = gl_FrontLightModelProduct.sceneColor;\n";
+    sstr<<"  vec4 color = texture2D( baseTexture, gl_TexCoord[baseTextureUnit].xy );\n";
+    sstr<<"  float z_ndc = gl_FragCoord.z*2.0-1.0;\n";
+    sstr<<"  float distance = (z_ndc*gl_ProjectionMatrix[3][3]-gl_ProjectionMatrix[3][2])/(z_ndc*gl_ProjectionMatrix[2][3]-gl_ProjectionMatrix[2][2]);\n";
+    sstr<<"  float shadow;\n";
+    for(unsigned int sm_i=0; sm_i<numShadowMaps; ++sm_i)
+    {
+        if (sm_i==0) sstr<<"  if (distance<shadowSplitDistances[0]) ";
+        else if (sm_i+1<numShadowMaps) sstr<<"  else if (distance<shadowSplitDistances["<<sm_i<<"]) ";
+        else sstr<<"  else ";
+        sstr<<"shadow = shadow2DProj( shadowTexture"<<sm_i<<", gl_TexCoord[shadowTextureUnit"<<sm_i<<"] ).r;\n";
+    }
+    sstr<<"  color *= mix( colorAmbientEmissive, gl_Color, shadow );\n";
+    sstr<<"  gl_FragColor = color;\n";
+    sstr<<"}\n";
+    return sstr.str();
+}
+
 template<class T>
 class RenderLeafTraverser : public T
 {
@@ -152,12 +198,16 @@ class VDSMCameraCullCallback : public osg::NodeCallback
         osg::RefMatrix* getProjectionMatrix() { return _projectionMatrix.get(); }
         osgUtil::RenderStage* getRenderStage() { return _renderStage.get(); }
 
+        /** Set the node culled ahead of the shadowed scene, used to copy a cached static shadow map into the shadow map.*/
+        void setCompositeNode(osg::Geode* geode) { _compositeNode = geode; }
+
     protected:
 
         ViewDependentShadowMap*                 _vdsm;
         osg::ref_ptr<osg::RefMatrix>            _projectionMatrix;
         osg::ref_ptr<osgUtil::RenderStage>      _renderStage;
         osg::Polytope                           _polytope;
+        osg::ref_ptr<osg::Geode>                _compositeNode;
 };
 
 VDSMCameraCullCallback::VDSMCameraCullCallback(ViewDependentShadowMap* vdsm, osg::Polytope& polytope):
@@ -184,6 +234,14 @@ void VDSMCameraCullCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
         cv->pushCullingSet();
     }
 #endif
+    // the static shadow map is composited whatever the traversal mask used for the dynamic shadow casters.
+    if (_compositeNode.valid())
+    {
+        nv->pushOntoNodePath(_compositeNode.get());
+        nv->apply(*_compositeNode);
+        nv->popFromNodePath();
+    }
+
     if (_vdsm->getShadowedScene())
     {
         _vdsm->getShadowedScene()->osg::Group::traverse(*nv);
@@ -515,8 +573,230 @@ void ViewDependentShadowMap::ShadowData::releaseGLObjects(osg::State* state) con
     OSG_INFO<<"ViewDependentShadowMap::ShadowData::releaseGLObjects"<<std::endl;
     _texture->releaseGLObjects(state);
     _camera->releaseGLObjects(state);
+    if (_staticShadowMap.valid()) _staticShadowMap->releaseGLObjects(state);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+// StaticShadowMap
+//
+static const char vertexShaderSource_copyStaticShadowMap[] =
+        "varying vec2 texCoord;                                                  \n"
+        "                                                                        \n"
+        "void main(void)                                                         \n"
+        "{                                                                       \n"
+        "  texCoord = gl_Vertex.xy*0.5+0.5;                                      \n"
+        "  gl_Position = vec4(gl_Vertex.xy, 0.0, 1.0);                           \n"
+        "} \n";
+
+static const char fragmentShaderSource_copyStaticShadowMap[] =
+        "uniform sampler2D staticShadowTexture;                                  \n"
+        "varying vec2 texCoord;                                                  \n"
+        "                                                                        \n"
+        "void main(void)                                                         \n"
+        "{                                                                       \n"
+        "  gl_FragDepth = texture2D( staticShadowTexture, texCoord ).r;          \n"
+        "} \n";
+
+ViewDependentShadowMap::StaticShadowMap::StaticShadowMap(ViewDependentShadowMap::ViewDependentData* vdd):
+    _active(false),
+    _refresh(false),
+    _valid(false)
+{
+    const ShadowSettings* settings = vdd->getViewDependentShadowMap()->getShadowedScene()->getShadowSettings();
+
+    osg::Vec2s textureSize = settings->getTextureSize();
+
+    // set up the texture, read back texel for texel rather than compared with
+    _texture = new osg::Texture2D;
+    _texture->setTextureSize(textureSize.x(), textureSize.y());
+    _texture->setInternalFormat(GL_DEPTH_COMPONENT);
+    _texture->setFilter(osg::Texture2D::MIN_FILTER,osg::Texture2D::NEAREST);
+    _texture->setFilter(osg::Texture2D::MAG_FILTER,osg::Texture2D::NEAREST);
+    _texture->setWrap(osg::Texture2D::WRAP_S,osg::Texture2D::CLAMP_TO_EDGE);
+    _texture->setWrap(osg::Texture2D::WRAP_T,osg::Texture2D::CLAMP_TO_EDGE);
+
+    // set up the camera, its projection is kept as computed so the dynamic shadow casters can be rendered with the same one.
+    _camera = new osg::Camera;
+    _camera->setName("StaticShadowCamera");
+    _camera->setReferenceFrame(osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT);
+    _camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,0.0f));
+    _camera->setComputeNearFarMode(osg::Camera::DO_NOT_COMPUTE_NEAR_FAR);
+    _camera->setCullingMode(_camera->getCullingMode() & ~osg::CullSettings::SMALL_FEATURE_CULLING);
+    _camera->setViewport(0,0,textureSize.x(),textureSize.y());
+    _camera->setClearMask(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+    // render ahead of the shadow map camera which copies the texture.
+    _camera->setRenderOrder(osg::Camera::PRE_RENDER, -1);
+    _camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+    _camera->attach(osg::Camera::DEPTH_BUFFER, _texture.get());
+
+    // set up a quad covering the whole shadow map writing the depth of the texture.
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    vertices->push_back(osg::Vec3(-1.0f,-1.0f,0.0f));
+    vertices->push_back(osg::Vec3(1.0f,-1.0f,0.0f));
+    vertices->push_back(osg::Vec3(-1.0f,1.0f,0.0f));
+    vertices->push_back(osg::Vec3(1.0f,1.0f,0.0f));
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+    geometry->setDataVariance(osg::Object::DYNAMIC);
+    geometry->setCullingActive(false);
+
+    osg::ref_ptr<osg::Program> program = new osg::Program;
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, vertexShaderSource_copyStaticShadowMap));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, fragmentShaderSource_copyStaticShadowMap));
+
+    unsigned int protectedValue = osg::StateAttribute::ON | osg::StateAttribute::PROTECTED;
+
+    osg::StateSet* stateset = geometry->getOrCreateStateSet();
+    stateset->setTextureAttributeAndModes(0, _texture.get(), protectedValue);
+    stateset->addUniform(new osg::Uniform("staticShadowTexture", 0));
+    stateset->setAttribute(program.get(), protectedValue);
+    stateset->setAttributeAndModes(new osg::Depth(osg::Depth::ALWAYS), protectedValue);
+    stateset->setMode(GL_CULL_FACE, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+
+    // draw ahead of the dynamic shadow casters.
+    stateset->setRenderBinDetails(-1, "RenderBin");
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    geode->addDrawable(geometry.get());
+    geode->setCullingActive(false);
+    geode->setDataVariance(osg::Object::DYNAMIC);
+    _compositeNode = geode;
+}
+
+void ViewDependentShadowMap::StaticShadowMap::releaseGLObjects(osg::State* state) const
+{
+    _texture->releaseGLObjects(state);
+    _camera->releaseGLObjects(state);
+    _compositeNode->releaseGLObjects(state);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+// ShadowMapSetup
+//
+// settings of a shadow map camera kept from its set up until the shadow map has been culled.
+struct ShadowMapSetup
+{
+    ShadowMapSetup(ViewDependentShadowMap::LightData* ld, const ViewDependentShadowMap::Frustum& f, unsigned int tu):
+        lightData(ld),
+        frustum(f),
+        textureUnit(tu) {}
+
+    ViewDependentShadowMap::LightData*              lightData;
+    ViewDependentShadowMap::Frustum                 frustum;
+    unsigned int                                    textureUnit;
+    osg::ref_ptr<ViewDependentShadowMap::ShadowData> shadowData;
+    osg::ref_ptr<VDSMCameraCullCallback>            cullCallback;
+};
+
+typedef std::vector<ShadowMapSetup> ShadowMapSetupList;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+// ShadowCasterCullVisitor
+//
+// culls only the static or only the dynamic shadow casters, told apart by their DataVariance.
+class ShadowCasterCullVisitor : public osgUtil::CullVisitor
+{
+    public:
+
+        enum ShadowCasters
+        {
+            STATIC_SHADOW_CASTERS,
+            DYNAMIC_SHADOW_CASTERS
+        };
+
+        ShadowCasterCullVisitor(const osgUtil::CullVisitor& cv, ShadowCasters shadowCasters):
+            osgUtil::CullVisitor(cv),
+            _shadowCasters(shadowCasters),
+            _numDynamicParents(0) {}
+
+        void setShadowCasters(ShadowCasters shadowCasters) { _shadowCasters = shadowCasters; }
+        ShadowCasters getShadowCasters() const { return _shadowCasters; }
+
+        virtual void reset()
+        {
+            osgUtil::CullVisitor::reset();
+            _numDynamicParents = 0;
+        }
+
+        virtual void apply(osg::Node& node) { filter(node); }
+        virtual void apply(osg::Geode& node) { filter(node); }
+        virtual void apply(osg::Billboard& node) { filter(node); }
+        virtual void apply(osg::LightSource& node) { filter(node); }
+        virtual void apply(osg::ClipNode& node) { filter(node); }
+        virtual void apply(osg::TexGenNode& node) { filter(node); }
+        virtual void apply(osg::Group& node) { filter(node); }
+        virtual void apply(osg::Transform& node) { filter(node); }
+        virtual void apply(osg::Projection& node) { filter(node); }
+        virtual void apply(osg::Switch& node) { filter(node); }
+        virtual void apply(osg::LOD& node) { filter(node); }
+        virtual void apply(osg::ClearNode& node) { filter(node); }
+        virtual void apply(osg::OccluderNode& node) { filter(node); }
+        virtual void apply(osg::OcclusionQueryNode& node) { filter(node); }
+
+        virtual void apply(osg::Drawable& drawable)
+        {
+            bool dynamic = _numDynamicParents>0 || drawable.getDataVariance()==osg::Object::DYNAMIC;
+            if (dynamic == (_shadowCasters==DYNAMIC_SHADOW_CASTERS)) osgUtil::CullVisitor::apply(drawable);
+        }
+
+    protected:
+
+        // static shadow casters skip the dynamic subgraphs, dynamic shadow casters traverse the whole scene graph
+        // but only keep the drawables within dynamic subgraphs.
+        template<class T>
+        void filter(T& node)
+        {
+            bool dynamic = node.getDataVariance()==osg::Object::DYNAMIC;
+            if (dynamic)
+            {
+                if (_shadowCasters==STATIC_SHADOW_CASTERS) return;
+                ++_numDynamicParents;
+            }
+
+            osgUtil::CullVisitor::apply(node);
+
+            if (dynamic) --_numDynamicParents;
+        }
+
+        ShadowCasters   _shadowCasters;
+        unsigned int    _numDynamicParents;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+// CullShadowCastingScenesOperation
+//
+// culls the shadow casting scene of each shadow map camera with its own CullVisitor.
+class CullShadowCastingScenesOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+    public:
+
+        typedef std::vector< std::pair<osgUtil::CullVisitor*, osg::Camera*> > CullVisitorCameraList;
+
+        CullShadowCastingScenesOperation(const ViewDependentShadowMap* vdsm, CullVisitorCameraList& cullVisitorCameraList):
+            _vdsm(vdsm),
+            _cullVisitorCameraList(cullVisitorCameraList) {}
+
+        virtual void operator() (unsigned int begin, unsigned int end)
+        {
+            for(unsigned int i=begin; i<end; ++i)
+            {
+                _vdsm->cullShadowCastingScene(_cullVisitorCameraList[i].first, _cullVisitorCameraList[i].second);
+            }
+        }
+
+    protected:
+
+        const ViewDependentShadowMap*   _vdsm;
+        CullVisitorCameraList&          _cullVisitorCameraList;
+};
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Frustum
@@ -542,6 +822,36 @@ ViewDependentShadowMap::Frustum::Frustum(osgUtil::CullVisitor* cv, double minZNe
         OSG_INFO<<"Projection matrix after clamping "<<projectionMatrix<<std::endl;
     }
 
+    computeCornersFacesAndEdges();
+}
+
+ViewDependentShadowMap::Frustum::Frustum(const Frustum& frustum, double zNear, double zFar):
+    projectionMatrix(frustum.projectionMatrix),
+    modelViewMatrix(frustum.modelViewMatrix),
+    corners(8),
+    faces(6),
+    edges(12)
+{
+    // replace the depth range of the projection matrix, leaving its x and y extents untouched.
+    bool orthographic = projectionMatrix(0,3)==0.0 && projectionMatrix(1,3)==0.0 && projectionMatrix(2,3)==0.0;
+    if (orthographic)
+    {
+        projectionMatrix(2,2) = -2.0/(zFar-zNear);
+        projectionMatrix(3,2) = -(zFar+zNear)/(zFar-zNear);
+    }
+    else
+    {
+        projectionMatrix(2,2) = -(zFar+zNear)/(zFar-zNear);
+        projectionMatrix(3,2) = -2.0*zFar*zNear/(zFar-zNear);
+    }
+
+    OSG_INFO<<"Split frustum zNear = "<<zNear<<", zFar = "<<zFar<<std::endl;
+
+    computeCornersFacesAndEdges();
+}
+
+void ViewDependentShadowMap::Frustum::computeCornersFacesAndEdges()
+{
     corners[0].set(-1.0,-1.0,-1.0);
     corners[1].set(1.0,-1.0,-1.0);
     corners[2].set(1.0,-1.0,1.0);
@@ -704,6 +1014,23 @@ void ViewDependentShadowMap::cleanSceneGraph()
     OSG_INFO<<"ViewDependentShadowMap::cleanSceneGraph()"<<std::endl;
 }
 
+void ViewDependentShadowMap::dirtyStaticShadowCasters()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_viewDependentDataMapMutex);
+    for(ViewDependentDataMap::iterator itr = _viewDependentDataMap.begin();
+        itr != _viewDependentDataMap.end();
+        ++itr)
+    {
+        ShadowDataList& sdl = itr->second->getShadowDataList();
+        for(ShadowDataList::iterator sd_itr = sdl.begin();
+            sd_itr != sdl.end();
+            ++sd_itr)
+        {
+            if ((*sd_itr)->_staticShadowMap.valid()) (*sd_itr)->_staticShadowMap->_valid = false;
+        }
+    }
+}
+
 ViewDependentShadowMap::ViewDependentData* ViewDependentShadowMap::createViewDependentData(osgUtil::CullVisitor* /*cv*/)
 {
     return new ViewDependentData(this);
@@ -827,130 +1154,144 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
     previous_sdl.swap(sdl);
 
     unsigned int numShadowMapsPerLight = settings->getNumShadowMapsPerLight();
-    if (numShadowMapsPerLight>2)
+    bool cascaded = numShadowMapsPerLight>1 && settings->getMultipleShadowMapHint()==ShadowSettings::CASCADED;
+    unsigned int maximumNumShadowMapsPerLight = cascaded ? 4 : 2;
+    if (numShadowMapsPerLight>maximumNumShadowMapsPerLight)
     {
-        OSG_NOTICE<<"numShadowMapsPerLight of "<<numShadowMapsPerLight<<" is greater than maximum supported, falling back to 2."<<std::endl;
-        numShadowMapsPerLight = 2;
+        OSG_NOTICE<<"numShadowMapsPerLight of "<<numShadowMapsPerLight<<" is greater than maximum supported, falling back to "<<maximumNumShadowMapsPerLight<<"."<<std::endl;
+        numShadowMapsPerLight = maximumNumShadowMapsPerLight;
     }
 
-    LightDataList& pll = vdd->getLightDataList();
-    for(LightDataList::iterator itr = pll.begin();
-        itr != pll.end();
-        ++itr)
+    // distances from the eye at which the view frustum is split between the cascades.
+    std::vector<double> splitDistances;
+    if (cascaded)
     {
-        // 3. create per light/per shadow map division of lightspace/frustum
-        //    create a list of light/shadow map data structures
-
-        LightData& pl = **itr;
+        double left, right, bottom, top, zNear, zFar;
+        if (orthographicViewFrustum)
+        {
+            frustum.projectionMatrix.getOrtho(left, right, bottom, top, zNear, zFar);
+        }
+        else
+        {
+            frustum.projectionMatrix.getFrustum(left, right, bottom, top, zNear, zFar);
+        }
 
-        // 3.1 compute light space polytope
-        //
-        osg::Polytope polytope = computeLightViewFrustumPolytope(frustum, pl);
+        // blend logarithmic splits, which keep the texel to pixel ratio constant along the view direction,
+        // with uniform splits, which keep the far cascades from becoming too long.
+        double weight = (zNear>0.0) ? settings->getCascadeSplitWeight() : 0.0;
 
-        // if polytope is empty then no rendering.
-        if (polytope.empty())
+        splitDistances.push_back(zNear);
+        for(unsigned int sm_i=1; sm_i<numShadowMapsPerLight; ++sm_i)
         {
-            OSG_NOTICE<<"Polytope empty no shadow to render"<<std::endl;
-            continue;
+            double ratio = double(sm_i)/double(numShadowMapsPerLight);
+            double logarithmicSplit = (weight>0.0) ? zNear*pow(zFar/zNear, ratio) : 0.0;
+            double uniformSplit = zNear+(zFar-zNear)*ratio;
+            splitDistances.push_back(logarithmicSplit*weight + uniformSplit*(1.0-weight));
         }
+        splitDistances.push_back(zFar);
 
-        // 3.2 compute RTT camera view+projection matrix settings
-        //
-        osg::Matrixd projectionMatrix;
-        osg::Matrixd viewMatrix;
-        if (!computeShadowCameraSettings(frustum, pl, projectionMatrix, viewMatrix))
+        osg::ref_ptr<osg::Uniform>& splitDistancesUniform = vdd->_splitDistancesUniform;
+        if (!splitDistancesUniform || splitDistancesUniform->getNumElements()!=numShadowMapsPerLight-1)
         {
-            OSG_NOTICE<<"No valid Camera settings, no shadow to render"<<std::endl;
-            continue;
+            splitDistancesUniform = new osg::Uniform(osg::Uniform::FLOAT, "shadowSplitDistances", numShadowMapsPerLight-1);
         }
 
-        // if we are using multiple shadow maps and CastShadowTraversalMask is being used
-        // traverse the scene to compute the extents of the objects
-        if (/*numShadowMapsPerLight>1 &&*/ _shadowedScene->getCastsShadowTraversalMask()!=0xffffffff)
+        for(unsigned int sm_i=1; sm_i<numShadowMapsPerLight; ++sm_i)
         {
-            // osg::ElapsedTime timer;
+            OSG_INFO<<"Cascade split distance "<<splitDistances[sm_i]<<std::endl;
+            splitDistancesUniform->setElement(sm_i-1, static_cast<float>(splitDistances[sm_i]));
+        }
+    }
 
-            osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,2048,2048);
-            ComputeLightSpaceBounds clsb(viewport.get(), projectionMatrix, viewMatrix);
-            clsb.setTraversalMask(_shadowedScene->getCastsShadowTraversalMask());
+    // the static shadow casters are cached in orthographic shadow maps which aren't split in light space.
+    bool cacheStaticShadowCasters = settings->getStaticShadowCastersHint()!=ShadowSettings::NO_STATIC_SHADOW_CASTERS &&
+                                    !settings->getDebugDraw() &&
+                                    (numShadowMapsPerLight==1 || cascaded) &&
+                                    (orthographicViewFrustum || settings->getShadowMapProjectionHint()!=ShadowSettings::PERSPECTIVE_SHADOW_MAP);
 
-            osg::Matrixd invertModelView;
-            invertModelView.invert(viewMatrix);
-            osg::Polytope local_polytope(polytope);
-            local_polytope.transformProvidingInverse(invertModelView);
+    // shadow maps whose cameras have been set up, culled together once all of them have been set up.
+    ShadowDataList shadowMapsToCull;
+    ShadowMapSetupList shadowMapSetups;
+
+    LightDataList& pll = vdd->getLightDataList();
+    for(LightDataList::iterator itr = pll.begin();
+        itr != pll.end();
+        ++itr)
+    {
+        // 3. create per light/per shadow map division of lightspace/frustum
+        //    create a list of light/shadow map data structures
 
-            osg::CullingSet& cs = clsb.getProjectionCullingStack().back();
-            cs.setFrustum(local_polytope);
-            clsb.pushCullingSet();
+        LightData& pl = **itr;
 
-            _shadowedScene->accept(clsb);
+        osg::Polytope polytope;
+        osg::Matrixd projectionMatrix;
+        osg::Matrixd viewMatrix;
+        double splitPoint = 0.0;
 
-            // OSG_NOTICE<<"Extents of LightSpace "<<clsb._bb.xMin()<<", "<<clsb._bb.xMax()<<", "<<clsb._bb.yMin()<<", "<<clsb._bb.yMax()<<", "<<clsb._bb.zMin()<<", "<<clsb._bb.zMax()<<std::endl;
-            // OSG_NOTICE<<"  time "<<timer.elapsedTime_m()<<"ms, mask = "<<std::hex<<_shadowedScene->getCastsShadowTraversalMask()<<std::endl;
+        // cascaded shadow maps each compute their own light space polytope and camera settings.
+        if (!cascaded)
+        {
+            // 3.1 compute light space polytope
+            // 3.2 compute RTT camera view+projection matrix settings
+            //
+            if (!computeShadowMapSettings(frustum, pl, polytope, projectionMatrix, viewMatrix)) continue;
 
-            if (clsb._bb.xMin()>-1.0f || clsb._bb.xMax()<1.0f || clsb._bb.yMin()>-1.0f || clsb._bb.yMax()<1.0f)
+            if (numShadowMapsPerLight>1)
             {
-                // OSG_NOTICE<<"Need to clamp projection matrix"<<std::endl;
+                osg::Vec3d eye_v = frustum.eye * viewMatrix;
+                osg::Vec3d center_v = frustum.center * viewMatrix;
+                osg::Vec3d viewdir_v = center_v-eye_v; viewdir_v.normalize();
+                osg::Vec3d lightdir(0.0,0.0,-1.0);
 
-#if 1
-                double xMid = (clsb._bb.xMin()+clsb._bb.xMax())*0.5f;
-                double xRange = clsb._bb.xMax()-clsb._bb.xMin();
-#else
-                double xMid = 0.0;
-                double xRange = 2.0;
-#endif
-                double yMid = (clsb._bb.yMin()+clsb._bb.yMax())*0.5f;
-                double yRange = (clsb._bb.yMax()-clsb._bb.yMin());
+                double dotProduct_v = lightdir * viewdir_v;
+                double angle = acosf(dotProduct_v);
 
-                // OSG_NOTICE<<"  xMid="<<xMid<<", yMid="<<yMid<<", xRange="<<xRange<<", yRange="<<yRange<<std::endl;
+                osg::Vec3d eye_ls = eye_v * projectionMatrix;
 
-                projectionMatrix =
-                    projectionMatrix *
-                    osg::Matrixd::translate(osg::Vec3d(-xMid,-yMid,0.0)) *
-                    osg::Matrixd::scale(osg::Vec3d(2.0/xRange, 2.0/yRange,1.0));
+                OSG_INFO<<"Angle between view vector and eye "<<osg::RadiansToDegrees(angle)<<std::endl;
+                OSG_INFO<<"eye_ls="<<eye_ls<<std::endl;
 
+                if (eye_ls.y()>=-1.0 && eye_ls.y()<=1.0)
+                {
+                    OSG_INFO<<"Eye point inside light space clip region   "<<std::endl;
+                    splitPoint = 0.0;
+                }
+                else
+                {
+                    double n = -1.0-eye_ls.y();
+                    double f = 1.0-eye_ls.y();
+                    double sqrt_nf = sqrt(n*f);
+                    double mid = eye_ls.y()+sqrt_nf;
+                    double ratioOfMidToUseForSplit = 0.8;
+                    splitPoint = mid * ratioOfMidToUseForSplit;
+
+                    OSG_INFO<<"  n="<<n<<", f="<<f<<", sqrt_nf="<<sqrt_nf<<" mid="<<mid<<std::endl;
+                }
             }
-
         }
 
-        double splitPoint = 0.0;
-
-        if (numShadowMapsPerLight>1)
+        // 4. For each light/shadow map
+        for (unsigned int sm_i=0; sm_i<numShadowMapsPerLight; ++sm_i)
         {
-            osg::Vec3d eye_v = frustum.eye * viewMatrix;
-            osg::Vec3d center_v = frustum.center * viewMatrix;
-            osg::Vec3d viewdir_v = center_v-eye_v; viewdir_v.normalize();
-            osg::Vec3d lightdir(0.0,0.0,-1.0);
-
-            double dotProduct_v = lightdir * viewdir_v;
-            double angle = acosf(dotProduct_v);
+            ShadowMapSetup setup(&pl, frustum, textureUnit);
 
-            osg::Vec3d eye_ls = eye_v * projectionMatrix;
+            if (cascaded)
+            {
+                // extend each cascade slightly into the next to prevent a seam showing through between the shadowmaps.
+                double zNear = splitDistances[sm_i];
+                double zFar = splitDistances[sm_i+1];
+                if (sm_i+1<numShadowMapsPerLight) zFar += (zFar-zNear)*0.05;
 
-            OSG_INFO<<"Angle between view vector and eye "<<osg::RadiansToDegrees(angle)<<std::endl;
-            OSG_INFO<<"eye_ls="<<eye_ls<<std::endl;
+                setup.frustum = Frustum(frustum, zNear, zFar);
 
-            if (eye_ls.y()>=-1.0 && eye_ls.y()<=1.0)
-            {
-                OSG_INFO<<"Eye point inside light space clip region   "<<std::endl;
-                splitPoint = 0.0;
-            }
-            else
-            {
-                double n = -1.0-eye_ls.y();
-                double f = 1.0-eye_ls.y();
-                double sqrt_nf = sqrt(n*f);
-                double mid = eye_ls.y()+sqrt_nf;
-                double ratioOfMidToUseForSplit = 0.8;
-                splitPoint = mid * ratioOfMidToUseForSplit;
-
-                OSG_INFO<<"  n="<<n<<", f="<<f<<", sqrt_nf="<<sqrt_nf<<" mid="<<mid<<std::endl;
+                if (!computeShadowMapSettings(setup.frustum, pl, polytope, projectionMatrix, viewMatrix))
+                {
+                    // keep the texture units of the following cascades in step with the shader uniforms.
+                    ++textureUnit;
+                    continue;
+                }
             }
-        }
 
-        // 4. For each light/shadow map
-        for (unsigned int sm_i=0; sm_i<numShadowMapsPerLight; ++sm_i)
-        {
             osg::ref_ptr<ShadowData> sd;
 
             if (previous_sdl.empty())
@@ -967,6 +1308,19 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
 
             osg::ref_ptr<osg::Camera> camera = sd->_camera;
 
+            // with the static shadow casters cached the shadow map has to keep the projection of the static shadow map.
+            bool useStaticShadowMap = cacheStaticShadowCasters && pl.directionalLight;
+            if (useStaticShadowMap)
+            {
+                setUpStaticShadowMap(*sd, pl, projectionMatrix, viewMatrix);
+            }
+            else if (sd->_staticShadowMap.valid())
+            {
+                sd->_staticShadowMap->_active = false;
+            }
+
+            camera->setComputeNearFarMode(useStaticShadowMap ? osg::Camera::DO_NOT_COMPUTE_NEAR_FAR : osg::Camera::COMPUTE_NEAR_FAR_USING_BOUNDING_VOLUMES);
+
             camera->setProjectionMatrix(projectionMatrix);
             camera->setViewMatrix(viewMatrix);
 
@@ -984,7 +1338,7 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
             local_polytope.transformProvidingInverse(invertModelView);
 
 
-            if (numShadowMapsPerLight>1)
+            if (numShadowMapsPerLight>1 && !cascaded)
             {
                 // compute the start and end range in non-dimensional coords
 #if 0
@@ -1050,49 +1404,61 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
 
 
             osg::ref_ptr<VDSMCameraCullCallback> vdsmCallback = new VDSMCameraCullCallback(this, local_polytope);
+            if (useStaticShadowMap) vdsmCallback->setCompositeNode(sd->_staticShadowMap->_compositeNode.get());
             camera->setCullCallback(vdsmCallback.get());
 
-            // 4.3 traverse RTT camera
-            //
+            setup.shadowData = sd;
+            setup.cullCallback = vdsmCallback;
+            shadowMapSetups.push_back(setup);
+            shadowMapsToCull.push_back(sd);
 
-            cv.pushStateSet(_shadowCastingStateSet.get());
+            ++textureUnit;
+        }
+    }
 
-            cullShadowCastingScene(&cv, camera.get());
+    // 4.3 traverse RTT cameras
+    //
+    cullShadowCastingScenes(&cv, shadowMapsToCull);
 
-            cv.popStateSet();
+    for(ShadowMapSetupList::iterator setup_itr = shadowMapSetups.begin();
+        setup_itr != shadowMapSetups.end();
+        ++setup_itr)
+    {
+        ShadowMapSetup& setup = *setup_itr;
+        ShadowData* sd = setup.shadowData.get();
+        osg::Camera* camera = sd->_camera.get();
+        VDSMCameraCullCallback* vdsmCallback = setup.cullCallback.get();
 
-            if (!orthographicViewFrustum && settings->getShadowMapProjectionHint()==ShadowSettings::PERSPECTIVE_SHADOW_MAP)
+        if (!orthographicViewFrustum && settings->getShadowMapProjectionHint()==ShadowSettings::PERSPECTIVE_SHADOW_MAP)
+        {
+            adjustPerspectiveShadowMapCameraSettings(vdsmCallback->getRenderStage(), setup.frustum, *setup.lightData, camera);
+            if (vdsmCallback->getProjectionMatrix())
             {
-                adjustPerspectiveShadowMapCameraSettings(vdsmCallback->getRenderStage(), frustum, pl, camera.get());
-                if (vdsmCallback->getProjectionMatrix())
-                {
-                    vdsmCallback->getProjectionMatrix()->set(camera->getProjectionMatrix());
-                }
+                vdsmCallback->getProjectionMatrix()->set(camera->getProjectionMatrix());
             }
+        }
 
-            // 4.4 compute main scene graph TexGen + uniform settings + setup state
-            //
-            assignTexGenSettings(&cv, camera.get(), textureUnit, sd->_texgen.get());
+        // 4.4 compute main scene graph TexGen + uniform settings + setup state
+        //
+        assignTexGenSettings(&cv, camera, setup.textureUnit, sd->_texgen.get());
 
-            // mark the light as one that has active shadows and requires shaders
-            pl.textureUnits.push_back(textureUnit);
+        // mark the light as one that has active shadows and requires shaders
+        setup.lightData->textureUnits.push_back(setup.textureUnit);
 
-            // pass on shadow data to ShadowDataList
-            sd->_textureUnit = textureUnit;
+        // pass on shadow data to ShadowDataList
+        sd->_textureUnit = setup.textureUnit;
 
-            if (textureUnit >= 8)
-            {
-                OSG_NOTICE<<"Shadow texture unit is invalid for texgen, will not be used."<<std::endl;
-            }
-            else
-            {
-                sdl.push_back(sd);
-            }
-
-            // increment counters.
-            ++textureUnit;
-            ++numValidShadows ;
+        if (setup.textureUnit >= 8)
+        {
+            OSG_NOTICE<<"Shadow texture unit is invalid for texgen, will not be used."<<std::endl;
         }
+        else
+        {
+            sdl.push_back(sd);
+        }
+
+        // increment counters.
+        ++numValidShadows ;
     }
 
     if (numValidShadows>0)
@@ -1103,6 +1469,79 @@ void ViewDependentShadowMap::cull(osgUtil::CullVisitor& cv)
     // OSG_NOTICE<<"End of shadow setup Projection matrix "<<*cv.getProjectionMatrix()<<std::endl;
 }
 
+bool ViewDependentShadowMap::computeShadowMapSettings(Frustum& frustum, LightData& positionedLight, osg::Polytope& polytope, osg::Matrixd& projectionMatrix, osg::Matrixd& viewMatrix)
+{
+    // 3.1 compute light space polytope
+    //
+    polytope = computeLightViewFrustumPolytope(frustum, positionedLight);
+
+    // if polytope is empty then no rendering.
+    if (polytope.empty())
+    {
+        OSG_NOTICE<<"Polytope empty no shadow to render"<<std::endl;
+        return false;
+    }
+
+    // 3.2 compute RTT camera view+projection matrix settings
+    //
+    if (!computeShadowCameraSettings(frustum, positionedLight, projectionMatrix, viewMatrix))
+    {
+        OSG_NOTICE<<"No valid Camera settings, no shadow to render"<<std::endl;
+        return false;
+    }
+
+    // if we are using multiple shadow maps and CastShadowTraversalMask is being used
+    // traverse the scene to compute the extents of the objects
+    if (/*numShadowMapsPerLight>1 &&*/ _shadowedScene->getCastsShadowTraversalMask()!=0xffffffff)
+    {
+        // osg::ElapsedTime timer;
+
+        osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,2048,2048);
+        ComputeLightSpaceBounds clsb(viewport.get(), projectionMatrix, viewMatrix);
+        clsb.setTraversalMask(_shadowedScene->getCastsShadowTraversalMask());
+
+        osg::Matrixd invertModelView;
+        invertModelView.invert(viewMatrix);
+        osg::Polytope local_polytope(polytope);
+        local_polytope.transformProvidingInverse(invertModelView);
+
+        osg::CullingSet& cs = clsb.getProjectionCullingStack().back();
+        cs.setFrustum(local_polytope);
+        clsb.pushCullingSet();
+
+        _shadowedScene->accept(clsb);
+
+        // OSG_NOTICE<<"Extents of LightSpace "<<clsb._bb.xMin()<<", "<<clsb._bb.xMax()<<", "<<clsb._bb.yMin()<<", "<<clsb._bb.yMax()<<", "<<clsb._bb.zMin()<<", "<<clsb._bb.zMax()<<std::endl;
+        // OSG_NOTICE<<"  time "<<timer.elapsedTime_m()<<"ms, mask = "<<std::hex<<_shadowedScene->getCastsShadowTraversalMask()<<std::endl;
+
+        if (clsb._bb.xMin()>-1.0f || clsb._bb.xMax()<1.0f || clsb._bb.yMin()>-1.0f || clsb._bb.yMax()<1.0f)
+        {
+            // OSG_NOTICE<<"Need to clamp projection matrix"<<std::endl;
+
+#if 1
+            double xMid = (clsb._bb.xMin()+clsb._bb.xMax())*0.5f;
+            double xRange = clsb._bb.xMax()-clsb._bb.xMin();
+#else
+            double xMid = 0.0;
+            double xRange = 2.0;
+#endif
+            double yMid = (clsb._bb.yMin()+clsb._bb.yMax())*0.5f;
+            double yRange = (clsb._bb.yMax()-clsb._bb.yMin());
+
+            // OSG_NOTICE<<"  xMid="<<xMid<<", yMid="<<yMid<<", xRange="<<xRange<<", yRange="<<yRange<<std::endl;
+
+            projectionMatrix =
+                projectionMatrix *
+                osg::Matrixd::translate(osg::Vec3d(-xMid,-yMid,0.0)) *
+                osg::Matrixd::scale(osg::Vec3d(2.0/xRange, 2.0/yRange,1.0));
+
+        }
+
+    }
+
+    return true;
+}
+
 bool ViewDependentShadowMap::selectActiveLights(osgUtil::CullVisitor* cv, ViewDependentData* vdd) const
 {
     OSG_INFO<<"selectActiveLights"<<std::endl;
@@ -1238,7 +1677,12 @@ void ViewDependentShadowMap::createShaders()
             _program = new osg::Program;
 
             //osg::ref_ptr<osg::Shader> fragment_shader = new osg::Shader(osg::Shader::FRAGMENT, fragmentShaderSource_noBaseTexture);
-            if (settings->getNumShadowMapsPerLight()==2)
+            if (settings->getNumShadowMapsPerLight()>1 && settings->getMultipleShadowMapHint()==ShadowSettings::CASCADED)
+            {
+                unsigned int numShadowMaps = osg::minimum(settings->getNumShadowMapsPerLight(), 4u);
+                _program->addShader(new osg::Shader(osg::Shader::FRAGMENT, createFragmentShaderSource_withBaseTexture_cascadedShadowMaps(numShadowMaps)));
+            }
+            else if (settings->getNumShadowMapsPerLight()==2)
             {
                 _program->addShader(new osg::Shader(osg::Shader::FRAGMENT, fragmentShaderSource_withBaseTexture_twoShadowMaps));
             }
@@ -1963,6 +2407,80 @@ struct RenderLeafBounds
     double min_z, max_z;
 };
 
+void ViewDependentShadowMap::setUpStaticShadowMap(ShadowData& sd, LightData& positionedLight, osg::Matrixd& projectionMatrix, osg::Matrixd& viewMatrix)
+{
+    if (!sd._staticShadowMap)
+    {
+        sd._staticShadowMap = new StaticShadowMap(sd._viewDependentData);
+
+        // cull the static shadow casters against the camera frustum alone, the static shadow map outliving the current view.
+        osg::Polytope polytope;
+        sd._staticShadowMap->_camera->setCullCallback(new VDSMCameraCullCallback(this, polytope));
+    }
+
+    StaticShadowMap& ssm = *sd._staticShadowMap;
+    ssm._active = true;
+
+    double margin = 1.0+getShadowedScene()->getShadowSettings()->getStaticShadowMapMargin();
+
+    // the static shadow map can be reused as long as the light keeps its direction and the light space frustum
+    // computed for this frame lies within the one it was rendered with, and is still more than half as large
+    // across as when it was rendered, so that zooming in doesn't leave the static shadows at a fraction of the resolution.
+    bool reuse = ssm._valid && (ssm._lightDir-positionedLight.lightDir).length2()<1e-10;
+    if (reuse)
+    {
+        osg::Matrixd clipToStaticClip = osg::Matrixd::inverse(viewMatrix*projectionMatrix) * ssm._viewMatrix * ssm._projectionMatrix;
+        double limit = 1.0+1e-6;
+        osg::BoundingBoxd bb;
+        for(unsigned int i=0; i<8 && reuse; ++i)
+        {
+            osg::Vec3d corner((i&1) ? 1.0 : -1.0, (i&2) ? 1.0 : -1.0, (i&4) ? 1.0 : -1.0);
+            corner = corner * clipToStaticClip;
+            reuse = fabs(corner.x())<=limit && fabs(corner.y())<=limit && fabs(corner.z())<=limit;
+            bb.expandBy(corner);
+        }
+
+        // the static shadow map spans 2.0 across in its clip space, of which 2.0/margin was needed when it was rendered
+        if (reuse && osg::maximum(bb.xMax()-bb.xMin(), bb.yMax()-bb.yMin())<1.0/margin)
+        {
+            OSG_INFO<<"Static shadow map much larger than needed"<<std::endl;
+            reuse = false;
+        }
+    }
+
+    if (reuse)
+    {
+        OSG_INFO<<"Reusing static shadow map"<<std::endl;
+
+        projectionMatrix = ssm._projectionMatrix;
+        viewMatrix = ssm._viewMatrix;
+        ssm._refresh = false;
+        return;
+    }
+
+    // enlarge the light space frustum, keeping its near plane on the bounding sphere of the scene, so that the view
+    // can move a little before the static shadow casters have to be rendered again.
+    double left, right, bottom, top, zNear, zFar;
+    if (projectionMatrix.getOrtho(left, right, bottom, top, zNear, zFar))
+    {
+        double xMid = (left+right)*0.5, xHalfRange = (right-left)*0.5*margin;
+        double yMid = (bottom+top)*0.5, yHalfRange = (top-bottom)*0.5*margin;
+        zFar = zNear + (zFar-zNear)*margin;
+        projectionMatrix.makeOrtho(xMid-xHalfRange, xMid+xHalfRange, yMid-yHalfRange, yMid+yHalfRange, zNear, zFar);
+    }
+
+    OSG_INFO<<"Refreshing static shadow map"<<std::endl;
+
+    ssm._valid = true;
+    ssm._refresh = true;
+    ssm._lightDir = positionedLight.lightDir;
+    ssm._viewMatrix = viewMatrix;
+    ssm._projectionMatrix = projectionMatrix;
+
+    ssm._camera->setViewMatrix(viewMatrix);
+    ssm._camera->setProjectionMatrix(projectionMatrix);
+}
+
 bool ViewDependentShadowMap::adjustPerspectiveShadowMapCameraSettings(osgUtil::RenderStage* renderStage, Frustum& frustum, LightData& /*positionedLight*/, osg::Camera* camera)
 {
     const ShadowSettings* settings = getShadowedScene()->getShadowSettings();
@@ -2340,6 +2858,168 @@ void ViewDependentShadowMap::cullShadowCastingScene(osgUtil::CullVisitor* cv, os
     return;
 }
 
+// set up the CullVisitor of a shadow map as osgUtil::SceneView does for its own, but continuing from where cv is.
+template<class T>
+static osgUtil::CullVisitor* setUpShadowCastingCullVisitor(T& owner, osgUtil::CullVisitor* cv, osgUtil::RenderStage* currentStage,
+                                                           const std::vector<osg::StateSet*>& statesets, osg::StateSet* shadowCastingStateSet,
+                                                           ShadowSettings::StaticShadowCastersHint staticShadowCastersHint,
+                                                           ShadowCasterCullVisitor::ShadowCasters shadowCasters, unsigned int traversalMask)
+{
+    // shadow casters told apart by their DataVariance need a ShadowCasterCullVisitor, which doesn't otherwise apply.
+    bool filterByDataVariance = staticShadowCastersHint==ShadowSettings::STATIC_SHADOW_CASTERS_BY_DATA_VARIANCE;
+    ShadowCasterCullVisitor* scv = dynamic_cast<ShadowCasterCullVisitor*>(owner._cullVisitor.get());
+    if (!owner._cullVisitor || (scv!=0)!=filterByDataVariance)
+    {
+        if (filterByDataVariance) owner._cullVisitor = scv = new ShadowCasterCullVisitor(*cv, shadowCasters);
+        else owner._cullVisitor = cv->clone();
+    }
+    if (!owner._stateGraph) owner._stateGraph = new osgUtil::StateGraph;
+    if (!owner._renderStage) owner._renderStage = new osgUtil::RenderStage;
+
+    if (scv) scv->setShadowCasters(shadowCasters);
+
+    osgUtil::CullVisitor* cullVisitor = owner._cullVisitor.get();
+    cullVisitor->reset();
+    cullVisitor->setFrameStamp(const_cast<osg::FrameStamp*>(cv->getFrameStamp()));
+    cullVisitor->setTraversalNumber(cv->getTraversalNumber());
+    cullVisitor->setTraversalMask(traversalMask);
+    cullVisitor->setCullSettings(*cv);
+    cullVisitor->setDatabaseRequestHandler(cv->getDatabaseRequestHandler());
+    cullVisitor->setImageRequestHandler(cv->getImageRequestHandler());
+    cullVisitor->setRenderInfo(cv->getRenderInfo());
+
+    owner._stateGraph->clean();
+    owner._renderStage->reset();
+    owner._renderStage->setDrawBuffer(currentStage->getDrawBuffer(), currentStage->getDrawBufferApplyMask());
+    owner._renderStage->setReadBuffer(currentStage->getReadBuffer(), currentStage->getReadBufferApplyMask());
+    owner._renderStage->setClearColor(currentStage->getClearColor());
+    owner._renderStage->setColorMask(currentStage->getColorMask());
+    owner._renderStage->setViewport(currentStage->getViewport());
+
+    cullVisitor->setStateGraph(owner._stateGraph.get());
+    cullVisitor->setRenderStage(owner._renderStage.get());
+
+    cullVisitor->pushViewport(cv->getViewport());
+    cullVisitor->pushProjectionMatrix(cv->getProjectionMatrix());
+    cullVisitor->pushModelViewMatrix(cv->getModelViewMatrix(), osg::Transform::ABSOLUTE_RF);
+
+    for(std::vector<osg::StateSet*>::const_iterator ss_itr = statesets.begin();
+        ss_itr != statesets.end();
+        ++ss_itr)
+    {
+        cullVisitor->pushStateSet(*ss_itr);
+    }
+    cullVisitor->pushStateSet(shadowCastingStateSet);
+
+    return cullVisitor;
+}
+
+void ViewDependentShadowMap::cullShadowCastingScenes(osgUtil::CullVisitor* cv, ShadowDataList& shadowDataList) const
+{
+    OSG_INFO<<"cullShadowCastingScenes()"<<std::endl;
+
+    bool staticShadowMapsActive = false;
+    for(ShadowDataList::iterator itr = shadowDataList.begin();
+        itr != shadowDataList.end() && !staticShadowMapsActive;
+        ++itr)
+    {
+        staticShadowMapsActive = (*itr)->_staticShadowMap.valid() && (*itr)->_staticShadowMap->_active;
+    }
+
+    if (!staticShadowMapsActive && (osgUtil::WorkerThreadPool::instance()->getNumThreads()<=1 || shadowDataList.size()<=1))
+    {
+        for(ShadowDataList::iterator itr = shadowDataList.begin();
+            itr != shadowDataList.end();
+            ++itr)
+        {
+            cv->pushStateSet(_shadowCastingStateSet.get());
+
+            cullShadowCastingScene(cv, (*itr)->_camera.get());
+
+            cv->popStateSet();
+        }
+        return;
+    }
+
+    // compute the bounding volumes up front so the concurrent traversals only read the scene graph.
+    _shadowedScene->getBound();
+
+    // the state inherited from the scene graph above the ShadowedScene, from the root down.
+    std::vector<osg::StateSet*> statesets;
+    for(osgUtil::StateGraph* sg = cv->getCurrentStateGraph(); sg; sg = sg->_parent)
+    {
+        if (sg->getStateSet()) statesets.insert(statesets.begin(), const_cast<osg::StateSet*>(sg->getStateSet()));
+    }
+
+    osgUtil::RenderStage* currentStage = cv->getCurrentRenderBin()->getStage();
+
+    const ShadowSettings* settings = getShadowedScene()->getShadowSettings();
+    ShadowSettings::StaticShadowCastersHint staticShadowCastersHint = settings->getStaticShadowCastersHint();
+
+    // shadow casters told apart by node mask are culled with the static or the dynamic bits of the traversal mask.
+    unsigned int traversalMask = cv->getTraversalMask();
+    unsigned int staticTraversalMask = traversalMask;
+    unsigned int dynamicTraversalMask = traversalMask;
+    if (staticShadowCastersHint==ShadowSettings::STATIC_SHADOW_CASTERS_BY_NODE_MASK)
+    {
+        staticTraversalMask = traversalMask & settings->getStaticCastsShadowTraversalMask();
+        dynamicTraversalMask = traversalMask & ~(settings->getStaticCastsShadowTraversalMask());
+    }
+
+    CullShadowCastingScenesOperation::CullVisitorCameraList cullVisitorCameraList;
+    for(ShadowDataList::iterator itr = shadowDataList.begin();
+        itr != shadowDataList.end();
+        ++itr)
+    {
+        ShadowData& sd = **itr;
+        StaticShadowMap* ssm = (sd._staticShadowMap.valid() && sd._staticShadowMap->_active) ? sd._staticShadowMap.get() : 0;
+
+        if (ssm && ssm->_refresh)
+        {
+            osgUtil::CullVisitor* cullVisitor = setUpShadowCastingCullVisitor(*ssm, cv, currentStage, statesets, _shadowCastingStateSet.get(),
+                                                                               staticShadowCastersHint, ShadowCasterCullVisitor::STATIC_SHADOW_CASTERS, staticTraversalMask);
+            cullVisitorCameraList.push_back(CullShadowCastingScenesOperation::CullVisitorCameraList::value_type(cullVisitor, ssm->_camera.get()));
+        }
+
+        osgUtil::CullVisitor* cullVisitor = setUpShadowCastingCullVisitor(sd, cv, currentStage, statesets, _shadowCastingStateSet.get(),
+                                                                           ssm ? staticShadowCastersHint : ShadowSettings::NO_STATIC_SHADOW_CASTERS,
+                                                                           ShadowCasterCullVisitor::DYNAMIC_SHADOW_CASTERS,
+                                                                           ssm ? dynamicTraversalMask : traversalMask);
+        cullVisitorCameraList.push_back(CullShadowCastingScenesOperation::CullVisitorCameraList::value_type(cullVisitor, sd._camera.get()));
+    }
+
+    CullShadowCastingScenesOperation operation(this, cullVisitorCameraList);
+    osgUtil::WorkerThreadPool::instance()->run(operation, cullVisitorCameraList.size(), 1);
+
+    for(CullShadowCastingScenesOperation::CullVisitorCameraList::iterator itr = cullVisitorCameraList.begin();
+        itr != cullVisitorCameraList.end();
+        ++itr)
+    {
+        osgUtil::CullVisitor* cullVisitor = itr->first;
+        osg::Camera* camera = itr->second;
+
+        cullVisitor->popStateSet();
+        for(unsigned int i=0; i<statesets.size(); ++i)
+        {
+            cullVisitor->popStateSet();
+        }
+
+        cullVisitor->popModelViewMatrix();
+        cullVisitor->popProjectionMatrix();
+        cullVisitor->popViewport();
+
+        // move the render stage of the camera from its CullVisitor to the current render stage,
+        // as cullShadowCastingScene(cv, camera) would have placed it.
+        VDSMCameraCullCallback* vdsmCallback = dynamic_cast<VDSMCameraCullCallback*>(camera->getCullCallback());
+        osgUtil::RenderStage* renderStage = vdsmCallback ? vdsmCallback->getRenderStage() : 0;
+        if (renderStage)
+        {
+            renderStage->setInheritedPositionalStateContainer(currentStage->getPositionalStateContainer());
+            currentStage->addPreRenderStage(renderStage, camera->getRenderOrderNum());
+        }
+    }
+}
+
 osg::StateSet* ViewDependentShadowMap::selectStateSetForRenderingShadow(ViewDependentData& vdd) const
 {
     OSG_INFO<<"   selectStateSetForRenderingShadow() "<<vdd.getStateSet()<<std::endl;
@@ -2360,6 +3040,11 @@ osg::StateSet* ViewDependentShadowMap::selectStateSetForRenderingShadow(ViewDepe
         stateset->addUniform(itr->get());
     }
 
+    if (vdd._splitDistancesUniform.valid())
+    {
+        stateset->addUniform(vdd._splitDistancesUniform.get());
+    }
+
     if (_program.valid())
     {
         stateset->setAttribute(_program.get());
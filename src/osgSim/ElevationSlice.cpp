@@ -20,9 +20,14 @@
 
 #include <osg/Notify>
 #include <osgUtil/PlaneIntersector>
+#include <osgUtil/WorkerThreadPool>
+
+#include "LineSegmentBatch.h"
 
 #include <osgDB/WriteFile>
 
+#include <float.h>
+
 using namespace osgSim;
 
 namespace ElevationSliceUtils
@@ -1155,94 +1160,120 @@ struct LineConstructor
 
 };
 
-}
 
-ElevationSlice::ElevationSlice()
+// remove the points of a profile that are within heightTolerance of the line between the points kept on either side of them.
+void simplifyProfile(ElevationSlice::Vec3dList& intersections, ElevationSlice::DistanceHeightList& distanceHeightIntersections, double heightTolerance)
 {
-    setDatabaseCacheReadCallback(new DatabaseCacheReadCallback);
-}
+    if (distanceHeightIntersections.size()<3) return;
 
-void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
-{
-    osg::CoordinateSystemNode* csn = dynamic_cast<osg::CoordinateSystemNode*>(scene);
-    osg::EllipsoidModel* em = csn ? csn->getEllipsoidModel() : 0;
-
-
-    osg::Plane plane;
-    osg::Polytope boundingPolytope;
+    std::vector<bool> keep(distanceHeightIntersections.size(), false);
+    keep.front() = true;
+    keep.back() = true;
 
-    if (em)
+    typedef std::pair<unsigned int, unsigned int> Range;
+    std::vector<Range> ranges;
+    ranges.push_back(Range(0, distanceHeightIntersections.size()-1));
+    while(!ranges.empty())
     {
+        Range range = ranges.back();
+        ranges.pop_back();
 
-        osg::Vec3d start_upVector = em->computeLocalUpVector(_startPoint.x(), _startPoint.y(), _startPoint.z());
-        osg::Vec3d end_upVector = em->computeLocalUpVector(_endPoint.x(), _endPoint.y(), _endPoint.z());
+        const ElevationSlice::DistanceHeight& first = distanceHeightIntersections[range.first];
+        const ElevationSlice::DistanceHeight& last = distanceHeightIntersections[range.second];
+        double deltaDistance = last.first - first.first;
 
-        double start_latitude, start_longitude, start_height;
-        em->convertXYZToLatLongHeight(_startPoint.x(), _startPoint.y(), _startPoint.z(),
-                                      start_latitude, start_longitude, start_height);
+        unsigned int furthest = range.first;
+        double maxDeltaHeight = heightTolerance;
+        for(unsigned int i=range.first+1; i<range.second; ++i)
+        {
+            const ElevationSlice::DistanceHeight& dh = distanceHeightIntersections[i];
 
-        OSG_NOTICE<<"start_lat = "<<start_latitude<<" start_longitude = "<<start_longitude<<" start_height = "<<start_height<<std::endl;
+            // points at the distance of the first or last point, as on a cliff or a gap in the profile, are always kept
+            double deltaHeight = (dh.first<=first.first || dh.first>=last.first) ? DBL_MAX :
+                                 osg::absolute(dh.second - (first.second + (last.second-first.second)*(dh.first-first.first)/deltaDistance));
+            if (deltaHeight>maxDeltaHeight)
+            {
+                maxDeltaHeight = deltaHeight;
+                furthest = i;
+            }
+        }
 
-        double end_latitude, end_longitude, end_height;
-        em->convertXYZToLatLongHeight(_endPoint.x(), _endPoint.y(), _endPoint.z(),
-                                      end_latitude, end_longitude, end_height);
+        if (furthest!=range.first)
+        {
+            keep[furthest] = true;
+            ranges.push_back(Range(range.first, furthest));
+            ranges.push_back(Range(furthest, range.second));
+        }
+    }
 
-        OSG_NOTICE<<"end_lat = "<<end_latitude<<" end_longitude = "<<end_longitude<<" end_height = "<<end_height<<std::endl;
+    unsigned int numKept = 0;
+    for(unsigned int i=0; i<keep.size(); ++i)
+    {
+        if (keep[i])
+        {
+            intersections[numKept] = intersections[i];
+            distanceHeightIntersections[numKept] = distanceHeightIntersections[i];
+            ++numKept;
+        }
+    }
+    intersections.resize(numKept);
+    distanceHeightIntersections.resize(numKept);
+}
 
-        // set up the main intersection plane
-        osg::Vec3d planeNormal = (_endPoint - _startPoint) ^ start_upVector;
-        planeNormal.normalize();
-        plane.set( planeNormal, _startPoint );
+// part of the slice between two planes across it, with its own results.
+struct SliceSpan
+{
+    osg::Polytope                       boundingPolytope;
+    ElevationSlice::Vec3dList           intersections;
+    ElevationSlice::DistanceHeightList  distanceHeightIntersections;
+};
 
-        // set up the start cut off plane
-        osg::Vec3d startPlaneNormal = start_upVector ^ planeNormal;
-        startPlaneNormal.normalize();
-        boundingPolytope.add( osg::Plane(startPlaneNormal, _startPoint) );
+typedef std::vector<SliceSpan> SliceSpans;
 
-        // set up the end cut off plane
-        osg::Vec3d endPlaneNormal = planeNormal ^ end_upVector;
-        endPlaneNormal.normalize();
-        boundingPolytope.add( osg::Plane(endPlaneNormal, _endPoint) );
-    }
-    else
+// intersect spans of the slice with the scene and merge their intersections into profiles.
+class ComputeSpansOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+public:
+
+    ComputeSpansOperation(SliceSpans& spans, osg::Node* scene, osg::Node::NodeMask traversalMask, DatabaseCacheReadCallback* dcrc,
+                          const osg::Plane& plane, osg::EllipsoidModel* em, const DistanceHeightCalculator* dhc, const osg::Vec3d& startPoint, double heightTolerance):
+        _spans(spans),
+        _scene(scene),
+        _traversalMask(traversalMask),
+        _dcrc(dcrc),
+        _plane(plane),
+        _em(em),
+        _dhc(dhc),
+        _startPoint(startPoint),
+        _heightTolerance(heightTolerance) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
     {
-        osg::Vec3d upVector (0.0, 0.0, 1.0);
-
-        // set up the main intersection plane
-        osg::Vec3d planeNormal = (_endPoint - _startPoint) ^ upVector;
-        planeNormal.normalize();
-        plane.set( planeNormal, _startPoint );
-
-        // set up the start cut off plane
-        osg::Vec3d startPlaneNormal = upVector ^ planeNormal;
-        startPlaneNormal.normalize();
-        boundingPolytope.add( osg::Plane(startPlaneNormal, _startPoint) );
-
-        // set up the end cut off plane
-        osg::Vec3d endPlaneNormal = planeNormal ^ upVector;
-        endPlaneNormal.normalize();
-        boundingPolytope.add( osg::Plane(endPlaneNormal, _endPoint) );
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            computeSpan(_spans[i]);
+        }
     }
 
-    osg::ref_ptr<osgUtil::PlaneIntersector> intersector = new osgUtil::PlaneIntersector(plane, boundingPolytope);
+    void computeSpan(SliceSpan& span)
+    {
+        osg::ref_ptr<osgUtil::PlaneIntersector> intersector = new osgUtil::PlaneIntersector(_plane, span.boundingPolytope);
 
+        intersector->setRecordHeightsAsAttributes(true);
+        intersector->setEllipsoidModel(_em);
 
-    intersector->setRecordHeightsAsAttributes(true);
-    intersector->setEllipsoidModel(em);
+        osg::ref_ptr<TraversalReadCallback> readCallback = _dcrc ? new TraversalReadCallback(_dcrc) : 0;
+        osgUtil::IntersectionVisitor intersectionVisitor(intersector.get(), readCallback.get());
+        intersectionVisitor.setTraversalMask(_traversalMask);
 
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersector.get() );
+        _scene->accept(intersectionVisitor);
 
-    scene->accept(_intersectionVisitor);
+        osgUtil::PlaneIntersector::Intersections& intersections = intersector->getIntersections();
 
-    osgUtil::PlaneIntersector::Intersections& intersections = intersector->getIntersections();
+        typedef osgUtil::PlaneIntersector::Intersection::Polyline Polyline;
+        typedef osgUtil::PlaneIntersector::Intersection::Attributes Attributes;
 
-    typedef osgUtil::PlaneIntersector::Intersection::Polyline Polyline;
-    typedef osgUtil::PlaneIntersector::Intersection::Attributes Attributes;
-
-    if (!intersections.empty())
-    {
+        if (intersections.empty()) return;
 
         osgUtil::PlaneIntersector::Intersections::iterator itr;
         for(itr = intersections.begin();
@@ -1253,7 +1284,6 @@ void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask
 
             if (intersection.matrix.valid())
             {
-                // OSG_NOTICE<<"  transforming "<<std::endl;
                 // transform points on polyline
                 for(Polyline::iterator pitr = intersection.polyline.begin();
                     pitr != intersection.polyline.end();
@@ -1267,49 +1297,12 @@ void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask
             }
         }
 
-#if 0
-        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        LineConstructor constructor;
+        constructor._plane = _plane;
+        constructor._em = _em;
 
-        for(itr = intersections.begin();
-            itr != intersections.end();
-            ++itr)
+        if (_dhc)
         {
-
-            osgUtil::PlaneIntersector::Intersection& intersection = *itr;
-            osg::Geometry* geometry = new osg::Geometry;
-
-            osg::Vec3Array* vertices = new osg::Vec3Array;
-            vertices->reserve(intersection.polyline.size());
-            for(Polyline::iterator pitr = intersection.polyline.begin();
-                pitr != intersection.polyline.end();
-                ++pitr)
-            {
-                vertices->push_back(*pitr);
-            }
-
-            geometry->setVertexArray( vertices );
-            geometry->addPrimitiveSet( new osg::DrawArrays(GL_LINE_STRIP, 0, vertices->size()) );
-
-            osg::Vec4Array* colours = new osg::Vec4Array;
-            colours->push_back( osg::Vec4(1.0f,1.0f,1.0f,1.0f) );
-
-            geometry->setColorArray( colours );
-
-            geode->addDrawable( geometry );
-            geode->getOrCreateStateSet()->setMode( GL_LIGHTING, osg::StateAttribute::OFF );
-        }
-
-        osgDB::writeNodeFile(*geode, "raw.osg");
-#endif
-
-        ElevationSliceUtils::LineConstructor constructor;
-        constructor._plane = plane;
-        constructor._em = em;
-
-        if (em)
-        {
-            ElevationSliceUtils::DistanceHeightCalculator dhc(em, _startPoint, _endPoint);
-
             // convert into distance/height
             for(itr = intersections.begin();
                 itr != intersections.end();
@@ -1326,19 +1319,15 @@ void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask
                 {
                     const osg::Vec3d& v = *pitr;
                     double distance, height;
-                    dhc.computeDistanceHeight(v, distance, height);
+                    _dhc->computeDistanceHeight(v, distance, height);
 
                     double pi_height = *aitr;
 
-                    // OSG_NOTICE<<"computed height = "<<height<<" PI height = "<<pi_height<<std::endl;
-
                     constructor.add( distance, pi_height, v);
 
                 }
                 constructor.endline();
             }
-
-
         }
         else
         {
@@ -1362,11 +1351,7 @@ void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask
             }
         }
 
-        // copy final results
-        _intersections.clear();
-        _distanceHeightIntersections.clear();
-
-        // constructor.report();
+        if (constructor._segments.empty()) return;
 
         unsigned int numOverlapping = constructor.totalNumOverlapping();
 
@@ -1375,50 +1360,129 @@ void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask
             unsigned int previousNumOverlapping = numOverlapping;
 
             constructor.pruneOverlappingSegments();
-            // constructor.report();
 
             numOverlapping = constructor.totalNumOverlapping();
             if (previousNumOverlapping == numOverlapping) break;
         }
 
-        constructor.copyPoints(_intersections, _distanceHeightIntersections);
+        constructor.copyPoints(span.intersections, span.distanceHeightIntersections);
 
-#if 0
-        {
-            osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        if (_heightTolerance>0.0) simplifyProfile(span.intersections, span.distanceHeightIntersections, _heightTolerance);
+    }
 
-            osg::Geometry* geometry = new osg::Geometry;
+protected:
+
+    SliceSpans&                                     _spans;
+    osg::Node*                                      _scene;
+    osg::Node::NodeMask                             _traversalMask;
+    DatabaseCacheReadCallback*                      _dcrc;
+    osg::Plane                                      _plane;
+    osg::EllipsoidModel*                            _em;
+    const DistanceHeightCalculator*                 _dhc;
+    osg::Vec3d                                      _startPoint;
+    double                                          _heightTolerance;
+};
 
-            osg::Vec3Array* vertices = new osg::Vec3Array;
-            vertices->reserve(_intersections.size());
-            for(Vec3dList::iterator pitr = _intersections.begin();
-                pitr != _intersections.end();
-                ++pitr)
-            {
-                vertices->push_back(*pitr);
-            }
+}
 
-            geometry->setVertexArray( vertices );
-            geometry->addPrimitiveSet( new osg::DrawArrays(GL_LINE_STRIP, 0, _intersections.size()) );
+ElevationSlice::ElevationSlice():
+    _numSpans(0),
+    _heightTolerance(0.0)
+{
+    setDatabaseCacheReadCallback(new DatabaseCacheReadCallback);
+}
+
+void ElevationSlice::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
+{
+    osg::CoordinateSystemNode* csn = dynamic_cast<osg::CoordinateSystemNode*>(scene);
+    osg::EllipsoidModel* em = csn ? csn->getEllipsoidModel() : 0;
 
-            osg::Vec4Array* colours = new osg::Vec4Array;
-            colours->push_back( osg::Vec4(1.0f,0.5f,0.5f,1.0f) );
+    _intersections.clear();
+    _distanceHeightIntersections.clear();
 
-            geometry->setColorArray( colours );
+    unsigned int numSpans = _numSpans;
+    if (numSpans==0) numSpans = osgUtil::WorkerThreadPool::instance()->getNumThreads();
 
-            geode->addDrawable( geometry );
-            geode->getOrCreateStateSet()->setMode( GL_LIGHTING, osg::StateAttribute::OFF );
+    // the slice is cut into spans by planes containing the local up vector at regular intervals along it,
+    // adjacent spans share the plane between them so none of the slice is left out or intersected twice.
+    osg::Vec3d upVector (0.0, 0.0, 1.0);
+    osg::Plane plane;
 
-            osgDB::writeNodeFile(*geode, "processed.osg");
-        }
-#endif
+    if (em)
+    {
+        upVector = em->computeLocalUpVector(_startPoint.x(), _startPoint.y(), _startPoint.z());
+
+        double start_latitude, start_longitude, start_height;
+        em->convertXYZToLatLongHeight(_startPoint.x(), _startPoint.y(), _startPoint.z(),
+                                      start_latitude, start_longitude, start_height);
+
+        OSG_DEBUG<<"start_lat = "<<start_latitude<<" start_longitude = "<<start_longitude<<" start_height = "<<start_height<<std::endl;
+
+        double end_latitude, end_longitude, end_height;
+        em->convertXYZToLatLongHeight(_endPoint.x(), _endPoint.y(), _endPoint.z(),
+                                      end_latitude, end_longitude, end_height);
 
+        OSG_DEBUG<<"end_lat = "<<end_latitude<<" end_longitude = "<<end_longitude<<" end_height = "<<end_height<<std::endl;
     }
-    else
+
+    osg::Vec3d planeNormal = (_endPoint - _startPoint) ^ upVector;
+    planeNormal.normalize();
+    plane.set( planeNormal, _startPoint );
+
+    std::vector<osg::Plane> spanPlanes;
+    for(unsigned int i=0; i<=numSpans; ++i)
     {
-        OSG_NOTICE<<"No intersections found."<<std::endl;
+        osg::Vec3d point = (i==numSpans) ? _endPoint : _startPoint + (_endPoint - _startPoint)*(double(i)/double(numSpans));
+        osg::Vec3d pointUpVector = em ? em->computeLocalUpVector(point.x(), point.y(), point.z()) : upVector;
+
+        osg::Vec3d spanPlaneNormal = pointUpVector ^ planeNormal;
+        spanPlaneNormal.normalize();
+        spanPlanes.push_back( osg::Plane(spanPlaneNormal, point) );
+    }
+
+    ElevationSliceUtils::SliceSpans spans(numSpans);
+    for(unsigned int i=0; i<numSpans; ++i)
+    {
+        osg::Plane endPlane = spanPlanes[i+1];
+        endPlane.flip();
+
+        spans[i].boundingPolytope.add( spanPlanes[i] );
+        spans[i].boundingPolytope.add( endPlane );
     }
 
+    // compute the bounding volumes up front so the concurrent traversals only read the scene graph.
+    scene->getBound();
+
+    ElevationSliceUtils::DistanceHeightCalculator* dhc = em ? new ElevationSliceUtils::DistanceHeightCalculator(em, _startPoint, _endPoint) : 0;
+
+    ElevationSliceUtils::ComputeSpansOperation operation(spans, scene, traversalMask, _dcrc.get(), plane, em, dhc, _startPoint, _heightTolerance);
+    osgUtil::WorkerThreadPool::instance()->run(operation, numSpans, 1);
+
+    delete dhc;
+
+    // join up the profiles of the spans, leaving out the points shared by adjacent spans
+    for(ElevationSliceUtils::SliceSpans::iterator sitr = spans.begin();
+        sitr != spans.end();
+        ++sitr)
+    {
+        for(unsigned int i=0; i<sitr->intersections.size(); ++i)
+        {
+            const DistanceHeight& dh = sitr->distanceHeightIntersections[i];
+            if (i==0 && !_distanceHeightIntersections.empty())
+            {
+                const DistanceHeight& previous = _distanceHeightIntersections.back();
+                if (osg::absolute(dh.first-previous.first)<1e-3 && osg::absolute(dh.second-previous.second)<1e-3) continue;
+            }
+
+            _intersections.push_back(sitr->intersections[i]);
+            _distanceHeightIntersections.push_back(dh);
+        }
+    }
+
+    if (_intersections.empty())
+    {
+        OSG_INFO<<"No intersections found."<<std::endl;
+    }
 }
 
 ElevationSlice::Vec3dList ElevationSlice::computeElevationSlice(osg::Node* scene, const osg::Vec3d& startPoint, const osg::Vec3d& endPoint, osg::Node::NodeMask traversalMask)
@@ -15,7 +15,8 @@
 #include <osgSim/HeightAboveTerrain>
 
 #include <osg/Notify>
-#include <osgUtil/LineSegmentIntersector>
+
+#include "LineSegmentBatch.h"
 
 using namespace osgSim;
 
@@ -43,7 +44,9 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
     osg::CoordinateSystemNode* csn = dynamic_cast<osg::CoordinateSystemNode*>(scene);
     osg::EllipsoidModel* em = csn ? csn->getEllipsoidModel() : 0;
 
-    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    // only the nearest intersection below each point is needed.
+    LineSegmentBatch batch(_dcrc.get(), true);
+    batch.reserve(_HATList.size());
 
     for(HATList::iterator itr = _HATList.begin();
         itr != _HATList.end();
@@ -61,10 +64,9 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
 
             itr->_hat = height;
 
-            OSG_NOTICE<<"lat = "<<latitude<<" longitude = "<<longitude<<" height = "<<height<<std::endl;
+            OSG_DEBUG<<"lat = "<<latitude<<" longitude = "<<longitude<<" height = "<<height<<std::endl;
 
-            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(start, end);
-            intersectorGroup->addIntersector( intersector.get() );
+            batch.addSegment(start, end);
         }
         else
         {
@@ -76,34 +78,18 @@ void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeM
 
             itr->_hat = height;
 
-            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector( start, end);
-            intersectorGroup->addIntersector( intersector.get() );
+            batch.addSegment(start, end);
         }
     }
 
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersectorGroup.get() );
-
-    scene->accept(_intersectionVisitor);
+    batch.computeIntersections(scene, traversalMask);
 
-    unsigned int index = 0;
-    osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
-    for(osgUtil::IntersectorGroup::Intersectors::iterator intersector_itr = intersectors.begin();
-        intersector_itr != intersectors.end();
-        ++intersector_itr, ++index)
+    for(unsigned int index=0; index<_HATList.size(); ++index)
     {
-        osgUtil::LineSegmentIntersector* lsi = dynamic_cast<osgUtil::LineSegmentIntersector*>(intersector_itr->get());
-        if (lsi)
+        const LineSegmentBatch::Intersections& intersections = batch.getIntersections(index);
+        if (!intersections.empty())
         {
-            osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
-            if (!intersections.empty())
-            {
-                const osgUtil::LineSegmentIntersector::Intersection& intersection = *intersections.begin();
-                osg::Vec3d intersectionPoint = intersection.matrix.valid() ? intersection.localIntersectionPoint * (*intersection.matrix) :
-                                               intersection.localIntersectionPoint;
-                _HATList[index]._hat = (_HATList[index]._point - intersectionPoint).length();
-            }
+            _HATList[index]._hat = (_HATList[index]._point - intersections.front()).length();
         }
     }
 
@@ -14,14 +14,44 @@
 #include <osgSim/LineOfSight>
 
 #include <osg/Notify>
+#include <osg/KdTree>
 #include <osgDB/ReadFile>
-#include <osgUtil/LineSegmentIntersector>
+#include <osgDB/Registry>
+
+#include <OpenThreads/Block>
+
+#include "LineSegmentBatch.h"
 
 using namespace osgSim;
 
+// tile being loaded by another thread.
+class DatabaseCacheReadCallback::PendingRead : public osg::Referenced
+{
+public:
+    PendingRead() {}
+
+    void wait() { _block.block(); }
+
+    void complete(osg::Node* node)
+    {
+        _node = node;
+        _block.release();
+    }
+
+    osg::Node* getNode() const { return _node.get(); }
+
+protected:
+
+    virtual ~PendingRead() {}
+
+    OpenThreads::Block      _block;
+    osg::ref_ptr<osg::Node> _node;
+};
+
 DatabaseCacheReadCallback::DatabaseCacheReadCallback()
 {
     _maxNumFilesToCache = 2000;
+    _buildKdTrees = true;
 }
 
 void DatabaseCacheReadCallback::clearDatabaseCache()
@@ -36,7 +66,14 @@ void DatabaseCacheReadCallback::pruneUnusedDatabaseCache()
 
 osg::Node* DatabaseCacheReadCallback::readNodeFile(const std::string& filename)
 {
-    // first check to see if file is already loaded.
+    return readRefNodeFile(filename).release();
+}
+
+osg::ref_ptr<osg::Node> DatabaseCacheReadCallback::readRefNodeFile(const std::string& filename)
+{
+    osg::ref_ptr<PendingRead> pendingRead;
+
+    // first check to see if file is already loaded, or being loaded by another thread.
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
@@ -45,13 +82,49 @@ osg::Node* DatabaseCacheReadCallback::readNodeFile(const std::string& filename)
         {
             OSG_INFO<<"Getting from cache "<<filename<<std::endl;
 
-            return itr->second.get();
+            // take the reference while locked, so another thread inserting a tile can't discard this one first.
+            return itr->second;
+        }
+
+        PendingReadMap::iterator pitr = _pendingReads.find(filename);
+        if (pitr != _pendingReads.end())
+        {
+            pendingRead = pitr->second;
+        }
+        else
+        {
+            _pendingReads[filename] = new PendingRead;
         }
     }
 
+    if (pendingRead.valid())
+    {
+        OSG_INFO<<"Waiting for "<<filename<<std::endl;
+
+        pendingRead->wait();
+
+        return pendingRead->getNode();
+    }
+
     // now load the file.
     osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(filename);
 
+    // prepare the tile for the intersection traversals, which may be run concurrently and so mustn't modify it.
+    if (node.valid())
+    {
+        if (_buildKdTrees)
+        {
+            osg::KdTreeBuilder* kdTreeBuilder = osgDB::Registry::instance()->getKdTreeBuilder();
+            if (kdTreeBuilder)
+            {
+                osg::ref_ptr<osg::KdTreeBuilder> builder = kdTreeBuilder->clone();
+                node->accept(*builder);
+            }
+        }
+
+        node->getBound();
+    }
+
     // insert into the cache.
     if (node.valid())
     {
@@ -84,7 +157,18 @@ osg::Node* DatabaseCacheReadCallback::readNodeFile(const std::string& filename)
         }
     }
 
-    return node.release();
+    // the file is now in the cache, so let the threads waiting for it carry on.
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+        PendingReadMap::iterator pitr = _pendingReads.find(filename);
+        pendingRead = pitr->second;
+        _pendingReads.erase(pitr);
+    }
+
+    pendingRead->complete(node.get());
+
+    return node;
 }
 
 LineOfSight::LineOfSight()
@@ -106,47 +190,22 @@ unsigned int LineOfSight::addLOS(const osg::Vec3d& start, const osg::Vec3d& end)
 
 void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
 {
-    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    LineSegmentBatch batch(_dcrc.get(), false);
+    batch.reserve(_LOSList.size());
 
     for(LOSList::iterator itr = _LOSList.begin();
         itr != _LOSList.end();
         ++itr)
     {
-        osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(itr->_start, itr->_end);
-        intersectorGroup->addIntersector( intersector.get() );
+        batch.addSegment(itr->_start, itr->_end);
     }
 
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersectorGroup.get() );
+    batch.computeIntersections(scene, traversalMask);
 
-    scene->accept(_intersectionVisitor);
-
-    unsigned int index = 0;
-    osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
-    for(osgUtil::IntersectorGroup::Intersectors::iterator intersector_itr = intersectors.begin();
-        intersector_itr != intersectors.end();
-        ++intersector_itr, ++index)
+    for(unsigned int index=0; index<_LOSList.size(); ++index)
     {
-        osgUtil::LineSegmentIntersector* lsi = dynamic_cast<osgUtil::LineSegmentIntersector*>(intersector_itr->get());
-        if (lsi)
-        {
-            Intersections& intersectionsLOS = _LOSList[index]._intersections;
-            _LOSList[index]._intersections.clear();
-
-            osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
-
-            for(osgUtil::LineSegmentIntersector::Intersections::iterator itr = intersections.begin();
-                itr != intersections.end();
-                ++itr)
-            {
-                const osgUtil::LineSegmentIntersector::Intersection& intersection = *itr;
-                if (intersection.matrix.valid()) intersectionsLOS.push_back( intersection.localIntersectionPoint * (*intersection.matrix) );
-                else intersectionsLOS.push_back( intersection.localIntersectionPoint  );
-            }
-        }
+        _LOSList[index]._intersections = batch.getIntersections(index);
     }
-
 }
 
 LineOfSight::Intersections LineOfSight::computeIntersections(osg::Node* scene, const osg::Vec3d& start, const osg::Vec3d& end, osg::Node::NodeMask traversalMask)
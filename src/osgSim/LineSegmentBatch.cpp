@@ -0,0 +1,190 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "LineSegmentBatch.h"
+
+#include <osgUtil/LineSegmentIntersector>
+#include <osgUtil/WorkerThreadPool>
+
+#include <algorithm>
+
+using namespace osgSim;
+
+namespace
+{
+
+// spread the lower 10 bits of v so that there are two zero bits between each of them.
+inline unsigned int spreadBits(unsigned int v)
+{
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v <<  8)) & 0x0300F00F;
+    v = (v | (v <<  4)) & 0x030C30C3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+inline unsigned int quantize(double v, double minimum, double scale)
+{
+    double q = (v-minimum)*scale;
+    return q<=0.0 ? 0u : (q>=1023.0 ? 1023u : static_cast<unsigned int>(q));
+}
+
+// intersect the segments of a block of the spatial order with the scene.
+class IntersectSegmentsOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+public:
+
+    struct Segment
+    {
+        const osg::Vec3d*                   start;
+        const osg::Vec3d*                   end;
+        LineSegmentBatch::Intersections*    intersections;
+    };
+
+    typedef std::vector<Segment> Segments;
+
+    IntersectSegmentsOperation(osg::Node* scene, osg::Node::NodeMask traversalMask,
+                               DatabaseCacheReadCallback* dcrc, bool nearestOnly):
+        _scene(scene),
+        _traversalMask(traversalMask),
+        _dcrc(dcrc),
+        _nearestOnly(nearestOnly) {}
+
+    Segments& getSegments() { return _segments; }
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(*_segments[i].start, *_segments[i].end);
+            if (_nearestOnly) intersector->setIntersectionLimit(osgUtil::Intersector::LIMIT_NEAREST);
+            intersectorGroup->addIntersector( intersector.get() );
+        }
+
+        osg::ref_ptr<TraversalReadCallback> readCallback = _dcrc ? new TraversalReadCallback(_dcrc) : 0;
+        osgUtil::IntersectionVisitor intersectionVisitor(intersectorGroup.get(), readCallback.get());
+        intersectionVisitor.setTraversalMask(_traversalMask);
+
+        _scene->accept(intersectionVisitor);
+
+        osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            LineSegmentBatch::Intersections& results = *_segments[i].intersections;
+            results.clear();
+
+            osgUtil::LineSegmentIntersector* lsi = static_cast<osgUtil::LineSegmentIntersector*>(intersectors[i-begin].get());
+            osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
+
+            for(osgUtil::LineSegmentIntersector::Intersections::iterator itr = intersections.begin();
+                itr != intersections.end();
+                ++itr)
+            {
+                const osgUtil::LineSegmentIntersector::Intersection& intersection = *itr;
+                if (intersection.matrix.valid()) results.push_back( intersection.localIntersectionPoint * (*intersection.matrix) );
+                else results.push_back( intersection.localIntersectionPoint  );
+
+                if (_nearestOnly) break;
+            }
+        }
+    }
+
+protected:
+
+    osg::Node*                                      _scene;
+    osg::Node::NodeMask                             _traversalMask;
+    DatabaseCacheReadCallback*                      _dcrc;
+    bool                                            _nearestOnly;
+    Segments                                        _segments;
+};
+
+}
+
+LineSegmentBatch::LineSegmentBatch(DatabaseCacheReadCallback* dcrc, bool nearestOnly):
+    _dcrc(dcrc),
+    _nearestOnly(nearestOnly)
+{
+}
+
+void LineSegmentBatch::reserve(unsigned int numSegments)
+{
+    _segments.reserve(numSegments);
+}
+
+unsigned int LineSegmentBatch::addSegment(const osg::Vec3d& start, const osg::Vec3d& end)
+{
+    unsigned int index = _segments.size();
+    _segments.push_back(Segment(start,end));
+    return index;
+}
+
+void LineSegmentBatch::computeSpatialOrder(std::vector<unsigned int>& order) const
+{
+    osg::BoundingBoxd bb;
+    for(Segments::const_iterator itr = _segments.begin();
+        itr != _segments.end();
+        ++itr)
+    {
+        bb.expandBy((itr->start+itr->end)*0.5);
+    }
+
+    double extent = osg::maximum(bb.xMax()-bb.xMin(), osg::maximum(bb.yMax()-bb.yMin(), bb.zMax()-bb.zMin()));
+    double scale = extent>0.0 ? 1023.0/extent : 0.0;
+
+    typedef std::vector< std::pair<unsigned int, unsigned int> > CodeIndexList;
+    CodeIndexList codes;
+    codes.reserve(_segments.size());
+    for(unsigned int i=0; i<_segments.size(); ++i)
+    {
+        osg::Vec3d center = (_segments[i].start+_segments[i].end)*0.5;
+        unsigned int code = spreadBits(quantize(center.x(), bb.xMin(), scale)) |
+                            (spreadBits(quantize(center.y(), bb.yMin(), scale)) << 1) |
+                            (spreadBits(quantize(center.z(), bb.zMin(), scale)) << 2);
+        codes.push_back(CodeIndexList::value_type(code, i));
+    }
+
+    std::sort(codes.begin(), codes.end());
+
+    order.resize(codes.size());
+    for(unsigned int i=0; i<codes.size(); ++i)
+    {
+        order[i] = codes[i].second;
+    }
+}
+
+void LineSegmentBatch::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
+{
+    if (_segments.empty()) return;
+
+    // compute the bounding volumes up front so the concurrent traversals only read the scene graph.
+    scene->getBound();
+
+    std::vector<unsigned int> order;
+    computeSpatialOrder(order);
+
+    IntersectSegmentsOperation operation(scene, traversalMask, _dcrc.get(), _nearestOnly);
+    IntersectSegmentsOperation::Segments& segments = operation.getSegments();
+    segments.resize(order.size());
+    for(unsigned int i=0; i<order.size(); ++i)
+    {
+        Segment& segment = _segments[order[i]];
+        segments[i].start = &segment.start;
+        segments[i].end = &segment.end;
+        segments[i].intersections = &segment.intersections;
+    }
+
+    // blocks of segments are large enough to amortize a traversal of the upper levels of the scene graph.
+    osgUtil::WorkerThreadPool::instance()->run(operation, segments.size(), 64);
+}
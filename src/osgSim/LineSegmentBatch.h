@@ -0,0 +1,90 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSGSIM_LINESEGMENTBATCH
+#define OSGSIM_LINESEGMENTBATCH 1
+
+#include <osgSim/LineOfSight>
+
+#include <vector>
+
+namespace osgSim {
+
+/** ReadCallback of a single intersection traversal, reading the tiles through a DatabaseCacheReadCallback shared by
+  * concurrent traversals.  The tiles read are referenced until the traversal is over, so that another traversal can't
+  * discard them from the cache while they are used.*/
+class TraversalReadCallback : public osgUtil::IntersectionVisitor::ReadCallback
+{
+    public:
+
+        TraversalReadCallback(DatabaseCacheReadCallback* dcrc) : _dcrc(dcrc) {}
+
+        virtual osg::Node* readNodeFile(const std::string& filename)
+        {
+            osg::ref_ptr<osg::Node> node = _dcrc->readRefNodeFile(filename);
+            if (node.valid()) _nodes.push_back(node);
+            return node.get();
+        }
+
+    protected:
+
+        virtual ~TraversalReadCallback() {}
+
+        DatabaseCacheReadCallback*              _dcrc;
+        std::vector< osg::ref_ptr<osg::Node> >  _nodes;
+};
+
+/** Computes the intersections of many line segments with a scene graph, as used by LineOfSight and HeightAboveTerrain.
+  * The segments are sorted along a Morton curve so that each block of segments only covers a small part of the scene,
+  * and the blocks are intersected with their own IntersectionVisitor on the osgUtil::WorkerThreadPool threads.*/
+class LineSegmentBatch
+{
+    public:
+
+        typedef std::vector<osg::Vec3d> Intersections;
+
+        LineSegmentBatch(DatabaseCacheReadCallback* dcrc, bool nearestOnly);
+
+        void reserve(unsigned int numSegments);
+
+        unsigned int addSegment(const osg::Vec3d& start, const osg::Vec3d& end);
+
+        /** Compute the intersections, in world coordinates and sorted from the start of each segment.
+          * The tiles are read through the DatabaseCacheReadCallback, which is shared by the concurrent traversals.*/
+        void computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask);
+
+        const Intersections& getIntersections(unsigned int i) const { return _segments[i].intersections; }
+
+    protected:
+
+        struct Segment
+        {
+            Segment(const osg::Vec3d& s, const osg::Vec3d& e) : start(s), end(e) {}
+
+            osg::Vec3d      start;
+            osg::Vec3d      end;
+            Intersections   intersections;
+        };
+
+        typedef std::vector<Segment> Segments;
+
+        void computeSpatialOrder(std::vector<unsigned int>& order) const;
+
+        osg::ref_ptr<DatabaseCacheReadCallback> _dcrc;
+        bool                                    _nearestOnly;
+        Segments                                _segments;
+};
+
+}
+
+#endif
@@ -21,13 +21,15 @@ using namespace osgTerrain;
 //
 //  DisplacementMappingTechnique
 //
-DisplacementMappingTechnique::DisplacementMappingTechnique()
+DisplacementMappingTechnique::DisplacementMappingTechnique():
+    _lodMorphRangeApplied(0)
 {
     // OSG_NOTICE<<"DisplacementMappingTechnique::DisplacementMappingTechnique()"<<std::endl;
 }
 
 DisplacementMappingTechnique::DisplacementMappingTechnique(const DisplacementMappingTechnique& st,const osg::CopyOp& copyop):
-    osgTerrain::TerrainTechnique(st, copyop)
+    osgTerrain::TerrainTechnique(st, copyop),
+    _lodMorphRangeApplied(0)
 {
 }
 
@@ -44,6 +46,7 @@ void DisplacementMappingTechnique::init(int dirtyMask, bool assumeMultiThreaded)
 
     GeometryPool* geometryPool = _terrainTile->getTerrain()->getGeometryPool();
     _transform = geometryPool->getTileSubgraph(_terrainTile);
+    _lodMorphRangeApplied.exchange(0);
 
     // set tile as no longer dirty.
     _terrainTile->setDirtyMask(0);
@@ -59,7 +62,21 @@ void DisplacementMappingTechnique::update(osgUtil::UpdateVisitor* uv)
 
 void DisplacementMappingTechnique::cull(osgUtil::CullVisitor* cv)
 {
-    if (_transform.valid()) _transform->accept(*cv);
+    if (!_transform) return;
+
+    // the LOD the tile is below is only known from the path of the first traversal, the flag is an Atomic
+    // so that cull threads seeing it set also see the uniforms it was set after.
+    if (_lodMorphRangeApplied==0 && _terrainTile && _terrainTile->getTerrain())
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_transformMutex);
+        if (_lodMorphRangeApplied==0)
+        {
+            _terrainTile->getTerrain()->getGeometryPool()->applyLODMorphRange(_terrainTile, cv->getNodePath(), _transform.get());
+            _lodMorphRangeApplied.OR(1);
+        }
+    }
+
+    _transform->accept(*cv);
 }
 
 
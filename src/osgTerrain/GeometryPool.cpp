@@ -14,8 +14,11 @@
 #include <osgTerrain/GeometryPool>
 #include <osg/Texture1D>
 #include <osg/Texture2D>
+#include <osg/LOD>
 #include <osgDB/ReadFile>
 
+#include <float.h>
+
 using namespace osgTerrain;
 
 const osgTerrain::Locator* osgTerrain::computeMasterLocator(const osgTerrain::TerrainTile* tile)
@@ -42,10 +45,16 @@ const osgTerrain::Locator* osgTerrain::computeMasterLocator(const osgTerrain::Te
 //  GeometryPool
 //
 GeometryPool::GeometryPool():
+    _lodMorphRatio(0.25f),
     _rootStateSetAssigned(false)
 
 {
     _rootStateSet = new osg::StateSet;
+
+    // tiles which aren't the child of a LOD keep their own heights.
+    _rootStateSet->addUniform(new osg::Uniform("terrainLODCenter", osg::Vec3(0.0f, 0.0f, 0.0f)));
+    _rootStateSet->addUniform(new osg::Uniform("terrainMorphRange", osg::Vec2(0.0f, 0.0f)));
+    _rootStateSet->setDefine("LOD_MORPHING");
 }
 
 GeometryPool::~GeometryPool()
@@ -90,6 +99,130 @@ bool GeometryPool::createKeyForTile(TerrainTile* tile, GeometryKey& key)
     return true;
 }
 
+osg::ref_ptr<osg::DrawElements> GeometryPool::getOrCreateDrawElements(int nx, int ny)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_drawElementsMapMutex);
+
+    GridSize gridSize(nx, ny);
+    DrawElementsMap::iterator itr = _drawElementsMap.find(gridSize);
+    if (itr != _drawElementsMap.end())
+    {
+        return itr->second.get();
+    }
+
+    int numVertices = nx * ny + (nx)*2 + (ny)*2;
+
+    bool smallTile = numVertices <= 16384;
+
+    GLenum primitiveTypes = GL_QUADS;
+
+    osg::ref_ptr<osg::DrawElements> elements = smallTile ?
+        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(primitiveTypes)) :
+        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(primitiveTypes));
+
+    elements->reserveElements( (nx-1) * (ny-1) * 4 + (nx-1)*2*4 + (ny-1)*2*4 );
+    elements->setElementBufferObject(new osg::ElementBufferObject());
+
+    // first row containing the skirt
+    for(int c=0; c<nx-1; ++c)
+    {
+        int il = c;
+        int iu = il+nx+1;
+        elements->addElement(il);
+        elements->addElement(il+1);
+        elements->addElement(iu+1);
+        elements->addElement(iu);
+    }
+
+    // center section
+    for(int r=0; r<ny-1; ++r)
+    {
+        for(int c=0; c<nx+1; ++c)
+        {
+            int il = c+nx+r*(nx+2);
+            int iu = il+nx+2;
+            elements->addElement(il);
+            elements->addElement(il+1);
+            elements->addElement(iu+1);
+            elements->addElement(iu);
+        }
+    }
+
+    // top row containing skirt
+    for(int c=0; c<nx-1; ++c)
+    {
+        int il = c+nx+(ny-1)*(nx+2)+1;
+        int iu = il+nx+1;
+        elements->addElement(il);
+        elements->addElement(il+1);
+        elements->addElement(iu+1);
+        elements->addElement(iu);
+    }
+
+    _drawElementsMap[gridSize] = elements;
+
+    return elements;
+}
+
+void GeometryPool::setLODMorphRatio(float ratio)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_programMapMutex);
+
+    _lodMorphRatio = ratio;
+
+    if (_lodMorphRatio>0.0f) _rootStateSet->setDefine("LOD_MORPHING");
+    else _rootStateSet->removeDefine("LOD_MORPHING");
+}
+
+void GeometryPool::applyLODMorphRange(osgTerrain::TerrainTile* tile, const osg::NodePath& nodePath, osg::MatrixTransform* transform)
+{
+    if (_lodMorphRatio<=0.0f || !transform || nodePath.size()<2) return;
+
+    // the tile switches to its parent tile at the smallest maximum range of the LODs it is below, i.e. that of the
+    // LOD of the parent tile rather than that of the LOD of its own children.
+    const osg::LOD* lod = 0;
+    unsigned int lodIndex = 0;
+    unsigned int childIndex = 0;
+    for(unsigned int i=0; i<nodePath.size()-1; ++i)
+    {
+        const osg::LOD* candidate = dynamic_cast<const osg::LOD*>(nodePath[i]);
+        if (!candidate || candidate->getRangeMode()!=osg::LOD::DISTANCE_FROM_EYE_POINT) continue;
+
+        unsigned int index = candidate->getChildIndex(nodePath[i+1]);
+        if (index>=candidate->getNumRanges()) continue;
+
+        if (!lod || candidate->getMaxRange(index)<lod->getMaxRange(childIndex))
+        {
+            lod = candidate;
+            lodIndex = i;
+            childIndex = index;
+        }
+    }
+
+    if (!lod) return;
+
+    float minRange = lod->getMinRange(childIndex);
+    float maxRange = lod->getMaxRange(childIndex);
+    float morphDistance = (maxRange-minRange)*_lodMorphRatio;
+    if (morphDistance<=0.0f) return;
+
+    // the center of the LOD in the local coordinates of the tile geometry.
+    osg::NodePath lodToTile(nodePath.begin()+lodIndex+1, nodePath.end());
+    osg::Matrix tileToLOD = transform->getMatrix() * osg::computeLocalToWorld(lodToTile);
+    osg::Vec3d center = osg::Vec3d(lod->getCenter()) * osg::Matrix::inverse(tileToLOD);
+
+    // only the values of the uniforms created by getTileSubgraph() are set, as the StateSet mustn't be changed during cull.
+    osg::StateSet* stateset = transform->getStateSet();
+    osg::Uniform* lodCenter = stateset ? stateset->getUniform("terrainLODCenter") : 0;
+    osg::Uniform* morphRange = stateset ? stateset->getUniform("terrainMorphRange") : 0;
+    if (!lodCenter || !morphRange) return;
+
+    lodCenter->set(osg::Vec3(center));
+    morphRange->set(osg::Vec2(maxRange-morphDistance, 1.0f/morphDistance));
+
+    OSG_INFO<<"Tile "<<tile->getTileID().level<<" morphing from "<<maxRange-morphDistance<<" to "<<maxRange<<std::endl;
+}
+
 osg::ref_ptr<SharedGeometry> GeometryPool::getOrCreateGeometry(osgTerrain::TerrainTile* tile)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_geometryMapMutex);
@@ -131,7 +264,7 @@ osg::ref_ptr<SharedGeometry> GeometryPool::getOrCreateGeometry(osgTerrain::Terra
 
 
     int nx = key.nx;
-    int ny = key.nx;
+    int ny = key.ny;
 
     int numVerticesMainBody = nx * ny;
     int numVerticesSkirt = (nx)*2 + (ny)*2;
@@ -309,54 +442,7 @@ osg::ref_ptr<SharedGeometry> GeometryPool::getOrCreateGeometry(osgTerrain::Terra
     }
 
 #else
-    bool smallTile = numVertices <= 16384;
-
-    GLenum primitiveTypes = GL_QUADS;
-
-    osg::ref_ptr<osg::DrawElements> elements = smallTile ?
-        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(primitiveTypes)) :
-        static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(primitiveTypes));
-
-    elements->reserveElements( (nx-1) * (ny-1) * 4 + (nx-1)*2*4 + (ny-1)*2*4 );
-    elements->setElementBufferObject(new osg::ElementBufferObject());
-    geometry->setDrawElements(elements.get());
-
-
-    // first row containing the skirt
-    for(int c=0; c<nx-1; ++c)
-    {
-        int il = c;
-        int iu = il+nx+1;
-        elements->addElement(il);
-        elements->addElement(il+1);
-        elements->addElement(iu+1);
-        elements->addElement(iu);
-    }
-
-    // center section
-    for(int r=0; r<ny-1; ++r)
-    {
-        for(int c=0; c<nx+1; ++c)
-        {
-            int il = c+nx+r*(nx+2);
-            int iu = il+nx+2;
-            elements->addElement(il);
-            elements->addElement(il+1);
-            elements->addElement(iu+1);
-            elements->addElement(iu);
-        }
-    }
-
-    // top row containing skirt
-    for(int c=0; c<nx-1; ++c)
-    {
-        int il = c+nx+(ny-1)*(nx+2)+1;
-        int iu = il+nx+1;
-        elements->addElement(il);
-        elements->addElement(il+1);
-        elements->addElement(iu+1);
-        elements->addElement(iu);
-    }
+    geometry->setDrawElements(getOrCreateDrawElements(nx, ny).get());
 #endif
     if (locator)
     {
@@ -505,58 +591,17 @@ osg::ref_ptr<osg::MatrixTransform> GeometryPool::getTileSubgraph(osgTerrain::Ter
         }
     }
 
-    osg::Vec3Array* shared_vertices = dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray());
-    osg::Vec3Array* shared_normals = dynamic_cast<osg::Vec3Array*>(geometry->getNormalArray());
-    osg::FloatArray* heights = hf->getFloatArray();
-    const SharedGeometry::VertexToHeightFieldMapping& vthfm = geometry->getVertexToHeightFieldMapping();
-
-    if (hf && shared_vertices && shared_normals && (shared_vertices->size()==shared_normals->size()))
-    {
-        if (vthfm.size()==shared_vertices->size())
-        {
-            // Using cache VertexArray
-            unsigned int numVertices = shared_vertices->size();
-            osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-            vertices->resize(numVertices);
-
-            for(unsigned int i=0; i<numVertices; ++i)
-            {
-                unsigned int hi = vthfm[i];
-                (*vertices)[i] = (*shared_vertices)[i] + (*shared_normals)[i] * (*heights)[hi];
-            }
-
-            hfDrawable->setVertices(vertices.get());
-        }
-        else
-        {
-            // Setting local bounding
-            unsigned int nr = hf->getNumRows();
-            unsigned int nc = hf->getNumColumns();
-
-            osg::BoundingBox bb;
-
-            for(unsigned int r=0; r<nr; ++r)
-            {
-                for(unsigned int c=0; c<nc; ++c)
-                {
-                    unsigned int i = r*nc+c;
-                    float h = (*heights)[i];
-                    const osg::Vec3& v = (*shared_vertices)[i];
-                    const osg::Vec3& n = (*shared_normals)[i];
-
-                    const osg::Vec3 vt(v+n*h);
-                    bb.expandBy(vt);
-                }
-            }
-            hfDrawable->setInitialBound(bb);
-            // OSG_NOTICE<<"Assigning initial bound ("<<bb.xMin()<<", "<<bb.xMax()<<") ,  ("<<bb.yMin()<<", "<<bb.yMax()<<") ("<<bb.zMin()<<", "<<bb.zMax()<<")"<< std::endl;
-            // bb = hfDrawable->getBoundingBox();
-            //OSG_NOTICE<<"         getBoundingBox ("<<bb.xMin()<<", "<<bb.xMax()<<") ,  ("<<bb.yMin()<<", "<<bb.yMax()<<") ("<<bb.zMin()<<", "<<bb.zMax()<<")"<< std::endl;
+    osg::ref_ptr<osg::StateSet> stateset = transform->getOrCreateStateSet();
 
-        }
-    }
+    // the LOD morphing uniforms are only set once the LOD the tile is below is found by applyLODMorphRange(), so
+    // until then place the start of the morph out of reach.
+    osg::ref_ptr<osg::Uniform> lodCenter = new osg::Uniform("terrainLODCenter", osg::Vec3(0.0f, 0.0f, 0.0f));
+    lodCenter->setDataVariance(osg::Object::DYNAMIC);
+    stateset->addUniform(lodCenter.get());
 
-    osg::ref_ptr<osg::StateSet> stateset = transform->getOrCreateStateSet();
+    osg::ref_ptr<osg::Uniform> morphRange = new osg::Uniform("terrainMorphRange", osg::Vec2(FLT_MAX, 0.0f));
+    morphRange->setDataVariance(osg::Object::DYNAMIC);
+    stateset->addUniform(morphRange.get());
 
     // apply colour layers
     applyLayers(tile, stateset.get());
@@ -1044,6 +1089,92 @@ HeightFieldDrawable::~HeightFieldDrawable()
 {
 }
 
+namespace
+{
+
+// call functor with each of the vertices of the SharedGeometry displaced by the heights of the HeightField
+template<class Functor>
+void forEachVertex(const SharedGeometry* geometry, const osg::HeightField* heightField, Functor& functor)
+{
+    if (!geometry) return;
+
+    const osg::Vec3Array* shared_vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+    const osg::Vec3Array* shared_normals = dynamic_cast<const osg::Vec3Array*>(geometry->getNormalArray());
+    const osg::FloatArray* heights = heightField ? heightField->getFloatArray() : 0;
+    const SharedGeometry::VertexToHeightFieldMapping& vthfm = geometry->getVertexToHeightFieldMapping();
+
+    if (!shared_vertices) return;
+
+    unsigned int numVertices = shared_vertices->size();
+    if (!heights || !shared_normals || shared_normals->size()!=numVertices || vthfm.size()!=numVertices)
+    {
+        for(unsigned int i=0; i<numVertices; ++i) functor((*shared_vertices)[i]);
+        return;
+    }
+
+    for(unsigned int i=0; i<numVertices; ++i)
+    {
+        functor((*shared_vertices)[i] + (*shared_normals)[i] * (*heights)[vthfm[i]]);
+    }
+}
+
+struct AppendVertex
+{
+    AppendVertex(osg::Vec3Array& vertices) : _vertices(vertices) {}
+    void operator() (const osg::Vec3& v) { _vertices.push_back(v); }
+    osg::Vec3Array& _vertices;
+};
+
+struct ExpandBoundingBox
+{
+    void operator() (const osg::Vec3& v) { _bb.expandBy(v); }
+    osg::BoundingBox _bb;
+};
+
+}
+
+void HeightFieldDrawable::computeVertices(osg::Vec3Array& vertices) const
+{
+    vertices.clear();
+    if (_geometry.valid() && _geometry->getVertexArray()) vertices.reserve(_geometry->getVertexArray()->getNumElements());
+
+    AppendVertex appendVertex(vertices);
+    forEachVertex(_geometry.get(), _heightField.get(), appendVertex);
+}
+
+const osg::Vec3Array* HeightFieldDrawable::getOrComputeVertices() const
+{
+    if (_vertices.valid()) return _vertices.get();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_computedVerticesMutex);
+    if (!_computedVertices)
+    {
+        osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+        computeVertices(*vertices);
+        _computedVertices = vertices;
+    }
+    return _computedVertices.get();
+}
+
+osg::BoundingBox HeightFieldDrawable::computeBoundingBox() const
+{
+    // the bound is computed straight from the shared geometry and heights, so that culling doesn't make every tile
+    // keep its own copy of the vertices
+    ExpandBoundingBox expandBoundingBox;
+    if (_vertices.valid())
+    {
+        for(osg::Vec3Array::const_iterator itr = _vertices->begin(); itr != _vertices->end(); ++itr)
+        {
+            expandBoundingBox(*itr);
+        }
+    }
+    else
+    {
+        forEachVertex(_geometry.get(), _heightField.get(), expandBoundingBox);
+    }
+    return expandBoundingBox._bb;
+}
+
 void HeightFieldDrawable::drawImplementation(osg::RenderInfo& renderInfo) const
 {
     if (_geometry.valid()) _geometry->draw(renderInfo);
@@ -1076,55 +1207,49 @@ void HeightFieldDrawable::accept(osg::Drawable::ConstAttributeFunctor& caf) cons
 
 void HeightFieldDrawable::accept(osg::PrimitiveFunctor& pf) const
 {
-    // use the cached vertex positions for PrimitiveFunctor operations
+    // use the vertex positions for PrimitiveFunctor operations, computing them the first time they're needed
     if (!_geometry) return;
 
-    if (_vertices.valid())
-    {
-        pf.setVertexArray(_vertices->size(), &((*_vertices)[0]));
+    const osg::Vec3Array* vertices = getOrComputeVertices();
+    if (vertices->empty()) return;
 
-        const osg::DrawElementsUShort* deus = dynamic_cast<const osg::DrawElementsUShort*>(_geometry->getDrawElements());
-        if (deus)
-        {
-            pf.drawElements(GL_QUADS, deus->size(), &((*deus)[0]));
-        }
-        else
-        {
-            const osg::DrawElementsUInt* deui = dynamic_cast<const osg::DrawElementsUInt*>(_geometry->getDrawElements());
-            if (deui)
-            {
-                pf.drawElements(GL_QUADS, deui->size(), &((*deui)[0]));
-            }
-        }
+    pf.setVertexArray(vertices->size(), &((*vertices)[0]));
+
+    const osg::DrawElementsUShort* deus = dynamic_cast<const osg::DrawElementsUShort*>(_geometry->getDrawElements());
+    if (deus)
+    {
+        pf.drawElements(GL_QUADS, deus->size(), &((*deus)[0]));
     }
     else
     {
-        _geometry->accept(pf);
+        const osg::DrawElementsUInt* deui = dynamic_cast<const osg::DrawElementsUInt*>(_geometry->getDrawElements());
+        if (deui)
+        {
+            pf.drawElements(GL_QUADS, deui->size(), &((*deui)[0]));
+        }
     }
 }
 
 void HeightFieldDrawable::accept(osg::PrimitiveIndexFunctor& pif) const
 {
-    if (_vertices.valid())
-    {
-        pif.setVertexArray(_vertices->size(), &((*_vertices)[0]));
+    if (!_geometry) return;
 
-        const osg::DrawElementsUShort* deus = dynamic_cast<const osg::DrawElementsUShort*>(_geometry->getDrawElements());
-        if (deus)
-        {
-            pif.drawElements(GL_QUADS, deus->size(), &((*deus)[0]));
-        }
-        else
-        {
-            const osg::DrawElementsUInt* deui = dynamic_cast<const osg::DrawElementsUInt*>(_geometry->getDrawElements());
-            if (deui)
-            {
-                pif.drawElements(GL_QUADS, deui->size(), &((*deui)[0]));
-            }
-        }
+    const osg::Vec3Array* vertices = getOrComputeVertices();
+    if (vertices->empty()) return;
+
+    pif.setVertexArray(vertices->size(), &((*vertices)[0]));
+
+    const osg::DrawElementsUShort* deus = dynamic_cast<const osg::DrawElementsUShort*>(_geometry->getDrawElements());
+    if (deus)
+    {
+        pif.drawElements(GL_QUADS, deus->size(), &((*deus)[0]));
     }
     else
     {
-        _geometry->accept(pif);
+        const osg::DrawElementsUInt* deui = dynamic_cast<const osg::DrawElementsUInt*>(_geometry->getDrawElements());
+        if (deui)
+        {
+            pif.drawElements(GL_QUADS, deui->size(), &((*deui)[0]));
+        }
     }
 }
@@ -16,6 +16,7 @@
 #include <osgTerrain/Terrain>
 
 #include <osgUtil/MeshOptimizers>
+#include <osgUtil/WorkerThreadPool>
 
 #include <osgDB/FileUtils>
 
@@ -26,9 +27,13 @@
 #include <osg/Math>
 #include <osg/Timer>
 
+#include <iomanip>
+#include <sstream>
+
 using namespace osgTerrain;
 
-GeometryTechnique::GeometryTechnique()
+GeometryTechnique::GeometryTechnique():
+    _useHeightFieldForIntersections(false)
 {
     setFilterBias(0);
     setFilterWidth(0.1);
@@ -37,7 +42,8 @@ GeometryTechnique::GeometryTechnique()
 }
 
 GeometryTechnique::GeometryTechnique(const GeometryTechnique& gt,const osg::CopyOp& copyop):
-    TerrainTechnique(gt,copyop)
+    TerrainTechnique(gt,copyop),
+    _useHeightFieldForIntersections(gt._useHeightFieldForIntersections)
 {
     setFilterBias(gt._filterBias);
     setFilterWidth(gt._filterWidth);
@@ -239,15 +245,29 @@ class VertexNormalGenerator
         typedef std::pair< osg::ref_ptr<osg::Vec2Array>, Locator* > TexCoordLocatorPair;
         typedef std::map< Layer*, TexCoordLocatorPair > LayerToTexCoordMap;
 
+        struct TexCoordLayer
+        {
+            osg::Vec2Array*             texcoords;
+            Locator*                    locator;
+            osgTerrain::ImageLayer*     imageLayer;
+            osg::TransferFunction1D*    transferFunction;
+        };
+
+        typedef std::vector<TexCoordLayer> TexCoordLayers;
+
         VertexNormalGenerator(Locator* masterLocator, const osg::Vec3d& centerModel, int numRows, int numColmns, float scaleHeight, bool createSkirt);
 
         void populateCenter(osgTerrain::Layer* elevationLayer, LayerToTexCoordMap& layerToTexCoordMap);
+        void populateCenterRows(osgTerrain::Layer* elevationLayer, TexCoordLayers& texCoordLayers, int beginRow, int endRow);
         void populateLeftBoundary(osgTerrain::Layer* elevationLayer);
         void populateRightBoundary(osgTerrain::Layer* elevationLayer);
         void populateAboveBoundary(osgTerrain::Layer* elevationLayer);
         void populateBelowBoundary(osgTerrain::Layer* elevationLayer);
 
         void computeNormals();
+        void computeNormalRows(int beginRow, int endRow);
+
+        osg::HeightField* createHeightField() const;
 
         unsigned int capacity() const { return _vertices->capacity(); }
 
@@ -410,6 +430,7 @@ class VertexNormalGenerator
         float                           _scaleHeight;
 
         Indices                         _indices;
+        std::vector<unsigned char>      _valid;
 
         osg::ref_ptr<osg::Vec3Array>    _vertices;
         osg::ref_ptr<osg::Vec3Array>    _normals;
@@ -419,6 +440,42 @@ class VertexNormalGenerator
 
 };
 
+// populate blocks of rows of the center of the tile.
+class PopulateCenterOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+public:
+    PopulateCenterOperation(VertexNormalGenerator& vng, osgTerrain::Layer* elevationLayer, VertexNormalGenerator::TexCoordLayers& texCoordLayers):
+        _vng(vng),
+        _elevationLayer(elevationLayer),
+        _texCoordLayers(texCoordLayers) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        _vng.populateCenterRows(_elevationLayer, _texCoordLayers, begin, end);
+    }
+
+protected:
+    VertexNormalGenerator&                  _vng;
+    osgTerrain::Layer*                      _elevationLayer;
+    VertexNormalGenerator::TexCoordLayers&  _texCoordLayers;
+};
+
+// compute the normals of blocks of rows, each normal only depends upon the vertices so rows can be done in any order.
+class ComputeNormalsOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+public:
+    ComputeNormalsOperation(VertexNormalGenerator& vng):
+        _vng(vng) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        _vng.computeNormalRows(begin, end);
+    }
+
+protected:
+    VertexNormalGenerator&  _vng;
+};
+
 VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::Vec3d& centerModel, int numRows, int numColumns, float scaleHeight, bool createSkirt):
     _masterLocator(masterLocator),
     _centerModel(centerModel),
@@ -427,7 +484,8 @@ VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::
     _scaleHeight(scaleHeight)
 {
     int numVerticesInBody = numColumns*numRows;
-    int numVerticesInSkirt = createSkirt ? numColumns*2 + numRows*2 - 4 : 0;
+    // the skirt runs all the way round the tile so the corner vertices get two skirt vertices each
+    int numVerticesInSkirt = createSkirt ? numColumns*2 + numRows*2 : 0;
     int numVertices = numVerticesInBody+numVerticesInSkirt;
 
     _indices.resize((_numRows+2)*(_numColumns+2),0);
@@ -445,15 +503,128 @@ VertexNormalGenerator::VertexNormalGenerator(Locator* masterLocator, const osg::
     _boundaryVertices->reserve(_numRows*2 + _numColumns*2 + 4);
 }
 
+osg::HeightField* VertexNormalGenerator::createHeightField() const
+{
+    // the HeightField vertex (c,r) has to be the vertex r*numColumns+c of the geometry
+    for(int j=0; j<_numRows; ++j)
+    {
+        for(int i=0; i<_numColumns; ++i)
+        {
+            if (vertex_index(i,j)!=j*_numColumns+i) return 0;
+        }
+    }
+
+    const osg::Vec3& origin = (*_vertices)[0];
+    float dx = ((*_vertices)[_numColumns-1].x()-origin.x())/float(_numColumns-1);
+    float dy = ((*_vertices)[(_numRows-1)*_numColumns].y()-origin.y())/float(_numRows-1);
+    if (dx<=0.0f || dy<=0.0f) return 0;
+
+    float epsilon = osg::minimum(dx,dy)*1e-3f;
+
+    osg::ref_ptr<osg::HeightField> heightField = new osg::HeightField;
+    heightField->allocate(_numColumns, _numRows);
+    heightField->setOrigin(osg::Vec3(origin.x(), origin.y(), 0.0f));
+    heightField->setXInterval(dx);
+    heightField->setYInterval(dy);
+
+    for(int j=0; j<_numRows; ++j)
+    {
+        for(int i=0; i<_numColumns; ++i)
+        {
+            const osg::Vec3& v = (*_vertices)[j*_numColumns+i];
+
+            // the vertices of geocentric tiles don't lie on an axis aligned grid
+            if (fabsf(v.x()-(origin.x()+dx*float(i)))>epsilon || fabsf(v.y()-(origin.y()+dy*float(j)))>epsilon) return 0;
+
+            heightField->setHeight(i, j, v.z());
+        }
+    }
+
+    return heightField.release();
+}
+
 void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, LayerToTexCoordMap& layerToTexCoordMap)
 {
     // OSG_NOTICE<<std::endl<<"VertexNormalGenerator::populateCenter("<<elevationLayer<<")"<<std::endl;
 
+    int numVerticesInBody = _numColumns*_numRows;
+
+    // size the arrays up front so that blocks of rows can be filled in concurrently, each grid vertex (c,r) goes to r*numColumns+c.
+    _vertices->resize(numVerticesInBody);
+    _normals->resize(numVerticesInBody);
+    _elevations->resize(numVerticesInBody);
+    _valid.assign(numVerticesInBody, 0);
+
+    TexCoordLayers texCoordLayers;
+    for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
+        itr != layerToTexCoordMap.end();
+        ++itr)
+    {
+        TexCoordLayer texCoordLayer;
+        texCoordLayer.texcoords = itr->second.first.get();
+        texCoordLayer.locator = itr->second.second;
+        texCoordLayer.imageLayer = dynamic_cast<osgTerrain::ImageLayer*>(itr->first);
+        texCoordLayer.transferFunction = 0;
+        if (!texCoordLayer.imageLayer)
+        {
+            osgTerrain::ContourLayer* contourLayer = dynamic_cast<osgTerrain::ContourLayer*>(itr->first);
+            if (contourLayer && contourLayer->getTransferFunction() &&
+                contourLayer->getTransferFunction()->getMaximum()!=contourLayer->getTransferFunction()->getMinimum())
+            {
+                texCoordLayer.transferFunction = contourLayer->getTransferFunction();
+            }
+        }
+        texCoordLayer.texcoords->resize(numVerticesInBody);
+        texCoordLayers.push_back(texCoordLayer);
+    }
+
+    PopulateCenterOperation operation(*this, elevationLayer, texCoordLayers);
+    osgUtil::WorkerThreadPool::instance()->run(operation, _numRows, 16);
+
+    // pack the valid vertices together, keeping them in the order they would have been added one by one.
+    int numValid = 0;
+    for(int j=0; j<_numRows; ++j)
+    {
+        for(int i=0; i<_numColumns; ++i)
+        {
+            int k = j*_numColumns+i;
+            if (!_valid[k]) continue;
+
+            if (numValid!=k)
+            {
+                (*_vertices)[numValid] = (*_vertices)[k];
+                (*_normals)[numValid] = (*_normals)[k];
+                (*_elevations)[numValid] = (*_elevations)[k];
+                for(TexCoordLayers::iterator itr = texCoordLayers.begin(); itr != texCoordLayers.end(); ++itr)
+                {
+                    (*(itr->texcoords))[numValid] = (*(itr->texcoords))[k];
+                }
+            }
+
+            ++numValid;
+            index(i,j) = numValid;
+        }
+    }
+
+    if (numValid!=numVerticesInBody)
+    {
+        _vertices->resize(numValid);
+        _normals->resize(numValid);
+        _elevations->resize(numValid);
+        for(TexCoordLayers::iterator itr = texCoordLayers.begin(); itr != texCoordLayers.end(); ++itr)
+        {
+            itr->texcoords->resize(numValid);
+        }
+    }
+}
+
+void VertexNormalGenerator::populateCenterRows(osgTerrain::Layer* elevationLayer, TexCoordLayers& texCoordLayers, int beginRow, int endRow)
+{
     bool sampled = elevationLayer &&
                    ( (elevationLayer->getNumRows()!=static_cast<unsigned int>(_numRows)) ||
                      (elevationLayer->getNumColumns()!=static_cast<unsigned int>(_numColumns)) );
 
-    for(int j=0; j<_numRows; ++j)
+    for(int j=beginRow; j<endRow; ++j)
     {
         for(int i=0; i<_numColumns; ++i)
         {
@@ -470,73 +641,57 @@ void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, La
 
             if (validValue)
             {
+                int k = j*_numColumns+i;
+
                 osg::Vec3d model;
                 _masterLocator->convertLocalToModel(ndc, model);
 
-                for(VertexNormalGenerator::LayerToTexCoordMap::iterator itr = layerToTexCoordMap.begin();
-                    itr != layerToTexCoordMap.end();
+                for(TexCoordLayers::iterator itr = texCoordLayers.begin();
+                    itr != texCoordLayers.end();
                     ++itr)
                 {
-                    osg::Vec2Array* texcoords = itr->second.first.get();
-                    osgTerrain::ImageLayer* imageLayer(dynamic_cast<osgTerrain::ImageLayer*>(itr->first));
+                    osg::Vec2Array* texcoords = itr->texcoords;
+                    Locator* colorLocator = itr->locator;
 
-                    if (imageLayer != NULL)
+                    if (itr->imageLayer)
                     {
-                        Locator* colorLocator = itr->second.second;
                         if (colorLocator != _masterLocator)
                         {
                             osg::Vec3d color_ndc;
                             Locator::convertLocalCoordBetween(*_masterLocator, ndc, *colorLocator, color_ndc);
-                            (*texcoords).push_back(osg::Vec2(color_ndc.x(), color_ndc.y()));
+                            (*texcoords)[k].set(color_ndc.x(), color_ndc.y());
                         }
                         else
                         {
-                            (*texcoords).push_back(osg::Vec2(ndc.x(), ndc.y()));
+                            (*texcoords)[k].set(ndc.x(), ndc.y());
                         }
                     }
-                    else
+                    else if (itr->transferFunction)
                     {
-                        osgTerrain::ContourLayer* contourLayer(dynamic_cast<osgTerrain::ContourLayer*>(itr->first));
+                        osg::TransferFunction1D* transferFunction = itr->transferFunction;
+                        float difference = transferFunction->getMaximum()-transferFunction->getMinimum();
 
-                        bool texCoordSet = false;
-                        if (contourLayer)
+                        osg::Vec3d color_ndc;
+                        if (colorLocator != _masterLocator)
                         {
-                            osg::TransferFunction1D* transferFunction = contourLayer->getTransferFunction();
-                            if (transferFunction)
-                            {
-                                float difference = transferFunction->getMaximum()-transferFunction->getMinimum();
-                                if (difference != 0.0f)
-                                {
-                                    osg::Vec3d           color_ndc;
-                                    osgTerrain::Locator* colorLocator(itr->second.second);
-
-                                    if (colorLocator != _masterLocator)
-                                    {
-                                        Locator::convertLocalCoordBetween(*_masterLocator,ndc,*colorLocator,color_ndc);
-                                    }
-                                    else
-                                    {
-                                        color_ndc = ndc;
-                                    }
-
-                                    color_ndc[2] /= _scaleHeight;
-
-                                    (*texcoords).push_back(osg::Vec2((color_ndc[2]-transferFunction->getMinimum())/difference,0.0f));
-                                    texCoordSet = true;
-                                }
-                            }
+                            Locator::convertLocalCoordBetween(*_masterLocator,ndc,*colorLocator,color_ndc);
                         }
-                        if (!texCoordSet)
+                        else
                         {
-                            (*texcoords).push_back(osg::Vec2(0.0f,0.0f));
+                            color_ndc = ndc;
                         }
+
+                        color_ndc[2] /= _scaleHeight;
+
+                        (*texcoords)[k].set((color_ndc[2]-transferFunction->getMinimum())/difference,0.0f);
+                    }
+                    else
+                    {
+                        (*texcoords)[k].set(0.0f,0.0f);
                     }
                 }
 
-                if (_elevations.valid())
-                {
-                    (*_elevations).push_back(ndc.z());
-                }
+                (*_elevations)[k] = ndc.z();
 
                 // compute the local normal
                 osg::Vec3d ndc_one = ndc; ndc_one.z() += 1.0;
@@ -545,7 +700,9 @@ void VertexNormalGenerator::populateCenter(osgTerrain::Layer* elevationLayer, La
                 model_one = model_one - model;
                 model_one.normalize();
 
-                setVertex(i, j, osg::Vec3(model-_centerModel), model_one);
+                (*_vertices)[k] = osg::Vec3(model-_centerModel);
+                (*_normals)[k] = model_one;
+                _valid[k] = 1;
             }
         }
     }
@@ -736,17 +893,147 @@ void VertexNormalGenerator::populateBelowBoundary(osgTerrain::Layer* elevationLa
 void VertexNormalGenerator::computeNormals()
 {
     // compute normals for the center section
-    for(int j=0; j<_numRows; ++j)
+    ComputeNormalsOperation operation(*this);
+    osgUtil::WorkerThreadPool::instance()->run(operation, _numRows, 16);
+}
+
+void VertexNormalGenerator::computeNormalRows(int beginRow, int endRow)
+{
+    // a tile with no valid data has no vertices at all
+    if (_vertices->empty() || _normals->empty()) return;
+
+    osg::Vec3* vertices = &((*_vertices)[0]);
+    osg::Vec3* normals = &((*_normals)[0]);
+    int rowStride = _numColumns+2;
+    const osg::Vec3 zero(0.0f,0.0f,0.0f);
+
+    for(int j=beginRow; j<endRow; ++j)
     {
+        const int* indices = &_indices[(j+1)*rowStride+1];
         for(int i=0; i<_numColumns; ++i)
         {
-            int vi = vertex_index(i, j);
-            if (vi>=0) computeNormal(i, j, (*_normals)[vi]);
-            else OSG_NOTICE<<"Not computing normal, vi="<<vi<<std::endl;
+            int vi = indices[i]-1;
+            if (vi<0)
+            {
+                OSG_NOTICE<<"Not computing normal, vi="<<vi<<std::endl;
+                continue;
+            }
+
+            // vertices whose four neighbours are all in the body of the tile, the common case, take the
+            // same differences as computeNormal() does straight from the vertex array.
+            int left = indices[i-1], right = indices[i+1], bottom = indices[i-rowStride], top = indices[i+rowStride];
+            if (left>0 && right>0 && bottom>0 && top>0)
+            {
+                const osg::Vec3& center = vertices[vi];
+                osg::Vec3 dx = vertices[right-1]-center;
+                osg::Vec3 dy = (center-vertices[bottom-1]) + (vertices[top-1]-center);
+                if (dx!=zero && dy!=zero)
+                {
+                    normals[vi] = dx ^ dy;
+                    normals[vi].normalize();
+                }
+            }
+            else
+            {
+                computeNormal(i, j, normals[vi]);
+            }
         }
     }
 }
 
+// triangulate blocks of rows of cells, each cell writes its indices into its own six slots of the elements.
+class TriangulateCellsOperation : public osgUtil::WorkerThreadPool::RangeOperation
+{
+public:
+    TriangulateCellsOperation(const VertexNormalGenerator& vng, osg::DrawElements* elements, std::vector<unsigned char>& numCellIndices, bool swapOrientation, bool fixedDiagonal):
+        _vng(vng),
+        _elements(elements),
+        _numCellIndices(numCellIndices),
+        _swapOrientation(swapOrientation),
+        _fixedDiagonal(fixedDiagonal) {}
+
+    inline void addElement(unsigned int& index, int i) { _elements->setElement(index++, i); }
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        const osg::Vec3Array& normals = *_vng._normals;
+        int numCellColumns = _vng._numColumns-1;
+
+        for(int j=begin; j<static_cast<int>(end); ++j)
+        {
+            for(int i=0; i<numCellColumns; ++i)
+            {
+                // remap indices to final vertex positions
+                int i00 = _vng.vertex_index(i,   j);
+                int i01 = _vng.vertex_index(i,   j+1);
+                int i10 = _vng.vertex_index(i+1, j);
+                int i11 = _vng.vertex_index(i+1, j+1);
+
+                if (_swapOrientation)
+                {
+                    std::swap(i00,i01);
+                    std::swap(i10,i11);
+                }
+
+                unsigned int numValid = 0;
+                if (i00>=0) ++numValid;
+                if (i01>=0) ++numValid;
+                if (i10>=0) ++numValid;
+                if (i11>=0) ++numValid;
+
+                unsigned int cell = j*numCellColumns+i;
+                unsigned int index = cell*6;
+
+                if (numValid==4)
+                {
+                    // optimize which way to put the diagonal by choosing to
+                    // place it between the two corners that have the least curvature
+                    // relative to each other, unless the cells have to match the HeightField ones.
+                    float dot_00_11 = normals[i00] * normals[i11];
+                    float dot_01_10 = normals[i01] * normals[i10];
+                    bool diagonal_00_11 = _fixedDiagonal ? !_swapOrientation : (dot_00_11 > dot_01_10);
+                    if (diagonal_00_11)
+                    {
+                        addElement(index, i01);
+                        addElement(index, i00);
+                        addElement(index, i11);
+
+                        addElement(index, i00);
+                        addElement(index, i10);
+                        addElement(index, i11);
+                    }
+                    else
+                    {
+                        addElement(index, i01);
+                        addElement(index, i00);
+                        addElement(index, i10);
+
+                        addElement(index, i01);
+                        addElement(index, i10);
+                        addElement(index, i11);
+                    }
+                }
+                else if (numValid==3)
+                {
+                    if (i00>=0) addElement(index, i00);
+                    if (i01>=0) addElement(index, i01);
+                    if (i11>=0) addElement(index, i11);
+                    if (i10>=0) addElement(index, i10);
+                }
+
+                _numCellIndices[cell] = index-cell*6;
+            }
+        }
+    }
+
+protected:
+    const VertexNormalGenerator&    _vng;
+    osg::DrawElements*              _elements;
+    std::vector<unsigned char>&     _numCellIndices;
+    bool                            _swapOrientation;
+    bool                            _fixedDiagonal;
+};
+
 void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLocator, const osg::Vec3d& centerModel)
 {
     Terrain* terrain = _terrainTile->getTerrain();
@@ -757,6 +1044,38 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
     if(buffer._transform.valid())
         buffer._transform->addChild(buffer._geode.get());
 
+    // reuse the geometry built the last time the tile was loaded, unless the tile is being rebuilt because its data has changed.
+    // The geometry of tiles with equalized boundaries depends upon their neighbours so can't be reused.
+    TileCache* tileCache = (terrain && !terrain->getEqualizeBoundaries() && _terrainTile->getTileID().valid()) ? terrain->getTileCache() : 0;
+    std::string tileCacheName;
+    if (tileCache)
+    {
+        // TileIDs are only unique within a database, so identify the source of the tile by its elevation file name and the
+        // extents of its master locator, so that databases sharing a Terrain don't pick up each other's geometry.
+        std::ostringstream os;
+        os<<"GeometryTechnique "<<terrain->getSampleRatio()<<" "<<terrain->getVerticalScale()<<" "<<_terrainTile->getNumColorLayers()<<" "<<_useHeightFieldForIntersections;
+        if (elevationLayer) os<<" "<<elevationLayer->getFileName();
+        if (masterLocator)
+        {
+            const osg::Matrixd& transform = masterLocator->getTransform();
+            os<<std::setprecision(17)<<" "<<masterLocator->getCoordinateSystemType()
+              <<" "<<transform(3,0)<<" "<<transform(3,1)<<" "<<transform(0,0)<<" "<<transform(1,1);
+        }
+        tileCacheName = os.str();
+
+        if (!_currentBufferData)
+        {
+            osg::ref_ptr<osg::Object> object = tileCache->getObject(_terrainTile->getTileID(), tileCacheName);
+            osg::Geometry* geometry = dynamic_cast<osg::Geometry*>(object.get());
+            if (geometry)
+            {
+                buffer._geometry = geometry;
+                buffer._geode->addDrawable(buffer._geometry.get());
+                return;
+            }
+        }
+    }
+
     buffer._geometry = new osg::Geometry;
     buffer._geode->addDrawable(buffer._geometry.get());
 
@@ -1002,71 +1321,33 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
         static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_TRIANGLES)) :
         static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_TRIANGLES));
 
-    elements->reserveElements((numRows-1) * (numColumns-1) * 6);
-
     geometry->addPrimitiveSet(elements.get());
 
+    // assign the grid as the shape of the geometry so that the intersectors only walk the cells under a line segment.
+    osg::ref_ptr<osg::HeightField> heightField = _useHeightFieldForIntersections ? VNG.createHeightField() : 0;
+    if (heightField.valid()) geometry->setShape(heightField.get());
 
-    unsigned int i, j;
-    for(j=0; j<numRows-1; ++j)
-    {
-        for(i=0; i<numColumns-1; ++i)
-        {
-            // remap indices to final vertex positions
-            int i00 = VNG.vertex_index(i,   j);
-            int i01 = VNG.vertex_index(i,   j+1);
-            int i10 = VNG.vertex_index(i+1, j);
-            int i11 = VNG.vertex_index(i+1, j+1);
-
-            if (swapOrientation)
-            {
-                std::swap(i00,i01);
-                std::swap(i10,i11);
-            }
-
-            unsigned int numValid = 0;
-            if (i00>=0) ++numValid;
-            if (i01>=0) ++numValid;
-            if (i10>=0) ++numValid;
-            if (i11>=0) ++numValid;
 
-            if (numValid==4)
-            {
-                // optimize which way to put the diagonal by choosing to
-                // place it between the two corners that have the least curvature
-                // relative to each other.
-                float dot_00_11 = (*VNG._normals)[i00] * (*VNG._normals)[i11];
-                float dot_01_10 = (*VNG._normals)[i01] * (*VNG._normals)[i10];
-                if (dot_00_11 > dot_01_10)
-                {
-                    elements->addElement(i01);
-                    elements->addElement(i00);
-                    elements->addElement(i11);
+    // triangulate blocks of rows of cells concurrently, each cell into its own six slots of the elements,
+    // then pack the indices of cells that have fewer than four valid vertices together.
+    unsigned int numCells = (numRows-1) * (numColumns-1);
+    std::vector<unsigned char> numCellIndices(numCells, 0);
+    elements->resizeElements(numCells*6);
 
-                    elements->addElement(i00);
-                    elements->addElement(i10);
-                    elements->addElement(i11);
-                }
-                else
-                {
-                    elements->addElement(i01);
-                    elements->addElement(i00);
-                    elements->addElement(i10);
+    TriangulateCellsOperation operation(VNG, elements.get(), numCellIndices, swapOrientation, heightField.valid());
+    osgUtil::WorkerThreadPool::instance()->run(operation, numRows-1, 16);
 
-                    elements->addElement(i01);
-                    elements->addElement(i10);
-                    elements->addElement(i11);
-                }
-            }
-            else if (numValid==3)
-            {
-                if (i00>=0) elements->addElement(i00);
-                if (i01>=0) elements->addElement(i01);
-                if (i11>=0) elements->addElement(i11);
-                if (i10>=0) elements->addElement(i10);
-            }
+    unsigned int numIndices = 0;
+    for(unsigned int cell=0; cell<numCells; ++cell)
+    {
+        unsigned int base = cell*6;
+        for(unsigned int n=0; n<numCellIndices[cell]; ++n)
+        {
+            if (numIndices!=base+n) elements->setElement(numIndices, elements->getElement(base+n));
+            ++numIndices;
         }
     }
+    if (numIndices!=numCells*6) elements->resizeElements(numIndices);
 
 
     if (createSkirt)
@@ -1274,10 +1555,13 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
         //osg::Timer_t before = osg::Timer::instance()->tick();
         //OSG_NOTICE<<"osgTerrain::GeometryTechnique::build kd tree"<<std::endl;
         osg::ref_ptr<osg::KdTreeBuilder> builder = osgDB::Registry::instance()->getKdTreeBuilder()->clone();
+        if (_useHeightFieldForIntersections) builder->setKeepHeightFieldShapes(true);
         buffer._geode->accept(*builder);
         //osg::Timer_t after = osg::Timer::instance()->tick();
         //OSG_NOTICE<<"KdTree build time "<<osg::Timer::instance()->delta_m(before, after)<<std::endl;
     }
+
+    if (tileCache) tileCache->addObject(_terrainTile->getTileID(), tileCacheName, geometry);
 }
 
 void GeometryTechnique::applyColorLayers(BufferData& buffer)
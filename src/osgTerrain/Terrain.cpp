@@ -38,6 +38,7 @@ Terrain::Terrain(const Terrain& ts, const osg::CopyOp& copyop):
     _blendingPolicy(ts._blendingPolicy),
     _equalizeBoundaries(ts._equalizeBoundaries),
     _geometryPool(ts._geometryPool),
+    _tileCache(ts._tileCache),
     _terrainTechnique(ts._terrainTechnique)
 {
     setNumChildrenRequiringUpdateTraversal(getNumChildrenRequiringUpdateTraversal()+1);
@@ -120,6 +121,11 @@ void Terrain::traverse(osg::NodeVisitor& nv)
                 TerrainTile* tile = itr->get();
                 tile->traverse(nv);
             }
+
+            if (_tileCache.valid() && nv.getFrameStamp())
+            {
+                _tileCache->updateStats(nv.getFrameStamp()->getFrameNumber());
+            }
         }
     }
 
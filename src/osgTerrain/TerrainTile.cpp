@@ -14,6 +14,7 @@
 #include <osgTerrain/TerrainTile>
 #include <osgTerrain/Terrain>
 #include <osgTerrain/GeometryTechnique>
+#include <osgTerrain/TileCache>
 
 #include <osg/ClusterCullingCallback>
 
@@ -298,14 +299,34 @@ bool WhiteListTileLoadedCallback::layerAcceptable(const std::string& setname) co
     return _setWhiteList.count(setname)!=0;
 }
 
+void WhiteListTileLoadedCallback::setTileCache(TileCache* tileCache)
+{
+    _tileCache = tileCache;
+}
+
 bool WhiteListTileLoadedCallback::readImageLayer(osgTerrain::ImageLayer* imageLayer, const osgDB::ReaderWriter::Options* options) const
+{
+    return readImageLayer(TileID(), imageLayer, options);
+}
+
+bool WhiteListTileLoadedCallback::readImageLayer(const TileID& tileID, osgTerrain::ImageLayer* imageLayer, const osgDB::ReaderWriter::Options* options) const
 {
    if (!imageLayer->getImage() &&
         !imageLayer->getFileName().empty())
     {
         if (layerAcceptable(imageLayer->getSetName()))
         {
-            osg::ref_ptr<osg::Image> image = osgDB::readImageFile(imageLayer->getFileName(), options);
+            TileCache* tileCache = tileID.valid() ? _tileCache.get() : 0;
+
+            osg::ref_ptr<osg::Image> image;
+            if (tileCache) image = dynamic_cast<osg::Image*>(tileCache->getObject(tileID, imageLayer->getFileName()).get());
+
+            if (!image)
+            {
+                image = osgDB::readImageFile(imageLayer->getFileName(), options);
+                if (tileCache && image.valid()) tileCache->addObject(tileID, imageLayer->getFileName(), image.get());
+            }
+
             imageLayer->setImage(image.get());
         }
     }
@@ -319,6 +340,7 @@ bool WhiteListTileLoadedCallback::deferExternalLayerLoading() const
 
 void WhiteListTileLoadedCallback::loaded(osgTerrain::TerrainTile* tile, const osgDB::ReaderWriter::Options* options) const
 {
+    const TileID& tileID = tile->getTileID();
 
     // read any external layers
     for(unsigned int i=0; i<tile->getNumColorLayers(); ++i)
@@ -327,7 +349,7 @@ void WhiteListTileLoadedCallback::loaded(osgTerrain::TerrainTile* tile, const os
         osgTerrain::ImageLayer* imageLayer = dynamic_cast<osgTerrain::ImageLayer*>(layer);
         if (imageLayer)
         {
-            readImageLayer(imageLayer, options);
+            readImageLayer(tileID, imageLayer, options);
             continue;
         }
 
@@ -339,7 +361,7 @@ void WhiteListTileLoadedCallback::loaded(osgTerrain::TerrainTile* tile, const os
                 osgTerrain::ImageLayer* imageLayer = dynamic_cast<osgTerrain::ImageLayer*>(switchLayer->getLayer(si));
                 if (imageLayer)
                 {
-                    if (readImageLayer(imageLayer, options))
+                    if (readImageLayer(tileID, imageLayer, options))
                     {
                         // replace SwitchLayer by
                         if (_replaceSwitchLayer) tile->setColorLayer(i, imageLayer);
@@ -360,7 +382,7 @@ void WhiteListTileLoadedCallback::loaded(osgTerrain::TerrainTile* tile, const os
                 osgTerrain::ImageLayer* imageLayer = dynamic_cast<osgTerrain::ImageLayer*>(compositeLayer->getLayer(ci));
                 if (imageLayer)
                 {
-                    readImageLayer(imageLayer, options);
+                    readImageLayer(tileID, imageLayer, options);
                 }
             }
             continue;
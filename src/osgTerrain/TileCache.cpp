@@ -0,0 +1,186 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2014 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgTerrain/TileCache>
+
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/Shape>
+
+#include <OpenThreads/ScopedLock>
+
+#include <limits>
+
+using namespace osgTerrain;
+
+TileCache::TileCache():
+    _cache(256*1024*1024),
+    _numHits(0),
+    _numMisses(0),
+    _statsFrameNumber(std::numeric_limits<unsigned int>::max()),
+    _statsNumHits(0),
+    _statsNumMisses(0)
+{
+}
+
+TileCache::~TileCache()
+{
+}
+
+void TileCache::setMaximumMemory(size_t maximumMemory)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _cache.setMaximumMemory(maximumMemory);
+}
+
+size_t TileCache::getMemoryUsed() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _cache.getMemoryUsed();
+}
+
+unsigned int TileCache::getNumObjects() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _cache.size();
+}
+
+void TileCache::addObject(const TileID& tileID, const std::string& name, osg::Object* object)
+{
+    if (!object) return;
+
+    // compute the memory outside of the lock as it may have to walk all the arrays of a geometry
+    size_t memory = computeMemory(object);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _cache.add(Key(tileID, name), object, memory);
+}
+
+osg::ref_ptr<osg::Object> TileCache::getObject(const TileID& tileID, const std::string& name)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    osg::Object* object = _cache.get(Key(tileID, name));
+    if (object) ++_numHits;
+    else ++_numMisses;
+
+    return object;
+}
+
+void TileCache::removeObject(const TileID& tileID, const std::string& name)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _cache.remove(Key(tileID, name));
+}
+
+namespace
+{
+    struct SameTile
+    {
+        SameTile(const TileID& tileID) : _tileID(tileID) {}
+        bool operator() (const std::pair<TileID, std::string>& key) const { return key.first==_tileID; }
+        TileID _tileID;
+    };
+}
+
+void TileCache::removeTile(const TileID& tileID)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    // the names of a tile's objects are sorted after the empty string, so all of them follow its lower bound
+    _cache.removeRange(Key(tileID, std::string()), SameTile(tileID));
+}
+
+void TileCache::clear()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _cache.clear();
+}
+
+size_t TileCache::computeMemory(const osg::Object* object) const
+{
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if (image) return image->getTotalSizeInBytesIncludingMipmaps();
+
+    const osg::HeightField* heightField = dynamic_cast<const osg::HeightField*>(object);
+    if (heightField) return size_t(heightField->getNumColumns())*heightField->getNumRows()*sizeof(float);
+
+    const osg::Geometry* geometry = dynamic_cast<const osg::Geometry*>(object);
+    if (geometry)
+    {
+        size_t memory = 0;
+        if (geometry->getVertexArray()) memory += geometry->getVertexArray()->getTotalDataSize();
+        if (geometry->getNormalArray()) memory += geometry->getNormalArray()->getTotalDataSize();
+        if (geometry->getColorArray()) memory += geometry->getColorArray()->getTotalDataSize();
+        for(unsigned int i=0; i<geometry->getNumTexCoordArrays(); ++i)
+        {
+            if (geometry->getTexCoordArray(i)) memory += geometry->getTexCoordArray(i)->getTotalDataSize();
+        }
+        for(unsigned int i=0; i<geometry->getNumVertexAttribArrays(); ++i)
+        {
+            if (geometry->getVertexAttribArray(i)) memory += geometry->getVertexAttribArray(i)->getTotalDataSize();
+        }
+        for(unsigned int i=0; i<geometry->getNumPrimitiveSets(); ++i)
+        {
+            memory += geometry->getPrimitiveSet(i)->getTotalDataSize();
+        }
+
+        const osg::HeightField* shape = dynamic_cast<const osg::HeightField*>(geometry->getShape());
+        if (shape) memory += computeMemory(shape);
+
+        return memory;
+    }
+
+    return 0;
+}
+
+void TileCache::resetStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _numHits = 0;
+    _numMisses = 0;
+    _statsNumHits = 0;
+    _statsNumMisses = 0;
+}
+
+void TileCache::updateStats(unsigned int frameNumber)
+{
+    if (!_stats) return;
+
+    unsigned int numHits, numMisses, statsNumHits, statsNumMisses;
+    size_t memoryUsed;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+        // several Terrains may share the cache, only record it once per frame
+        if (frameNumber==_statsFrameNumber) return;
+        _statsFrameNumber = frameNumber;
+
+        numHits = _numHits;
+        numMisses = _numMisses;
+        statsNumHits = _statsNumHits;
+        statsNumMisses = _statsNumMisses;
+        memoryUsed = _cache.getMemoryUsed();
+
+        _statsNumHits = _numHits;
+        _statsNumMisses = _numMisses;
+    }
+
+    _stats->setAttribute(frameNumber, "TileCache hits", double(numHits-statsNumHits));
+    _stats->setAttribute(frameNumber, "TileCache misses", double(numMisses-statsNumMisses));
+    if (numHits+numMisses>0) _stats->setAttribute(frameNumber, "TileCache hit ratio", double(numHits)/double(numHits+numMisses));
+    _stats->setAttribute(frameNumber, "TileCache memory", double(memoryUsed)/(1024.0*1024.0));
+}
@@ -1,6 +1,6 @@
 char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "\n"
-                                           "#pragma import_defines ( HEIGHTFIELD_LAYER, COMPUTE_DIAGONALS, LIGHTING )\n"
+                                           "#pragma import_defines ( HEIGHTFIELD_LAYER, COMPUTE_DIAGONALS, LIGHTING, LOD_MORPHING )\n"
                                            "\n"
                                            "#ifdef COMPUTE_DIAGONALS\n"
                                            "#extension GL_EXT_geometry_shader4 : enable\n"
@@ -10,6 +10,11 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "uniform sampler2D terrainTexture;\n"
                                            "#endif\n"
                                            "\n"
+                                           "#if defined(HEIGHTFIELD_LAYER) && defined(LOD_MORPHING)\n"
+                                           "uniform vec3 terrainLODCenter;\n"
+                                           "uniform vec2 terrainMorphRange;\n"
+                                           "#endif\n"
+                                           "\n"
                                            "#ifdef COMPUTE_DIAGONALS\n"
                                            "varying vec2 texcoord_in;\n"
                                            "varying vec3 normals_in;\n"
@@ -25,6 +30,17 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "void directionalLight( int lightNum, vec3 normal, inout vec4 color );\n"
                                            "#endif\n"
                                            "\n"
+                                           "#if defined(HEIGHTFIELD_LAYER) && defined(LOD_MORPHING) && defined(COMPUTE_DIAGONALS)\n"
+                                           "// approximate normal of the parent tile at texcoord, its samples being spacing apart, used to pick the diagonal\n"
+                                           "// the geometry shader splits the parent's quads along, the tilt of gl_Normal being the same at all four corners.\n"
+                                           "vec3 parentNormal(vec2 texcoord, vec2 spacing, vec2 slopeScale)\n"
+                                           "{\n"
+                                           "    float dz_dx = (texture2D(terrainTexture, vec2(texcoord.x+spacing.x, texcoord.y)).r - texture2D(terrainTexture, vec2(texcoord.x-spacing.x, texcoord.y)).r) * slopeScale.x;\n"
+                                           "    float dz_dy = (texture2D(terrainTexture, vec2(texcoord.x, texcoord.y+spacing.y)).r - texture2D(terrainTexture, vec2(texcoord.x, texcoord.y-spacing.y)).r) * slopeScale.y;\n"
+                                           "    return normalize(vec3(-dz_dx, -dz_dy, 1.0));\n"
+                                           "}\n"
+                                           "#endif\n"
+                                           "\n"
                                            "void main(void)\n"
                                            "{\n"
                                            "    vec2 texcoord_center = gl_MultiTexCoord0.xy;\n"
@@ -122,6 +138,35 @@ char terrain_displacement_mapping_vert[] = "#version 120\n"
                                            "    basecolor = color;\n"
                                            "#endif\n"
                                            "\n"
+                                           "#if defined(HEIGHTFIELD_LAYER) && defined(LOD_MORPHING)\n"
+                                           "    // as the tile nears the distance at which its LOD switches to the parent tile, blend towards the height\n"
+                                           "    // the parent tile has at this vertex, interpolated from the samples at even rows and columns it shares.\n"
+                                           "    vec2 texcoord_odd = mod(floor(texcoord_center/gl_Color.xy+0.5), 2.0) * gl_Color.xy;\n"
+                                           "\n"
+                                           "    // a vertex at an odd row and column is at the centre of a quad of the parent tile, which is drawn as two triangles\n"
+                                           "    // split along the diagonal from its first to its third corner, (c,r) to (c+1,r+1), unless the geometry shader\n"
+                                           "    // computing the diagonals picks the other one, from (c+1,r) to (c,r+1), whose corner normals are at least as alike.\n"
+                                           "    vec2 texcoord_diagonal = texcoord_odd;\n"
+                                           "#ifdef COMPUTE_DIAGONALS\n"
+                                           "    if (texcoord_odd.x>0.0 && texcoord_odd.y>0.0)\n"
+                                           "    {\n"
+                                           "        vec2 spacing = 2.0*gl_Color.xy;\n"
+                                           "        vec2 slopeScale = 0.25*gl_MultiTexCoord0.zw;\n"
+                                           "        vec3 normal_0 = parentNormal(texcoord_center-texcoord_odd, spacing, slopeScale);\n"
+                                           "        vec3 normal_1 = parentNormal(vec2(texcoord_center.x+texcoord_odd.x, texcoord_center.y-texcoord_odd.y), spacing, slopeScale);\n"
+                                           "        vec3 normal_2 = parentNormal(texcoord_center+texcoord_odd, spacing, slopeScale);\n"
+                                           "        vec3 normal_3 = parentNormal(vec2(texcoord_center.x-texcoord_odd.x, texcoord_center.y+texcoord_odd.y), spacing, slopeScale);\n"
+                                           "        if (dot(normal_2,normal_0)<=dot(normal_3,normal_1)) texcoord_diagonal.x = -texcoord_odd.x;\n"
+                                           "    }\n"
+                                           "#endif\n"
+                                           "    float height_parent = 0.5 * (texture2D(terrainTexture, texcoord_center-texcoord_diagonal).r +\n"
+                                           "                                 texture2D(terrainTexture, texcoord_center+texcoord_diagonal).r);\n"
+                                           "\n"
+                                           "    float lod_distance = length((gl_ModelViewMatrix * vec4(terrainLODCenter, 1.0)).xyz);\n"
+                                           "    float morph = clamp((lod_distance-terrainMorphRange.x)*terrainMorphRange.y, 0.0, 1.0);\n"
+                                           "    height_center = mix(height_center, height_parent, morph);\n"
+                                           "#endif\n"
+                                           "\n"
                                            "    vec3 position = gl_Vertex.xyz + gl_Normal.xyz * height_center;\n"
                                            "    gl_Position   = gl_ModelViewProjectionMatrix * vec4(position,1.0);\n"
                                            "\n"
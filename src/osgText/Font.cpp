@@ -26,12 +26,243 @@
 #include <string.h>
 
 #include <OpenThreads/ReentrantMutex>
+#include <OpenThreads/Block>
 
 #include "DefaultFont.h"
 
 using namespace osgText;
 using namespace std;
 
+// Lookup table of the glyphs of one font resolution, read without locking. The charcodes are split in pages
+// of 256 entries allocated as the glyphs are added. Entries are set once, with the Font's _glyphMapMutex
+// locked, after the glyph has been placed in its texture, and the glyphs remain owned by _sizeGlyphMap.
+class Font::GlyphTable
+{
+public:
+    enum { PAGE_SIZE = 256, NUM_PAGES = 0x110000/PAGE_SIZE };
+
+    GlyphTable(const FontResolution& fontRes) : _fontRes(fontRes) {}
+
+    ~GlyphTable()
+    {
+        for(unsigned int i=0; i<NUM_PAGES; ++i)
+        {
+            delete [] static_cast<OpenThreads::AtomicPtr*>(_pages[i].get());
+        }
+    }
+
+    const FontResolution& getFontResolution() const { return _fontRes; }
+
+    Glyph* getGlyph(unsigned int charcode) const
+    {
+        if (charcode>=NUM_PAGES*PAGE_SIZE) return 0;
+
+        OpenThreads::AtomicPtr* page = static_cast<OpenThreads::AtomicPtr*>(_pages[charcode/PAGE_SIZE].get());
+        return page ? static_cast<Glyph*>(page[charcode%PAGE_SIZE].get()) : 0;
+    }
+
+    void setGlyph(unsigned int charcode, Glyph* glyph)
+    {
+        if (charcode>=NUM_PAGES*PAGE_SIZE) return;
+
+        OpenThreads::AtomicPtr& pagePtr = _pages[charcode/PAGE_SIZE];
+        OpenThreads::AtomicPtr* page = static_cast<OpenThreads::AtomicPtr*>(pagePtr.get());
+        if (!page)
+        {
+            page = new OpenThreads::AtomicPtr[PAGE_SIZE];
+            pagePtr.assign(page, 0);
+        }
+
+        OpenThreads::AtomicPtr& entry = page[charcode%PAGE_SIZE];
+        entry.assign(glyph, entry.get());
+    }
+
+protected:
+
+    FontResolution          _fontRes;
+    OpenThreads::AtomicPtr  _pages[NUM_PAGES];
+};
+
+// Glyph being created by one thread, the other threads requesting it wait for it rather than rasterizing it again.
+class Font::GlyphRequest : public osg::Referenced
+{
+public:
+    GlyphRequest() : _glyph(0) {}
+
+    void wait() { _block.block(); }
+
+    void complete(Glyph* glyph)
+    {
+        _glyph = glyph;
+        _block.release();
+    }
+
+    Glyph* getGlyph() const { return _glyph; }
+
+protected:
+
+    virtual ~GlyphRequest() {}
+
+    OpenThreads::Block  _block;
+    Glyph*              _glyph;
+};
+
+namespace
+{
+
+// Take the seed of the neighbour (nr,nc) as the nearest seed of (r,c) when it's closer than its current one.
+inline void updateNearest(std::vector<int>& nearest, int width, int r, int c, int nr, int nc)
+{
+    int seed = nearest[nr*width+nc];
+    if (seed<0) return;
+
+    int& current = nearest[r*width+c];
+    if (current>=0)
+    {
+        int sr = seed/width-r, sc = seed%width-c;
+        int cr = current/width-r, cc = current%width-c;
+        if (sr*sr+sc*sc >= cr*cr+cc*cc) return;
+    }
+    current = seed;
+}
+
+// Replace the coverage image of the glyph by the signed distance to its outline, padded by spread texels on
+// each side. Each texel takes the distance to the nearest texel on the other side of the outline, offset by
+// the estimate of that texel's own distance to the outline given by its coverage, the texels covered
+// partially use their own estimate. Nearest texels are found with a two pass sequential distance transform.
+void createSignedDistanceField(Glyph* glyph, unsigned int spread)
+{
+    int sourceWidth = glyph->s();
+    int sourceHeight = glyph->t();
+    if (sourceWidth<=0 || sourceHeight<=0 || glyph->getPixelSizeInBits()!=8) return;
+
+    int border = spread;
+    int width = sourceWidth+2*border;
+    int height = sourceHeight+2*border;
+    int size = width*height;
+
+    // estimated distance of each texel to the outline, negative inside the glyph.
+    std::vector<float> estimate(size, 0.5f);
+    std::vector<bool> inside(size, false);
+    for(int r=0; r<sourceHeight; ++r)
+    {
+        const unsigned char* coverage = glyph->data(0,r);
+        for(int c=0; c<sourceWidth; ++c)
+        {
+            int i = (r+border)*width+c+border;
+            estimate[i] = 0.5f-float(coverage[c])/255.0f;
+            inside[i] = coverage[c]>=128;
+        }
+    }
+
+    std::vector<int> nearest(size);
+    std::vector<float> distance(size, float(spread));
+
+    for(int pass=0; pass<2; ++pass)
+    {
+        // nearest texel inside the glyph for the texels outside, then the reverse.
+        bool seedInside = (pass==0);
+        for(int i=0; i<size; ++i) nearest[i] = (inside[i]==seedInside) ? i : -1;
+
+        // forward pass from the neighbours above and to the left, backward pass from the ones below and to the right.
+        for(int r=0; r<height; ++r)
+        {
+            for(int c=0; c<width; ++c)
+            {
+                if (c>0) updateNearest(nearest, width, r, c, r, c-1);
+                if (r>0)
+                {
+                    if (c>0) updateNearest(nearest, width, r, c, r-1, c-1);
+                    updateNearest(nearest, width, r, c, r-1, c);
+                    if (c<width-1) updateNearest(nearest, width, r, c, r-1, c+1);
+                }
+            }
+            for(int c=width-2; c>=0; --c) updateNearest(nearest, width, r, c, r, c+1);
+        }
+
+        for(int r=height-1; r>=0; --r)
+        {
+            for(int c=width-1; c>=0; --c)
+            {
+                if (c<width-1) updateNearest(nearest, width, r, c, r, c+1);
+                if (r<height-1)
+                {
+                    if (c<width-1) updateNearest(nearest, width, r, c, r+1, c+1);
+                    updateNearest(nearest, width, r, c, r+1, c);
+                    if (c>0) updateNearest(nearest, width, r, c, r+1, c-1);
+                }
+            }
+            for(int c=1; c<width; ++c) updateNearest(nearest, width, r, c, r, c-1);
+        }
+
+        for(int i=0; i<size; ++i)
+        {
+            if (inside[i]==seedInside || nearest[i]<0) continue;
+
+            int sr = nearest[i]/width-i/width, sc = nearest[i]%width-i%width;
+            distance[i] = sqrtf(float(sr*sr+sc*sc))-fabsf(estimate[nearest[i]]);
+        }
+    }
+
+    unsigned char* data = new unsigned char[size];
+    for(int i=0; i<size; ++i)
+    {
+        float signedDistance = inside[i] ? -distance[i] : distance[i];
+        if (estimate[i]>-0.5f && estimate[i]<0.5f) signedDistance = estimate[i];
+
+        float value = 0.5f-signedDistance*0.5f/float(spread);
+        data[i] = static_cast<unsigned char>(osg::clampBetween(value, 0.0f, 1.0f)*255.0f+0.5f);
+    }
+
+    // extend the glyph quad over the padding, keeping the size of the texels in glyph coordinates.
+    float texelWidth = glyph->getWidth()>0.0f ? glyph->getWidth()/float(sourceWidth) : glyph->getHeight()/float(sourceHeight);
+    float texelHeight = glyph->getHeight()>0.0f ? glyph->getHeight()/float(sourceHeight) : texelWidth;
+    osg::Vec2 padding(float(border)*texelWidth, float(border)*texelHeight);
+
+    glyph->setWidth(glyph->getWidth()+2.0f*padding.x());
+    glyph->setHeight(glyph->getHeight()+2.0f*padding.y());
+    glyph->setHorizontalBearing(glyph->getHorizontalBearing()-padding);
+    glyph->setVerticalBearing(glyph->getVerticalBearing()-padding);
+
+    glyph->setImage(width, height, 1,
+                    glyph->getInternalTextureFormat(),
+                    glyph->getPixelFormat(), GL_UNSIGNED_BYTE,
+                    data,
+                    osg::Image::USE_NEW_DELETE,
+                    1);
+}
+
+#if defined(OSG_GL3_AVAILABLE) && !defined(OSG_GL2_AVAILABLE) && !defined(OSG_GL1_AVAILABLE)
+#define GLYPH_CHANNEL "r"
+#else
+#define GLYPH_CHANNEL "a"
+#endif
+
+const char* signedDistanceFieldVertexShader =
+    "varying vec2 texCoord;\n"
+    "varying vec4 vertexColor;\n"
+    "void main()\n"
+    "{\n"
+    "    texCoord = gl_MultiTexCoord0.xy;\n"
+    "    vertexColor = gl_Color;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+// the edge is where the distance field crosses 0.5, smoothed over about a pixel on screen.
+const char* signedDistanceFieldFragmentShader =
+    "uniform sampler2D glyphTexture;\n"
+    "varying vec2 texCoord;\n"
+    "varying vec4 vertexColor;\n"
+    "void main()\n"
+    "{\n"
+    "    float distance = texture2D(glyphTexture, texCoord)." GLYPH_CHANNEL ";\n"
+    "    float width = max(fwidth(distance)*0.7, 0.001);\n"
+    "    float alpha = smoothstep(0.5-width, 0.5+width, distance);\n"
+    "    gl_FragColor = vec4(vertexColor.rgb, vertexColor.a*alpha);\n"
+    "}\n";
+
+}
+
 static osg::ApplicationUsageProxy Font_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_TEXT_INCREMENTAL_SUBLOADING <type>","ON | OFF");
 
 
@@ -232,7 +463,10 @@ Font::Font(FontImplementation* implementation):
     _minFilterHint(osg::Texture::LINEAR_MIPMAP_LINEAR),
     _magFilterHint(osg::Texture::LINEAR),
     _depth(1),
-    _numCurveSamples(10)
+    _numCurveSamples(10),
+    _glyphImageMode(GREYSCALE),
+    _signedDistanceFieldResolution(32,32),
+    _signedDistanceFieldSpread(4)
 {
     setImplementation(implementation);
 
@@ -254,6 +488,31 @@ Font::Font(FontImplementation* implementation):
 Font::~Font()
 {
     if (_implementation.valid()) _implementation->_facade = 0;
+
+    for(unsigned int i=0; i<MAX_GLYPH_TABLES; ++i)
+    {
+        delete static_cast<GlyphTable*>(_glyphTables[i].get());
+    }
+}
+
+void Font::setGlyphImageMode(GlyphImageMode mode)
+{
+    _glyphImageMode = mode;
+
+    if (_glyphImageMode==SIGNED_DISTANCE_FIELD)
+    {
+        if (!_glyphProgram)
+        {
+            _glyphProgram = new osg::Program;
+            _glyphProgram->setName("SignedDistanceFieldGlyphs");
+            _glyphProgram->addShader(new osg::Shader(osg::Shader::VERTEX, signedDistanceFieldVertexShader));
+            _glyphProgram->addShader(new osg::Shader(osg::Shader::FRAGMENT, signedDistanceFieldFragmentShader));
+        }
+    }
+    else
+    {
+        _glyphProgram = 0;
+    }
 }
 
 void Font::setImplementation(FontImplementation* implementation)
@@ -348,13 +607,55 @@ osg::Texture::FilterMode Font::getMagFilterHint() const
 }
 
 
+Font::GlyphTable* Font::getGlyphTable(const FontResolution& fontRes) const
+{
+    for(unsigned int i=0; i<MAX_GLYPH_TABLES; ++i)
+    {
+        GlyphTable* table = static_cast<GlyphTable*>(_glyphTables[i].get());
+        if (!table) return 0;
+        if (table->getFontResolution()==fontRes) return table;
+    }
+    return 0;
+}
+
+Font::GlyphTable* Font::getOrCreateGlyphTable(const FontResolution& fontRes)
+{
+    for(unsigned int i=0; i<MAX_GLYPH_TABLES; ++i)
+    {
+        GlyphTable* table = static_cast<GlyphTable*>(_glyphTables[i].get());
+        if (!table)
+        {
+            table = new GlyphTable(fontRes);
+            _glyphTables[i].assign(table, 0);
+            return table;
+        }
+        if (table->getFontResolution()==fontRes) return table;
+    }
+    return 0;
+}
+
 Glyph* Font::getGlyph(const FontResolution& fontRes, unsigned int charcode)
 {
     if (!_implementation) return 0;
 
+    // signed distance field glyphs are shared by all the font resolutions.
     FontResolution fontResUsed(0,0);
-    if (_implementation->supportsMultipleFontResolutions()) fontResUsed = fontRes;
+    if (_implementation->supportsMultipleFontResolutions())
+    {
+        fontResUsed = (_glyphImageMode==SIGNED_DISTANCE_FIELD) ? _signedDistanceFieldResolution : fontRes;
+    }
+
+    // glyphs already created are found without locking.
+    GlyphTable* table = getGlyphTable(fontResUsed);
+    if (table)
+    {
+        Glyph* glyph = table->getGlyph(charcode);
+        if (glyph) return glyph;
+    }
 
+    GlyphKey key(fontResUsed, charcode);
+    osg::ref_ptr<GlyphRequest> request;
+    bool createGlyph = false;
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphMapMutex);
         FontSizeGlyphMap::iterator itr = _sizeGlyphMap.find(fontResUsed);
@@ -364,15 +665,38 @@ Glyph* Font::getGlyph(const FontResolution& fontRes, unsigned int charcode)
             GlyphMap::iterator gitr = glyphmap.find(charcode);
             if (gitr!=glyphmap.end()) return gitr->second.get();
         }
+
+        osg::ref_ptr<GlyphRequest>& pending = _glyphRequests[key];
+        if (!pending)
+        {
+            pending = new GlyphRequest;
+            createGlyph = true;
+        }
+        request = pending;
     }
 
-    Glyph* glyph = _implementation->getGlyph(fontResUsed, charcode);
-    if (glyph)
+    if (!createGlyph)
     {
-        addGlyph(fontResUsed, charcode, glyph);
-        return glyph;
+        // another thread is creating this glyph, wait for it.
+        request->wait();
+        return request->getGlyph();
+    }
+
+    // create the glyph without holding the lock so other glyphs can be looked up and created meanwhile.
+    osg::ref_ptr<Glyph> glyph = _implementation->getGlyph(fontResUsed, charcode);
+    if (glyph.valid())
+    {
+        if (_glyphImageMode==SIGNED_DISTANCE_FIELD) createSignedDistanceField(glyph.get(), _signedDistanceFieldSpread);
+        addGlyph(fontResUsed, charcode, glyph.get());
     }
-    else return 0;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_glyphMapMutex);
+        _glyphRequests.erase(key);
+    }
+    request->complete(glyph.get());
+
+    return glyph.get();
 }
 
 Glyph3D* Font::getGlyph3D(unsigned int charcode)
@@ -411,6 +735,7 @@ void Font::setThreadSafeRefUnref(bool threadSafe)
 void Font::resizeGLObjectBuffers(unsigned int maxSize)
 {
     if (_stateset.valid()) _stateset->resizeGLObjectBuffers(maxSize);
+    if (_glyphProgram.valid()) _glyphProgram->resizeGLObjectBuffers(maxSize);
 
     for(GlyphTextureList::const_iterator itr=_glyphTextureList.begin();
         itr!=_glyphTextureList.end();
@@ -423,6 +748,7 @@ void Font::resizeGLObjectBuffers(unsigned int maxSize)
 void Font::releaseGLObjects(osg::State* state) const
 {
     if (_stateset.valid()) _stateset->releaseGLObjects(state);
+    if (_glyphProgram.valid()) _glyphProgram->releaseGLObjects(state);
 
     for(GlyphTextureList::const_iterator itr=_glyphTextureList.begin();
         itr!=_glyphTextureList.end();
@@ -493,12 +819,15 @@ void Font::addGlyph(const FontResolution& fontRes, unsigned int charcode, Glyph*
         if (!glyphTexture->getSpaceForGlyph(glyph,posX,posY))
         {
             OSG_WARN<<"Warning: unable to allocate texture big enough for glyph"<<std::endl;
-            return;
+            glyphTexture = 0;
         }
 
     }
 
     // add the glyph into the texture.
-    glyphTexture->addGlyph(glyph,posX,posY);
+    if (glyphTexture) glyphTexture->addGlyph(glyph,posX,posY);
 
+    // publish the glyph for lookups without locking once it's complete.
+    GlyphTable* table = getOrCreateGlyphTable(fontRes);
+    if (table) table->setGlyph(charcode, glyph);
 }
@@ -1371,6 +1371,16 @@ void Text::drawImplementation(osg::State& state, const osg::Vec4& colorMultiplie
 
         state.disableAllVertexArrays();
 
+        // signed distance field glyphs are drawn with the font's shader, restoring the previous program afterwards
+        // so that the bounding box and alignment are still drawn by the fixed function pipeline.
+        const osg::Program* glyphProgram = getActiveFont()->getGlyphProgram();
+        const osg::StateAttribute* previousProgram = 0;
+        if (glyphProgram)
+        {
+            previousProgram = state.getLastAppliedAttribute(osg::StateAttribute::PROGRAM);
+            state.applyAttribute(glyphProgram);
+        }
+
         // Okay, since ATI's cards/drivers are not working correctly,
         // we need alternative solutions to glPolygonOffset.
         // So this is a pick your poison approach. Each alternative
@@ -1404,6 +1414,20 @@ void Text::drawImplementation(osg::State& state, const osg::Vec4& colorMultiplie
         // unbind buffers if necessary
         state.unbindVertexBufferObject();
         state.unbindElementBufferObject();
+
+        if (glyphProgram)
+        {
+            if (previousProgram)
+            {
+                state.applyAttribute(previousProgram);
+            }
+            else
+            {
+                state.get<osg::GLExtensions>()->glUseProgram(0);
+                state.setLastAppliedProgramObject(0);
+                state.haveAppliedAttribute(osg::StateAttribute::PROGRAM);
+            }
+        }
     }
 
     if (_drawMode & BOUNDINGBOX)
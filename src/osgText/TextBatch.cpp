@@ -0,0 +1,488 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgText/TextBatch>
+
+#include <osg/Notify>
+#include <osg/State>
+
+#include <algorithm>
+
+using namespace osgText;
+
+TextBatch::GlyphBatch::GlyphBatch():
+    numUnusedQuads(0)
+{
+}
+
+TextBatch::TextBatch():
+    _enableDepthWrites(true)
+{
+    // the arrays are rewritten as the Text change so use vertex buffer objects rather than display lists.
+    setSupportsDisplayList(false);
+    setUseVertexBufferObjects(true);
+    setStateSet(Font::getDefaultFont()->getStateSet());
+
+    // the arrays are modified during the update traversal so mustn't overlap the draw of the previous frame.
+    setDataVariance(osg::Object::DYNAMIC);
+}
+
+TextBatch::TextBatch(const TextBatch& batch,const osg::CopyOp& copyop):
+    osg::Drawable(batch,copyop),
+    _enableDepthWrites(batch._enableDepthWrites)
+{
+    for(TextList::const_iterator itr = batch._texts.begin();
+        itr != batch._texts.end();
+        ++itr)
+    {
+        addText(const_cast<Text*>(itr->get()));
+    }
+}
+
+TextBatch::~TextBatch()
+{
+}
+
+bool TextBatch::addText(Text* text)
+{
+    if (!text || containsText(text)) return false;
+
+    if (text->getCharacterSizeMode()!=Text::OBJECT_COORDS || text->getAutoRotateToScreen())
+    {
+        OSG_NOTICE<<"Warning: TextBatch::addText() only batches Text with OBJECT_COORDS character size mode and without auto rotation to screen."<<std::endl;
+        return false;
+    }
+
+    // share the state of the first Text, normally the state of its font.
+    if (_texts.empty() && getStateSet()==Font::getDefaultFont()->getStateSet())
+    {
+        setStateSet(text->getStateSet());
+    }
+
+    _texts.push_back(text);
+    writeText(text);
+
+    dirtyBound();
+    return true;
+}
+
+bool TextBatch::removeText(Text* text)
+{
+    TextList::iterator itr = std::find(_texts.begin(), _texts.end(), text);
+    if (itr==_texts.end()) return false;
+
+    for(GlyphBatchMap::iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        releaseRange(bitr->second, text);
+    }
+
+    _texts.erase(itr);
+
+    dirtyBound();
+    return true;
+}
+
+void TextBatch::clear()
+{
+    _texts.clear();
+    _glyphBatches.clear();
+    dirtyBound();
+}
+
+bool TextBatch::containsText(const Text* text) const
+{
+    for(TextList::const_iterator itr = _texts.begin();
+        itr != _texts.end();
+        ++itr)
+    {
+        if (itr->get()==text) return true;
+    }
+    return false;
+}
+
+void TextBatch::dirtyText(Text* text)
+{
+    if (!containsText(text)) return;
+
+    // release the quads in the glyph textures the Text no longer uses.
+    const Text::TextureGlyphQuadMap& glyphQuadMap = text->getTextureGlyphQuadMap();
+    for(GlyphBatchMap::iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        if (glyphQuadMap.find(bitr->first)==glyphQuadMap.end()) releaseRange(bitr->second, text);
+    }
+
+    writeText(text);
+
+    dirtyBound();
+}
+
+unsigned int TextBatch::getNumGlyphs() const
+{
+    unsigned int numGlyphs = 0;
+    for(GlyphBatchMap::const_iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        const TextRangeMap& ranges = bitr->second.ranges;
+        for(TextRangeMap::const_iterator ritr = ranges.begin(); ritr != ranges.end(); ++ritr)
+        {
+            numGlyphs += ritr->second.numQuads;
+        }
+    }
+    return numGlyphs;
+}
+
+TextBatch::GlyphBatch& TextBatch::getOrCreateGlyphBatch(GlyphTexture* texture, const Font* font)
+{
+    GlyphBatch& glyphBatch = _glyphBatches[texture];
+    if (!glyphBatch.vertices)
+    {
+        glyphBatch.font = font;
+
+        osg::VertexBufferObject* vbo = new osg::VertexBufferObject;
+        vbo->setUsage(GL_DYNAMIC_DRAW_ARB);
+
+        glyphBatch.vertices = new osg::Vec3Array;
+        glyphBatch.vertices->setBinding(osg::Array::BIND_PER_VERTEX);
+        glyphBatch.vertices->setVertexBufferObject(vbo);
+
+        glyphBatch.texcoords = new osg::Vec2Array;
+        glyphBatch.texcoords->setBinding(osg::Array::BIND_PER_VERTEX);
+        glyphBatch.texcoords->setVertexBufferObject(vbo);
+
+        glyphBatch.colors = new osg::Vec4Array;
+        glyphBatch.colors->setBinding(osg::Array::BIND_PER_VERTEX);
+        glyphBatch.colors->setVertexBufferObject(vbo);
+
+        glyphBatch.indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+        glyphBatch.indices->setElementBufferObject(new osg::ElementBufferObject);
+    }
+    return glyphBatch;
+}
+
+void TextBatch::writeText(const Text* text)
+{
+    const Font* font = text->getFont() ? text->getFont() : Font::getDefaultFont().get();
+
+    const Text::TextureGlyphQuadMap& glyphQuadMap = text->getTextureGlyphQuadMap();
+    for(Text::TextureGlyphQuadMap::const_iterator titr = glyphQuadMap.begin();
+        titr != glyphQuadMap.end();
+        ++titr)
+    {
+        GlyphBatch& glyphBatch = getOrCreateGlyphBatch(titr->first.get(), font);
+        const Text::GlyphQuads& glyphQuads = titr->second;
+        unsigned int numQuads = static_cast<unsigned int>(glyphQuads._glyphs.size());
+
+        // rewrite the quads in place when they fit, otherwise move them to the end of the arrays.
+        TextRangeMap::iterator ritr = glyphBatch.ranges.find(text);
+        if (ritr!=glyphBatch.ranges.end() && numQuads<=ritr->second.capacity)
+        {
+            writeQuads(glyphBatch, text, &glyphQuads, ritr->second);
+            continue;
+        }
+
+        if (ritr!=glyphBatch.ranges.end()) releaseRange(glyphBatch, text);
+
+        TextRange& range = glyphBatch.ranges[text];
+        range.first = static_cast<unsigned int>(glyphBatch.vertices->size()/4);
+        range.capacity = numQuads;
+        resize(glyphBatch, range.first+numQuads);
+
+        writeQuads(glyphBatch, text, &glyphQuads, range);
+    }
+}
+
+void TextBatch::writeQuads(GlyphBatch& glyphBatch, const Text* text, const Text::GlyphQuads* glyphQuads, TextRange& range)
+{
+    // the glyphs of Text in OBJECT_COORDS don't depend on the view, the positions of the first context serve all of them.
+    const Text::GlyphQuads::Coords3& coords = glyphQuads->getTransformedCoords(0);
+    const Text::GlyphQuads::TexCoords& texcoords = glyphQuads->getTexCoords();
+    const Text::GlyphQuads::ColorCoords& colors = glyphQuads->_colorCoords;
+
+    unsigned int numQuads = static_cast<unsigned int>(glyphQuads->_glyphs.size());
+    if (!coords || coords->size()<numQuads*4 || texcoords->size()<numQuads*4) numQuads = 0;
+
+    bool gradient = text->getColorGradientMode()!=Text::SOLID && colors.valid() && colors->size()>=numQuads*4;
+    const osg::Vec4& color = text->getColor();
+
+    unsigned int first = range.first*4;
+    for(unsigned int i=0; i<numQuads*4; ++i)
+    {
+        (*glyphBatch.vertices)[first+i] = (*coords)[i];
+        (*glyphBatch.texcoords)[first+i] = (*texcoords)[i];
+        (*glyphBatch.colors)[first+i] = gradient ? (*colors)[i] : color;
+    }
+
+    clearQuads(glyphBatch, range.first+numQuads, range.capacity-numQuads);
+    range.numQuads = numQuads;
+
+    glyphBatch.vertices->dirty();
+    glyphBatch.texcoords->dirty();
+    glyphBatch.colors->dirty();
+}
+
+void TextBatch::clearQuads(GlyphBatch& glyphBatch, unsigned int first, unsigned int numQuads)
+{
+    // collapse the quads to a point so that they don't cover any pixels.
+    for(unsigned int i=first*4; i<(first+numQuads)*4; ++i)
+    {
+        (*glyphBatch.vertices)[i].set(0.0f,0.0f,0.0f);
+    }
+}
+
+void TextBatch::releaseRange(GlyphBatch& glyphBatch, const Text* text)
+{
+    TextRangeMap::iterator ritr = glyphBatch.ranges.find(text);
+    if (ritr==glyphBatch.ranges.end()) return;
+
+    clearQuads(glyphBatch, ritr->second.first, ritr->second.capacity);
+    glyphBatch.vertices->dirty();
+    glyphBatch.numUnusedQuads += ritr->second.capacity;
+    glyphBatch.ranges.erase(ritr);
+
+    // compact once more than half the quads are unused.
+    if (glyphBatch.numUnusedQuads*2 > glyphBatch.vertices->size()/4) compact(glyphBatch);
+}
+
+namespace
+{
+    struct LessFirst
+    {
+        template<class R>
+        bool operator() (const R* lhs, const R* rhs) const { return lhs->first < rhs->first; }
+    };
+}
+
+void TextBatch::compact(GlyphBatch& glyphBatch)
+{
+    // move the ranges down in the order they're in the arrays, so that a range is never copied over one not yet moved.
+    std::vector<TextRange*> ranges;
+    ranges.reserve(glyphBatch.ranges.size());
+    for(TextRangeMap::iterator ritr = glyphBatch.ranges.begin();
+        ritr != glyphBatch.ranges.end();
+        ++ritr)
+    {
+        ranges.push_back(&(ritr->second));
+    }
+    std::sort(ranges.begin(), ranges.end(), LessFirst());
+
+    unsigned int numQuads = 0;
+    for(std::vector<TextRange*>::iterator ritr = ranges.begin();
+        ritr != ranges.end();
+        ++ritr)
+    {
+        TextRange& range = **ritr;
+        unsigned int from = range.first*4;
+        unsigned int to = numQuads*4;
+        if (from!=to)
+        {
+            std::copy(glyphBatch.vertices->begin()+from, glyphBatch.vertices->begin()+from+range.numQuads*4, glyphBatch.vertices->begin()+to);
+            std::copy(glyphBatch.texcoords->begin()+from, glyphBatch.texcoords->begin()+from+range.numQuads*4, glyphBatch.texcoords->begin()+to);
+            std::copy(glyphBatch.colors->begin()+from, glyphBatch.colors->begin()+from+range.numQuads*4, glyphBatch.colors->begin()+to);
+        }
+        range.first = numQuads;
+        range.capacity = range.numQuads;
+        numQuads += range.numQuads;
+    }
+
+    glyphBatch.numUnusedQuads = 0;
+    resize(glyphBatch, numQuads);
+
+    glyphBatch.vertices->dirty();
+    glyphBatch.texcoords->dirty();
+    glyphBatch.colors->dirty();
+}
+
+void TextBatch::resize(GlyphBatch& glyphBatch, unsigned int numQuads)
+{
+    unsigned int previousNumQuads = static_cast<unsigned int>(glyphBatch.vertices->size()/4);
+    if (numQuads==previousNumQuads) return;
+
+    glyphBatch.vertices->resize(numQuads*4);
+    glyphBatch.texcoords->resize(numQuads*4);
+    glyphBatch.colors->resize(numQuads*4);
+
+    osg::DrawElementsUInt& indices = *glyphBatch.indices;
+    indices.resize(numQuads*6);
+    for(unsigned int q=previousNumQuads; q<numQuads; ++q)
+    {
+        unsigned int i = q*4;
+        unsigned int* quad = &indices[q*6];
+        quad[0] = i; quad[1] = i+1; quad[2] = i+3;
+        quad[3] = i+1; quad[4] = i+2; quad[5] = i+3;
+    }
+    indices.dirty();
+}
+
+void TextBatch::drawImplementation(osg::RenderInfo& renderInfo) const
+{
+    osg::State& state = *renderInfo.getState();
+
+    state.applyMode(GL_BLEND,true);
+#if defined(OSG_GL_FIXED_FUNCTION_AVAILABLE)
+    state.applyTextureMode(0,GL_TEXTURE_2D,osg::StateAttribute::ON);
+#endif
+
+    // draw without writing the depth so that the margins of neighbouring glyphs don't hide each other.
+    if (!state.getLastAppliedMode(GL_DEPTH_TEST))
+    {
+        drawGlyphs(state);
+        return;
+    }
+
+    glDepthMask(GL_FALSE);
+    drawGlyphs(state);
+
+    if (_enableDepthWrites)
+    {
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        drawGlyphs(state);
+    }
+
+    state.haveAppliedAttribute(osg::StateAttribute::DEPTH);
+    state.haveAppliedAttribute(osg::StateAttribute::COLORMASK);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void TextBatch::drawGlyphs(osg::State& state) const
+{
+    state.disableAllVertexArrays();
+
+    const osg::StateAttribute* previousProgram = state.getLastAppliedAttribute(osg::StateAttribute::PROGRAM);
+    bool programApplied = false;
+
+    for(GlyphBatchMap::const_iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        const GlyphBatch& glyphBatch = bitr->second;
+        if (glyphBatch.indices->empty()) continue;
+
+        state.applyTextureAttribute(0,bitr->first.get());
+#if defined(OSG_GL_FIXED_FUNCTION_AVAILABLE)
+        state.applyTextureAttribute(0,glyphBatch.font->getTexEnv());
+#endif
+
+        // signed distance field glyphs are drawn with their font's shader, see Text::drawImplementation().
+        const osg::Program* glyphProgram = glyphBatch.font->getGlyphProgram();
+        if (glyphProgram)
+        {
+            state.applyAttribute(glyphProgram);
+            programApplied = true;
+        }
+        else if (programApplied)
+        {
+            state.get<osg::GLExtensions>()->glUseProgram(0);
+            state.setLastAppliedProgramObject(0);
+            state.haveAppliedAttribute(osg::StateAttribute::PROGRAM);
+            programApplied = false;
+        }
+
+        state.setVertexPointer(glyphBatch.vertices.get());
+        state.setTexCoordPointer(0, glyphBatch.texcoords.get());
+        state.setColorPointer(glyphBatch.colors.get());
+
+        glyphBatch.indices->draw(state, true);
+    }
+
+    state.unbindVertexBufferObject();
+    state.unbindElementBufferObject();
+
+    if (programApplied)
+    {
+        if (previousProgram)
+        {
+            state.applyAttribute(previousProgram);
+        }
+        else
+        {
+            state.get<osg::GLExtensions>()->glUseProgram(0);
+            state.setLastAppliedProgramObject(0);
+            state.haveAppliedAttribute(osg::StateAttribute::PROGRAM);
+        }
+    }
+}
+
+osg::BoundingBox TextBatch::computeBoundingBox() const
+{
+    osg::BoundingBox bbox;
+    for(TextList::const_iterator itr = _texts.begin();
+        itr != _texts.end();
+        ++itr)
+    {
+        bbox.expandBy((*itr)->getBoundingBox());
+    }
+    return bbox;
+}
+
+void TextBatch::accept(osg::Drawable::ConstAttributeFunctor& af) const
+{
+    for(GlyphBatchMap::const_iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        const GlyphBatch& glyphBatch = bitr->second;
+        if (glyphBatch.vertices->empty()) continue;
+
+        af.apply(osg::Drawable::VERTICES, glyphBatch.vertices->size(), &(glyphBatch.vertices->front()));
+        af.apply(osg::Drawable::TEXTURE_COORDS_0, glyphBatch.texcoords->size(), &(glyphBatch.texcoords->front()));
+    }
+}
+
+void TextBatch::accept(osg::PrimitiveFunctor& pf) const
+{
+    for(GlyphBatchMap::const_iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        const GlyphBatch& glyphBatch = bitr->second;
+        if (glyphBatch.vertices->empty()) continue;
+
+        pf.setVertexArray(glyphBatch.vertices->size(), &(glyphBatch.vertices->front()));
+        pf.drawElements(GL_TRIANGLES, glyphBatch.indices->size(), &(glyphBatch.indices->front()));
+    }
+}
+
+void TextBatch::resizeGLObjectBuffers(unsigned int maxSize)
+{
+    osg::Drawable::resizeGLObjectBuffers(maxSize);
+
+    for(GlyphBatchMap::iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        GlyphBatch& glyphBatch = bitr->second;
+        glyphBatch.vertices->resizeGLObjectBuffers(maxSize);
+        glyphBatch.indices->resizeGLObjectBuffers(maxSize);
+    }
+}
+
+void TextBatch::releaseGLObjects(osg::State* state) const
+{
+    osg::Drawable::releaseGLObjects(state);
+
+    for(GlyphBatchMap::const_iterator bitr = _glyphBatches.begin();
+        bitr != _glyphBatches.end();
+        ++bitr)
+    {
+        const GlyphBatch& glyphBatch = bitr->second;
+        glyphBatch.vertices->releaseGLObjects(state);
+        glyphBatch.indices->releaseGLObjects(state);
+    }
+}
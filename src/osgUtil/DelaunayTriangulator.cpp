@@ -24,6 +24,7 @@
 #include <set>
 #include <map> //GWM July 2005 map is used in constraints.
 #include <osgUtil/Tessellator> // tessellator triangulates the constrained triangles
+#include <osgUtil/WorkerThreadPool>
 #include <stdlib.h>
 #include <iterator>
 
@@ -357,10 +358,6 @@ bool Sample_point_compare(const osg::Vec3 &p1, const osg::Vec3 &p2)
 }
 
 
-// container types
-typedef std::set<Edge, Edge::Less> Edge_set;
-
-
 DelaunayTriangulator::DelaunayTriangulator():
     osg::Referenced()
 {
@@ -385,23 +382,6 @@ DelaunayTriangulator::~DelaunayTriangulator()
 {
 }
 
-const Triangle * getTriangleWithEdge(const unsigned int ip1,const unsigned int ip2, const Triangle_list *triangles)
-{ // find triangle in list with edge from ip1 to ip2...
-    Triangle_list::const_iterator trconnitr; // connecting triangle
-    int idx=0;
-    for (trconnitr=triangles->begin(); trconnitr!=triangles->end(); )
-    {
-        if (trconnitr->isedge (ip1,ip2))
-        {
-            // this is the triangle.
-            return &(*trconnitr);
-        }
-        ++trconnitr;
-        idx++;
-    }
-    return NULL; //-1;
-}
-
 int DelaunayTriangulator::getindex(const osg::Vec3 &pt,const osg::Vec3Array *points)
 {
     // return index of pt in points (or -1)
@@ -740,6 +720,594 @@ osgUtil::DelaunayConstraint *getconvexhull(osg::Vec3Array *points)
     return dcconvexhull.release();
 }
 
+// Lookup of sample point indices by their x,y position.  The first numSorted points must be
+// sorted by x then y, points added afterwards are held in a map.
+class PointLookup
+{
+public:
+
+    PointLookup(const osg::Vec3Array* points, unsigned int numSorted):
+        _points(points),
+        _numSorted(numSorted) {}
+
+    int find(const osg::Vec3& pt) const
+    {
+        // binary search on the sorted points
+        unsigned int lo = 0, hi = _numSorted;
+        while (lo<hi)
+        {
+            unsigned int mid = lo + (hi-lo)/2;
+            const osg::Vec3& mp = (*_points)[mid];
+            if (mp.x()<pt.x() || (mp.x()==pt.x() && mp.y()<pt.y())) lo = mid+1;
+            else hi = mid;
+        }
+        if (lo<_numSorted && (*_points)[lo].x()==pt.x() && (*_points)[lo].y()==pt.y()) return lo;
+
+        ExtraPoints::const_iterator itr = _extraPoints.find(std::make_pair(pt.x(), pt.y()));
+        return itr!=_extraPoints.end() ? static_cast<int>(itr->second) : -1;
+    }
+
+    void add(const osg::Vec3& pt, unsigned int index)
+    {
+        _extraPoints.insert(std::make_pair(std::make_pair(pt.x(), pt.y()), index));
+    }
+
+protected:
+
+    typedef std::map< std::pair<float, float>, unsigned int > ExtraPoints;
+
+    const osg::Vec3Array*   _points;
+    unsigned int            _numSorted;
+    ExtraPoints             _extraPoints;
+};
+
+// Resolves the point indices of the vertices of a constraint primitive set.
+struct ResolveConstraintIndices : public WorkerThreadPool::RangeOperation
+{
+    ResolveConstraintIndices(const PointLookup& lookup, const osg::Vec3Array* vercon, const osg::PrimitiveSet* prset, std::vector<int>& indices):
+        _lookup(lookup), _vercon(vercon), _prset(prset), _indices(indices) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            _indices[i] = _lookup.find((*_vercon)[_prset->index(i)]);
+        }
+    }
+
+    const PointLookup&          _lookup;
+    const osg::Vec3Array*       _vercon;
+    const osg::PrimitiveSet*    _prset;
+    std::vector<int>&           _indices;
+};
+
+// interleave the bits of the lower 16 bits of x with zeros
+inline unsigned int spreadBits(unsigned int x)
+{
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+// CLASS: DelaunayMesh
+// Triangulation held as counter clockwise triangles with links to their neighbours, so that
+// points can be located by walking across the mesh and the Delaunay property can be restored
+// locally by edge flipping.  Triangle i has neighbour n[k] across the edge opposite v[k].
+
+class DelaunayMesh
+{
+public:
+
+    enum { NONE = 0xffffffff };
+
+    struct Tri
+    {
+        Vertex_index v[3];
+        unsigned int n[3];
+    };
+
+    // points [0, numPoints) are the sample points, [numPoints, numPoints+4) the corners of the super quad.
+    DelaunayMesh(osg::Vec3Array* points, unsigned int numPoints);
+
+    // insert all the sample points, in an order that keeps successive points close together.
+    void triangulate();
+
+    // force the edge ip1-ip2 into the triangulation by replacing the triangles that it crosses.
+    void insertConstraintEdge(Vertex_index ip1, Vertex_index ip2);
+
+    unsigned int getNumTriangles() const { return _tris.size(); }
+    bool valid(unsigned int t) const { return _tris[t].v[0]!=NONE; }
+    const Tri& getTriangle(unsigned int t) const { return _tris[t]; }
+
+protected:
+
+    double orient(Vertex_index a, Vertex_index b, Vertex_index p) const
+    {
+        const osg::Vec3& pa = (*_points)[a];
+        const osg::Vec3& pb = (*_points)[b];
+        const osg::Vec3& pp = (*_points)[p];
+        return (double(pb.x())-double(pa.x()))*(double(pp.y())-double(pa.y())) -
+               (double(pb.y())-double(pa.y()))*(double(pp.x())-double(pa.x()));
+    }
+
+    // positive if d lies inside the circumcircle of the counter clockwise triangle a,b,c
+    double incircle(Vertex_index a, Vertex_index b, Vertex_index c, Vertex_index d) const
+    {
+        const osg::Vec3& pd = (*_points)[d];
+        double adx = double((*_points)[a].x())-double(pd.x()), ady = double((*_points)[a].y())-double(pd.y());
+        double bdx = double((*_points)[b].x())-double(pd.x()), bdy = double((*_points)[b].y())-double(pd.y());
+        double cdx = double((*_points)[c].x())-double(pd.x()), cdy = double((*_points)[c].y())-double(pd.y());
+        return (adx*adx+ady*ady)*(bdx*cdy-cdx*bdy) +
+               (bdx*bdx+bdy*bdy)*(cdx*ady-adx*cdy) +
+               (cdx*cdx+cdy*cdy)*(adx*bdy-bdx*ady);
+    }
+
+    static int indexOf(const Tri& tri, Vertex_index v)
+    {
+        return tri.v[0]==v ? 0 : (tri.v[1]==v ? 1 : (tri.v[2]==v ? 2 : -1));
+    }
+
+    // redirect the link of triangle t that points to oldNeighbour so it points to newNeighbour
+    void relink(unsigned int t, unsigned int oldNeighbour, unsigned int newNeighbour)
+    {
+        if (t==NONE) return;
+        Tri& tri = _tris[t];
+        for(int k=0; k<3; ++k)
+        {
+            if (tri.n[k]==oldNeighbour) { tri.n[k] = newNeighbour; return; }
+        }
+    }
+
+    void setTriangle(unsigned int t, Vertex_index a, Vertex_index b, Vertex_index c, unsigned int na, unsigned int nb, unsigned int nc)
+    {
+        Tri& tri = _tris[t];
+        tri.v[0] = a; tri.v[1] = b; tri.v[2] = c;
+        tri.n[0] = na; tri.n[1] = nb; tri.n[2] = nc;
+        _vertexTri[a] = t; _vertexTri[b] = t; _vertexTri[c] = t;
+    }
+
+    unsigned int allocateTriangle()
+    {
+        if (!_freeTris.empty())
+        {
+            unsigned int t = _freeTris.back();
+            _freeTris.pop_back();
+            return t;
+        }
+        _tris.push_back(Tri());
+        return _tris.size()-1;
+    }
+
+    unsigned int locate(Vertex_index p, unsigned int start) const;
+    unsigned int insertPoint(Vertex_index p, unsigned int start);
+    void legalize(Vertex_index p);
+
+    void getTrianglesAroundVertex(Vertex_index v, std::vector<unsigned int>& triangles) const;
+    unsigned int findTriangleWithEdge(Vertex_index ip1, Vertex_index ip2) const;
+    bool hasEdge(Vertex_index ip1, Vertex_index ip2) const;
+    void replaceTriangles(std::vector<unsigned int>& oldTris, const Triangle_list& newTris);
+
+    // edge a-b of a removed triangle, with the triangle t outside it that links to it via n[k]
+    struct BoundaryEdge
+    {
+        Vertex_index a, b;
+        unsigned int t;
+        int k;
+    };
+
+    osg::Vec3Array*                 _points;
+    unsigned int                    _numPoints;
+    std::vector<Tri>                _tris;
+    std::vector<unsigned int>       _vertexTri;
+    std::vector<unsigned int>       _freeTris;
+    std::vector< std::pair<unsigned int, int> > _flipStack;
+    mutable std::vector<unsigned int> _star;
+};
+
+DelaunayMesh::DelaunayMesh(osg::Vec3Array* points, unsigned int numPoints):
+    _points(points),
+    _numPoints(numPoints)
+{
+    _tris.reserve(2*numPoints+2);
+    _vertexTri.resize(numPoints+4, static_cast<unsigned int>(NONE));
+
+    // the two super triangles covering the super quad
+    _tris.resize(2);
+    setTriangle(0, numPoints, numPoints+1, numPoints+2, NONE, 1, NONE);
+    setTriangle(1, numPoints+3, numPoints, numPoints+2, 0, NONE, NONE);
+}
+
+void DelaunayMesh::triangulate()
+{
+    if (_numPoints==0) return;
+
+    // insert the points in Morton order, so that each point is close to the previous one and
+    // the walk to locate it only crosses a few triangles.
+    float minx = (*_points)[0].x(), maxx = minx;
+    float miny = (*_points)[0].y(), maxy = miny;
+    for(unsigned int i=1; i<_numPoints; ++i)
+    {
+        const osg::Vec3& pt = (*_points)[i];
+        if (pt.x()<minx) minx = pt.x(); else if (pt.x()>maxx) maxx = pt.x();
+        if (pt.y()<miny) miny = pt.y(); else if (pt.y()>maxy) maxy = pt.y();
+    }
+    double sx = maxx>minx ? 65535.0/(double(maxx)-double(minx)) : 0.0;
+    double sy = maxy>miny ? 65535.0/(double(maxy)-double(miny)) : 0.0;
+
+    std::vector< std::pair<unsigned int, unsigned int> > order(_numPoints);
+    for(unsigned int i=0; i<_numPoints; ++i)
+    {
+        const osg::Vec3& pt = (*_points)[i];
+        unsigned int ix = static_cast<unsigned int>((double(pt.x())-double(minx))*sx);
+        unsigned int iy = static_cast<unsigned int>((double(pt.y())-double(miny))*sy);
+        order[i] = std::make_pair(spreadBits(ix) | (spreadBits(iy)<<1), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    unsigned int start = 0;
+    for(unsigned int i=0; i<_numPoints; ++i)
+    {
+        start = insertPoint(order[i].second, start);
+    }
+}
+
+unsigned int DelaunayMesh::locate(Vertex_index p, unsigned int start) const
+{
+    // visibility walk, varying the first edge tested to avoid cycling in degenerate cases
+    unsigned int t = start;
+    unsigned int maxSteps = 1000 + _tris.size();
+    for(unsigned int step=0; step<maxSteps; ++step)
+    {
+        const Tri& tri = _tris[t];
+        bool moved = false;
+        for(int k=0; k<3 && !moved; ++k)
+        {
+            int i = (k+step)%3;
+            if (orient(tri.v[(i+1)%3], tri.v[(i+2)%3], p)<0.0)
+            {
+                if (tri.n[i]==NONE) return NONE;
+                t = tri.n[i];
+                moved = true;
+            }
+        }
+        if (!moved) return t;
+    }
+    return NONE;
+}
+
+unsigned int DelaunayMesh::insertPoint(Vertex_index p, unsigned int start)
+{
+    unsigned int t = locate(p, start);
+    if (t==NONE)
+    {
+        // fall back to a brute force search
+        for(unsigned int i=0; i<_tris.size() && t==NONE; ++i)
+        {
+            const Tri& tri = _tris[i];
+            if (valid(i) &&
+                orient(tri.v[1], tri.v[2], p)>=0.0 &&
+                orient(tri.v[2], tri.v[0], p)>=0.0 &&
+                orient(tri.v[0], tri.v[1], p)>=0.0) t = i;
+        }
+        if (t==NONE)
+        {
+            OSG_INFO << "DelaunayTriangulator: unable to locate point " << p << std::endl;
+            return start;
+        }
+    }
+
+    Tri tri = _tris[t];
+    int onEdge = -1;
+    int numOnEdge = 0;
+    for(int i=0; i<3; ++i)
+    {
+        if (orient(tri.v[(i+1)%3], tri.v[(i+2)%3], p)==0.0) { onEdge = i; ++numOnEdge; }
+    }
+
+    if (numOnEdge>1)
+    {
+        OSG_INFO << "DelaunayTriangulator: ignoring point " << p << " coincident with an existing point" << std::endl;
+        return t;
+    }
+
+    if (onEdge<0 || tri.n[onEdge]==NONE)
+    {
+        // split triangle a,b,c into a,b,p b,c,p c,a,p
+        Vertex_index a = tri.v[0], b = tri.v[1], c = tri.v[2];
+        unsigned int na = tri.n[0], nb = tri.n[1], nc = tri.n[2];
+        unsigned int t1 = allocateTriangle();
+        unsigned int t2 = allocateTriangle();
+        setTriangle(t,  a, b, p, t1, t2, nc);
+        setTriangle(t1, b, c, p, t2, t, na);
+        setTriangle(t2, c, a, p, t, t1, nb);
+        relink(na, t, t1);
+        relink(nb, t, t2);
+
+        _flipStack.push_back(std::make_pair(t, 2));
+        _flipStack.push_back(std::make_pair(t1, 2));
+        _flipStack.push_back(std::make_pair(t2, 2));
+    }
+    else
+    {
+        // p lies on the edge b,c shared by a,b,c and d,c,b, split both triangles in two
+        unsigned int u = tri.n[onEdge];
+        Vertex_index a = tri.v[onEdge], b = tri.v[(onEdge+1)%3], c = tri.v[(onEdge+2)%3];
+        unsigned int tb = tri.n[(onEdge+1)%3], tc = tri.n[(onEdge+2)%3];
+
+        Tri utri = _tris[u];
+        int j = indexOf(utri, c);
+        j = (j+2)%3; // index of d, the vertex opposite the shared edge
+        Vertex_index d = utri.v[j];
+        unsigned int ub = utri.n[(j+1)%3], uc = utri.n[(j+2)%3];
+
+        unsigned int t2 = allocateTriangle();
+        unsigned int u2 = allocateTriangle();
+        setTriangle(t,  a, b, p, u2, t2, tc);
+        setTriangle(t2, a, p, c, u, tb, t);
+        setTriangle(u,  d, c, p, t2, u2, uc);
+        setTriangle(u2, d, p, b, t, ub, u);
+        relink(tb, t, t2);
+        relink(ub, u, u2);
+
+        _flipStack.push_back(std::make_pair(t, 2));
+        _flipStack.push_back(std::make_pair(t2, 1));
+        _flipStack.push_back(std::make_pair(u, 2));
+        _flipStack.push_back(std::make_pair(u2, 1));
+    }
+
+    legalize(p);
+
+    return _vertexTri[p];
+}
+
+void DelaunayMesh::legalize(Vertex_index p)
+{
+    // Lawson flips of the edges opposite p, each flip adds another edge to p so this terminates.
+    while(!_flipStack.empty())
+    {
+        unsigned int t = _flipStack.back().first;
+        _flipStack.pop_back();
+
+        int i = indexOf(_tris[t], p);
+        if (i<0) continue;
+
+        Tri& tri = _tris[t];
+        unsigned int u = tri.n[i];
+        if (u==NONE) continue;
+
+        Vertex_index a = tri.v[(i+1)%3], b = tri.v[(i+2)%3];
+        Tri& utri = _tris[u];
+        int j = indexOf(utri, a);
+        if (j<0) continue;
+        j = (j+1)%3; // utri is d,b,a
+        Vertex_index d = utri.v[j];
+
+        if (incircle(p, a, b, d)<=0.0) continue;
+
+        unsigned int tA = tri.n[(i+1)%3], tB = tri.n[(i+2)%3];
+        unsigned int uB = utri.n[(j+1)%3], uA = utri.n[(j+2)%3];
+
+        setTriangle(t, p, a, d, uB, u, tB);
+        setTriangle(u, p, d, b, uA, tA, t);
+        relink(uB, u, t);
+        relink(tA, t, u);
+
+        _flipStack.push_back(std::make_pair(t, 0));
+        _flipStack.push_back(std::make_pair(u, 0));
+    }
+}
+
+void DelaunayMesh::getTrianglesAroundVertex(Vertex_index v, std::vector<unsigned int>& triangles) const
+{
+    triangles.clear();
+    if (v>=_vertexTri.size()) return;
+
+    unsigned int t0 = _vertexTri[v];
+    if (t0==NONE || !valid(t0) || indexOf(_tris[t0], v)<0)
+    {
+        for(t0=0; t0<_tris.size(); ++t0)
+        {
+            if (valid(t0) && indexOf(_tris[t0], v)>=0) break;
+        }
+        if (t0==_tris.size()) return;
+    }
+
+    // rotate one way round the vertex, and if the fan is open then the other way too.
+    unsigned int t = t0;
+    do
+    {
+        triangles.push_back(t);
+        t = _tris[t].n[(indexOf(_tris[t], v)+1)%3];
+    } while(t!=NONE && t!=t0 && triangles.size()<_tris.size());
+
+    if (t==NONE)
+    {
+        t = _tris[t0].n[(indexOf(_tris[t0], v)+2)%3];
+        while(t!=NONE && triangles.size()<_tris.size())
+        {
+            triangles.push_back(t);
+            t = _tris[t].n[(indexOf(_tris[t], v)+2)%3];
+        }
+    }
+}
+
+unsigned int DelaunayMesh::findTriangleWithEdge(Vertex_index ip1, Vertex_index ip2) const
+{
+    // find the triangle with the edge from ip1 to ip2
+    getTrianglesAroundVertex(ip1, _star);
+    for(std::vector<unsigned int>::const_iterator itr=_star.begin(); itr!=_star.end(); ++itr)
+    {
+        const Tri& tri = _tris[*itr];
+        if (tri.v[(indexOf(tri, ip1)+1)%3]==ip2) return *itr;
+    }
+    return NONE;
+}
+
+bool DelaunayMesh::hasEdge(Vertex_index ip1, Vertex_index ip2) const
+{
+    getTrianglesAroundVertex(ip1, _star);
+    for(std::vector<unsigned int>::const_iterator itr=_star.begin(); itr!=_star.end(); ++itr)
+    {
+        if (indexOf(_tris[*itr], ip2)>=0) return true;
+    }
+    return false;
+}
+
+void DelaunayMesh::replaceTriangles(std::vector<unsigned int>& oldTris, const Triangle_list& newTris)
+{
+    std::sort(oldTris.begin(), oldTris.end());
+    oldTris.erase(std::unique(oldTris.begin(), oldTris.end()), oldTris.end());
+
+    // collect the edges around the hole, along with the triangles outside them
+    std::vector<BoundaryEdge> boundary;
+    for(std::vector<unsigned int>::const_iterator itr=oldTris.begin(); itr!=oldTris.end(); ++itr)
+    {
+        const Tri& tri = _tris[*itr];
+        for(int i=0; i<3; ++i)
+        {
+            unsigned int nb = tri.n[i];
+            if (nb!=NONE && !std::binary_search(oldTris.begin(), oldTris.end(), nb))
+            {
+                BoundaryEdge be;
+                be.a = tri.v[(i+1)%3]; be.b = tri.v[(i+2)%3]; be.t = nb;
+                for(be.k=0; be.k<3 && _tris[nb].n[be.k]!=*itr; ++be.k) {}
+                if (be.k==3) continue;
+                _tris[nb].n[be.k] = NONE;
+                boundary.push_back(be);
+            }
+        }
+    }
+
+    for(std::vector<unsigned int>::const_iterator itr=oldTris.begin(); itr!=oldTris.end(); ++itr)
+    {
+        _tris[*itr].v[0] = NONE;
+        _freeTris.push_back(*itr);
+    }
+
+    if (_vertexTri.size()<_points->size()) _vertexTri.resize(_points->size(), static_cast<unsigned int>(NONE));
+
+    // add the new triangles, counter clockwise
+    std::vector<unsigned int> added;
+    for(Triangle_list::const_iterator itr=newTris.begin(); itr!=newTris.end(); ++itr)
+    {
+        Vertex_index a = itr->a(), b = itr->b(), c = itr->c();
+        if (orient(a, b, c)<0.0) std::swap(b, c);
+        unsigned int t = allocateTriangle();
+        setTriangle(t, a, b, c, NONE, NONE, NONE);
+        added.push_back(t);
+    }
+
+    // link them to each other and to the triangles around the hole
+    for(std::vector<unsigned int>::const_iterator itr=added.begin(); itr!=added.end(); ++itr)
+    {
+        Tri& tri = _tris[*itr];
+        for(int i=0; i<3; ++i)
+        {
+            if (tri.n[i]!=NONE) continue;
+            Vertex_index a = tri.v[(i+1)%3], b = tri.v[(i+2)%3];
+            for(std::vector<unsigned int>::const_iterator oitr=itr+1; oitr!=added.end() && tri.n[i]==NONE; ++oitr)
+            {
+                Tri& other = _tris[*oitr];
+                int j = indexOf(other, b);
+                if (j>=0 && other.v[(j+1)%3]==a && other.n[(j+2)%3]==NONE)
+                {
+                    tri.n[i] = *oitr;
+                    other.n[(j+2)%3] = *itr;
+                }
+            }
+            for(std::vector<BoundaryEdge>::const_iterator bitr=boundary.begin(); bitr!=boundary.end() && tri.n[i]==NONE; ++bitr)
+            {
+                if (bitr->a==a && bitr->b==b)
+                {
+                    tri.n[i] = bitr->t;
+                    _tris[bitr->t].n[bitr->k] = *itr;
+                }
+            }
+        }
+    }
+}
+
+void DelaunayMesh::insertConstraintEdge(Vertex_index ip1, Vertex_index ip2)
+{
+    // check that the edge ip1-ip2 is not already part of the triangulation.
+    if (ip1==ip2 || hasEdge(ip1, ip2)) return;
+
+    // then check for intermediate triangles, erase them and replace with constrained triangles.
+    // find triangle with point ip1 where the 2 edges from ip1 contain the line p1-p2.
+    osg::Vec2 p1((*_points)[ip1].x(),(*_points)[ip1].y()); // a constraint line joins p1-p2
+    osg::Vec2 p2((*_points)[ip2].x(),(*_points)[ip2].y());
+
+    std::vector<unsigned int> star;
+    getTrianglesAroundVertex(ip1, star);
+    for(std::vector<unsigned int>::const_iterator titr=star.begin(); titr!=star.end(); ++titr)
+    {
+        if (!valid(*titr)) continue;
+
+        const Tri& first = _tris[*titr];
+        Triangle tri(first.v[0], first.v[1], first.v[2], _points);
+        int icut=tri.lineBisects(_points,ip1,p2);
+        if (icut>0)
+        {
+            // triangle titr starts the constraint edge.  Form 2 lists of vertices for the edges of the
+            // hole created, one to the left of the line ip1-ip2 and the other to the right, which in
+            // turn are filled in with the tessellator.
+            std::vector<unsigned int> trisToDelete;
+            std::vector<unsigned int> edgeRight, edgeLeft;
+            edgeRight.push_back(ip1);
+            edgeLeft.push_back(ip1);
+            trisToDelete.push_back(*titr);
+            // now find the unique triangle that shares the defined edge
+            unsigned int e1=0, e2=0; // indices of ends of test triangle titr
+            if      (icut==1) {e1=tri.b(); e2=tri.c();} // icut=1 implies vertex a is not involved
+            else if (icut==2) {e1=tri.c(); e2=tri.a();}
+            else if (icut==3) {e1=tri.a(); e2=tri.b();}
+            edgeRight.push_back(e2);
+            edgeLeft.push_back(e1);
+            unsigned int tradj=findTriangleWithEdge(e2,e1);
+            if (tradj!=NONE)
+            {
+                while (tradj!=NONE && indexOf(_tris[tradj], ip2)<0 && trisToDelete.size()<999)
+                {
+                    trisToDelete.push_back(tradj);
+                    const Tri& adj = _tris[tradj];
+                    Triangle adjtri(adj.v[0], adj.v[1], adj.v[2], _points);
+                    icut=adjtri.whichEdge(_points,p1,p2,e1,e2);
+                    if      (icut==1) {e1=adjtri.b(); e2=adjtri.c();}
+                    else if (icut==2) {e1=adjtri.c(); e2=adjtri.a();}
+                    else if (icut==3) {e1=adjtri.a(); e2=adjtri.b();}
+                    if (edgeLeft.back()!=e1 && edgeRight.back()==e2 && e1!=ip2) {
+                        edgeLeft.push_back(e1);
+                    } else if(edgeRight.back()!=e2 && edgeLeft.back()==e1 && e2!=ip2) {
+                        edgeRight.push_back(e2);
+                    } else {
+                        OSG_WARN << "tradj error " << adjtri.a()<<  " , " << adjtri.b()<<  " , " << adjtri.c()<< std::endl;
+                    }
+                    unsigned int previousTradj = tradj;
+                    tradj=findTriangleWithEdge(e2,e1);
+                    if (tradj == previousTradj) {
+                        tradj = NONE;
+                    }
+                }
+                if (trisToDelete.size()>=900) {
+                    OSG_WARN << " found " << trisToDelete.size() << " adjacent tris " <<std::endl;
+                }
+            }
+
+            // both lines end at ip2 point.
+            edgeLeft.push_back(ip2);
+            edgeRight.push_back(ip2);
+            if (tradj!=NONE) trisToDelete.push_back(tradj);
+            Triangle_list constrainedtris=fillHole(_points,edgeLeft);
+            Triangle_list righttris=fillHole(_points,edgeRight);
+            constrainedtris.insert(constrainedtris.end(), righttris.begin(), righttris.end());
+            replaceTriangles(trisToDelete, constrainedtris);
+        }
+    }
+}
+
 bool DelaunayTriangulator::triangulate()
 {
     // check validity of input array
@@ -757,39 +1325,35 @@ bool DelaunayTriangulator::triangulate()
         return false;
     }
 
-    // Eliminate duplicate lat/lon points from input coordinates.
+    // Eliminate duplicate lat/lon points from input coordinates, this also sorts the points by x then y.
     _uniqueifyPoints();
 
-
-    // initialize storage structures
-    Triangle_list triangles;
-    Triangle_list discarded_tris;
-
     // GWM July 2005 add constraint vertices to terrain
-    linelist::iterator linitr;
-    for (linitr=constraint_lines.begin();linitr!=constraint_lines.end();linitr++)
     {
-        DelaunayConstraint* dc=(*linitr).get();
-        const osg::Vec3Array* vercon= dynamic_cast<const osg::Vec3Array*>(dc->getVertexArray());
-        if (vercon)
+        PointLookup lookup(points, points->size());
+        linelist::iterator linitr;
+        for (linitr=constraint_lines.begin();linitr!=constraint_lines.end();linitr++)
         {
-            int nadded=0;
-            for (unsigned int icon=0;icon<vercon->size();icon++)
+            DelaunayConstraint* dc=(*linitr).get();
+            const osg::Vec3Array* vercon= dynamic_cast<const osg::Vec3Array*>(dc->getVertexArray());
+            if (vercon)
             {
-                osg::Vec3 p1=(*vercon)[icon];
-                int idx=getindex(p1,points_.get());
-                if (idx<0)
-                { // only unique vertices are permitted.
-                    points_->push_back(p1); // add non-unique constraint points to triangulation
-                    nadded++;
-                }
-                else
+                for (unsigned int icon=0;icon<vercon->size();icon++)
                 {
-                    OSG_WARN << "DelaunayTriangulator: ignore a duplicate point at "<< p1.x()<< " " << p1.y() << std::endl;;
+                    osg::Vec3 p1=(*vercon)[icon];
+                    int idx=lookup.find(p1);
+                    if (idx<0)
+                    { // only unique vertices are permitted.
+                        lookup.add(p1, points->size());
+                        points->push_back(p1); // add non-unique constraint points to triangulation
+                    }
+                    else
+                    {
+                        OSG_WARN << "DelaunayTriangulator: ignore a duplicate point at "<< p1.x()<< " " << p1.y() << std::endl;;
+                    }
                 }
             }
         }
-    //    OSG_WARN<< "constraint size "<<vercon->size()<<" " <<nadded<< std::endl;
     }
         // GWM July 2005 end
 
@@ -831,239 +1395,52 @@ bool DelaunayTriangulator::triangulate()
     points_->push_back(osg::Vec3(maxx + .10*(maxx - minx), maxy + .10*(maxy - miny), 0));
     points_->push_back(osg::Vec3(minx - .10*(maxx - minx), maxy + .10*(maxy - miny), 0));
 
-    // add supertriangles to triangle list
-    triangles.push_back(Triangle(last_valid_index+1, last_valid_index+2, last_valid_index+3, points));
-    triangles.push_back(Triangle(last_valid_index+4, last_valid_index+1, last_valid_index+3, points));
-
-
-    // begin triangulation
-    GLuint pidx = 0;
-    osg::Vec3Array::const_iterator i;
-
-    OSG_INFO << "DelaunayTriangulator: triangulating vertex grid (" << (points->size()-3) <<" points)\n";
-
-    for (i=points->begin(); i!=points->end(); ++i, ++pidx)
-    {
-
-        // don't process supertriangle vertices
-        if (pidx > last_valid_index) break;
-
-        Edge_set edges;
-
-        // iterate through triangles
-        Triangle_list::iterator j, next_j;
-        for (j=triangles.begin(); j!=triangles.end(); j = next_j)
-        {
-
-            next_j = j;
-            ++next_j;
-
-            // get the circumcircle (x,y centre & radius)
-            osg::Vec3 cc = j->get_circumcircle();
+    // begin triangulation, starting from the two supertriangles and inserting one point at a time.
+    OSG_INFO << "DelaunayTriangulator: triangulating vertex grid (" << (last_valid_index+1) <<" points)\n";
 
-            // OPTIMIZATION: since points are pre-sorted by the X component,
-            // check whether we can discard this triangle for future operations
-            float xdist = i->x() - cc.x();
-            // this is where the circumcircles radius rather than R^2 is faster.
-            // original code used r^2 and needed to test xdist*xdist>cc.z && i->x()>cc.x().
-            if ((xdist ) > cc.z() )
-            {
-                discarded_tris.push_back(*j); // these are not needed for further tests as no more
-                // points will ever lie inside this triangle.
-                triangles.erase(j);
-            }
-            else
-            {
+    DelaunayMesh mesh(points, last_valid_index+1);
+    mesh.triangulate();
 
-                // if the point lies in the triangle's circumcircle then add
-                // its edges to the edge list and remove the triangle
-                if (point_in_circle(*i, cc))
-                {
-                    for (int ei=0; ei<3; ++ei)
-                    {
-                        std::pair<Edge_set::iterator, bool> result = edges.insert(j->get_edge(ei));
-                        if (!result.second)
-                        {
-                            // cast away constness of a set element, which is
-                            // safe in this case since the set_duplicate is
-                            // not used as part of the Less operator.
-                            Edge& edge = const_cast<Edge&>(*(result.first));
-                            // not clear why this change is needed? But prevents removal of twice referenced edges??
-                      //      edge.set_duplicate(true);
-                            edge.set_duplicate(!edge.get_duplicate());
-                        }
-                    }
-                    triangles.erase(j);
-                }
-            }
-        }
-
-        // remove duplicate edges and add new triangles
-        Edge_set::iterator ci;
-        for (ci=edges.begin(); ci!=edges.end(); ++ci)
-        {
-            if (!ci->get_duplicate())
-            {
-                triangles.push_back(Triangle(pidx, ci->ib(), ci->ie(), points));
-            }
-        }
-    }
     // dec 2006 we used to remove supertriangle vertices here, but then we cant strictly use the supertriangle
     // vertices to find intersections of constraints with terrain, so moved to later.
 
     OSG_INFO << "DelaunayTriangulator: finalizing and cleaning up structures\n";
 
-     // rejoin the two triangle lists
-    triangles.insert(triangles.begin(), discarded_tris.begin(), discarded_tris.end());
-
         // GWM July 2005 eliminate any triangle with an edge crossing a constraint line
     // http://www.geom.uiuc.edu/~samuelp/del_project.html
     // we could also implement the sourcecode in http://gts.sourceforge.net/reference/gts-delaunay-and-constrained-delaunay-triangulations.html
     // this uses the set of lines which are boundaries of the constraints, including points
     // added to the contours by tessellation.
+    PointLookup lookup(points, last_valid_index+1);
+    std::vector<int> indices;
     for (linelist::iterator dcitr=constraint_lines.begin();dcitr!=constraint_lines.end();dcitr++)
     {
-        //DelaunayConstraint *dc=(*dcitr).get();
         const osg::Vec3Array* vercon = dynamic_cast<const osg::Vec3Array*>((*dcitr)->getVertexArray());
         if (vercon)
         {
             for (unsigned int ipr=0; ipr<(*dcitr)->getNumPrimitiveSets(); ipr++)
             {
                 const osg::PrimitiveSet* prset=(*dcitr)->getPrimitiveSet(ipr);
-                if (prset->getMode()==osg::PrimitiveSet::LINE_LOOP ||
-                    prset->getMode()==osg::PrimitiveSet::LINE_STRIP)
+                if ((prset->getMode()==osg::PrimitiveSet::LINE_LOOP ||
+                     prset->getMode()==osg::PrimitiveSet::LINE_STRIP) &&
+                    prset->getNumIndices()>0)
                 {
+                    // look up the indices of the whole line as a batch before inserting its edges
+                    indices.resize(prset->getNumIndices());
+                    ResolveConstraintIndices resolve(lookup, vercon, prset, indices);
+                    WorkerThreadPool::instance()->run(resolve, indices.size(), 4096);
+
                     // loops or strips
                     // start with the last point on the loop
-                    unsigned int ip1=getindex((*vercon)[prset->index (prset->getNumIndices()-1)],points_.get());
-                    for (unsigned int i=0; i<prset->getNumIndices(); i++)
+                    int ip1=indices.back();
+                    for (unsigned int i=0; i<indices.size(); i++)
                     {
-                        unsigned int ip2=getindex((*vercon)[prset->index(i)],points_.get());
-                        if (i>0 || prset->getMode()==osg::PrimitiveSet::LINE_LOOP)
+                        int ip2=indices[i];
+                        // dont check edge from end to start for strips
+                        if ((i>0 || prset->getMode()==osg::PrimitiveSet::LINE_LOOP) && ip1>=0 && ip2>=0)
                         {
-                            // dont check edge from end to start
-                            // for strips
-                            // 2 points on the constraint
-                            bool edgused=false;// first check for exact edge indices are used.
-                            Triangle_list::iterator titr;
-                            int it=0;
-                            for (titr=triangles.begin(); titr!=triangles.end() && !edgused; ++titr)
-                            {
-                                //check that the edge ip1-ip2 is not already part of the triangulation.
-                                if (titr->isedge(ip1,ip2)) edgused=true;
-                                if (titr->isedge(ip2,ip1)) edgused=true;
-                                //        if (edgused) OSG_WARN << "Edge used in triangle " << it << " " <<
-                                //            titr->a()<<","<< titr->b()<<","<< titr->c()<<  std::endl;
-                                it++;
-                            }
-                            if (!edgused)
-                            {
-                                // then check for intermediate triangles, erase them and replace with constrained triangles.
-                                // find triangle with point ip1 where the 2 edges from ip1 contain the line p1-p2.
-                                osg::Vec2 p1((*points_)[ip1].x(),(*points_)[ip1].y()); // a constraint line joins p1-p2
-                                osg::Vec2 p2((*points_)[ip2].x(),(*points_)[ip2].y());
-                                int ntr=0;
-                                std::vector<const Triangle *> trisToDelete; // array of triangles to delete from terrain.
-                                // form 2 lists of vertices for the edges of the hole created.
-                                // The hole joins vertex ip1 to ip2, and one list of edges lies to the left
-                                // of the line ip1-ip2m the other to the right.
-                                // a list of vertices forming 2 halves of the removed triangles.
-                                // which in turn are filled in with the tessellator.
-                                for (titr=triangles.begin(); titr!=triangles.end(); )
-                                {
-                                    int icut=titr->lineBisects(points_.get(),ip1,p2);
-                                    //    OSG_WARN << "Testing triangle " << ntr << " "<< ip1 << " ti " <<
-                                    //        titr->a()<< ","<<titr->b() <<"," <<titr->c() << std::endl;
-                                    if (icut>0)
-                                    {
-                                        // triangle titr starts the constraint edge
-                                        std::vector<unsigned int> edgeRight, edgeLeft;
-                                        edgeRight.push_back(ip1);
-                                        edgeLeft.push_back(ip1);
-                                        //        OSG_WARN << "hole first " << edgeLeft.back()<<  " rt " << edgeRight.back()<< std::endl;
-                                        trisToDelete.push_back(&(*titr));
-                                        // now find the unique triangle that shares the defined edge
-                                        unsigned int e1, e2; // indices of ends of test triangle titr
-                                        if    (icut==1)
-                                        {
-                                            // icut=1 implies vertex a is not involved
-                                            e1=titr->b(); e2=titr->c();
-                                        }
-                                        else if (icut==2)
-                                        {
-                                            e1=titr->c(); e2=titr->a();
-                                        }
-                                        else if (icut==3)
-                                        {
-                                            e1=titr->a(); e2=titr->b();
-                                        }
-                                        edgeRight.push_back(e2);
-                                        edgeLeft.push_back(e1);
-                                        //        OSG_WARN << icut << "hole edges " << edgeLeft.back()<<  " rt " << edgeRight.back()<< std::endl;
-                                        const Triangle *tradj=getTriangleWithEdge(e2,e1, &triangles);
-                                        if (tradj)
-                                        {
-                                            while (tradj && !tradj->usesVertex(ip2) && trisToDelete.size()<999)
-                                            {
-                                                trisToDelete.push_back(tradj);
-                                                icut=tradj->whichEdge(points_.get(),p1,p2,e1,e2);
-                                                //    OSG_WARN  << ntr << " cur triedge " << icut << " " << ip1 <<
-                                                //        " to " << ip2 << " tadj " << tradj->a()<< ","<<tradj->b() <<","
-                                                //        <<tradj->c() <<std::endl;
-                                                if        (icut==1) {e1=tradj->b(); e2=tradj->c();} // icut=1 implies vertex a is not involved
-                                                else if (icut==2) {e1=tradj->c(); e2=tradj->a();}
-                                                else if (icut==3) {e1=tradj->a(); e2=tradj->b();}
-                                                if (edgeLeft.back()!=e1 && edgeRight.back()==e2 && e1!=ip2) {
-                                                    edgeLeft.push_back(e1);
-                                                } else if(edgeRight.back()!=e2 && edgeLeft.back()==e1 && e2!=ip2) {
-                                                    edgeRight.push_back(e2);
-                                                } else {
-                                                    if (!tradj->usesVertex(ip2)) OSG_WARN << "tradj error " << tradj->a()<<  " , " << tradj->b()<<  " , " << tradj->c()<< std::endl;
-                                                }
-                                                const Triangle *previousTradj = tradj;
-                                                tradj=getTriangleWithEdge(e2,e1, &triangles);
-                                                if (tradj == previousTradj) {
-                                                    tradj = 0;
-                                                }
-                                            }
-                                            if (trisToDelete.size()>=900) {
-                                                OSG_WARN << " found " << trisToDelete.size() << " adjacent tris " <<std::endl;
-                                            }
-                                        }
-
-                                        // both lines end at ip2 point.
-                                        edgeLeft.push_back(ip2);
-                                        edgeRight.push_back(ip2);
-                                        if (tradj) trisToDelete.push_back(tradj);
-                                        //        OSG_WARN << icut << "hole last " << edgeLeft.back()<<  " rt " << edgeRight.back()<< std::endl;
-                                        Triangle_list constrainedtris=fillHole(points_.get(),edgeLeft);
-                                        triangles.insert(triangles.begin(), constrainedtris.begin(), constrainedtris.end());
-                                        constrainedtris=fillHole(points_.get(),edgeRight);
-                                        triangles.insert(triangles.begin(), constrainedtris.begin(), constrainedtris.end());
-
-                                    }
-                                    ++titr;
-                                    ntr++;
-                                }
-                                // remove the triangles list
-                                Triangle_list::iterator tri; // counts through triangles
-                                for (tri=triangles.begin(); tri!=triangles.end(); )
-                                {
-                                    bool deleted=false;
-                                    for (std::vector<const Triangle *>::iterator deleteTri=trisToDelete.begin();
-                                    deleteTri!=trisToDelete.end(); )
-                                    {
-                                        if (&(*tri)==*deleteTri)
-                                        {
-                                            deleted=true;
-                                            tri=triangles.erase(tri);
-                                            deleteTri=trisToDelete.erase(deleteTri); // 24.12.06 remove from delete list.
-                                        } else {deleteTri++; }
-                                    }
-                                    if (!deleted) ++tri;
-                                }
-                            }
-                        } // strip test
+                            mesh.insertConstraintEdge(ip1, ip2);
+                        }
 
                         ip1=ip2; // next edge of line
                     }
@@ -1072,62 +1449,55 @@ bool DelaunayTriangulator::triangulate()
         }
     }
     // GWM Sept 2005 end
+
     // dec 2006 remove supertriangle vertices - IF we have added some internal vertices (see fillholes)
-    // then these may not be the last vertices in the list.
-//    } else { // remove 3 super-triangle vertices more completely, moving any reference indices down.
-    Triangle_list::iterator tri;
+    // then these may not be the last vertices in the list, so move any reference indices down.
     GLuint supertriend = last_valid_index+4;
-    for (tri=triangles.begin(); tri!=triangles.end();)
-    { // look for triangles using the supertriangle indices or >super indices and move down by 3.
-        if ((tri->a() > last_valid_index && tri->a() <= supertriend) ||
-            (tri->b() > last_valid_index && tri->b() <= supertriend ) ||
-            (tri->c() > last_valid_index && tri->c() <= supertriend )) {
-            tri=triangles.erase(tri);
-        } else { // move down by 3 tests
-            if (tri->a() > last_valid_index) { // move index down 4
-                tri->incrementa(-4);
-            }
-            if (tri->b() > last_valid_index) { // move down 4
-                tri->incrementb(-4);
-            }
-            if (tri->c() > last_valid_index) { // move down 4 -- correction 21.12.06- was b() should test index c()
-                tri->incrementc(-4);
-            }
-            ++tri; // only increment tri here as the other path increments tri when tri=triangles.erase.
-        }
-    }
-        // remove 3 supertriangle vertices from points. They may not be the last vertices in points if
-        // extra points have been inserted by the constraint re-triangulation.
+
+    // remove 4 supertriangle vertices from points. They may not be the last vertices in points if
+    // extra points have been inserted by the constraint re-triangulation.
     points->erase(points->begin()+last_valid_index+1,points->begin()+last_valid_index+5);
-    //last_valid_index = points->size()-1; // the last valid vertex is last point.
-    // end of dec 2006 changes.
 
     // initialize index storage vector
     std::vector<GLuint> pt_indices;
-    pt_indices.reserve(triangles.size() * 3);
+    pt_indices.reserve(mesh.getNumTriangles() * 3);
 
     // build osg primitive
     OSG_INFO << "DelaunayTriangulator: building primitive(s)\n";
-    Triangle_list::const_iterator ti;
-    for (ti=triangles.begin(); ti!=triangles.end(); ++ti)
+    for (unsigned int t=0; t<mesh.getNumTriangles(); ++t)
     {
+        if (!mesh.valid(t)) continue;
 
-        // don't add this triangle to the primitive if it shares any vertex with
-        // the supertriangle triangles have already been removed.
-        // Don't need this test: ti->a() <= last_valid_index && ti->b() <= last_valid_index && ti->c() <= last_valid_index &&
-          // Don't add degenerate (zero radius) triangles
-        if ( ti->get_circumcircle().z()>0.0)
+        // don't add this triangle to the primitive if it shares any vertex with the supertriangle
+        const DelaunayMesh::Tri& tri = mesh.getTriangle(t);
+        GLuint v[3];
+        bool super = false;
+        for (int k=0; k<3; ++k)
         {
-
-            if (normals_.valid())
+            v[k] = tri.v[k];
+            if (v[k] > last_valid_index)
             {
-                (normals_.get())->push_back(ti->compute_normal(points));
+                if (v[k] <= supertriend) super = true;
+                else v[k] -= 4;
             }
+        }
+        if (super) continue;
+
+        // Don't add degenerate (zero area) triangles
+        const osg::Vec3& pa = (*points)[v[0]];
+        const osg::Vec3& pb = (*points)[v[1]];
+        const osg::Vec3& pc = (*points)[v[2]];
+        if ((pb.x()-pa.x())*(pc.y()-pa.y()) == (pb.y()-pa.y())*(pc.x()-pa.x())) continue;
 
-            pt_indices.push_back(ti->a());
-            pt_indices.push_back(ti->b());
-            pt_indices.push_back(ti->c());
+        if (normals_.valid())
+        {
+            osg::Vec3 N = (pb - pa) ^ (pc - pa);
+            (normals_.get())->push_back(N / N.length());
         }
+
+        pt_indices.push_back(v[0]);
+        pt_indices.push_back(v[1]);
+        pt_indices.push_back(v[2]);
     }
 
     // LF August 2011 fix crash when no triangle is created
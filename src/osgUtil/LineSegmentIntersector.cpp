@@ -22,6 +22,8 @@
 #include <osg/Timer>
 #include <osg/TexMat>
 
+#include <algorithm>
+
 using namespace osgUtil;
 
 namespace LineSegmentIntersectorUtils
@@ -383,6 +385,9 @@ void LineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Dr
         return;
     }
 
+    osg::HeightField* heightField = dynamic_cast<osg::HeightField*>(drawable->getShape());
+    if (heightField && intersectHeightField(iv, drawable, *heightField, s, e)) return;
+
     LineSegmentIntersectorUtils::TriangleIntersections intersections;
 
     if (getPrecisionHint()==USE_DOUBLE_CALCULATIONS)
@@ -476,6 +481,170 @@ void LineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Dr
     }
 }
 
+namespace
+{
+
+// intersect the segment s,e with the triangle v0,v1,v2, returning the ratio along the segment and the barycentric coords of the hit.
+inline bool intersectTriangle(const osg::Vec3d& s, const osg::Vec3d& d,
+                              const osg::Vec3d& v0, const osg::Vec3d& v1, const osg::Vec3d& v2,
+                              double& ratio, double& r1, double& r2)
+{
+    osg::Vec3d e1 = v1-v0;
+    osg::Vec3d e2 = v2-v0;
+    osg::Vec3d p = d^e2;
+    double det = e1*p;
+    if (det==0.0) return false;
+
+    double inv_det = 1.0/det;
+    osg::Vec3d t = s-v0;
+    r1 = (t*p)*inv_det;
+    if (r1<0.0 || r1>1.0) return false;
+
+    osg::Vec3d q = t^e1;
+    r2 = (d*q)*inv_det;
+    if (r2<0.0 || r1+r2>1.0) return false;
+
+    ratio = (e2*q)*inv_det;
+    return ratio>=0.0 && ratio<=1.0;
+}
+
+// clip the range [t0,t1] of s+d*t to min<=s+d*t<=max.
+inline bool clipRange(double s, double d, double min, double max, double& t0, double& t1)
+{
+    if (d==0.0) return s>=min && s<=max;
+
+    double ta = (min-s)/d;
+    double tb = (max-s)/d;
+    if (ta>tb) std::swap(ta,tb);
+    if (ta>t0) t0 = ta;
+    if (tb<t1) t1 = tb;
+    return t0<=t1;
+}
+
+}
+
+bool LineSegmentIntersector::intersectHeightField(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable, const osg::HeightField& field,
+                                                  const osg::Vec3d& s, const osg::Vec3d& e)
+{
+    int numColumns = static_cast<int>(field.getNumColumns());
+    int numRows = static_cast<int>(field.getNumRows());
+    double dx = field.getXInterval();
+    double dy = field.getYInterval();
+    if (numColumns<2 || numRows<2 || dx<=0.0 || dy<=0.0) return false;
+
+    // transform the segment into the frame of the height field where vertex (c,r) is at (c*dx, r*dy, height).
+    osg::Matrixd matrix = field.computeRotationMatrix();
+    matrix.setTrans(field.getOrigin());
+    osg::Matrixd inverse = osg::Matrixd::inverse(matrix);
+    osg::Vec3d ls = s*inverse;
+    osg::Vec3d ld = e*inverse - ls;
+
+    // clip the segment to the extents of the grid
+    double t0 = 0.0, t1 = 1.0;
+    if (!clipRange(ls.x(), ld.x(), 0.0, dx*double(numColumns-1), t0, t1) ||
+        !clipRange(ls.y(), ld.y(), 0.0, dy*double(numRows-1), t0, t1)) return true;
+
+    // walk the cells the segment passes over, in order along the segment.
+    double u = (ls.x()+ld.x()*t0)/dx;
+    double v = (ls.y()+ld.y()*t0)/dy;
+    int c = osg::clampBetween(static_cast<int>(floor(u)), 0, numColumns-2);
+    int r = osg::clampBetween(static_cast<int>(floor(v)), 0, numRows-2);
+
+    double du = ld.x()/dx;
+    double dv = ld.y()/dy;
+    int stepC = du>0.0 ? 1 : -1;
+    int stepR = dv>0.0 ? 1 : -1;
+    double tDeltaC = du!=0.0 ? fabs(1.0/du) : DBL_MAX;
+    double tDeltaR = dv!=0.0 ? fabs(1.0/dv) : DBL_MAX;
+    double tMaxC = du!=0.0 ? (double(du>0.0 ? c+1 : c) - ls.x()/dx)/du : DBL_MAX;
+    double tMaxR = dv!=0.0 ? (double(dv>0.0 ? r+1 : r) - ls.y()/dy)/dv : DBL_MAX;
+
+    bool limitOne = _intersectionLimit!=NO_LIMIT;
+    while(true)
+    {
+        osg::Vec3d v00(dx*double(c), dy*double(r), field.getHeight(c,r));
+        osg::Vec3d v10(dx*double(c+1), dy*double(r), field.getHeight(c+1,r));
+        osg::Vec3d v01(dx*double(c), dy*double(r+1), field.getHeight(c,r+1));
+        osg::Vec3d v11(dx*double(c+1), dy*double(r+1), field.getHeight(c+1,r+1));
+
+        unsigned int i00 = r*numColumns+c;
+        unsigned int i10 = i00+1;
+        unsigned int i01 = i00+numColumns;
+        unsigned int i11 = i01+1;
+
+        // the two triangles of the cell, as tessellated by ShapeDrawable.
+        const osg::Vec3d* triangles[2][3] = { { &v01, &v00, &v11 }, { &v00, &v10, &v11 } };
+        unsigned int indices[2][3] = { { i01, i00, i11 }, { i00, i10, i11 } };
+
+        bool hitCell = false;
+        double previousRatio = -1.0;
+        for(unsigned int tri=0; tri<2; ++tri)
+        {
+            double ratio, r1, r2;
+            if (!intersectTriangle(ls, ld, *triangles[tri][0], *triangles[tri][1], *triangles[tri][2], ratio, r1, r2)) continue;
+
+            // a hit on the diagonal is shared by both triangles.
+            if (tri==1 && hitCell && fabs(ratio-previousRatio)<1e-12) continue;
+
+            // remap ratio into _start, _end range
+            double remap_ratio = ((s-_start).length() + ratio * (e-s).length() )/(_end-_start).length();
+
+            if ( _intersectionLimit == LIMIT_NEAREST && !getIntersections().empty() )
+            {
+                if (remap_ratio >= getIntersections().begin()->ratio ) continue;
+                else getIntersections().clear();
+            }
+
+            Intersection hit;
+            hit.ratio = remap_ratio;
+            hit.matrix = iv.getModelMatrix();
+            hit.nodePath = iv.getNodePath();
+            hit.drawable = drawable;
+            hit.primitiveIndex = 2*(r*(numColumns-1)+c)+tri;
+
+            hit.localIntersectionPoint = _start*(1.0-remap_ratio) + _end*remap_ratio;
+
+            osg::Vec3d normal = (*triangles[tri][1]-*triangles[tri][0])^(*triangles[tri][2]-*triangles[tri][0]);
+            normal.normalize();
+            hit.localIntersectionNormal = osg::Matrixd::transform3x3(normal, matrix);
+
+            hit.indexList.reserve(3);
+            hit.ratioList.reserve(3);
+            hit.indexList.push_back(indices[tri][0]);
+            hit.ratioList.push_back(1.0-r1-r2);
+            hit.indexList.push_back(indices[tri][1]);
+            hit.ratioList.push_back(r1);
+            hit.indexList.push_back(indices[tri][2]);
+            hit.ratioList.push_back(r2);
+
+            insertIntersection(hit);
+
+            hitCell = true;
+            previousRatio = ratio;
+        }
+
+        // the cells are visited in order along the segment, so the first cell hit holds the nearest intersection.
+        if (hitCell && limitOne) break;
+
+        if (tMaxC<tMaxR)
+        {
+            if (tMaxC>t1) break;
+            c += stepC;
+            tMaxC += tDeltaC;
+            if (c<0 || c>numColumns-2) break;
+        }
+        else
+        {
+            if (tMaxR>t1) break;
+            r += stepR;
+            tMaxR += tDeltaR;
+            if (r<0 || r>numRows-2) break;
+        }
+    }
+
+    return true;
+}
+
 void LineSegmentIntersector::reset()
 {
     Intersector::reset();
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include <iostream>
+#include <sstream>
 #include <osg/Notify>
 #include <osg/Geometry>
 #include <osg/Math>
@@ -1194,6 +1195,243 @@ void VertexAccessOrderVisitor::optimizeOrder(Geometry& geom)
     geom.dirtyDisplayList();
 }
 
+namespace
+{
+inline short quantizeToShort(float value)
+{
+    float q = osg::round(value*32767.0f);
+    return static_cast<short>(osg::clampBetween(q, -32767.0f, 32767.0f));
+}
+
+// Encode a unit vector using the octahedral mapping, projecting it onto the
+// octahedron |x|+|y|+|z|=1 and folding the lower hemisphere over the upper.
+inline osg::Vec2s encodeOctahedral(const osg::Vec3& n)
+{
+    float l1 = fabsf(n.x()) + fabsf(n.y()) + fabsf(n.z());
+    if (l1==0.0f) return osg::Vec2s(0,0);
+
+    float x = n.x()/l1;
+    float y = n.y()/l1;
+    if (n.z()<0.0f)
+    {
+        float fx = (1.0f-fabsf(y)) * (x>=0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f-fabsf(x)) * (y>=0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    return osg::Vec2s(quantizeToShort(x), quantizeToShort(y));
+}
+
+inline float quantizationScale(float halfRange)
+{
+    return halfRange>0.0f ? halfRange : 1.0f;
+}
+}
+
+VertexQuantizationVisitor::VertexQuantizationVisitor(Optimizer* optimizer)
+    : GeometryCollector(optimizer, Optimizer::VERTEX_QUANTIZATION),
+      _quantizeNormals(true),
+      _quantizeTexCoords(true),
+      _assignShaderAttribute(true),
+      _normalTextureUnit(7),
+      _shaderAttributeType(StateAttribute::Type(DEFAULT_SHADER_ATTRIBUTE_TYPE)),
+      _numBytesBefore(0),
+      _numBytesAfter(0)
+{
+}
+
+void VertexQuantizationVisitor::quantize()
+{
+    for (GeometryList::iterator itr = _geometryList.begin(), end = _geometryList.end();
+         itr != end;
+         ++itr)
+    {
+        quantize(*(*itr));
+    }
+}
+
+void VertexQuantizationVisitor::quantize(Geometry& geom)
+{
+    Vec3Array* vertices = dynamic_cast<Vec3Array*>(geom.getVertexArray());
+    if (!vertices || vertices->empty())
+        return;
+
+    const unsigned int numVertices = vertices->size();
+
+    Vec3Array* normals = 0;
+    if (_quantizeNormals)
+    {
+        Array* normalArray = geom.getNormalArray();
+        if (normalArray)
+        {
+            normals = dynamic_cast<Vec3Array*>(normalArray);
+
+            // the decoding shader expects all or nothing, so leave geometry with normals we can't encode alone.
+            if (!normals ||
+                normals->getBinding()!=Array::BIND_PER_VERTEX ||
+                normals->size()!=numVertices ||
+                geom.getTexCoordArray(_normalTextureUnit))
+            {
+                OSG_INFO<<"VertexQuantizationVisitor::quantize() unable to encode normals, skipping Geometry."<<std::endl;
+                return;
+            }
+        }
+    }
+
+    Vec2Array* texcoords = 0;
+    if (_quantizeTexCoords)
+    {
+        texcoords = dynamic_cast<Vec2Array*>(geom.getTexCoordArray(0));
+        if (texcoords && (texcoords->getBinding()!=Array::BIND_PER_VERTEX || texcoords->size()!=numVertices))
+        {
+            texcoords = 0;
+        }
+    }
+
+    // positions, quantized relative to the centre of the bounding box
+    BoundingBox bb;
+    for(Vec3Array::const_iterator itr = vertices->begin(); itr != vertices->end(); ++itr)
+    {
+        bb.expandBy(*itr);
+    }
+
+    Vec3 positionOffset = bb.center();
+    Vec3 positionScale(quantizationScale((bb.xMax()-bb.xMin())*0.5f),
+                       quantizationScale((bb.yMax()-bb.yMin())*0.5f),
+                       quantizationScale((bb.zMax()-bb.zMin())*0.5f));
+
+    ref_ptr<Vec3sArray> quantizedVertices = new Vec3sArray(numVertices);
+    quantizedVertices->setBinding(Array::BIND_PER_VERTEX);
+    for(unsigned int i=0; i<numVertices; ++i)
+    {
+        Vec3 v = (*vertices)[i] - positionOffset;
+        (*quantizedVertices)[i].set(quantizeToShort(v.x()/positionScale.x()),
+                                    quantizeToShort(v.y()/positionScale.y()),
+                                    quantizeToShort(v.z()/positionScale.z()));
+    }
+
+    _numBytesBefore += vertices->getTotalDataSize();
+    _numBytesAfter += quantizedVertices->getTotalDataSize();
+
+    geom.setVertexArray(quantizedVertices.get());
+
+    // normals, octahedral encoded and passed down the normal texture unit
+    if (normals)
+    {
+        ref_ptr<Vec2sArray> encodedNormals = new Vec2sArray(numVertices);
+        encodedNormals->setBinding(Array::BIND_PER_VERTEX);
+        for(unsigned int i=0; i<numVertices; ++i)
+        {
+            (*encodedNormals)[i] = encodeOctahedral((*normals)[i]);
+        }
+
+        _numBytesBefore += normals->getTotalDataSize();
+        _numBytesAfter += encodedNormals->getTotalDataSize();
+
+        geom.setNormalArray(0);
+        geom.setTexCoordArray(_normalTextureUnit, encodedNormals.get(), Array::BIND_PER_VERTEX);
+    }
+
+    // texture coordinates, quantized relative to the centre of their range
+    Vec4 texcoordScaleOffset(1.0f, 1.0f, 0.0f, 0.0f);
+    if (texcoords && !texcoords->empty())
+    {
+        Vec2 tmin = texcoords->front();
+        Vec2 tmax = texcoords->front();
+        for(Vec2Array::const_iterator itr = texcoords->begin(); itr != texcoords->end(); ++itr)
+        {
+            tmin.set(osg::minimum(tmin.x(), itr->x()), osg::minimum(tmin.y(), itr->y()));
+            tmax.set(osg::maximum(tmax.x(), itr->x()), osg::maximum(tmax.y(), itr->y()));
+        }
+
+        Vec2 texcoordOffset = (tmin+tmax)*0.5f;
+        Vec2 texcoordScale(quantizationScale((tmax.x()-tmin.x())*0.5f),
+                           quantizationScale((tmax.y()-tmin.y())*0.5f));
+
+        ref_ptr<Vec2sArray> quantizedTexCoords = new Vec2sArray(numVertices);
+        quantizedTexCoords->setBinding(Array::BIND_PER_VERTEX);
+        for(unsigned int i=0; i<numVertices; ++i)
+        {
+            Vec2 t = (*texcoords)[i] - texcoordOffset;
+            (*quantizedTexCoords)[i].set(quantizeToShort(t.x()/texcoordScale.x()),
+                                         quantizeToShort(t.y()/texcoordScale.y()));
+        }
+
+        _numBytesBefore += texcoords->getTotalDataSize();
+        _numBytesAfter += quantizedTexCoords->getTotalDataSize();
+
+        geom.setTexCoordArray(0, quantizedTexCoords.get(), Array::BIND_PER_VERTEX);
+
+        texcoordScaleOffset.set(texcoordScale.x()/32767.0f, texcoordScale.y()/32767.0f,
+                                texcoordOffset.x(), texcoordOffset.y());
+    }
+
+    // the quantized vertex array can't be used to compute the bounds so provide them up front
+    geom.setInitialBound(bb);
+
+    // the uniforms are specific to this Geometry so mustn't be added to a StateSet it shares with others
+    if (geom.getStateSet() && geom.getStateSet()->getNumParents()>1)
+    {
+        geom.setStateSet(osg::clone(geom.getStateSet(), osg::CopyOp::SHALLOW_COPY));
+    }
+
+    StateSet* stateset = geom.getOrCreateStateSet();
+    stateset->addUniform(new Uniform("osg_QuantizedPositionScale", Vec3(positionScale/32767.0f)));
+    stateset->addUniform(new Uniform("osg_QuantizedPositionOffset", positionOffset));
+    stateset->addUniform(new Uniform("osg_QuantizedTexCoordScaleOffset", texcoordScaleOffset));
+
+    if (_assignShaderAttribute)
+    {
+        // only decode the octahedral normals for Geometry whose normals have been encoded
+        ref_ptr<ShaderAttribute>& shaderAttribute = normals ? _normalsShaderAttribute : _shaderAttribute;
+        if (!shaderAttribute) shaderAttribute = createDequantizationShaderAttribute(_normalTextureUnit, normals!=0, _shaderAttributeType);
+        stateset->setAttribute(shaderAttribute.get());
+    }
+
+    geom.dirtyDisplayList();
+}
+
+ShaderAttribute* VertexQuantizationVisitor::createDequantizationShaderAttribute(unsigned int normalTextureUnit, bool quantizedNormals, StateAttribute::Type type)
+{
+    std::string declarations =
+        "uniform vec3 osg_QuantizedPositionScale;\n"
+        "uniform vec3 osg_QuantizedPositionOffset;\n"
+        "uniform vec4 osg_QuantizedTexCoordScaleOffset;\n"
+        "vec4 osg_DequantizedVertex;\n"
+        "vec3 osg_DequantizedNormal;\n"
+        "vec4 osg_DequantizedTexCoord0;\n";
+
+    std::string decodeNormal = "osg_DequantizedNormal = normalize(gl_NormalMatrix * gl_Normal);\n";
+
+    if (quantizedNormals)
+    {
+        declarations +=
+            "vec3 osg_decodeOctahedralNormal(vec2 e)\n"
+            "{\n"
+            "    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+            "    if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);\n"
+            "    return normalize(v);\n"
+            "}\n";
+
+        std::stringstream normalTexCoord;
+        normalTexCoord<<"gl_MultiTexCoord"<<normalTextureUnit;
+        decodeNormal = "osg_DequantizedNormal = normalize(gl_NormalMatrix * osg_decodeOctahedralNormal("+normalTexCoord.str()+".xy / 32767.0));\n";
+    }
+
+    ref_ptr<Shader> vertexShader = new Shader(Shader::VERTEX);
+    vertexShader->addCodeInjection(-1.0f, declarations);
+    vertexShader->addCodeInjection(0.0f,
+        "osg_DequantizedVertex = vec4(gl_Vertex.xyz * osg_QuantizedPositionScale + osg_QuantizedPositionOffset, 1.0);\n"+
+        decodeNormal+
+        "osg_DequantizedTexCoord0 = vec4(gl_MultiTexCoord0.xy * osg_QuantizedTexCoordScaleOffset.xy + osg_QuantizedTexCoordScaleOffset.zw, gl_MultiTexCoord0.zw);\n"
+        "gl_Position = gl_ModelViewProjectionMatrix * osg_DequantizedVertex;\n");
+
+    ShaderAttribute* sa = new ShaderAttribute;
+    sa->setType(type);
+    sa->addShader(vertexShader.get());
+    return sa;
+}
+
 void SharedArrayOptimizer::findDuplicatedUVs(const osg::Geometry& geometry)
 {
     _deduplicateUvs.clear();
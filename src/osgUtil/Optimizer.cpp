@@ -56,7 +56,7 @@ void Optimizer::reset()
 {
 }
 
-static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES  | TRISTRIP_GEOMETRY | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM");
+static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES  | TRISTRIP_GEOMETRY | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM | VERTEX_QUANTIZATION");
 
 void Optimizer::optimize(osg::Node* node)
 {
@@ -136,6 +136,9 @@ void Optimizer::optimize(osg::Node* node)
         if(str.find("~VERTEX_PRETRANSFORM")!=std::string::npos) options ^= VERTEX_PRETRANSFORM;
         else if(str.find("VERTEX_PRETRANSFORM")!=std::string::npos) options |= VERTEX_PRETRANSFORM;
 
+        if(str.find("~VERTEX_QUANTIZATION")!=std::string::npos) options ^= VERTEX_QUANTIZATION;
+        else if(str.find("VERTEX_QUANTIZATION")!=std::string::npos) options |= VERTEX_QUANTIZATION;
+
     }
     else
     {
@@ -382,6 +385,15 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
         vaov.optimizeOrder();
     }
 
+    if (options & VERTEX_QUANTIZATION)
+    {
+        OSG_INFO<<"Optimizer::optimize() doing VERTEX_QUANTIZATION"<<std::endl;
+        VertexQuantizationVisitor vqv(this);
+        node->accept(vqv);
+        vqv.quantize();
+        OSG_INFO<<"    vertex data reduced from "<<vqv.getNumBytesBefore()<<" to "<<vqv.getNumBytesAfter()<<" bytes"<<std::endl;
+    }
+
     if (osg::getNotifyLevel()>=osg::INFO)
     {
         stats.reset();
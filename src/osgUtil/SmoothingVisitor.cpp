@@ -10,15 +10,17 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * OpenSceneGraph Public License for more details.
 */
-#include <osg/TriangleFunctor>
 #include <osg/TriangleIndexFunctor>
 #include <osg/io_utils>
 
 #include <osgUtil/SmoothingVisitor>
+#include <osgUtil/WorkerThreadPool>
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include <list>
-#include <set>
+#include <vector>
 #include <osgUtil/MeshOptimizers>
 
 
@@ -28,70 +30,202 @@ using namespace osgUtil;
 namespace Smoother
 {
 
-struct LessPtr
+typedef std::vector<unsigned int> IndexList;
+
+// collects the vertex indices of all the triangles in a Geometry, skipping degenerate and out of range triangles.
+struct CollectTriangleIndices
 {
-    inline bool operator() (const osg::Vec3* lhs,const osg::Vec3* rhs) const
+    CollectTriangleIndices():
+        _numVertices(0),
+        _currentPrimitiveSetIndex(0) {}
+
+    void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
     {
-        return *lhs<*rhs;
+        if (p1==p2 || p2==p3 || p1==p3) return;
+        if (p1>=_numVertices || p2>=_numVertices || p3>=_numVertices) return;
+
+        _indices.push_back(p1);
+        _indices.push_back(p2);
+        _indices.push_back(p3);
+        _primitiveSetIndices.push_back(_currentPrimitiveSetIndex);
     }
+
+    unsigned int    _numVertices;
+    unsigned int    _currentPrimitiveSetIndex;
+    IndexList       _indices;
+    IndexList       _primitiveSetIndices;
 };
 
-// triangle functor.
-struct SmoothTriangleFunctor
+static unsigned int collectTriangles(osg::Geometry& geom, unsigned int numVertices, osg::TriangleIndexFunctor<CollectTriangleIndices>& collector)
 {
+    collector._numVertices = numVertices;
+    for(unsigned int i = 0; i < geom.getNumPrimitiveSets(); ++i)
+    {
+        collector._currentPrimitiveSetIndex = i;
+        geom.getPrimitiveSet(i)->accept(collector);
+    }
+    return collector._indices.size()/3;
+}
 
-    osg::Vec3* _coordBase;
-    osg::Vec3* _normalBase;
+inline unsigned int hashVec3(const osg::Vec3& v)
+{
+    unsigned int hash = 2166136261u;
+    for(unsigned int i=0; i<3; ++i)
+    {
+        // make sure -0.0 and 0.0, which compare as equal, hash the same
+        float f = (v[i]==0.0f) ? 0.0f : v[i];
+        unsigned int bits;
+        memcpy(&bits, &f, sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    return hash ^ (hash>>15);
+}
 
-    typedef std::multiset<const osg::Vec3*,LessPtr> CoordinateSet;
-    CoordinateSet _coordSet;
+// map each vertex to the first vertex in the array with the same position, using an open addressing hash table.
+static void findSharedVertices(const osg::Vec3Array& vertices, IndexList& shared)
+{
+    const unsigned int numVertices = vertices.size();
+    shared.resize(numVertices);
 
-    SmoothTriangleFunctor():
-         _coordBase(0),
-         _normalBase(0) {}
+    unsigned int tableSize = 1;
+    while(tableSize < numVertices*2) tableSize <<= 1;
+    const unsigned int mask = tableSize-1;
+    const unsigned int empty = ~0u;
+    IndexList table(tableSize, empty);
 
-    void set(osg::Vec3 *cb,int noVertices, osg::Vec3 *nb)
+    for(unsigned int i=0; i<numVertices; ++i)
     {
-        _coordBase=cb;
-        _normalBase=nb;
-
-        osg::Vec3* vptr = cb;
-        for(int i=0;i<noVertices;++i)
+        const osg::Vec3& v = vertices[i];
+        unsigned int slot = hashVec3(v) & mask;
+        while(table[slot]!=empty && !(vertices[table[slot]]==v))
         {
-            _coordSet.insert(vptr++);
+            slot = (slot+1) & mask;
         }
+
+        if (table[slot]==empty) table[slot] = i;
+        shared[i] = table[slot];
     }
+}
 
-    inline void updateNormal(const osg::Vec3& normal,const osg::Vec3* vptr)
-    {
-        std::pair<CoordinateSet::iterator,CoordinateSet::iterator> p =
-            _coordSet.equal_range(vptr);
+struct ComputeFaceNormals : public WorkerThreadPool::RangeOperation
+{
+    ComputeFaceNormals(const osg::Vec3Array& vertices, const IndexList& indices, std::vector<osg::Vec3>& faceNormals, bool normalize):
+        _vertices(vertices),
+        _indices(indices),
+        _faceNormals(faceNormals),
+        _normalize(normalize) {}
 
-        for(CoordinateSet::iterator itr=p.first;
-            itr!=p.second;
-            ++itr)
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int t=begin; t<end; ++t)
         {
-            osg::Vec3* nptr = _normalBase + (*itr-_coordBase);
-            (*nptr) += normal;
+            const osg::Vec3& v1 = _vertices[_indices[t*3]];
+            const osg::Vec3& v2 = _vertices[_indices[t*3+1]];
+            const osg::Vec3& v3 = _vertices[_indices[t*3+2]];
+            osg::Vec3 normal( (v2-v1)^(v3-v1) );
+            if (_normalize) normal.normalize();
+            _faceNormals[t] = normal;
         }
     }
 
-    inline void operator() ( const osg::Vec3 &v1, const osg::Vec3 &v2, const osg::Vec3 &v3, bool treatVertexDataAsTemporary )
+    const osg::Vec3Array&       _vertices;
+    const IndexList&            _indices;
+    std::vector<osg::Vec3>&     _faceNormals;
+    bool                        _normalize;
+};
+
+// sums the face normals of the triangles adjacent to each vertex, the triangles of each vertex are kept
+// in index order so the result doesn't depend upon how the work is split across threads.
+struct GatherVertexNormals : public WorkerThreadPool::RangeOperation
+{
+    GatherVertexNormals(const IndexList& offsets, const IndexList& triangles, const std::vector<osg::Vec3>& faceNormals, osg::Vec3Array& normals):
+        _offsets(offsets),
+        _triangles(triangles),
+        _faceNormals(faceNormals),
+        _normals(normals) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
     {
-        if (!treatVertexDataAsTemporary)
+        for(unsigned int v=begin; v<end; ++v)
         {
-            // calc orientation of triangle.
-            osg::Vec3 normal = (v2-v1)^(v3-v1);
-            // normal.normalize();
-
-            updateNormal(normal,&v1);
-            updateNormal(normal,&v2);
-            updateNormal(normal,&v3);
+            osg::Vec3 normal(0.0f,0.0f,0.0f);
+            for(unsigned int i=_offsets[v]; i<_offsets[v+1]; ++i)
+            {
+                normal += _faceNormals[_triangles[i]];
+            }
+            normal.normalize();
+            _normals[v] = normal;
         }
+    }
 
+    const IndexList&                _offsets;
+    const IndexList&                _triangles;
+    const std::vector<osg::Vec3>&   _faceNormals;
+    osg::Vec3Array&                 _normals;
+};
+
+struct CopySharedNormals : public WorkerThreadPool::RangeOperation
+{
+    CopySharedNormals(const IndexList& shared, osg::Vec3Array& normals):
+        _shared(shared),
+        _normals(normals) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for(unsigned int v=begin; v<end; ++v)
+        {
+            if (_shared[v]!=v) _normals[v] = _normals[_shared[v]];
+        }
     }
+
+    const IndexList&    _shared;
+    osg::Vec3Array&     _normals;
 };
 
+static const unsigned int s_minBlockSize = 4096;
+
+// compute the vertex normals as the sum of the adjacent face normals, if shared is non null vertices are mapped through
+// it so that all the vertices that share a position get the same normal.
+static void computeVertexNormals(const osg::Vec3Array& vertices, const IndexList& indices, bool areaWeighted, const IndexList* shared, osg::Vec3Array& normals)
+{
+    const unsigned int numVertices = vertices.size();
+    const unsigned int numTriangles = indices.size()/3;
+    WorkerThreadPool* workerThreadPool = WorkerThreadPool::instance();
+
+    std::vector<osg::Vec3> faceNormals(numTriangles);
+    ComputeFaceNormals computeFaceNormals(vertices, indices, faceNormals, !areaWeighted);
+    workerThreadPool->run(computeFaceNormals, numTriangles, s_minBlockSize);
+
+    // build the vertex to triangle adjacency
+    IndexList offsets(numVertices+1, 0);
+    for(IndexList::const_iterator itr = indices.begin(); itr != indices.end(); ++itr)
+    {
+        ++offsets[(shared ? (*shared)[*itr] : *itr) + 1];
+    }
+    for(unsigned int v=0; v<numVertices; ++v)
+    {
+        offsets[v+1] += offsets[v];
+    }
+
+    IndexList triangles(indices.size());
+    IndexList position(offsets.begin(), offsets.end()-1);
+    for(unsigned int i=0; i<indices.size(); ++i)
+    {
+        triangles[position[shared ? (*shared)[indices[i]] : indices[i]]++] = i/3;
+    }
+
+    normals.resize(numVertices);
+
+    GatherVertexNormals gatherVertexNormals(offsets, triangles, faceNormals, normals);
+    workerThreadPool->run(gatherVertexNormals, numVertices, s_minBlockSize);
+
+    if (shared)
+    {
+        CopySharedNormals copySharedNormals(*shared, normals);
+        workerThreadPool->run(copySharedNormals, numVertices, s_minBlockSize);
+    }
+}
+
 static void smooth_old(osg::Geometry& geom)
 {
     OSG_INFO<<"smooth_old("<<&geom<<")"<<std::endl;
@@ -122,131 +256,43 @@ static void smooth_old(osg::Geometry& geom)
     osg::Vec3Array *coords = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
     if (!coords || !coords->size()) return;
 
-    osg::Vec3Array *normals = new osg::Vec3Array(coords->size());
-
-    osg::Vec3Array::iterator nitr;
-    for(nitr = normals->begin();
-        nitr!=normals->end();
-        ++nitr)
-    {
-        nitr->set(0.0f,0.0f,0.0f);
-    }
+    osg::TriangleIndexFunctor<CollectTriangleIndices> collector;
+    collectTriangles(geom, coords->size(), collector);
 
-    TriangleFunctor<SmoothTriangleFunctor> stf;
-    stf.set(&(coords->front()),coords->size(),&(normals->front()));
+    // vertices that share the same position are smoothed together regardless of their indices.
+    IndexList shared;
+    findSharedVertices(*coords, shared);
 
-    geom.accept(stf);
+    osg::Vec3Array *normals = new osg::Vec3Array(coords->size());
+    computeVertexNormals(*coords, collector._indices, true, &shared, *normals);
 
-    for(nitr= normals->begin();
-        nitr!=normals->end();
-        ++nitr)
-    {
-        nitr->normalize();
-    }
     geom.setNormalArray( normals, osg::Array::BIND_PER_VERTEX);
 
     geom.dirtyDisplayList();
 }
 
 
-struct SmoothTriangleIndexFunctor
-{
-    SmoothTriangleIndexFunctor():
-        _vertices(0),
-        _normals(0)
-    {
-    }
-
-    bool set(osg::Vec3Array* vertices, osg::Vec3Array* normals)
-    {
-        _vertices = vertices;
-        _normals = normals;
-
-        if (!_vertices)
-        {
-            OSG_NOTICE<<"Warning: SmoothTriangleIndexFunctor::set(..) requires a valid vertex arrays."<<std::endl;
-            return false;
-        }
-
-        if (!_normals)
-        {
-            OSG_NOTICE<<"Warning: SmoothTriangleIndexFunctor::set(..) requires a valid normal arrays."<<std::endl;
-            return false;
-        }
-
-        for(osg::Vec3Array::iterator itr = _normals->begin();
-            itr != _normals->end();
-            ++itr)
-        {
-            (*itr).set(0.0f,0.0f,0.0f);
-        }
-
-        return true;
-    }
-
-    void normalize()
-    {
-        if (!_normals) return;
-
-        for(osg::Vec3Array::iterator itr = _normals->begin();
-            itr != _normals->end();
-            ++itr)
-        {
-            (*itr).normalize();
-        }
-    }
-
-    void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
-    {
-        if (p1==p2 || p2==p3 || p1==p3)
-        {
-            return;
-        }
-
-        const osg::Vec3& v1 = (*_vertices)[p1];
-        const osg::Vec3& v2 = (*_vertices)[p2];
-        const osg::Vec3& v3 = (*_vertices)[p3];
-        osg::Vec3 normal( (v2-v1)^(v3-v1) );
-
-        normal.normalize();
-
-        (*_normals)[p1] += normal;
-        (*_normals)[p2] += normal;
-        (*_normals)[p3] += normal;
-    }
-
-    osg::Vec3Array*     _vertices;
-    osg::Vec3Array*     _normals;
-};
-
-
-
 struct FindSharpEdgesFunctor
 {
     FindSharpEdgesFunctor():
+        _geometry(0),
         _vertices(0),
         _normals(0),
-        _maxDeviationDotProduct(0.0f),
-        _currentPrimitiveSetIndex(0)
+        _creaseAngle(0.0f),
+        _maxDeviationDotProduct(0.0f)
     {
     }
 
-    struct Triangle : public osg::Referenced
+    struct Triangle
     {
         Triangle(unsigned int primitiveSetIndex, unsigned int p1, unsigned int p2, unsigned int p3):
             _primitiveSetIndex(primitiveSetIndex), _p1(p1), _p2(p2), _p3(p3) {}
 
-        Triangle(const Triangle& tri):
-            osg::Referenced(true),
-            _primitiveSetIndex(tri._primitiveSetIndex), _p1(tri._p1), _p2(tri._p2), _p3(tri._p3) {}
-
-        Triangle& operator = (const Triangle& tri)
+        inline void replace(unsigned int p, unsigned int new_p)
         {
-            _primitiveSetIndex = tri._primitiveSetIndex;
-            _p1 = tri._p1;
-            _p2 = tri._p2;
-            _p3 = tri._p3;
-            return *this;
+            if (_p1==p) _p1 = new_p;
+            if (_p2==p) _p2 = new_p;
+            if (_p3==p) _p3 = new_p;
         }
 
         unsigned int _primitiveSetIndex;
@@ -255,19 +301,7 @@ struct FindSharpEdgesFunctor
         unsigned int _p3;
     };
 
-    typedef std::list< osg::ref_ptr<Triangle> > Triangles;
-
-    struct ProblemVertex : public osg::Referenced
-    {
-        ProblemVertex(unsigned int p):
-            _point(p) {}
-
-        unsigned int _point;
-        Triangles _triangles;
-    };
-
-    typedef std::vector< osg::ref_ptr<ProblemVertex> > ProblemVertexVector;
-    typedef std::list< osg::ref_ptr<ProblemVertex> > ProblemVertexList;
+    typedef std::vector<Triangle> Triangles;
     typedef std::list< osg::ref_ptr<osg::Array> > ArrayList;
 
     bool set(osg::Geometry* geom, float creaseAngle)
@@ -277,7 +311,7 @@ struct FindSharpEdgesFunctor
 
         if (!_geometry)
         {
-            OSG_NOTICE<<"Warning: SmoothTriangleIndexFunctor::set(..) requires a geometry."<<std::endl;
+            OSG_NOTICE<<"Warning: FindSharpEdgesFunctor::set(..) requires a geometry."<<std::endl;
             return false;
         }
 
@@ -287,18 +321,16 @@ struct FindSharpEdgesFunctor
 
         if (!_vertices)
         {
-            OSG_NOTICE<<"Warning: SmoothTriangleIndexFunctor::set(..) requires a valid vertex arrays."<<std::endl;
+            OSG_NOTICE<<"Warning: FindSharpEdgesFunctor::set(..) requires a valid vertex arrays."<<std::endl;
             return false;
         }
 
         if (!_normals)
         {
-            OSG_NOTICE<<"Warning: SmoothTriangleIndexFunctor::set(..) requires a valid normal arrays."<<std::endl;
+            OSG_NOTICE<<"Warning: FindSharpEdgesFunctor::set(..) requires a valid normal arrays."<<std::endl;
             return false;
         }
 
-        _problemVertexVector.resize(_vertices->size());
-
         addArray(geom->getVertexArray());
         addArray(geom->getNormalArray());
         addArray(geom->getColorArray());
@@ -321,90 +353,74 @@ struct FindSharpEdgesFunctor
         }
     }
 
-    void operator() (unsigned int p1, unsigned int p2, unsigned int p3)
+    // find the vertices whose smoothed normal deviates too far from the face normal of any of its triangles.
+    void findProblemVertices(const IndexList& indices, const IndexList& primitiveSetIndices, const std::vector<osg::Vec3>& faceNormals)
     {
-        osg::Vec3 normal( computeNormal(p1, p2, p3) );
+        const unsigned int numTriangles = primitiveSetIndices.size();
+        _triangles.reserve(numTriangles);
 
-        if (p1==p2 || p2==p3 || p1==p3)
+        std::vector<bool> problemVertex(_vertices->size(), false);
+        for(unsigned int t=0; t<numTriangles; ++t)
         {
-            // OSG_NOTICE<<"NULL triangle ("<<p1<<", "<<p2<<", "<<p3<<")"<<std::endl;
-            return;
-        }
+            unsigned int p1 = indices[t*3], p2 = indices[t*3+1], p3 = indices[t*3+2];
+            _triangles.push_back(Triangle(primitiveSetIndices[t], p1, p2, p3));
 
-        Triangle* tri = new Triangle(_currentPrimitiveSetIndex, p1, p2, p3);
-        _triangles.push_back(tri);
+            const osg::Vec3& normal = faceNormals[t];
+            if (checkDeviation(p1, normal)) markProblemVertex(p1, problemVertex);
+            if (checkDeviation(p2, normal)) markProblemVertex(p2, problemVertex);
+            if (checkDeviation(p3, normal)) markProblemVertex(p3, problemVertex);
+        }
 
-        if (checkDeviation(p1, normal)) markProblemVertex(p1);
-        if (checkDeviation(p2, normal)) markProblemVertex(p2);
-        if (checkDeviation(p3, normal)) markProblemVertex(p3);
-    }
+        // collect the triangles of each problem vertex, stored contiguously per problem vertex.
+        IndexList problemVertexIndex(_vertices->size(), 0);
+        for(unsigned int i=0; i<_problemVertices.size(); ++i)
+        {
+            problemVertexIndex[_problemVertices[i]] = i;
+        }
 
-    void markProblemVertex(unsigned int p)
-    {
-        if (!_problemVertexVector[p])
+        _problemTriangleOffsets.assign(_problemVertices.size()+1, 0);
+        for(unsigned int i=0; i<indices.size(); ++i)
         {
-            _problemVertexVector[p] = new ProblemVertex(p);
-            _problemVertexList.push_back(_problemVertexVector[p]);
+            if (problemVertex[indices[i]]) ++_problemTriangleOffsets[problemVertexIndex[indices[i]]+1];
+        }
+        for(unsigned int i=0; i<_problemVertices.size(); ++i)
+        {
+            _problemTriangleOffsets[i+1] += _problemTriangleOffsets[i];
         }
-    }
 
-    void checkTrianglesForProblemVertices()
-    {
-        for(Triangles::iterator itr = _triangles.begin();
-            itr != _triangles.end();
-            ++itr)
+        _problemTriangles.resize(_problemTriangleOffsets.back());
+        IndexList position(_problemTriangleOffsets.begin(), _problemTriangleOffsets.end()-1);
+        for(unsigned int i=0; i<indices.size(); ++i)
         {
-            Triangle* tri = itr->get();
-            insertTriangleIfProblemVertex(tri->_p1, tri);
-            insertTriangleIfProblemVertex(tri->_p2, tri);
-            insertTriangleIfProblemVertex(tri->_p3, tri);
+            if (problemVertex[indices[i]]) _problemTriangles[position[problemVertexIndex[indices[i]]]++] = i/3;
         }
     }
 
-    void insertTriangleIfProblemVertex(unsigned int p, Triangle* tri)
+    inline void markProblemVertex(unsigned int p, std::vector<bool>& problemVertex)
     {
-        if (_problemVertexVector[p]) _problemVertexVector[p]->_triangles.push_back(tri);
+        if (!problemVertex[p])
+        {
+            problemVertex[p] = true;
+            _problemVertices.push_back(p);
+        }
     }
 
-    bool checkDeviation(unsigned int p, osg::Vec3& normal)
+    inline bool checkDeviation(unsigned int p, const osg::Vec3& normal) const
     {
         float deviation = normal * (*_normals)[p];
         return (deviation < _maxDeviationDotProduct);
     }
 
-    osg::Vec3 computeNormal(unsigned int p1, unsigned int p2, unsigned int p3)
+    osg::Vec3 computeNormal(const Triangle& tri) const
     {
-        const osg::Vec3& v1 = (*_vertices)[p1];
-        const osg::Vec3& v2 = (*_vertices)[p2];
-        const osg::Vec3& v3 = (*_vertices)[p3];
+        const osg::Vec3& v1 = (*_vertices)[tri._p1];
+        const osg::Vec3& v2 = (*_vertices)[tri._p2];
+        const osg::Vec3& v3 = (*_vertices)[tri._p3];
         osg::Vec3 normal( (v2-v1)^(v3-v1) );
         normal.normalize();
         return normal;
     }
 
-    void listProblemVertices()
-    {
-        OSG_NOTICE<<"listProblemVertices() "<<_problemVertexList.size()<<std::endl;
-        for(ProblemVertexList::iterator itr = _problemVertexList.begin();
-            itr != _problemVertexList.end();
-            ++itr)
-        {
-            ProblemVertex* pv = itr->get();
-            OSG_NOTICE<<"  pv._point = "<<pv->_point<<" triangles "<<pv->_triangles.size()<<std::endl;
-            for(Triangles::iterator titr = pv->_triangles.begin();
-                titr != pv->_triangles.end();
-                ++titr)
-            {
-                Triangle* tri = titr->get();
-                OSG_NOTICE<<"    triangle("<<tri->_p1<<", "<<tri->_p2<<", "<<tri->_p3<<")"<<std::endl;
-                osg::Vec3 normal( computeNormal(tri->_p1, tri->_p2, tri->_p3) );
-                float deviation = normal * (*_normals)[pv->_point];
-                OSG_NOTICE<<"    deviation "<<deviation<<std::endl;
-            }
-
-        }
-    }
-
     class DuplicateVertex : public osg::ArrayVisitor
     {
         public:
@@ -449,151 +465,119 @@ struct FindSharpEdgesFunctor
         return duplicate._end;
     }
 
-    void duplicateProblemVertexAll(ProblemVertex* pv)
+    struct IsAssociated
     {
-        unsigned int p = pv->_point;
-        Triangles::iterator titr = pv->_triangles.begin();
-        ++titr;
-        for(;
-            titr != pv->_triangles.end();
-            ++titr)
+        IsAssociated(const FindSharpEdgesFunctor& fsef, const osg::Vec3& normal):
+            _fsef(fsef),
+            _normal(normal) {}
+
+        bool operator() (unsigned int t) const
         {
-            Triangle* tri = titr->get();
-            unsigned int duplicated_p = duplicateVertex(p);
-            if (tri->_p1==p) tri->_p1 = duplicated_p;
-            if (tri->_p2==p) tri->_p2 = duplicated_p;
-            if (tri->_p3==p) tri->_p3 = duplicated_p;
+            return (_normal * _fsef.computeNormal(_fsef._triangles[t])) >= _fsef._maxDeviationDotProduct;
         }
-    }
 
-    void duplicateProblemVertex(ProblemVertex* pv)
+        const FindSharpEdgesFunctor&    _fsef;
+        osg::Vec3                       _normal;
+    };
+
+    void duplicateProblemVertex(unsigned int p, unsigned int* begin, unsigned int* end)
     {
-        if (pv->_triangles.size()<=2)
+        if (end-begin<=2)
         {
-            duplicateProblemVertexAll(pv);
+            // the first triangle keeps the original vertex
+            for(unsigned int* titr = begin+1; titr != end; ++titr)
+            {
+                _triangles[*titr].replace(p, duplicateVertex(p));
+            }
         }
         else
         {
             // implement a form of greedy association based on similar orientation
             // rather than iterating through all the various permutation of triangles that might
-            // provide the best fit.
-            unsigned int p = pv->_point;
-            Triangles::iterator titr = pv->_triangles.begin();
-            while(titr != pv->_triangles.end())
+            // provide the best fit.  Each group of associated triangles gets its own duplicate of
+            // the vertex, associated triangles are moved to the front of the remaining range.
+            while(begin != end)
             {
-                Triangle* tri = titr->get();
-                osg::Vec3 normal = computeNormal(tri->_p1, tri->_p2, tri->_p3);
-
-                Triangles associatedTriangles;
-                associatedTriangles.push_back(tri);
+                osg::Vec3 normal = computeNormal(_triangles[*begin]);
 
-                // remove triangle for list
-                pv->_triangles.erase(titr);
+                // move the triangles that are close enough together to associate to the front,
+                // keeping the order of the rest so the next seed triangle is chosen as before.
+                unsigned int* associatedEnd = std::stable_partition(begin+1, end, IsAssociated(*this, normal));
 
-                // reset iterator
-                titr = pv->_triangles.begin();
-                while(titr != pv->_triangles.end())
-                {
-                    Triangle* tri2 = titr->get();
-                    osg::Vec3 normal2 = computeNormal(tri2->_p1, tri2->_p2, tri2->_p3);
-                    float deviation = normal * normal2;
-                    if (deviation >= _maxDeviationDotProduct)
-                    {
-                        // Tri and tri2 are close enough together to associate.
-                        associatedTriangles.push_back(tri2);
-
-                        Triangles::iterator titr_to_erase = titr;
-
-                        ++titr;
-                        pv->_triangles.erase(titr_to_erase);
-                    }
-                    else
-                    {
-                        ++titr;
-                    }
-                }
-
-                // create duplicate vertex to set of associated triangles
+                // create duplicate vertex for the set of associated triangles
                 unsigned int duplicated_p = duplicateVertex(p);
-
-                // now rest the index on th triangles of the point that was duplicated
-                for(Triangles::iterator aitr = associatedTriangles.begin();
-                    aitr != associatedTriangles.end();
-                    ++aitr)
+                for(unsigned int* aitr = begin; aitr != associatedEnd; ++aitr)
                 {
-                    Triangle* tri = aitr->get();
-                    if (tri->_p1==p) tri->_p1 = duplicated_p;
-                    if (tri->_p2==p) tri->_p2 = duplicated_p;
-                    if (tri->_p3==p) tri->_p3 = duplicated_p;
+                    _triangles[*aitr].replace(p, duplicated_p);
                 }
 
-                // reset iterator to beginning
-                titr = pv->_triangles.begin();
+                begin = associatedEnd;
             }
-
         }
     }
 
     void duplicateProblemVertices()
     {
-        checkTrianglesForProblemVertices();
-
-        for(ProblemVertexList::iterator itr = _problemVertexList.begin();
-            itr != _problemVertexList.end();
-            ++itr)
+        for(unsigned int i=0; i<_problemVertices.size(); ++i)
         {
-            ProblemVertex* pv = itr->get();
-            if (pv->_triangles.size()>1)
+            unsigned int numTriangles = _problemTriangleOffsets[i+1]-_problemTriangleOffsets[i];
+            if (numTriangles>1)
             {
-                duplicateProblemVertex(itr->get());
+                unsigned int* begin = &_problemTriangles[_problemTriangleOffsets[i]];
+                duplicateProblemVertex(_problemVertices[i], begin, begin+numTriangles);
             }
         }
     }
 
-    osg::PrimitiveSet* createPrimitiveSet(Triangles& triangles)
+    void updateGeometry(IndexList& indices)
     {
-        osg::ref_ptr<osg::DrawElements> elements = (_vertices->size()<16384) ?
-            static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_TRIANGLES)) :
-            static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_TRIANGLES));
-
-        elements->reserveElements(triangles.size()*3);
+        duplicateProblemVertices();
 
-        for(Triangles::iterator itr = triangles.begin();
-            itr != triangles.end();
+        // count the triangles of each primitive set so the new elements can be sized up front.
+        IndexList numTrianglesPerPrimitiveSet(_geometry->getNumPrimitiveSets(), 0);
+        for(Triangles::iterator itr = _triangles.begin();
+            itr != _triangles.end();
             ++itr)
         {
-            Triangle* tri = itr->get();
-            elements->addElement(tri->_p1);
-            elements->addElement(tri->_p2);
-            elements->addElement(tri->_p3);
+            ++numTrianglesPerPrimitiveSet[itr->_primitiveSetIndex];
         }
 
-        return elements.release();
-    }
+        std::vector< osg::ref_ptr<osg::DrawElements> > elementsList(_geometry->getNumPrimitiveSets());
+        for(unsigned int i=0; i<elementsList.size(); ++i)
+        {
+            if (numTrianglesPerPrimitiveSet[i]==0) continue;
 
-    void updateGeometry()
-    {
-        duplicateProblemVertices();
+            elementsList[i] = (_vertices->size()<16384) ?
+                static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(GL_TRIANGLES)) :
+                static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(GL_TRIANGLES));
 
+            elementsList[i]->reserveElements(numTrianglesPerPrimitiveSet[i]*3);
+        }
 
-        typedef std::map<unsigned int, Triangles> TriangleMap;
-        TriangleMap triangleMap;
+        indices.clear();
+        indices.reserve(_triangles.size()*3);
         for(Triangles::iterator itr = _triangles.begin();
             itr != _triangles.end();
             ++itr)
         {
-            Triangle* tri = itr->get();
-            triangleMap[tri->_primitiveSetIndex].push_back(tri);
+            osg::DrawElements* elements = elementsList[itr->_primitiveSetIndex].get();
+            elements->addElement(itr->_p1);
+            elements->addElement(itr->_p2);
+            elements->addElement(itr->_p3);
+
+            indices.push_back(itr->_p1);
+            indices.push_back(itr->_p2);
+            indices.push_back(itr->_p3);
         }
 
-        for(TriangleMap::iterator itr = triangleMap.begin();
-            itr != triangleMap.end();
-            ++itr)
+        for(unsigned int i=0; i<elementsList.size(); ++i)
         {
-            osg::PrimitiveSet* originalPrimitiveSet = _geometry->getPrimitiveSet(itr->first);
-            osg::PrimitiveSet* newPrimitiveSet = createPrimitiveSet(itr->second);
+            if (!elementsList[i]) continue;
+
+            osg::PrimitiveSet* originalPrimitiveSet = _geometry->getPrimitiveSet(i);
+            osg::PrimitiveSet* newPrimitiveSet = elementsList[i]->asPrimitiveSet();
             newPrimitiveSet->setName(originalPrimitiveSet->getName());
-            _geometry->setPrimitiveSet(itr->first, newPrimitiveSet);
+            _geometry->setPrimitiveSet(i, newPrimitiveSet);
         }
     }
 
@@ -604,10 +588,10 @@ struct FindSharpEdgesFunctor
     ArrayList           _arrays;
     float               _creaseAngle;
     float               _maxDeviationDotProduct;
-    ProblemVertexVector _problemVertexVector;
-    ProblemVertexList   _problemVertexList;
     Triangles           _triangles;
-    unsigned int        _currentPrimitiveSetIndex;
+    IndexList           _problemVertices;
+    IndexList           _problemTriangleOffsets;
+    IndexList           _problemTriangles;
 };
 
 
@@ -625,17 +609,11 @@ static void smooth_new(osg::Geometry& geom, double creaseAngle)
         geom.setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
     }
 
-    osg::TriangleIndexFunctor<SmoothTriangleIndexFunctor> stif;
-    if (stif.set(vertices, normals))
-    {
-        // accumulate all the normals
-        geom.accept(stif);
-
-        // normalize the normals
-        stif.normalize();
-    }
+    osg::TriangleIndexFunctor<CollectTriangleIndices> collector;
+    const unsigned int numTriangles = collectTriangles(geom, vertices->size(), collector);
 
-    osg::TriangleIndexFunctor<FindSharpEdgesFunctor> fsef;
+    // accumulate and normalize all the normals
+    computeVertexNormals(*vertices, collector._indices, false, 0, *normals);
 
     osgUtil::SharedArrayOptimizer sharedArrayOptimizer;
     sharedArrayOptimizer.findDuplicatedUVs(geom);
@@ -643,30 +621,19 @@ static void smooth_new(osg::Geometry& geom, double creaseAngle)
     // Duplicate shared arrays to avoid index errors during duplication
     if (geom.containsSharedArrays()) geom.duplicateSharedArrays();
 
+    FindSharpEdgesFunctor fsef;
     if (fsef.set(&geom, creaseAngle))
     {
         // look for normals that deviate too far
+        std::vector<osg::Vec3> faceNormals(numTriangles);
+        ComputeFaceNormals computeFaceNormals(*fsef._vertices, collector._indices, faceNormals, true);
+        WorkerThreadPool::instance()->run(computeFaceNormals, numTriangles, s_minBlockSize);
 
-        fsef.setVertexArray(vertices->getNumElements(), static_cast<const Vec3*>(vertices->getDataPointer()));
-        for(unsigned int i = 0; i < geom.getNumPrimitiveSets(); ++i)
-        {
-            fsef._currentPrimitiveSetIndex = i;
-            geom.getPrimitiveSet(i)->accept(fsef);
-        }
-
-        // fsef.listProblemVertices();
-        fsef.updateGeometry();
-
-        osg::TriangleIndexFunctor<SmoothTriangleIndexFunctor> stif2;
-        if (stif2.set(vertices, normals))
-        {
-            // accumulate all the normals
-            geom.accept(stif);
-
-            // normalize the normals
-            stif.normalize();
-        }
+        fsef.findProblemVertices(collector._indices, collector._primitiveSetIndices, faceNormals);
+        fsef.updateGeometry(collector._indices);
 
+        // recompute the normals now that the vertices on sharp edges have been duplicated
+        computeVertexNormals(*fsef._vertices, collector._indices, false, 0, *fsef._normals);
     }
 
     sharedArrayOptimizer.deduplicateUVs(geom);
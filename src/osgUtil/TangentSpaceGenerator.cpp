@@ -1,62 +1,206 @@
 #include <osgUtil/TangentSpaceGenerator>
+#include <osgUtil/WorkerThreadPool>
 
 #include <osg/Notify>
 #include <osg/io_utils>
 
+#include <math.h>
+#include <vector>
+
 using namespace osgUtil;
 
-TangentSpaceGenerator::TangentSpaceGenerator()
-:    osg::Referenced(),
-    T_(new osg::Vec4Array),
-    B_(new osg::Vec4Array),
-    N_(new osg::Vec4Array)
+namespace TangentSpace
 {
-    T_->setBinding(osg::Array::BIND_PER_VERTEX); T_->setNormalize(false);
-    B_->setBinding(osg::Array::BIND_PER_VERTEX); T_->setNormalize(false);
-    N_->setBinding(osg::Array::BIND_PER_VERTEX); T_->setNormalize(false);
+
+typedef std::vector<unsigned int> IndexList;
+
+static const unsigned int s_minBlockSize = 4096;
+
+// return a pointer to contiguous Vec3 data for the first numVertices elements of an attribute array, Vec3Arrays are
+// used directly while other arrays are converted into storage with Vec2 arrays leaving z as 0 and Vec4 arrays dropping w.
+static const osg::Vec3* getVec3Data(const osg::Array* array, unsigned int numVertices, const char* name, std::vector<osg::Vec3>& storage)
+{
+    if (array->getType()==osg::Array::Vec3ArrayType && array->getNumElements()>=numVertices)
+    {
+        return &(static_cast<const osg::Vec3Array&>(*array).front());
+    }
+
+    storage.assign(numVertices, osg::Vec3(0.0f,0.0f,0.0f));
+    unsigned int num = osg::minimum(numVertices, array->getNumElements());
+    unsigned int i;
+
+    switch (array->getType())
+    {
+    case osg::Array::Vec2ArrayType:
+        for (i=0; i<num; ++i) {
+            const osg::Vec2& v = static_cast<const osg::Vec2Array&>(*array)[i];
+            storage[i].set(v.x(), v.y(), 0.0f);
+        }
+        break;
+
+    case osg::Array::Vec3ArrayType:
+        for (i=0; i<num; ++i) {
+            storage[i] = static_cast<const osg::Vec3Array&>(*array)[i];
+        }
+        break;
+
+    case osg::Array::Vec4ArrayType:
+        for (i=0; i<num; ++i) {
+            const osg::Vec4& v = static_cast<const osg::Vec4Array&>(*array)[i];
+            storage[i].set(v.x(), v.y(), v.z());
+        }
+        break;
+
+    default:
+        OSG_WARN << "Warning: TangentSpaceGenerator: " << name << " array must be Vec2Array, Vec3Array or Vec4Array" << std::endl;
+    }
+
+    return &storage.front();
 }
 
-TangentSpaceGenerator::TangentSpaceGenerator(const TangentSpaceGenerator &copy, const osg::CopyOp &copyop)
-:    osg::Referenced(copy),
-    T_(static_cast<osg::Vec4Array *>(copyop(copy.T_.get()))),
-    B_(static_cast<osg::Vec4Array *>(copyop(copy.B_.get()))),
-    N_(static_cast<osg::Vec4Array *>(copyop(copy.N_.get())))
+static const osg::Vec2* getVec2Data(const osg::Array* array, unsigned int numVertices, const char* name, std::vector<osg::Vec2>& storage)
 {
+    if (array->getType()==osg::Array::Vec2ArrayType && array->getNumElements()>=numVertices)
+    {
+        return &(static_cast<const osg::Vec2Array&>(*array).front());
+    }
+
+    storage.assign(numVertices, osg::Vec2(0.0f,0.0f));
+    unsigned int num = osg::minimum(numVertices, array->getNumElements());
+    unsigned int i;
+
+    switch (array->getType())
+    {
+    case osg::Array::Vec2ArrayType:
+        for (i=0; i<num; ++i) {
+            storage[i] = static_cast<const osg::Vec2Array&>(*array)[i];
+        }
+        break;
+
+    case osg::Array::Vec3ArrayType:
+        for (i=0; i<num; ++i) {
+            const osg::Vec3& v = static_cast<const osg::Vec3Array&>(*array)[i];
+            storage[i].set(v.x(), v.y());
+        }
+        break;
+
+    case osg::Array::Vec4ArrayType:
+        for (i=0; i<num; ++i) {
+            const osg::Vec4& v = static_cast<const osg::Vec4Array&>(*array)[i];
+            storage[i].set(v.x(), v.y());
+        }
+        break;
+
+    default:
+        OSG_WARN << "Warning: TangentSpaceGenerator: " << name << " array must be Vec2Array, Vec3Array or Vec4Array" << std::endl;
+    }
+
+    return &storage.front();
 }
 
-void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit)
+
+// collects the vertex indices of the triangles of a PrimitiveSet, skipping triangles that reference vertices out of range.
+// DrawArrays, DrawArrayLengths and DrawElements indices are read directly rather than through PrimitiveSet::index().
+struct TriangleCollector
 {
-    const osg::Array *vx = geo->getVertexArray();
-    const osg::Array *nx = geo->getNormalArray();
-    const osg::Array *tx = geo->getTexCoordArray(normal_map_tex_unit);
+    TriangleCollector(IndexList& indices, unsigned int numVertices):
+        _indices(indices),
+        _numVertices(numVertices),
+        _pset(0),
+        _first(0),
+        _ubyteIndices(0),
+        _ushortIndices(0),
+        _uintIndices(0) {}
+
+    void setPrimitiveSet(osg::PrimitiveSet* pset)
+    {
+        _pset = pset;
+        _first = 0;
+        _ubyteIndices = 0;
+        _ushortIndices = 0;
+        _uintIndices = 0;
+
+        switch (pset->getType()) {
+            case osg::PrimitiveSet::DrawArraysPrimitiveType:
+                _first = static_cast<osg::DrawArrays*>(pset)->getFirst();
+                _pset = 0;
+                break;
+            case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+                _first = static_cast<osg::DrawArrayLengths*>(pset)->getFirst();
+                _pset = 0;
+                break;
+            case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+                if (pset->getNumIndices()>0) _ubyteIndices = &(static_cast<osg::DrawElementsUByte*>(pset)->front());
+                break;
+            case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+                if (pset->getNumIndices()>0) _ushortIndices = &(static_cast<osg::DrawElementsUShort*>(pset)->front());
+                break;
+            case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+                if (pset->getNumIndices()>0) _uintIndices = &(static_cast<osg::DrawElementsUInt*>(pset)->front());
+                break;
+            default:
+                break;
+        }
+    }
 
-    if (!vx || !tx) return;
+    inline unsigned int index(unsigned int i) const
+    {
+        if (_uintIndices) return _uintIndices[i];
+        if (_ushortIndices) return _ushortIndices[i];
+        if (_ubyteIndices) return _ubyteIndices[i];
+        if (_pset) return _pset->index(i);
+        return _first + i;
+    }
 
+    inline void operator() (unsigned int iA, unsigned int iB, unsigned int iC)
+    {
+        iA = index(iA);
+        iB = index(iB);
+        iC = index(iC);
+        if (iA>=_numVertices || iB>=_numVertices || iC>=_numVertices) return;
+
+        _indices.push_back(iA);
+        _indices.push_back(iB);
+        _indices.push_back(iC);
+    }
 
-    unsigned int vertex_count = vx->getNumElements();
-    T_->assign(vertex_count, osg::Vec4());
-    B_->assign(vertex_count, osg::Vec4());
-    N_->assign(vertex_count, osg::Vec4());
+    IndexList&          _indices;
+    unsigned int        _numVertices;
+    osg::PrimitiveSet*  _pset;
+    unsigned int        _first;
+    const GLubyte*      _ubyteIndices;
+    const GLushort*     _ushortIndices;
+    const GLuint*       _uintIndices;
+};
 
+static void collectTriangles(osg::Geometry* geo, TriangleCollector& collect)
+{
     unsigned int i; // VC6 doesn't like for-scoped variables
 
+    unsigned int numIndices = 0;
+    for (unsigned int pri=0; pri<geo->getNumPrimitiveSets(); ++pri) {
+        numIndices += geo->getPrimitiveSet(pri)->getNumIndices();
+    }
+    collect._indices.reserve(numIndices);
+
     for (unsigned int pri=0; pri<geo->getNumPrimitiveSets(); ++pri) {
         osg::PrimitiveSet *pset = geo->getPrimitiveSet(pri);
+        collect.setPrimitiveSet(pset);
 
         unsigned int N = pset->getNumIndices();
 
         switch (pset->getMode()) {
 
             case osg::PrimitiveSet::TRIANGLES:
-                for (i=0; i<N; i+=3) {
-                    compute(pset, vx, nx, tx, i, i+1, i+2);
+                for (i=0; i+2<N; i+=3) {
+                    collect(i, i+1, i+2);
                 }
                 break;
 
             case osg::PrimitiveSet::QUADS:
-                for (i=0; i<N; i+=4) {
-                    compute(pset, vx, nx, tx, i, i+1, i+2);
-                    compute(pset, vx, nx, tx, i+2, i+3, i);
+                for (i=0; i+3<N; i+=4) {
+                    collect(i, i+1, i+2);
+                    collect(i+2, i+3, i);
                 }
                 break;
 
@@ -65,22 +209,22 @@ void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit
                     osg::DrawArrayLengths *dal = static_cast<osg::DrawArrayLengths *>(pset);
                     unsigned int j = 0;
                     for (osg::DrawArrayLengths::const_iterator pi=dal->begin(); pi!=dal->end(); ++pi) {
-                        unsigned int iN = static_cast<unsigned int>(*pi-2);
+                        unsigned int iN = *pi>2 ? static_cast<unsigned int>(*pi-2) : 0;
                         for (i=0; i<iN; ++i, ++j) {
                             if ((i%2) == 0) {
-                                compute(pset, vx, nx, tx, j, j+1, j+2);
+                                collect(j, j+1, j+2);
                             } else {
-                                compute(pset, vx, nx, tx, j+1, j, j+2);
+                                collect(j+1, j, j+2);
                             }
                         }
-                        j += 2;
+                        j += static_cast<unsigned int>(*pi) - iN;
                     }
                 } else {
-                    for (i=0; i<N-2; ++i) {
+                    for (i=0; i+2<N; ++i) {
                         if ((i%2) == 0) {
-                            compute(pset, vx, nx, tx, i, i+1, i+2);
+                            collect(i, i+1, i+2);
                         } else {
-                            compute(pset, vx, nx, tx, i+1, i, i+2);
+                            collect(i+1, i, i+2);
                         }
                     }
                 }
@@ -91,22 +235,22 @@ void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit
                     osg::DrawArrayLengths *dal = static_cast<osg::DrawArrayLengths *>(pset);
                     unsigned int j = 0;
                     for (osg::DrawArrayLengths::const_iterator pi=dal->begin(); pi!=dal->end(); ++pi) {
-                        unsigned int iN = static_cast<unsigned int>(*pi-2);
+                        unsigned int iN = *pi>2 ? static_cast<unsigned int>(*pi-2) : 0;
                         for (i=0; i<iN; ++i, ++j) {
                             if ((i%2) == 0) {
-                                compute(pset, vx, nx, tx, j, j+2, j+1);
+                                collect(j, j+2, j+1);
                             } else {
-                                compute(pset, vx, nx, tx, j, j+1, j+2);
+                                collect(j, j+1, j+2);
                             }
                         }
-                        j += 2;
+                        j += static_cast<unsigned int>(*pi) - iN;
                     }
                 } else {
-                    for (i=0; i<N-2; ++i) {
+                    for (i=0; i+2<N; ++i) {
                         if ((i%2) == 0) {
-                            compute(pset, vx, nx, tx, i, i+2, i+1);
+                            collect(i, i+2, i+1);
                         } else {
-                            compute(pset, vx, nx, tx, i, i+1, i+2);
+                            collect(i, i+1, i+2);
                         }
                     }
                 }
@@ -118,15 +262,15 @@ void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit
                     osg::DrawArrayLengths *dal = static_cast<osg::DrawArrayLengths *>(pset);
                     unsigned int j = 0;
                     for (osg::DrawArrayLengths::const_iterator pi=dal->begin(); pi!=dal->end(); ++pi) {
-                        unsigned int iN = static_cast<unsigned int>(*pi-2);
-                        for (i=0; i<iN; ++i) {
-                            compute(pset, vx, nx, tx, 0, j+1, j+2);
+                        unsigned int iN = static_cast<unsigned int>(*pi);
+                        for (i=1; i+1<iN; ++i) {
+                            collect(j, j+i, j+i+1);
                         }
-                        j += 2;
+                        j += iN;
                     }
                 } else {
-                    for (i=0; i<N-2; ++i) {
-                        compute(pset, vx, nx, tx, 0, i+1, i+2);
+                    for (i=1; i+1<N; ++i) {
+                        collect(0, i, i+1);
                     }
                 }
                 break;
@@ -142,18 +286,117 @@ void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit
             default: OSG_WARN << "Warning: TangentSpaceGenerator: unknown primitive mode " << pset->getMode() << "\n";
         }
     }
+}
+
+
+struct Attributes
+{
+    Attributes(): positions(0), normals(0), texcoords(0) {}
+
+    const osg::Vec3*        positions;
+    const osg::Vec3*        normals;
+    const osg::Vec2*        texcoords;
+    IndexList               indices;
+
+    std::vector<osg::Vec3>  positionStorage;
+    std::vector<osg::Vec3>  normalStorage;
+    std::vector<osg::Vec2>  texcoordStorage;
+};
+
+struct TriangleBasis
+{
+    osg::Vec3   tangent;
+    osg::Vec3   binormal;
+    osg::Vec3   normal;
+    float       orientation;
+};
+
+// per vertex sums kept together so each corner only touches one cache line
+struct VertexBasis
+{
+    VertexBasis(): orientation(0.0f) {}
+
+    osg::Vec3   tangent;
+    osg::Vec3   binormal;
+    osg::Vec3   normal;
+    float       orientation;
+};
+
+inline osg::Vec3 projectAndNormalize(const osg::Vec3& v, const osg::Vec3& n)
+{
+    osg::Vec3 p = v - n*(n*v);
+    p.normalize();
+    return p;
+}
+
+// The basis of the original TangentSpaceGenerator.  Each of the x, y and z components of the triangle's tangent and
+// binormal is solved from the plane through its (position, u, v) points, they're then projected against the vertex
+// normal, or the face normal if there are no normals, and summed.  The final normal is tangent ^ binormal, flipped to
+// face the same way as the summed normal.
+struct DefaultBasis
+{
+    static inline void computeTriangle(const Attributes& attributes, unsigned int t, TriangleBasis& basis)
+    {
+        const unsigned int iA = attributes.indices[t*3];
+        const unsigned int iB = attributes.indices[t*3+1];
+        const unsigned int iC = attributes.indices[t*3+2];
+
+        const osg::Vec3 dP1 = attributes.positions[iB] - attributes.positions[iA];
+        const osg::Vec3 dP2 = attributes.positions[iC] - attributes.positions[iA];
+        const osg::Vec2 dUV1 = attributes.texcoords[iB] - attributes.texcoords[iA];
+        const osg::Vec2 dUV2 = attributes.texcoords[iC] - attributes.texcoords[iA];
+
+        osg::Vec3 T, B;
+        for (unsigned int axis=0; axis<3; ++axis)
+        {
+            osg::Vec3 V = osg::Vec3(dP1[axis], dUV1.x(), dUV1.y()) ^
+                          osg::Vec3(dP2[axis], dUV2.x(), dUV2.y());
+            if (V.x() != 0) {
+                V.normalize();
+                T[axis] = -V.y() / V.x();
+                B[axis] = -V.z() / V.x();
+            }
+        }
+
+        if (attributes.normals)
+        {
+            basis.tangent = T;
+            basis.binormal = B;
+        }
+        else
+        {
+            // all the corners use the face normal so project once per triangle
+            const osg::Vec3 N = dP1 ^ dP2;
+            basis.tangent = (N ^ T) ^ N;
+            basis.binormal = N ^ (B ^ N);
+            basis.normal = N;
+        }
+    }
 
-    // normalize basis vectors and force the normal vector to match
-    // the triangle normal's direction
-    unsigned int attrib_count = vx->getNumElements();
-    for (i=0; i<attrib_count; ++i) {
-        osg::Vec4 &vT = (*T_)[i];
-        osg::Vec4 &vB = (*B_)[i];
-        osg::Vec4 &vN = (*N_)[i];
+    static inline void addCorner(const Attributes& attributes, const TriangleBasis& basis, unsigned int corner, VertexBasis& sum)
+    {
+        if (attributes.normals)
+        {
+            const osg::Vec3& N = attributes.normals[attributes.indices[corner]];
+            sum.tangent += (N ^ basis.tangent) ^ N;
+            sum.binormal += N ^ (basis.binormal ^ N);
+            sum.normal += N;
+        }
+        else
+        {
+            sum.tangent += basis.tangent;
+            sum.binormal += basis.binormal;
+            sum.normal += basis.normal;
+        }
+    }
 
-        osg::Vec3 txN = osg::Vec3(vT.x(), vT.y(), vT.z()) ^ osg::Vec3(vB.x(), vB.y(), vB.z());
-        bool flipped = txN * osg::Vec3(vN.x(), vN.y(), vN.z()) < 0;
+    static inline void finalize(const Attributes&, unsigned int, const VertexBasis& sum, osg::Vec4& vT, osg::Vec4& vB, osg::Vec4& vN)
+    {
+        osg::Vec3 txN = sum.tangent ^ sum.binormal;
+        bool flipped = txN * sum.normal < 0;
 
+        vT = osg::Vec4(sum.tangent, 0);
+        vB = osg::Vec4(sum.binormal, 0);
         if (flipped) {
             vN = osg::Vec4(-txN, 0);
         } else {
@@ -166,189 +409,315 @@ void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit
 
         vT[3] = flipped ? -1.0f : 1.0f;
     }
-    /* TO-DO: if indexed, compress the attributes to have only one
-     * version of each (different indices for each one?) */
-}
+};
 
-void TangentSpaceGenerator::compute(osg::PrimitiveSet *pset,
-                                    const osg::Array* vx,
-                                    const osg::Array* nx,
-                                    const osg::Array* tx,
-                                    int iA, int iB, int iC)
+// The basis computed by MikkTSpace.  The triangle's tangent is projected onto the plane of each corner's vertex normal
+// and summed weighted by the corner angle, triangles with degenerate texture coordinates are skipped.  The tangent's w
+// holds the handedness, taken from the angle weighted texture space orientation of the triangles, and the binormal is
+// w * (normal ^ tangent).
+struct MikkTSpaceBasis
 {
-    iA = pset->index(iA);
-    iB = pset->index(iB);
-    iC = pset->index(iC);
+    static inline void computeTriangle(const Attributes& attributes, unsigned int t, TriangleBasis& basis)
+    {
+        const unsigned int iA = attributes.indices[t*3];
+        const unsigned int iB = attributes.indices[t*3+1];
+        const unsigned int iC = attributes.indices[t*3+2];
 
-    osg::Vec3 P1;
-    osg::Vec3 P2;
-    osg::Vec3 P3;
+        const osg::Vec3 d1 = attributes.positions[iB] - attributes.positions[iA];
+        const osg::Vec3 d2 = attributes.positions[iC] - attributes.positions[iA];
+        const osg::Vec2 t21 = attributes.texcoords[iB] - attributes.texcoords[iA];
+        const osg::Vec2 t31 = attributes.texcoords[iC] - attributes.texcoords[iA];
 
-    int i; // VC6 doesn't like for-scoped variables
+        const float signedAreaSTx2 = t21.x()*t31.y() - t21.y()*t31.x();
+        osg::Vec3 os = d1*t31.y() - d2*t21.y();
 
-    switch (vx->getType())
-    {
-    case osg::Array::Vec2ArrayType:
-        for (i=0; i<2; ++i) {
-            P1.ptr()[i] = static_cast<const osg::Vec2Array&>(*vx)[iA].ptr()[i];
-            P2.ptr()[i] = static_cast<const osg::Vec2Array&>(*vx)[iB].ptr()[i];
-            P3.ptr()[i] = static_cast<const osg::Vec2Array&>(*vx)[iC].ptr()[i];
+        if (signedAreaSTx2 != 0.0f)
+        {
+            basis.orientation = signedAreaSTx2 > 0.0f ? 1.0f : -1.0f;
+            float length = os.length();
+            if (length > 0.0f) os *= basis.orientation/length;
+        }
+        else
+        {
+            basis.orientation = 0.0f;
         }
-        break;
 
-    case osg::Array::Vec3ArrayType:
-        P1 = static_cast<const osg::Vec3Array&>(*vx)[iA];
-        P2 = static_cast<const osg::Vec3Array&>(*vx)[iB];
-        P3 = static_cast<const osg::Vec3Array&>(*vx)[iC];
-        break;
+        basis.tangent = os;
+    }
 
-    case osg::Array::Vec4ArrayType:
-        for (i=0; i<3; ++i) {
-            P1.ptr()[i] = static_cast<const osg::Vec4Array&>(*vx)[iA].ptr()[i];
-            P2.ptr()[i] = static_cast<const osg::Vec4Array&>(*vx)[iB].ptr()[i];
-            P3.ptr()[i] = static_cast<const osg::Vec4Array&>(*vx)[iC].ptr()[i];
+    static inline void addCorner(const Attributes& attributes, const TriangleBasis& basis, unsigned int corner, VertexBasis& sum)
+    {
+        if (basis.orientation==0.0f) return;
+
+        const unsigned int base = (corner/3)*3;
+        const unsigned int order = corner-base;
+        const osg::Vec3& n = attributes.normals[attributes.indices[corner]];
+        const osg::Vec3& p0 = attributes.positions[attributes.indices[base + (order+2)%3]];
+        const osg::Vec3& p1 = attributes.positions[attributes.indices[corner]];
+        const osg::Vec3& p2 = attributes.positions[attributes.indices[base + (order+1)%3]];
+
+        osg::Vec3 v1 = projectAndNormalize(p0 - p1, n);
+        osg::Vec3 v2 = projectAndNormalize(p2 - p1, n);
+        float angle = acosf(osg::clampBetween(v1*v2, -1.0f, 1.0f));
+
+        sum.tangent += projectAndNormalize(basis.tangent, n) * angle;
+        sum.orientation += basis.orientation * angle;
+    }
+
+    static inline void finalize(const Attributes& attributes, unsigned int v, const VertexBasis& sum, osg::Vec4& vT, osg::Vec4& vB, osg::Vec4& vN)
+    {
+        const osg::Vec3& n = attributes.normals[v];
+
+        // reproject as the sum may be tiny where the tangents of the triangles cancel out
+        osg::Vec3 T = sum.tangent - n*(n*sum.tangent);
+        if (T.normalize()==0.0f)
+        {
+            // no usable triangles, pick any direction perpendicular to the normal
+            osg::Vec3 axis = (fabsf(n.x()) < 0.9f) ? osg::Vec3(1.0f,0.0f,0.0f) : osg::Vec3(0.0f,1.0f,0.0f);
+            T = projectAndNormalize(axis, n);
         }
-        break;
 
-    default:
-        OSG_WARN << "Warning: TangentSpaceGenerator: vertex array must be Vec2Array, Vec3Array or Vec4Array" << std::endl;
+        const float sign = sum.orientation < 0.0f ? -1.0f : 1.0f;
+
+        vT.set(T.x(), T.y(), T.z(), sign);
+        vB = osg::Vec4((n ^ T) * sign, 0.0f);
+        vN = osg::Vec4(n, 0.0f);
     }
+};
 
-    osg::Vec3 N1;
-    osg::Vec3 N2;
-    osg::Vec3 N3;
+template<class Basis>
+struct ComputeTriangleBasis : public WorkerThreadPool::RangeOperation
+{
+    ComputeTriangleBasis(const Attributes& attributes, std::vector<TriangleBasis>& triangles):
+        _attributes(attributes),
+        _triangles(triangles) {}
 
-    if(nx)
+    virtual void operator() (unsigned int begin, unsigned int end)
     {
-        switch (nx->getType())
+        for (unsigned int t=begin; t<end; ++t)
         {
-        case osg::Array::Vec2ArrayType:
-            for (i=0; i<2; ++i) {
-                N1.ptr()[i] = static_cast<const osg::Vec2Array&>(*nx)[iA].ptr()[i];
-                N2.ptr()[i] = static_cast<const osg::Vec2Array&>(*nx)[iB].ptr()[i];
-                N3.ptr()[i] = static_cast<const osg::Vec2Array&>(*nx)[iC].ptr()[i];
-            }
-            break;
-
-        case osg::Array::Vec3ArrayType:
-            N1 = static_cast<const osg::Vec3Array&>(*nx)[iA];
-            N2 = static_cast<const osg::Vec3Array&>(*nx)[iB];
-            N3 = static_cast<const osg::Vec3Array&>(*nx)[iC];
-            break;
-
-        case osg::Array::Vec4ArrayType:
-            for (i=0; i<3; ++i) {
-                N1.ptr()[i] = static_cast<const osg::Vec4Array&>(*nx)[iA].ptr()[i];
-                N2.ptr()[i] = static_cast<const osg::Vec4Array&>(*nx)[iB].ptr()[i];
-                N3.ptr()[i] = static_cast<const osg::Vec4Array&>(*nx)[iC].ptr()[i];
+            Basis::computeTriangle(_attributes, t, _triangles[t]);
+        }
+    }
+
+    const Attributes&               _attributes;
+    std::vector<TriangleBasis>&     _triangles;
+};
+
+// sums the corner contributions of each vertex in triangle order, so the result is the same as accumulating
+// the triangles sequentially, then finalizes the vertex's basis.
+template<class Basis>
+struct GatherVertexBasis : public WorkerThreadPool::RangeOperation
+{
+    GatherVertexBasis(const Attributes& attributes, const std::vector<TriangleBasis>& triangles, const IndexList& offsets, const IndexList& corners,
+                      osg::Vec4Array& T, osg::Vec4Array& B, osg::Vec4Array& N):
+        _attributes(attributes),
+        _triangles(triangles),
+        _offsets(offsets),
+        _corners(corners),
+        _T(T),
+        _B(B),
+        _N(N) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for (unsigned int v=begin; v<end; ++v)
+        {
+            VertexBasis sum;
+            for (unsigned int i=_offsets[v]; i<_offsets[v+1]; ++i)
+            {
+                Basis::addCorner(_attributes, _triangles[_corners[i]/3], _corners[i], sum);
             }
-            break;
+            Basis::finalize(_attributes, v, sum, _T[v], _B[v], _N[v]);
+        }
+    }
 
-        default:
-            OSG_WARN << "Warning: TangentSpaceGenerator: normal array must be Vec2Array, Vec3Array or Vec4Array" << std::endl;
+    const Attributes&                   _attributes;
+    const std::vector<TriangleBasis>&   _triangles;
+    const IndexList&                    _offsets;
+    const IndexList&                    _corners;
+    osg::Vec4Array&                     _T;
+    osg::Vec4Array&                     _B;
+    osg::Vec4Array&                     _N;
+};
+
+template<class Basis>
+struct FinalizeVertexBasis : public WorkerThreadPool::RangeOperation
+{
+    FinalizeVertexBasis(const Attributes& attributes, const std::vector<VertexBasis>& sums, osg::Vec4Array& T, osg::Vec4Array& B, osg::Vec4Array& N):
+        _attributes(attributes),
+        _sums(sums),
+        _T(T),
+        _B(B),
+        _N(N) {}
+
+    virtual void operator() (unsigned int begin, unsigned int end)
+    {
+        for (unsigned int v=begin; v<end; ++v)
+        {
+            Basis::finalize(_attributes, v, _sums[v], _T[v], _B[v], _N[v]);
         }
     }
 
-    osg::Vec2 uv1;
-    osg::Vec2 uv2;
-    osg::Vec2 uv3;
+    const Attributes&                   _attributes;
+    const std::vector<VertexBasis>&     _sums;
+    osg::Vec4Array&                     _T;
+    osg::Vec4Array&                     _B;
+    osg::Vec4Array&                     _N;
+};
 
-    switch (tx->getType())
+template<class Basis>
+static void computeBasis(const Attributes& attributes, bool useWorkerThreads, osg::Vec4Array& T, osg::Vec4Array& B, osg::Vec4Array& N)
+{
+    const unsigned int numVertices = T.size();
+    const unsigned int numTriangles = attributes.indices.size()/3;
+    WorkerThreadPool* workerThreadPool = WorkerThreadPool::instance();
+
+    if (useWorkerThreads && workerThreadPool->getNumThreads()>1 && numTriangles>s_minBlockSize)
     {
-    case osg::Array::Vec2ArrayType:
-        uv1 = static_cast<const osg::Vec2Array&>(*tx)[iA];
-        uv2 = static_cast<const osg::Vec2Array&>(*tx)[iB];
-        uv3 = static_cast<const osg::Vec2Array&>(*tx)[iC];
-        break;
+        std::vector<TriangleBasis> triangles(numTriangles);
+        ComputeTriangleBasis<Basis> computeTriangleBasis(attributes, triangles);
+        workerThreadPool->run(computeTriangleBasis, numTriangles, s_minBlockSize);
+
+        // build the vertex to corner adjacency, the corners of each vertex are kept in triangle order.
+        IndexList offsets(numVertices+1, 0);
+        for (IndexList::const_iterator itr = attributes.indices.begin(); itr != attributes.indices.end(); ++itr) {
+            ++offsets[*itr + 1];
+        }
+        for (unsigned int v=0; v<numVertices; ++v) {
+            offsets[v+1] += offsets[v];
+        }
 
-    case osg::Array::Vec3ArrayType:
-        for (i=0; i<2; ++i) {
-            uv1.ptr()[i] = static_cast<const osg::Vec3Array&>(*tx)[iA].ptr()[i];
-            uv2.ptr()[i] = static_cast<const osg::Vec3Array&>(*tx)[iB].ptr()[i];
-            uv3.ptr()[i] = static_cast<const osg::Vec3Array&>(*tx)[iC].ptr()[i];
+        IndexList corners(attributes.indices.size());
+        IndexList position(offsets.begin(), offsets.end()-1);
+        for (unsigned int i=0; i<attributes.indices.size(); ++i) {
+            corners[position[attributes.indices[i]]++] = i;
         }
-        break;
 
-    case osg::Array::Vec4ArrayType:
-        for (i=0; i<2; ++i) {
-            uv1.ptr()[i] = static_cast<const osg::Vec4Array&>(*tx)[iA].ptr()[i];
-            uv2.ptr()[i] = static_cast<const osg::Vec4Array&>(*tx)[iB].ptr()[i];
-            uv3.ptr()[i] = static_cast<const osg::Vec4Array&>(*tx)[iC].ptr()[i];
+        GatherVertexBasis<Basis> gatherVertexBasis(attributes, triangles, offsets, corners, T, B, N);
+        workerThreadPool->run(gatherVertexBasis, numVertices, s_minBlockSize);
+    }
+    else
+    {
+        // accumulate straight into the vertices, avoiding the per triangle storage and adjacency
+        std::vector<VertexBasis> sums(numVertices);
+        TriangleBasis basis;
+        for (unsigned int t=0; t<numTriangles; ++t)
+        {
+            Basis::computeTriangle(attributes, t, basis);
+            for (unsigned int corner=t*3; corner<t*3+3; ++corner)
+            {
+                Basis::addCorner(attributes, basis, corner, sums[attributes.indices[corner]]);
+            }
         }
-        break;
 
-    default:
-        OSG_WARN << "Warning: TangentSpaceGenerator: texture coord array must be Vec2Array, Vec3Array or Vec4Array" << std::endl;
+        FinalizeVertexBasis<Basis> finalizeVertexBasis(attributes, sums, T, B, N);
+        if (useWorkerThreads) workerThreadPool->run(finalizeVertexBasis, numVertices, s_minBlockSize);
+        else finalizeVertexBasis(0, numVertices);
     }
+}
 
-    osg::Vec3 V, T1, T2, T3, B1, B2, B3;
+// normalized, area weighted vertex normals for the MikkTSpace basis when the Geometry doesn't have normals.
+static void computeVertexNormals(Attributes& attributes, unsigned int numVertices)
+{
+    std::vector<osg::Vec3>& normals = attributes.normalStorage;
+    normals.assign(numVertices, osg::Vec3(0.0f,0.0f,0.0f));
 
-    // no normal per vertex use the one by face
-    if (!nx) {
-        N1 = (P2 - P1) ^ (P3 - P1);
-        N2 = N1;
-        N3 = N1;
+    for (unsigned int i=0; i+2<attributes.indices.size(); i+=3)
+    {
+        const unsigned int iA = attributes.indices[i];
+        const unsigned int iB = attributes.indices[i+1];
+        const unsigned int iC = attributes.indices[i+2];
+        osg::Vec3 normal = (attributes.positions[iB] - attributes.positions[iA]) ^ (attributes.positions[iC] - attributes.positions[iA]);
+        normals[iA] += normal;
+        normals[iB] += normal;
+        normals[iC] += normal;
     }
 
-    V = osg::Vec3(P2.x() - P1.x(), uv2.x() - uv1.x(), uv2.y() - uv1.y()) ^
-        osg::Vec3(P3.x() - P1.x(), uv3.x() - uv1.x(), uv3.y() - uv1.y());
-    if (V.x() != 0) {
-        V.normalize();
-        T1.x() += -V.y() / V.x();
-        B1.x() += -V.z() / V.x();
-        T2.x() += -V.y() / V.x();
-        B2.x() += -V.z() / V.x();
-        T3.x() += -V.y() / V.x();
-        B3.x() += -V.z() / V.x();
+    for (unsigned int v=0; v<numVertices; ++v)
+    {
+        normals[v].normalize();
     }
 
-    V = osg::Vec3(P2.y() - P1.y(), uv2.x() - uv1.x(), uv2.y() - uv1.y()) ^
-        osg::Vec3(P3.y() - P1.y(), uv3.x() - uv1.x(), uv3.y() - uv1.y());
-    if (V.x() != 0) {
-        V.normalize();
-        T1.y() += -V.y() / V.x();
-        B1.y() += -V.z() / V.x();
-        T2.y() += -V.y() / V.x();
-        B2.y() += -V.z() / V.x();
-        T3.y() += -V.y() / V.x();
-        B3.y() += -V.z() / V.x();
-    }
+    attributes.normals = &normals.front();
+}
 
-    V = osg::Vec3(P2.z() - P1.z(), uv2.x() - uv1.x(), uv2.y() - uv1.y()) ^
-        osg::Vec3(P3.z() - P1.z(), uv3.x() - uv1.x(), uv3.y() - uv1.y());
-    if (V.x() != 0) {
-        V.normalize();
-        T1.z() += -V.y() / V.x();
-        B1.z() += -V.z() / V.x();
-        T2.z() += -V.y() / V.x();
-        B2.z() += -V.z() / V.x();
-        T3.z() += -V.y() / V.x();
-        B3.z() += -V.z() / V.x();
+static void normalizeVertexNormals(Attributes& attributes, unsigned int numVertices)
+{
+    std::vector<osg::Vec3>& normals = attributes.normalStorage;
+    if (normals.empty()) normals.assign(attributes.normals, attributes.normals+numVertices);
+
+    for (unsigned int v=0; v<numVertices; ++v)
+    {
+        normals[v].normalize();
     }
 
-    osg::Vec3 tempvec;
+    attributes.normals = &normals.front();
+}
+
+}
+
+TangentSpaceGenerator::TangentSpaceGenerator()
+:    osg::Referenced(),
+    T_(new osg::Vec4Array),
+    B_(new osg::Vec4Array),
+    N_(new osg::Vec4Array),
+    mikktspace_(false),
+    useWorkerThreads_(true)
+{
+    T_->setBinding(osg::Array::BIND_PER_VERTEX); T_->setNormalize(false);
+    B_->setBinding(osg::Array::BIND_PER_VERTEX); B_->setNormalize(false);
+    N_->setBinding(osg::Array::BIND_PER_VERTEX); N_->setNormalize(false);
+}
+
+TangentSpaceGenerator::TangentSpaceGenerator(const TangentSpaceGenerator &copy, const osg::CopyOp &copyop)
+:    osg::Referenced(copy),
+    T_(static_cast<osg::Vec4Array *>(copyop(copy.T_.get()))),
+    B_(static_cast<osg::Vec4Array *>(copyop(copy.B_.get()))),
+    N_(static_cast<osg::Vec4Array *>(copyop(copy.N_.get()))),
+    mikktspace_(copy.mikktspace_),
+    useWorkerThreads_(copy.useWorkerThreads_)
+{
+}
 
-    tempvec = N1 ^ T1;
-    (*T_)[iA] += osg::Vec4(tempvec ^ N1, 0);
+void TangentSpaceGenerator::generate(osg::Geometry *geo, int normal_map_tex_unit)
+{
+    const osg::Array *vx = geo->getVertexArray();
+    const osg::Array *nx = geo->getNormalArray();
+    const osg::Array *tx = geo->getTexCoordArray(normal_map_tex_unit);
 
-    tempvec = B1 ^ N1;
-    (*B_)[iA] += osg::Vec4(N1 ^ tempvec, 0);
+    if (!vx || !tx) return;
 
-    tempvec = N2 ^ T2;
-    (*T_)[iB] += osg::Vec4(tempvec ^ N2, 0);
 
-    tempvec = B2 ^ N2;
-    (*B_)[iB] += osg::Vec4(N2 ^ tempvec, 0);
+    unsigned int vertex_count = vx->getNumElements();
+    T_->assign(vertex_count, osg::Vec4());
+    B_->assign(vertex_count, osg::Vec4());
+    N_->assign(vertex_count, osg::Vec4());
 
-    tempvec = N3 ^ T3;
-    (*T_)[iC] += osg::Vec4(tempvec ^ N3, 0);
+    if (vertex_count==0) return;
 
-    tempvec = B3 ^ N3;
-    (*B_)[iC] += osg::Vec4(N3 ^ tempvec, 0);
+    // gather the attributes and triangles into contiguous arrays so the passes below
+    // don't need to dispatch on the array and primitive types per triangle
+    TangentSpace::Attributes attributes;
+    attributes.positions = TangentSpace::getVec3Data(vx, vertex_count, "vertex", attributes.positionStorage);
+    if (nx) attributes.normals = TangentSpace::getVec3Data(nx, vertex_count, "normal", attributes.normalStorage);
+    attributes.texcoords = TangentSpace::getVec2Data(tx, vertex_count, "texture coord", attributes.texcoordStorage);
 
-    (*N_)[iA] += osg::Vec4(N1, 0);
-    (*N_)[iB] += osg::Vec4(N2, 0);
-    (*N_)[iC] += osg::Vec4(N3, 0);
+    TangentSpace::TriangleCollector collector(attributes.indices, vertex_count);
+    TangentSpace::collectTriangles(geo, collector);
 
-}
+    if (mikktspace_)
+    {
+        if (attributes.normals) TangentSpace::normalizeVertexNormals(attributes, vertex_count);
+        else TangentSpace::computeVertexNormals(attributes, vertex_count);
 
+        TangentSpace::computeBasis<TangentSpace::MikkTSpaceBasis>(attributes, useWorkerThreads_, *T_, *B_, *N_);
+    }
+    else
+    {
+        TangentSpace::computeBasis<TangentSpace::DefaultBasis>(attributes, useWorkerThreads_, *T_, *B_, *N_);
+    }
+
+    /* TO-DO: if indexed, compress the attributes to have only one
+     * version of each (different indices for each one?) */
+}
@@ -17,11 +17,20 @@
 #include <osg/io_utils>
 #include <osgUtil/Tessellator>
 
+#include <algorithm>
+
 using namespace osg;
 using namespace osgUtil;
 
+// concave polygons with more vertices than this are passed to glu, as ear clipping grows
+// faster than glu's sweep and overtakes it at a few thousand vertices.
+static const unsigned int s_maxEarClippingVertices = 1024;
+
 
 Tessellator::Tessellator() :
+    _simplePolygonFastPath(true),
+    _vertexArrayBegin(0),
+    _vertexArraySize(0),
     _wtype(TESS_WINDING_ODD),
     _ttype(TESS_TYPE_POLYGONS),
     _boundaryOnly(false), _numberVerts(0)
@@ -51,38 +60,21 @@ Tessellator::~Tessellator()
 void Tessellator::beginTessellation()
 {
     reset();
-
-    if (_tobj)
-    {
-        gluTessProperty(_tobj, GLU_TESS_WINDING_RULE, _wtype);
-        gluTessProperty(_tobj, GLU_TESS_BOUNDARY_ONLY, _boundaryOnly);
-
-        if (tessNormal.length()>0.0) gluTessNormal(_tobj, tessNormal.x(), tessNormal.y(), tessNormal.z());
-
-        gluTessBeginPolygon(_tobj,this);
-    }
 }
 
 void Tessellator::beginContour()
 {
-    if (_tobj)
-    {
-        gluTessBeginContour(_tobj);
-    }
+    // contours are collected up and only passed to glu at endTessellation(), if they need it.
+    _contours.push_back(Prim::VecList());
 }
 
 void Tessellator::addVertex(osg::Vec3* vertex)
 {
-    if (_tobj)
+    if (!_contours.empty())
     {
         if (vertex && vertex->valid())
         {
-            Vec3d* data = new Vec3d;
-            _coordData.push_back(data);
-            (*data)._v[0]=(*vertex)[0];
-            (*data)._v[1]=(*vertex)[1];
-            (*data)._v[2]=(*vertex)[2];
-            gluTessVertex(_tobj,data->_v,vertex);
+            _contours.back().push_back(vertex);
         }
         else
         {
@@ -99,16 +91,37 @@ void Tessellator::addVertex(osg::Vec3* vertex)
 
 void Tessellator::endContour()
 {
-    if (_tobj)
-    {
-        gluTessEndContour(_tobj);
-    }
 }
 
 void Tessellator::endTessellation()
 {
+    if (_simplePolygonFastPath && tessellateSimplePolygon()) return;
+
     if (_tobj)
     {
+        gluTessProperty(_tobj, GLU_TESS_WINDING_RULE, _wtype);
+        gluTessProperty(_tobj, GLU_TESS_BOUNDARY_ONLY, _boundaryOnly);
+
+        if (tessNormal.length()>0.0) gluTessNormal(_tobj, tessNormal.x(), tessNormal.y(), tessNormal.z());
+
+        gluTessBeginPolygon(_tobj,this);
+
+        for(ContourList::iterator citr=_contours.begin(); citr!=_contours.end(); ++citr)
+        {
+            gluTessBeginContour(_tobj);
+            for(Prim::VecList::iterator vitr=citr->begin(); vitr!=citr->end(); ++vitr)
+            {
+                osg::Vec3* vertex = *vitr;
+                Vec3d* data = new Vec3d;
+                _coordData.push_back(data);
+                (*data)._v[0]=(*vertex)[0];
+                (*data)._v[1]=(*vertex)[1];
+                (*data)._v[2]=(*vertex)[2];
+                gluTessVertex(_tobj,data->_v,vertex);
+            }
+            gluTessEndContour(_tobj);
+        }
+
         gluTessEndPolygon(_tobj);
 
         if (_errorCode!=0)
@@ -137,9 +150,284 @@ void Tessellator::reset()
     _coordData.clear();
     _newVertexList.clear();
     _primList.clear();
+    _contours.clear();
     _errorCode = 0;
 }
 
+namespace
+{
+
+// 2D position of a contour vertex projected onto the plane of the polygon
+struct ProjectedVertex
+{
+    double x, y;
+};
+
+inline double orient2d(const ProjectedVertex& a, const ProjectedVertex& b, const ProjectedVertex& c)
+{
+    return (b.x-a.x)*(c.y-a.y) - (b.y-a.y)*(c.x-a.x);
+}
+
+inline bool onSegment(const ProjectedVertex& a, const ProjectedVertex& b, const ProjectedVertex& p)
+{
+    return osg::minimum(a.x,b.x)<=p.x && p.x<=osg::maximum(a.x,b.x) &&
+           osg::minimum(a.y,b.y)<=p.y && p.y<=osg::maximum(a.y,b.y);
+}
+
+// true if the closed segments a-b and c-d touch or cross
+bool segmentsIntersect(const ProjectedVertex& a, const ProjectedVertex& b, const ProjectedVertex& c, const ProjectedVertex& d)
+{
+    double d1 = orient2d(c, d, a);
+    double d2 = orient2d(c, d, b);
+    double d3 = orient2d(a, b, c);
+    double d4 = orient2d(a, b, d);
+    if (((d1>0.0 && d2<0.0) || (d1<0.0 && d2>0.0)) &&
+        ((d3>0.0 && d4<0.0) || (d3<0.0 && d4>0.0))) return true;
+    if (d1==0.0 && onSegment(c, d, a)) return true;
+    if (d2==0.0 && onSegment(c, d, b)) return true;
+    if (d3==0.0 && onSegment(a, b, c)) return true;
+    if (d4==0.0 && onSegment(a, b, d)) return true;
+    return false;
+}
+
+// true if the counter clockwise polygon is strictly convex, with the boundary going round just once
+bool isConvex(const std::vector<ProjectedVertex>& vertices)
+{
+    unsigned int n = vertices.size();
+    int xSignChanges = 0, ySignChanges = 0;
+    int lastXSign = 0, lastYSign = 0, firstXSign = 0, firstYSign = 0;
+    for(unsigned int i=0; i<n; ++i)
+    {
+        const ProjectedVertex& a = vertices[i];
+        const ProjectedVertex& b = vertices[(i+1)%n];
+        const ProjectedVertex& c = vertices[(i+2)%n];
+        if (orient2d(a, b, c)<=0.0) return false;
+
+        int xSign = b.x>a.x ? 1 : (b.x<a.x ? -1 : 0);
+        int ySign = b.y>a.y ? 1 : (b.y<a.y ? -1 : 0);
+        if (xSign!=0)
+        {
+            if (lastXSign!=0 && xSign!=lastXSign) ++xSignChanges;
+            if (firstXSign==0) firstXSign = xSign;
+            lastXSign = xSign;
+        }
+        if (ySign!=0)
+        {
+            if (lastYSign!=0 && ySign!=lastYSign) ++ySignChanges;
+            if (firstYSign==0) firstYSign = ySign;
+            lastYSign = ySign;
+        }
+    }
+    if (lastXSign!=firstXSign) ++xSignChanges;
+    if (lastYSign!=firstYSign) ++ySignChanges;
+    return xSignChanges<=2 && ySignChanges<=2;
+}
+
+// edge i of a polygon, from vertex i to i+1, with its x range
+struct ProjectedEdge
+{
+    double minx, maxx;
+    unsigned int i;
+    bool operator < (const ProjectedEdge& rhs) const { return minx<rhs.minx; }
+};
+
+// true if no two edges of the polygon touch, other than adjacent edges at their shared vertex
+bool isSimple(const std::vector<ProjectedVertex>& vertices)
+{
+    unsigned int n = vertices.size();
+    std::vector<ProjectedEdge> edges(n);
+    for(unsigned int i=0; i<n; ++i)
+    {
+        const ProjectedVertex& a = vertices[i];
+        const ProjectedVertex& b = vertices[(i+1)%n];
+        if (a.x==b.x && a.y==b.y) return false;
+
+        // adjacent edge folding back over this one
+        const ProjectedVertex& c = vertices[(i+2)%n];
+        if (orient2d(a, b, c)==0.0 && (b.x-a.x)*(c.x-b.x)+(b.y-a.y)*(c.y-b.y)<0.0) return false;
+
+        edges[i].minx = osg::minimum(a.x, b.x);
+        edges[i].maxx = osg::maximum(a.x, b.x);
+        edges[i].i = i;
+    }
+
+    // sweep along x, only testing edges whose x ranges overlap
+    std::sort(edges.begin(), edges.end());
+    for(unsigned int e=0; e<n; ++e)
+    {
+        unsigned int i = edges[e].i;
+        const ProjectedVertex& a = vertices[i];
+        const ProjectedVertex& b = vertices[(i+1)%n];
+        double miny = osg::minimum(a.y, b.y), maxy = osg::maximum(a.y, b.y);
+        for(unsigned int f=e+1; f<n && edges[f].minx<=edges[e].maxx; ++f)
+        {
+            unsigned int j = edges[f].i;
+            if (j==(i+1)%n || i==(j+1)%n) continue;
+
+            const ProjectedVertex& c = vertices[j];
+            const ProjectedVertex& d = vertices[(j+1)%n];
+            if (osg::maximum(c.y, d.y)<miny || osg::minimum(c.y, d.y)>maxy) continue;
+
+            if (segmentsIntersect(a, b, c, d)) return false;
+        }
+    }
+    return true;
+}
+
+inline bool pointInTriangle(const ProjectedVertex& a, const ProjectedVertex& b, const ProjectedVertex& c, const ProjectedVertex& p)
+{
+    return orient2d(a, b, p)>=0.0 && orient2d(b, c, p)>=0.0 && orient2d(c, a, p)>=0.0;
+}
+
+// ear clip a simple counter clockwise polygon, appending the vertex indices of the triangles
+bool earClip(const std::vector<ProjectedVertex>& vertices, std::vector<unsigned int>& triangles)
+{
+    unsigned int n = vertices.size();
+    std::vector<unsigned int> prev(n), next(n);
+    std::vector<unsigned char> reflex(n);
+    for(unsigned int i=0; i<n; ++i)
+    {
+        prev[i] = (i+n-1)%n;
+        next[i] = (i+1)%n;
+        reflex[i] = orient2d(vertices[prev[i]], vertices[i], vertices[next[i]])<=0.0;
+    }
+
+    unsigned int remaining = n;
+    unsigned int i = 0;
+    unsigned int stalled = 0;
+    while(remaining>3)
+    {
+        unsigned int a = prev[i], c = next[i];
+        bool ear = !reflex[i];
+        if (ear)
+        {
+            // only reflex vertices can lie inside an ear
+            const ProjectedVertex& va = vertices[a];
+            const ProjectedVertex& vb = vertices[i];
+            const ProjectedVertex& vc = vertices[c];
+            double minx = osg::minimum(va.x, osg::minimum(vb.x, vc.x)), maxx = osg::maximum(va.x, osg::maximum(vb.x, vc.x));
+            double miny = osg::minimum(va.y, osg::minimum(vb.y, vc.y)), maxy = osg::maximum(va.y, osg::maximum(vb.y, vc.y));
+            for(unsigned int j=next[c]; j!=a && ear; j=next[j])
+            {
+                const ProjectedVertex& p = vertices[j];
+                if (reflex[j] && p.x>=minx && p.x<=maxx && p.y>=miny && p.y<=maxy &&
+                    pointInTriangle(va, vb, vc, p)) ear = false;
+            }
+        }
+
+        if (ear)
+        {
+            triangles.push_back(a);
+            triangles.push_back(i);
+            triangles.push_back(c);
+
+            next[a] = c;
+            prev[c] = a;
+            --remaining;
+            reflex[a] = orient2d(vertices[prev[a]], vertices[a], vertices[c])<=0.0;
+            reflex[c] = orient2d(vertices[a], vertices[c], vertices[next[c]])<=0.0;
+
+            i = a;
+            stalled = 0;
+        }
+        else
+        {
+            i = next[i];
+            if (++stalled>remaining) return false;
+        }
+    }
+
+    if (orient2d(vertices[prev[i]], vertices[i], vertices[next[i]])<=0.0) return false;
+
+    triangles.push_back(prev[i]);
+    triangles.push_back(i);
+    triangles.push_back(next[i]);
+    return true;
+}
+
+}
+
+bool Tessellator::tessellateSimplePolygon()
+{
+    if (_boundaryOnly || _contours.size()!=1) return false;
+    if (_wtype!=TESS_WINDING_ODD && _wtype!=TESS_WINDING_NONZERO) return false;
+
+    Prim::VecList& contour = _contours.front();
+    unsigned int n = contour.size();
+    if (n<3) return false;
+
+    // normal of the polygon, using Newell's method if it hasn't been set
+    osg::Vec3d normal(tessNormal);
+    if (normal.length2()==0.0)
+    {
+        for(unsigned int i=0; i<n; ++i)
+        {
+            const osg::Vec3& a = *contour[i];
+            const osg::Vec3& b = *contour[(i+1)%n];
+            normal.x() += (double(a.y())-double(b.y()))*(double(a.z())+double(b.z()));
+            normal.y() += (double(a.z())-double(b.z()))*(double(a.x())+double(b.x()));
+            normal.z() += (double(a.x())-double(b.x()))*(double(a.y())+double(b.y()));
+        }
+        if (normal.length2()==0.0) return false;
+    }
+
+    // project onto the plane of the dominant axis of the normal, such that counter clockwise
+    // about the normal remains counter clockwise in 2D.
+    int ux = 0, uy = 1;
+    double ax = fabs(normal.x()), ay = fabs(normal.y()), az = fabs(normal.z());
+    if (az>=ax && az>=ay) { ux = 0; uy = 1; if (normal.z()<0.0) std::swap(ux, uy); }
+    else if (ax>=ay) { ux = 1; uy = 2; if (normal.x()<0.0) std::swap(ux, uy); }
+    else { ux = 2; uy = 0; if (normal.y()<0.0) std::swap(ux, uy); }
+
+    std::vector<ProjectedVertex> vertices(n);
+    double area = 0.0;
+    for(unsigned int i=0; i<n; ++i)
+    {
+        vertices[i].x = (*contour[i])[ux];
+        vertices[i].y = (*contour[i])[uy];
+    }
+    for(unsigned int i=0; i<n; ++i)
+    {
+        const ProjectedVertex& a = vertices[i];
+        const ProjectedVertex& b = vertices[(i+1)%n];
+        area += a.x*b.y - b.x*a.y;
+    }
+    if (area==0.0) return false;
+
+    // glu outputs triangles counter clockwise about the normal, so work on a counter clockwise contour
+    if (area<0.0)
+    {
+        std::reverse(vertices.begin(), vertices.end());
+        std::reverse(contour.begin(), contour.end());
+    }
+
+    std::vector<unsigned int> triangles;
+    triangles.reserve((n-2)*3);
+    if (isConvex(vertices))
+    {
+        for(unsigned int i=1; i<n-1; ++i)
+        {
+            triangles.push_back(0);
+            triangles.push_back(i);
+            triangles.push_back(i+1);
+        }
+    }
+    else if (n>s_maxEarClippingVertices || !isSimple(vertices) || !earClip(vertices, triangles))
+    {
+        if (area<0.0) std::reverse(contour.begin(), contour.end());
+        return false;
+    }
+
+    Prim* prim = new Prim(GL_TRIANGLES);
+    prim->_vertices.reserve(triangles.size());
+    for(std::vector<unsigned int>::iterator itr=triangles.begin(); itr!=triangles.end(); ++itr)
+    {
+        prim->_vertices.push_back(contour[*itr]);
+    }
+    _primList.push_back(prim);
+
+    return true;
+}
 
 class InsertNewVertices : public osg::ArrayVisitor
 {
@@ -489,20 +777,20 @@ void Tessellator::handleNewVertices(osg::Geometry& geom,VertexPtrToIndexMap &ver
             if (normals)
             {
                 osg::Vec3 norm(0.0f,0.0f,0.0f);
-                if (newVertex._v1) norm += (*normals)[vertexPtrToIndexMap[newVertex._v1]] * newVertex._f1;
-                if (newVertex._v2) norm += (*normals)[vertexPtrToIndexMap[newVertex._v2]] * newVertex._f2;
-                if (newVertex._v3) norm += (*normals)[vertexPtrToIndexMap[newVertex._v3]] * newVertex._f3;
-                if (newVertex._v4) norm += (*normals)[vertexPtrToIndexMap[newVertex._v4]] * newVertex._f4;
+                if (newVertex._v1) norm += (*normals)[getVertexIndex(vertexPtrToIndexMap, newVertex._v1)] * newVertex._f1;
+                if (newVertex._v2) norm += (*normals)[getVertexIndex(vertexPtrToIndexMap, newVertex._v2)] * newVertex._f2;
+                if (newVertex._v3) norm += (*normals)[getVertexIndex(vertexPtrToIndexMap, newVertex._v3)] * newVertex._f3;
+                if (newVertex._v4) norm += (*normals)[getVertexIndex(vertexPtrToIndexMap, newVertex._v4)] * newVertex._f4;
                 norm.normalize();
                 normals->push_back(norm);
             }
 
             if (!arrays.empty())
             {
-                InsertNewVertices inv(newVertex._f1,vertexPtrToIndexMap[newVertex._v1],
-                    newVertex._f2,vertexPtrToIndexMap[newVertex._v2],
-                    newVertex._f3,vertexPtrToIndexMap[newVertex._v3],
-                    newVertex._f4,vertexPtrToIndexMap[newVertex._v4]);
+                InsertNewVertices inv(newVertex._f1,getVertexIndex(vertexPtrToIndexMap, newVertex._v1),
+                    newVertex._f2,getVertexIndex(vertexPtrToIndexMap, newVertex._v2),
+                    newVertex._f3,getVertexIndex(vertexPtrToIndexMap, newVertex._v3),
+                    newVertex._f4,getVertexIndex(vertexPtrToIndexMap, newVertex._v4));
 
                 // assign the rest of the attributes.
                 for(ArrayList::iterator aItr=arrays.begin();
@@ -618,16 +906,17 @@ void Tessellator::collectTessellation(osg::Geometry &geom, unsigned int /*origin
     if (geom.containsDeprecatedData()) geom.fixDeprecatedData();
 
     osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
-    VertexPtrToIndexMap vertexPtrToIndexMap;
 
-    // populate the VertexPtrToIndexMap.
-    for(unsigned int vi=0;vi<vertices->size();++vi)
-    {
-        vertexPtrToIndexMap[&((*vertices)[vi])] = vi;
-    }
+    // vertices from the vertex array are indexed by their position in it, so the map only has to hold
+    // the new vertices, the array's address is recorded before new vertices are appended to it.
+    VertexPtrToIndexMap vertexPtrToIndexMap;
+    _vertexArrayBegin = vertices->empty() ? 0 : &(vertices->front());
+    _vertexArraySize = vertices->size();
 
     handleNewVertices(geom, vertexPtrToIndexMap);
 
+    unsigned int numVertices = vertices->size();
+
     // we don't properly handle per primitive and per primitive_set bindings yet
     // will need to address this soon. Robert Oct 2002.
     {
@@ -668,28 +957,28 @@ void Tessellator::collectTessellation(osg::Geometry &geom, unsigned int /*origin
               Prim* prim=primItr->get();
               int ntris=0;
 
-              if(vertexPtrToIndexMap.size() <= 255)
+              if(numVertices <= 255)
               {
                   osg::DrawElementsUByte* elements = new osg::DrawElementsUByte(prim->_mode);
                   for(Prim::VecList::iterator vitr=prim->_vertices.begin();
                   vitr!=prim->_vertices.end();
                   ++vitr)
                 {
-                    elements->push_back(vertexPtrToIndexMap[*vitr]);
+                    elements->push_back(getVertexIndex(vertexPtrToIndexMap, *vitr));
                 }
 
                   // add to the drawn primitive list.
                   geom.addPrimitiveSet(elements);
                   ntris=elements->getNumIndices()/3;
               }
-              else if(vertexPtrToIndexMap.size() > 255 && vertexPtrToIndexMap.size() <= 65535)
+              else if(numVertices > 255 && numVertices <= 65535)
               {
                   osg::DrawElementsUShort* elements = new osg::DrawElementsUShort(prim->_mode);
                   for(Prim::VecList::iterator vitr=prim->_vertices.begin();
                     vitr!=prim->_vertices.end();
                     ++vitr)
                   {
-                    elements->push_back(vertexPtrToIndexMap[*vitr]);
+                    elements->push_back(getVertexIndex(vertexPtrToIndexMap, *vitr));
                   }
 
                   // add to the drawn primitive list.
@@ -703,7 +992,7 @@ void Tessellator::collectTessellation(osg::Geometry &geom, unsigned int /*origin
                     vitr!=prim->_vertices.end();
                     ++vitr)
                   {
-                    elements->push_back(vertexPtrToIndexMap[*vitr]);
+                    elements->push_back(getVertexIndex(vertexPtrToIndexMap, *vitr));
                   }
 
                   // add to the drawn primitive list.
@@ -0,0 +1,166 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osgUtil/WorkerThreadPool>
+
+#include <osg/ApplicationUsage>
+#include <osg/Math>
+#include <osg/Notify>
+
+#include <OpenThreads/Atomic>
+
+#include <stdlib.h>
+
+using namespace osgUtil;
+
+static osg::ApplicationUsageProxy WorkerThreadPool_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NUM_WORKER_THREADS <int>","Set the number of threads used by osgUtil::WorkerThreadPool to process data parallel work.");
+
+namespace
+{
+
+/** The blocks of a single call to WorkerThreadPool::run().  The blocks are claimed one at a time by the calling
+  * thread and by the worker threads that pick this operation off the queue, so that a caller only ever processes
+  * the blocks of its own operation and nested calls to run() from within a block can't stall on another caller's work.*/
+struct RangeBlocksOperation : public osg::Operation
+{
+    RangeBlocksOperation(WorkerThreadPool::RangeOperation& operation, unsigned int numItems, unsigned int blockSize, unsigned int numBlocks):
+        osg::Operation("RangeBlocksOperation", false),
+        _operation(operation),
+        _numItems(numItems),
+        _blockSize(blockSize),
+        _numBlocks(numBlocks),
+        _blockCount(new osg::RefBlockCount(numBlocks))
+    {
+        _blockCount->reset();
+    }
+
+    /** Process blocks until none are left unclaimed.  Once all the blocks have been claimed _operation is no
+      * longer accessed, so it's safe for a worker thread to call this after run() has returned.*/
+    void processBlocks()
+    {
+        unsigned int block;
+        while((block = ++_nextBlock) <= _numBlocks)
+        {
+            unsigned int begin = (block-1)*_blockSize;
+            _operation(begin, osg::minimum(begin+_blockSize, _numItems));
+            _blockCount->completed();
+        }
+    }
+
+    virtual void operator () (osg::Object*)
+    {
+        processBlocks();
+    }
+
+    void waitForCompletion()
+    {
+        while(_blockCount->getCurrentCount()>0)
+        {
+            _blockCount->block();
+        }
+    }
+
+    WorkerThreadPool::RangeOperation&   _operation;
+    unsigned int                        _numItems;
+    unsigned int                        _blockSize;
+    unsigned int                        _numBlocks;
+    OpenThreads::Atomic                 _nextBlock;
+    osg::ref_ptr<osg::RefBlockCount>    _blockCount;
+};
+
+}
+
+WorkerThreadPool::WorkerThreadPool(unsigned int numThreads):
+    _numThreads(numThreads)
+{
+    if (_numThreads==0)
+    {
+        const char* str = getenv("OSG_NUM_WORKER_THREADS");
+        if (str) _numThreads = atoi(str);
+        else _numThreads = OpenThreads::GetNumberOfProcessors();
+    }
+
+    if (_numThreads==0) _numThreads = 1;
+}
+
+WorkerThreadPool::~WorkerThreadPool()
+{
+    for(Threads::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->setDone(true);
+    }
+
+    for(Threads::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->cancel();
+    }
+}
+
+WorkerThreadPool* WorkerThreadPool::instance()
+{
+    static osg::ref_ptr<WorkerThreadPool> s_workerThreadPool = new WorkerThreadPool;
+    return s_workerThreadPool.get();
+}
+
+void WorkerThreadPool::startThreads()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_threadsMutex);
+    if (!_threads.empty()) return;
+
+    OSG_INFO<<"WorkerThreadPool::startThreads() starting "<<_numThreads-1<<" threads"<<std::endl;
+
+    _operationQueue = new osg::OperationQueue;
+    for(unsigned int i=1; i<_numThreads; ++i)
+    {
+        osg::ref_ptr<osg::OperationThread> thread = new osg::OperationThread;
+        thread->setOperationQueue(_operationQueue.get());
+        thread->startThread();
+        _threads.push_back(thread);
+    }
+}
+
+void WorkerThreadPool::run(RangeOperation& operation, unsigned int numItems, unsigned int minBlockSize)
+{
+    if (numItems==0) return;
+    if (minBlockSize==0) minBlockSize = 1;
+
+    // aim for several blocks per thread so that uneven blocks are balanced out.
+    unsigned int numBlocks = osg::minimum(_numThreads*4, (numItems+minBlockSize-1)/minBlockSize);
+    if (_numThreads<=1 || numBlocks<=1)
+    {
+        operation(0, numItems);
+        return;
+    }
+
+    startThreads();
+
+    unsigned int blockSize = (numItems+numBlocks-1)/numBlocks;
+    numBlocks = (numItems+blockSize-1)/blockSize;
+
+    osg::ref_ptr<RangeBlocksOperation> blocks = new RangeBlocksOperation(operation, numItems, blockSize, numBlocks);
+
+    // queue one entry for each worker thread that can usefully help, each of which processes blocks until none are left
+    unsigned int numHelpers = osg::minimum(_numThreads-1, numBlocks-1);
+    for(unsigned int i=0; i<numHelpers; ++i)
+    {
+        _operationQueue->add(blocks.get());
+    }
+
+    // help out with our own blocks rather than just waiting on them
+    blocks->processBlocks();
+
+    blocks->waitForCompletion();
+}
@@ -0,0 +1,105 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2014 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgVolume/BrickCache>
+
+#include <OpenThreads/ScopedLock>
+
+using namespace osgVolume;
+
+BrickCache::BrickCache():
+    _cache(256*1024*1024),
+    _numHits(0),
+    _numMisses(0)
+{
+}
+
+BrickCache::~BrickCache()
+{
+}
+
+BrickCache* BrickCache::instance()
+{
+    static osg::ref_ptr<BrickCache> s_brickCache = new BrickCache;
+    return s_brickCache.get();
+}
+
+void BrickCache::setMaximumMemory(size_t maximumMemory)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _cache.setMaximumMemory(maximumMemory);
+}
+
+size_t BrickCache::getMemoryUsed() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _cache.getMemoryUsed();
+}
+
+unsigned int BrickCache::getNumImages() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _cache.size();
+}
+
+void BrickCache::addImage(const std::string& fileName, const TileID& tileID, osg::Image* image)
+{
+    if (!image) return;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _cache.add(Key(fileName, tileID), image, image->getTotalSizeInBytes());
+}
+
+osg::ref_ptr<osg::Image> BrickCache::getImage(const std::string& fileName, const TileID& tileID)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    osg::Image* image = _cache.get(Key(fileName, tileID));
+    if (image) ++_numHits;
+    else ++_numMisses;
+
+    return image;
+}
+
+namespace
+{
+    struct SameFile
+    {
+        SameFile(const std::string& fileName) : _fileName(fileName) {}
+        bool operator() (const std::pair<std::string, TileID>& key) const { return key.first==_fileName; }
+        std::string _fileName;
+    };
+}
+
+void BrickCache::removeFile(const std::string& fileName)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    // TileID's default constructor gives the lowest valid TileID, so all the bricks of a file follow its lower bound
+    _cache.removeRange(Key(fileName, TileID()), SameFile(fileName));
+}
+
+void BrickCache::clear()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _cache.clear();
+}
+
+void BrickCache::resetStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _numHits = 0;
+    _numMisses = 0;
+}
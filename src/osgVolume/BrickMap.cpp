@@ -0,0 +1,292 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2014 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgVolume/BrickMap>
+
+#include <osg/ImageUtils>
+#include <osg/Notify>
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace osgVolume;
+
+namespace
+{
+
+// read the alpha value the shaders will sample for each pixel of a row, luminance and intensity textures being set up as GL_INTENSITY
+struct ReadAlphaOperation : public osg::CastAndScaleToFloatOperation
+{
+    ReadAlphaOperation(float* alpha) : _alpha(alpha) {}
+
+    float* _alpha;
+
+    inline void luminance(float l) { *_alpha++ = l; }
+    inline void alpha(float a) { *_alpha++ = a; }
+    inline void luminance_alpha(float /*l*/, float a) { *_alpha++ = a; }
+    inline void rgb(float /*r*/, float /*g*/, float /*b*/) { *_alpha++ = 1.0f; }
+    inline void rgba(float /*r*/, float /*g*/, float /*b*/, float a) { *_alpha++ = a; }
+};
+
+// the bricks along an axis that the voxel at position is part of, either as one of the brick's own voxels or as one bordering it
+inline void brickRange(unsigned int position, unsigned int brickSize, unsigned int numBricks, unsigned int& first, unsigned int& last)
+{
+    unsigned int brick = position/brickSize;
+    first = (position%brickSize==0 && brick>0) ? brick-1 : brick;
+    last = (position%brickSize==brickSize-1 && brick+1<numBricks) ? brick+1 : brick;
+}
+
+inline unsigned char floorToByte(float v) { return static_cast<unsigned char>(floorf(osg::clampBetween(v, 0.0f, 1.0f)*255.0f)); }
+inline unsigned char ceilToByte(float v) { return static_cast<unsigned char>(ceilf(osg::clampBetween(v, 0.0f, 1.0f)*255.0f)); }
+
+}
+
+BrickMap::BrickMap():
+    _sourceModifiedCount(0),
+    _brickSize(0),
+    _numBricksS(0),
+    _numBricksT(0),
+    _numBricksR(0),
+    _numEmptyBricks(0),
+    _maximumOpacity(1.0f)
+{
+}
+
+BrickMap::~BrickMap()
+{
+}
+
+bool BrickMap::isSupported(const osg::Image* image)
+{
+    if (!image || !image->data() || image->s()==0 || image->t()==0 || image->r()==0) return false;
+
+    switch(image->getPixelFormat())
+    {
+        case(GL_ALPHA):
+        case(GL_LUMINANCE):
+        case(GL_INTENSITY):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_RGBA):
+        case(GL_BGRA):
+            break;
+        default:
+            return false;
+    }
+
+    switch(image->getDataType())
+    {
+        case(GL_BYTE):
+        case(GL_UNSIGNED_BYTE):
+        case(GL_SHORT):
+        case(GL_UNSIGNED_SHORT):
+        case(GL_INT):
+        case(GL_UNSIGNED_INT):
+        case(GL_FLOAT):
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool BrickMap::compute(const osg::Image* image, unsigned int brickSize)
+{
+    if (!isSupported(image) || brickSize==0)
+    {
+        OSG_NOTICE<<"BrickMap::compute(..), unable to compute brick map for image."<<std::endl;
+        return false;
+    }
+
+    _sourceImage = image;
+    _sourceModifiedCount = image->getModifiedCount();
+    _brickSize = brickSize;
+
+    unsigned int s = image->s();
+    unsigned int t = image->t();
+    unsigned int r = image->r();
+
+    _numBricksS = (s+brickSize-1)/brickSize;
+    _numBricksT = (t+brickSize-1)/brickSize;
+    _numBricksR = (r+brickSize-1)/brickSize;
+
+    unsigned int numBricks = _numBricksS*_numBricksT*_numBricksR;
+    _minimum.assign(numBricks, FLT_MAX);
+    _maximum.assign(numBricks, -FLT_MAX);
+
+    // stream through the image a row at a time, folding each row into the bricks of its slice and each slice into the
+    // layers of bricks it borders, so that no more than a slice of bricks is needed on top of the final brick map.
+    unsigned int numSliceBricks = _numBricksS*_numBricksT;
+    std::vector<float> alphas(s);
+    std::vector<float> rowMinimum(_numBricksS), rowMaximum(_numBricksS);
+    std::vector<float> sliceMinimum(numSliceBricks), sliceMaximum(numSliceBricks);
+
+    for(unsigned int k=0; k<r; ++k)
+    {
+        std::fill(sliceMinimum.begin(), sliceMinimum.end(), FLT_MAX);
+        std::fill(sliceMaximum.begin(), sliceMaximum.end(), -FLT_MAX);
+
+        for(unsigned int j=0; j<t; ++j)
+        {
+            ReadAlphaOperation operation(&alphas.front());
+            osg::readRow(s, image->getPixelFormat(), image->getDataType(), image->data(0,j,k), operation);
+
+            for(unsigned int bi=0; bi<_numBricksS; ++bi)
+            {
+                unsigned int begin = bi*brickSize>0 ? bi*brickSize-1 : 0;
+                unsigned int end = osg::minimum((bi+1)*brickSize+1, s);
+
+                float minimum = alphas[begin];
+                float maximum = alphas[begin];
+                for(unsigned int i=begin+1; i<end; ++i)
+                {
+                    float a = alphas[i];
+                    if (a<minimum) minimum = a;
+                    if (a>maximum) maximum = a;
+                }
+
+                rowMinimum[bi] = minimum;
+                rowMaximum[bi] = maximum;
+            }
+
+            unsigned int firstJ, lastJ;
+            brickRange(j, brickSize, _numBricksT, firstJ, lastJ);
+            for(unsigned int bj=firstJ; bj<=lastJ; ++bj)
+            {
+                float* minimum = &sliceMinimum[bj*_numBricksS];
+                float* maximum = &sliceMaximum[bj*_numBricksS];
+                for(unsigned int bi=0; bi<_numBricksS; ++bi)
+                {
+                    if (rowMinimum[bi]<minimum[bi]) minimum[bi] = rowMinimum[bi];
+                    if (rowMaximum[bi]>maximum[bi]) maximum[bi] = rowMaximum[bi];
+                }
+            }
+        }
+
+        unsigned int firstK, lastK;
+        brickRange(k, brickSize, _numBricksR, firstK, lastK);
+        for(unsigned int bk=firstK; bk<=lastK; ++bk)
+        {
+            float* minimum = &_minimum[bk*numSliceBricks];
+            float* maximum = &_maximum[bk*numSliceBricks];
+            for(unsigned int bi=0; bi<numSliceBricks; ++bi)
+            {
+                if (sliceMinimum[bi]<minimum[bi]) minimum[bi] = sliceMinimum[bi];
+                if (sliceMaximum[bi]>maximum[bi]) maximum[bi] = sliceMaximum[bi];
+            }
+        }
+    }
+
+    // samples taken towards the edge of the volume blend in the zero border color of the volume's texture
+    for(unsigned int bk=0; bk<_numBricksR; ++bk)
+    {
+        for(unsigned int bj=0; bj<_numBricksT; ++bj)
+        {
+            for(unsigned int bi=0; bi<_numBricksS; ++bi)
+            {
+                if (bi==0 || bj==0 || bk==0 || bi+1==_numBricksS || bj+1==_numBricksT || bk+1==_numBricksR)
+                {
+                    unsigned int i = index(bi,bj,bk);
+                    if (_minimum[i]>0.0f) _minimum[i] = 0.0f;
+                    if (_maximum[i]<0.0f) _maximum[i] = 0.0f;
+                }
+            }
+        }
+    }
+
+    classify();
+
+    return true;
+}
+
+void BrickMap::classify(const osg::TransferFunction1D* tf, float tfScale, float tfOffset)
+{
+    // allocate a new image rather than modify one that a texture created by an earlier classification may be drawing
+    _image = new osg::Image;
+    _image->allocateImage(_numBricksS, _numBricksT, _numBricksR, GL_RGB, GL_UNSIGNED_BYTE);
+
+    // sparse table of the maximum alpha of the transfer function over runs of cells of each power of two length, so
+    // that the maximum over any range of cells takes just two lookups
+    const osg::Image* tfImage = tf ? tf->getImage() : 0;
+    bool useTransferFunction = tfImage && tfImage->s()>0 && tfImage->getPixelFormat()==GL_RGBA && tfImage->getDataType()==GL_FLOAT;
+    if (tf && !useTransferFunction)
+    {
+        OSG_NOTICE<<"BrickMap::classify(..), unsupported transfer function image, treating all bricks as visible."<<std::endl;
+    }
+
+    std::vector< std::vector<float> > tfMaximum;
+    int numCells = 0;
+    if (useTransferFunction)
+    {
+        numCells = tfImage->s();
+
+        const float* rgba = reinterpret_cast<const float*>(tfImage->data());
+        tfMaximum.push_back(std::vector<float>(numCells));
+        for(int i=0; i<numCells; ++i)
+        {
+            tfMaximum[0][i] = rgba[i*4+3];
+        }
+
+        for(int length=2; length<=numCells; length*=2)
+        {
+            std::vector<float> maximum(numCells-length+1);
+            const std::vector<float>& previous = tfMaximum.back();
+            for(unsigned int i=0; i<maximum.size(); ++i)
+            {
+                maximum[i] = osg::maximum(previous[i], previous[i+length/2]);
+            }
+            tfMaximum.push_back(maximum);
+        }
+    }
+
+    _numEmptyBricks = 0;
+    unsigned char maximumOpacity = 0;
+
+    unsigned char* rgb = _image->data();
+    unsigned int numBricks = _minimum.size();
+    for(unsigned int i=0; i<numBricks; ++i)
+    {
+        float minimum = osg::clampBetween(_minimum[i], 0.0f, 1.0f);
+        float maximum = osg::clampBetween(_maximum[i], 0.0f, 1.0f);
+
+        float opacity = 1.0f;
+        if (useTransferFunction)
+        {
+            // the transfer function's texture is linearly filtered so take in the cells either side of the range of values
+            float v0 = osg::clampBetween((minimum*tfScale+tfOffset)*float(numCells)-0.5f, -1.0f, float(numCells));
+            float v1 = osg::clampBetween((maximum*tfScale+tfOffset)*float(numCells)-0.5f, -1.0f, float(numCells));
+            if (v0>v1) std::swap(v0, v1);
+
+            int first = osg::maximum(static_cast<int>(floorf(v0)), 0);
+            int last = osg::minimum(static_cast<int>(floorf(v1))+1, numCells-1);
+
+            unsigned int level = 0;
+            while((2<<level)<=(last-first+1)) ++level;
+
+            opacity = osg::maximum(tfMaximum[level][first], tfMaximum[level][last+1-(1<<level)]);
+        }
+        else if (!tf)
+        {
+            opacity = maximum;
+        }
+
+        *rgb++ = floorToByte(minimum);
+        *rgb++ = ceilToByte(maximum);
+        *rgb = ceilToByte(opacity);
+
+        if (*rgb==0) ++_numEmptyBricks;
+        if (*rgb>maximumOpacity) maximumOpacity = *rgb;
+        ++rgb;
+    }
+
+    _maximumOpacity = float(maximumOpacity)/255.0f;
+}
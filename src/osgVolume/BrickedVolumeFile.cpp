@@ -0,0 +1,755 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2014 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgVolume/BrickedVolumeFile>
+#include <osgVolume/BrickMap>
+
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+
+#include <limits>
+#include <sstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace osgVolume;
+
+namespace
+{
+
+const char s_magic[8] = { 'O', 'S', 'G', 'B', 'V', 'O', 'L', '\0' };
+const unsigned int s_version = 1;
+const unsigned int s_endianMarker = 0x01020304;
+
+template<typename T>
+void writeValue(std::ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return !in.fail();
+}
+
+typedef std::vector<BrickedVolumeFile::BrickInfo> BrickInfos;
+
+void writeBrickInfos(std::ostream& out, const BrickInfos& brickInfos)
+{
+    const uint32_t unused = 0;
+    for(BrickInfos::const_iterator itr = brickInfos.begin();
+        itr != brickInfos.end();
+        ++itr)
+    {
+        writeValue(out, itr->offset);
+        writeValue(out, itr->minimum);
+        writeValue(out, itr->maximum);
+        writeValue(out, static_cast<uint32_t>(itr->flags));
+        writeValue(out, unused);
+    }
+}
+
+bool isSupportedDataType(GLenum dataType)
+{
+    switch(dataType)
+    {
+        case(GL_BYTE):
+        case(GL_UNSIGNED_BYTE):
+        case(GL_SHORT):
+        case(GL_UNSIGNED_SHORT):
+        case(GL_INT):
+        case(GL_UNSIGNED_INT):
+        case(GL_FLOAT):
+            return true;
+        default:
+            return false;
+    }
+}
+
+unsigned int computePixelSize(GLenum pixelFormat, GLenum dataType)
+{
+    return osg::Image::computePixelSizeInBits(pixelFormat, dataType)/8;
+}
+
+std::string temporaryFileName(const std::string& fileName, unsigned int level)
+{
+    std::stringstream str;
+    str<<fileName<<".level"<<level<<".tmp";
+    return str.str();
+}
+
+// source of the slices of a level of the volume, each stored row by row with no padding
+class SliceSource
+{
+public:
+    SliceSource(unsigned int sliceSize): _sliceSize(sliceSize) {}
+    virtual ~SliceSource() {}
+
+    unsigned int getSliceSize() const { return _sliceSize; }
+
+    virtual bool readSlice(unsigned int r, unsigned char* data) = 0;
+
+protected:
+    unsigned int _sliceSize;
+};
+
+class ImageSliceSource : public SliceSource
+{
+public:
+    ImageSliceSource(const osg::Image* image):
+        SliceSource(computePixelSize(image->getPixelFormat(), image->getDataType())*image->s()*image->t()),
+        _image(image) {}
+
+    virtual bool readSlice(unsigned int r, unsigned char* data)
+    {
+        // copy row by row as the image's rows may be padded
+        unsigned int rowSize = _sliceSize/_image->t();
+        for(int t=0; t<_image->t(); ++t)
+        {
+            memcpy(data+t*rowSize, _image->data(0,t,r), rowSize);
+        }
+        return true;
+    }
+
+protected:
+    const osg::Image* _image;
+};
+
+class RawFileSliceSource : public SliceSource
+{
+public:
+    RawFileSliceSource(const std::string& fileName, unsigned int sliceSize):
+        SliceSource(sliceSize),
+        _file(fileName.c_str(), std::ios::in | std::ios::binary) {}
+
+    bool valid() const { return _file.is_open(); }
+
+    virtual bool readSlice(unsigned int r, unsigned char* data)
+    {
+        _file.seekg(static_cast<std::streamoff>(r)*static_cast<std::streamoff>(_sliceSize));
+        _file.read(reinterpret_cast<char*>(data), _sliceSize);
+        return !_file.fail();
+    }
+
+protected:
+    osgDB::ifstream _file;
+};
+
+template<typename T>
+T averageValue(double sum, unsigned int count)
+{
+    double value = sum/double(count);
+    return std::numeric_limits<T>::is_integer ? static_cast<T>(floor(value+0.5)) : static_cast<T>(value);
+}
+
+// average each 2x2x2 block of voxels of the slices a and b into a slice of half the size, b being 0 when a is the last
+// of an odd number of slices, only the voxels within the slices being averaged on the far edges of odd sized slices
+template<typename T>
+void downsampleSlices(const unsigned char* a, const unsigned char* b, unsigned int s, unsigned int t, unsigned int numComponents, unsigned char* result)
+{
+    const T* slices[2] = { reinterpret_cast<const T*>(a), reinterpret_cast<const T*>(b) };
+    unsigned int numSlices = b ? 2 : 1;
+    T* ptr = reinterpret_cast<T*>(result);
+
+    unsigned int halfS = (s+1)/2;
+    unsigned int halfT = (t+1)/2;
+    for(unsigned int j=0; j<halfT; ++j)
+    {
+        unsigned int lastRow = osg::minimum(j*2+1, t-1);
+        for(unsigned int i=0; i<halfS; ++i)
+        {
+            unsigned int lastColumn = osg::minimum(i*2+1, s-1);
+            for(unsigned int c=0; c<numComponents; ++c)
+            {
+                double sum = 0.0;
+                unsigned int count = 0;
+                for(unsigned int k=0; k<numSlices; ++k)
+                {
+                    for(unsigned int row=j*2; row<=lastRow; ++row)
+                    {
+                        for(unsigned int column=i*2; column<=lastColumn; ++column)
+                        {
+                            sum += double(slices[k][(row*s+column)*numComponents+c]);
+                            ++count;
+                        }
+                    }
+                }
+                *(ptr++) = averageValue<T>(sum, count);
+            }
+        }
+    }
+}
+
+void downsampleSlices(GLenum dataType, const unsigned char* a, const unsigned char* b, unsigned int s, unsigned int t, unsigned int numComponents, unsigned char* result)
+{
+    switch(dataType)
+    {
+        case(GL_BYTE):              downsampleSlices<char>(a, b, s, t, numComponents, result); break;
+        case(GL_UNSIGNED_BYTE):     downsampleSlices<unsigned char>(a, b, s, t, numComponents, result); break;
+        case(GL_SHORT):             downsampleSlices<short>(a, b, s, t, numComponents, result); break;
+        case(GL_UNSIGNED_SHORT):    downsampleSlices<unsigned short>(a, b, s, t, numComponents, result); break;
+        case(GL_INT):               downsampleSlices<int>(a, b, s, t, numComponents, result); break;
+        case(GL_UNSIGNED_INT):      downsampleSlices<unsigned int>(a, b, s, t, numComponents, result); break;
+        case(GL_FLOAT):             downsampleSlices<float>(a, b, s, t, numComponents, result); break;
+    }
+}
+
+class BrickedVolumeWriter
+{
+public:
+    BrickedVolumeWriter(unsigned int s, unsigned int t, unsigned int r, GLenum pixelFormat, GLenum dataType,
+                        const osg::Matrixd& transform, unsigned int brickSize, const std::string& fileName):
+        _s(s), _t(t), _r(r),
+        _pixelFormat(pixelFormat),
+        _dataType(dataType),
+        _pixelSize(computePixelSize(pixelFormat, dataType)),
+        _transform(transform),
+        _brickSize(brickSize),
+        _fileName(fileName)
+    {
+        BrickedVolumeFile::computeLevels(_s, _t, _r, _brickSize, _levels);
+
+        const BrickedVolumeFile::Level& lastLevel = _levels.back();
+        _brickInfos.resize(lastLevel.firstBrick + lastLevel.numBricksS*lastLevel.numBricksT*lastLevel.numBricksR);
+    }
+
+    bool write(SliceSource& source)
+    {
+        _out.open(_fileName.c_str(), std::ios::out | std::ios::binary);
+        if (!_out)
+        {
+            OSG_NOTICE<<"BrickedVolumeFile::write() unable to open "<<_fileName<<" for writing."<<std::endl;
+            return false;
+        }
+
+        // header, then a table of bricks to be filled in once the bricks have been written
+        _out.write(s_magic, sizeof(s_magic));
+        writeValue(_out, static_cast<uint32_t>(s_version));
+        writeValue(_out, static_cast<uint32_t>(s_endianMarker));
+        writeValue(_out, static_cast<uint32_t>(_s));
+        writeValue(_out, static_cast<uint32_t>(_t));
+        writeValue(_out, static_cast<uint32_t>(_r));
+        writeValue(_out, static_cast<uint32_t>(_pixelFormat));
+        writeValue(_out, static_cast<uint32_t>(_dataType));
+        writeValue(_out, static_cast<uint32_t>(_brickSize));
+        writeValue(_out, static_cast<uint32_t>(_levels.size()));
+        for(unsigned int i=0; i<16; ++i)
+        {
+            writeValue(_out, _transform.ptr()[i]);
+        }
+
+        std::streamoff tablePosition = _out.tellp();
+        writeBrickInfos(_out, _brickInfos);
+
+        // the finest level is read from the source, each coarser level from the temporary file that the level before
+        // it was downsampled into
+        unsigned int lastLevel = _levels.size()-1;
+        bool result = writeLevel(source, lastLevel);
+        for(int level=int(lastLevel)-1; level>=0 && result; --level)
+        {
+            const BrickedVolumeFile::Level& levelInfo = _levels[level];
+            RawFileSliceSource levelSource(temporaryFileName(_fileName, level), levelInfo.s*levelInfo.t*_pixelSize);
+            result = levelSource.valid() && writeLevel(levelSource, level);
+        }
+
+        for(unsigned int level=0; level<lastLevel; ++level)
+        {
+            ::remove(temporaryFileName(_fileName, level).c_str());
+        }
+
+        if (!result)
+        {
+            OSG_NOTICE<<"BrickedVolumeFile::write() failed writing "<<_fileName<<std::endl;
+            return false;
+        }
+
+        computeChildrenHaveData();
+
+        _out.seekp(tablePosition);
+        writeBrickInfos(_out, _brickInfos);
+
+        return !_out.fail();
+    }
+
+protected:
+
+    typedef BrickedVolumeFile::Level Level;
+
+    BrickedVolumeFile::BrickInfo& getBrickInfo(unsigned int level, unsigned int i, unsigned int j, unsigned int k)
+    {
+        const Level& levelInfo = _levels[level];
+        return _brickInfos[levelInfo.firstBrick + (k*levelInfo.numBricksT+j)*levelInfo.numBricksS+i];
+    }
+
+    bool writeLevel(SliceSource& source, unsigned int level)
+    {
+        if (!writeBricks(source, level)) return false;
+        if (level>0 && !downsample(source, level)) return false;
+        return true;
+    }
+
+    // write the bricks of a level, reading the slices of each layer of bricks and those bordering it
+    bool writeBricks(SliceSource& source, unsigned int level)
+    {
+        const Level& levelInfo = _levels[level];
+        unsigned int rowSize = levelInfo.s*_pixelSize;
+        unsigned int sliceSize = source.getSliceSize();
+
+        std::vector<unsigned char> slices(sliceSize*(_brickSize+2));
+
+        for(unsigned int bk=0; bk<levelInfo.numBricksR; ++bk)
+        {
+            int firstSlice = int(bk*_brickSize)-1;
+            unsigned int numSlices = osg::minimum(_brickSize, levelInfo.r-bk*_brickSize)+2;
+            for(unsigned int k=0; k<numSlices; ++k)
+            {
+                int slice = firstSlice+int(k);
+                unsigned char* data = &slices[k*sliceSize];
+                if (slice>=0 && slice<int(levelInfo.r))
+                {
+                    if (!source.readSlice(slice, data)) return false;
+                }
+                else
+                {
+                    memset(data, 0, sliceSize);
+                }
+            }
+
+            for(unsigned int bj=0; bj<levelInfo.numBricksT; ++bj)
+            {
+                int firstRow = int(bj*_brickSize)-1;
+                unsigned int numRows = osg::minimum(_brickSize, levelInfo.t-bj*_brickSize)+2;
+
+                for(unsigned int bi=0; bi<levelInfo.numBricksS; ++bi)
+                {
+                    int firstColumn = int(bi*_brickSize)-1;
+                    unsigned int numColumns = osg::minimum(_brickSize, levelInfo.s-bi*_brickSize)+2;
+
+                    int beginColumn = osg::maximum(firstColumn, 0);
+                    int endColumn = osg::minimum(firstColumn+int(numColumns), int(levelInfo.s));
+
+                    osg::ref_ptr<osg::Image> brick = new osg::Image;
+                    brick->allocateImage(numColumns, numRows, numSlices, _pixelFormat, _dataType);
+
+                    for(unsigned int k=0; k<numSlices; ++k)
+                    {
+                        for(unsigned int j=0; j<numRows; ++j)
+                        {
+                            unsigned char* dest = brick->data(0,j,k);
+                            memset(dest, 0, numColumns*_pixelSize);
+
+                            int row = firstRow+int(j);
+                            if (row<0 || row>=int(levelInfo.t)) continue;
+
+                            memcpy(dest + (beginColumn-firstColumn)*_pixelSize,
+                                   &slices[k*sliceSize + row*rowSize + beginColumn*_pixelSize],
+                                   (endColumn-beginColumn)*_pixelSize);
+                        }
+                    }
+
+                    BrickedVolumeFile::BrickInfo& info = getBrickInfo(level, bi, bj, bk);
+
+                    osg::ref_ptr<BrickMap> brickMap = new BrickMap;
+                    if (BrickMap::isSupported(brick.get()) &&
+                        brickMap->compute(brick.get(), osg::maximum(numColumns, osg::maximum(numRows, numSlices))))
+                    {
+                        info.minimum = brickMap->getMinimum(0,0,0);
+                        info.maximum = brickMap->getMaximum(0,0,0);
+                    }
+                    else
+                    {
+                        info.minimum = 0.0f;
+                        info.maximum = 1.0f;
+                    }
+
+                    if (info.minimum!=0.0f || info.maximum!=0.0f)
+                    {
+                        info.offset = static_cast<uint64_t>(_out.tellp());
+                        info.flags |= BrickedVolumeFile::HAS_DATA;
+                        _out.write(reinterpret_cast<const char*>(brick->data()), brick->getTotalSizeInBytes());
+                        if (_out.fail()) return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // downsample a level into the temporary file of the next coarser level
+    bool downsample(SliceSource& source, unsigned int level)
+    {
+        const Level& levelInfo = _levels[level];
+        const Level& coarserLevelInfo = _levels[level-1];
+        unsigned int numComponents = osg::Image::computeNumComponents(_pixelFormat);
+
+        osgDB::ofstream out(temporaryFileName(_fileName, level-1).c_str(), std::ios::out | std::ios::binary);
+        if (!out) return false;
+
+        std::vector<unsigned char> a(source.getSliceSize());
+        std::vector<unsigned char> b(source.getSliceSize());
+        std::vector<unsigned char> result(coarserLevelInfo.s*coarserLevelInfo.t*_pixelSize);
+
+        for(unsigned int k=0; k<coarserLevelInfo.r; ++k)
+        {
+            bool hasSecondSlice = k*2+1<levelInfo.r;
+            if (!source.readSlice(k*2, &a[0])) return false;
+            if (hasSecondSlice && !source.readSlice(k*2+1, &b[0])) return false;
+
+            downsampleSlices(_dataType, &a[0], hasSecondSlice ? &b[0] : 0, levelInfo.s, levelInfo.t, numComponents, &result[0]);
+
+            out.write(reinterpret_cast<const char*>(&result[0]), result.size());
+        }
+
+        return !out.fail();
+    }
+
+    void computeChildrenHaveData()
+    {
+        for(int level=int(_levels.size())-2; level>=0; --level)
+        {
+            const Level& levelInfo = _levels[level];
+            const Level& childLevelInfo = _levels[level+1];
+            for(unsigned int k=0; k<levelInfo.numBricksR; ++k)
+            {
+                for(unsigned int j=0; j<levelInfo.numBricksT; ++j)
+                {
+                    for(unsigned int i=0; i<levelInfo.numBricksS; ++i)
+                    {
+                        BrickedVolumeFile::BrickInfo& info = getBrickInfo(level, i, j, k);
+                        for(unsigned int ck=k*2; ck<osg::minimum(k*2+2, childLevelInfo.numBricksR); ++ck)
+                        {
+                            for(unsigned int cj=j*2; cj<osg::minimum(j*2+2, childLevelInfo.numBricksT); ++cj)
+                            {
+                                for(unsigned int ci=i*2; ci<osg::minimum(i*2+2, childLevelInfo.numBricksS); ++ci)
+                                {
+                                    if (getBrickInfo(level+1, ci, cj, ck).flags!=0) info.flags |= BrickedVolumeFile::CHILDREN_HAVE_DATA;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned int                    _s, _t, _r;
+    GLenum                          _pixelFormat;
+    GLenum                          _dataType;
+    unsigned int                    _pixelSize;
+    osg::Matrixd                    _transform;
+    unsigned int                    _brickSize;
+    std::string                     _fileName;
+
+    BrickedVolumeFile::Levels       _levels;
+    BrickInfos                      _brickInfos;
+    osgDB::ofstream                 _out;
+};
+
+bool checkWriteParameters(unsigned int s, unsigned int t, unsigned int r, GLenum pixelFormat, GLenum dataType, unsigned int brickSize)
+{
+    if (s==0 || t==0 || r==0 || brickSize==0)
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::write() requires a volume and brick size greater than zero."<<std::endl;
+        return false;
+    }
+
+    if (!isSupportedDataType(dataType) || osg::Image::computeNumComponents(pixelFormat)==0)
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::write() pixel format 0x"<<std::hex<<pixelFormat<<" and data type 0x"<<dataType<<std::dec<<" not supported."<<std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+BrickedVolumeFile::BrickedVolumeFile():
+    _s(0),
+    _t(0),
+    _r(0),
+    _pixelFormat(0),
+    _dataType(0),
+    _brickSize(0),
+    _brickCache(BrickCache::instance())
+{
+}
+
+BrickedVolumeFile::~BrickedVolumeFile()
+{
+}
+
+bool BrickedVolumeFile::write(const osg::Image* image, const osg::Matrixd& transform, unsigned int brickSize, const std::string& fileName)
+{
+    if (!image || !image->data() ||
+        !checkWriteParameters(image->s(), image->t(), image->r(), image->getPixelFormat(), image->getDataType(), brickSize))
+    {
+        return false;
+    }
+
+    ImageSliceSource source(image);
+    BrickedVolumeWriter writer(image->s(), image->t(), image->r(), image->getPixelFormat(), image->getDataType(), transform, brickSize, fileName);
+    return writer.write(source);
+}
+
+bool BrickedVolumeFile::write(const std::string& rawFileName, unsigned int s, unsigned int t, unsigned int r, GLenum pixelFormat, GLenum dataType,
+                              const osg::Matrixd& transform, unsigned int brickSize, const std::string& fileName)
+{
+    if (!checkWriteParameters(s, t, r, pixelFormat, dataType, brickSize)) return false;
+
+    RawFileSliceSource source(rawFileName, s*t*computePixelSize(pixelFormat, dataType));
+    if (!source.valid())
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::write() unable to open "<<rawFileName<<std::endl;
+        return false;
+    }
+
+    BrickedVolumeWriter writer(s, t, r, pixelFormat, dataType, transform, brickSize, fileName);
+    return writer.write(source);
+}
+
+void BrickedVolumeFile::computeLevels(unsigned int s, unsigned int t, unsigned int r, unsigned int brickSize, Levels& levels)
+{
+    levels.clear();
+    if (s==0 || t==0 || r==0 || brickSize==0) return;
+
+    // start from the full resolution, halving until the whole volume fits in a single brick
+    while(true)
+    {
+        Level level;
+        level.s = s;
+        level.t = t;
+        level.r = r;
+        level.numBricksS = (s+brickSize-1)/brickSize;
+        level.numBricksT = (t+brickSize-1)/brickSize;
+        level.numBricksR = (r+brickSize-1)/brickSize;
+        levels.insert(levels.begin(), level);
+
+        if (s<=brickSize && t<=brickSize && r<=brickSize) break;
+
+        s = (s+1)/2;
+        t = (t+1)/2;
+        r = (r+1)/2;
+    }
+
+    unsigned int firstBrick = 0;
+    for(Levels::iterator itr = levels.begin();
+        itr != levels.end();
+        ++itr)
+    {
+        itr->firstBrick = firstBrick;
+        firstBrick += itr->numBricksS*itr->numBricksT*itr->numBricksR;
+    }
+}
+
+bool BrickedVolumeFile::open(const std::string& fileName)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileMutex);
+
+    _levels.clear();
+    _brickInfos.clear();
+    if (_file.is_open()) _file.close();
+
+    _file.clear();
+    _file.open(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!_file.is_open()) return false;
+
+    char magic[8];
+    _file.read(magic, sizeof(magic));
+    if (_file.fail() || memcmp(magic, s_magic, sizeof(magic))!=0)
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::open() "<<fileName<<" is not a bricked volume file."<<std::endl;
+        _file.close();
+        return false;
+    }
+
+    uint32_t version = 0, endianMarker = 0;
+    readValue(_file, version);
+    readValue(_file, endianMarker);
+    if (version!=s_version || endianMarker!=s_endianMarker)
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::open() "<<fileName<<" has an unsupported version or byte order."<<std::endl;
+        _file.close();
+        return false;
+    }
+
+    uint32_t s = 0, t = 0, r = 0, pixelFormat = 0, dataType = 0, brickSize = 0, numLevels = 0;
+    readValue(_file, s);
+    readValue(_file, t);
+    readValue(_file, r);
+    readValue(_file, pixelFormat);
+    readValue(_file, dataType);
+    readValue(_file, brickSize);
+    readValue(_file, numLevels);
+
+    osg::Matrixd transform;
+    for(unsigned int i=0; i<16; ++i)
+    {
+        readValue(_file, transform.ptr()[i]);
+    }
+
+    Levels levels;
+    computeLevels(s, t, r, brickSize, levels);
+    if (_file.fail() || levels.empty() || levels.size()!=numLevels)
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::open() "<<fileName<<" has an invalid header."<<std::endl;
+        _file.close();
+        return false;
+    }
+
+    const Level& lastLevel = levels.back();
+    BrickInfos brickInfos(lastLevel.firstBrick + lastLevel.numBricksS*lastLevel.numBricksT*lastLevel.numBricksR);
+    for(BrickInfos::iterator itr = brickInfos.begin();
+        itr != brickInfos.end();
+        ++itr)
+    {
+        uint32_t flags = 0, unused = 0;
+        readValue(_file, itr->offset);
+        readValue(_file, itr->minimum);
+        readValue(_file, itr->maximum);
+        readValue(_file, flags);
+        readValue(_file, unused);
+        itr->flags = flags;
+    }
+
+    if (_file.fail())
+    {
+        OSG_NOTICE<<"BrickedVolumeFile::open() "<<fileName<<" has a truncated table of bricks."<<std::endl;
+        _file.close();
+        return false;
+    }
+
+    _fileName = fileName;
+    _s = s;
+    _t = t;
+    _r = r;
+    _pixelFormat = pixelFormat;
+    _dataType = dataType;
+    _brickSize = brickSize;
+    _transform = transform;
+    _levels.swap(levels);
+    _brickInfos.swap(brickInfos);
+
+    return true;
+}
+
+const BrickedVolumeFile::Level* BrickedVolumeFile::findLevel(const TileID& tileID) const
+{
+    if (tileID.level<0 || tileID.level>=int(_levels.size())) return 0;
+
+    const Level& level = _levels[tileID.level];
+    if (tileID.x<0 || tileID.x>=int(level.numBricksS) ||
+        tileID.y<0 || tileID.y>=int(level.numBricksT) ||
+        tileID.z<0 || tileID.z>=int(level.numBricksR)) return 0;
+
+    return &level;
+}
+
+const BrickedVolumeFile::BrickInfo* BrickedVolumeFile::getBrickInfo(const TileID& tileID) const
+{
+    const Level* level = findLevel(tileID);
+    if (!level) return 0;
+
+    return &_brickInfos[level->firstBrick + (tileID.z*level->numBricksT+tileID.y)*level->numBricksS+tileID.x];
+}
+
+bool BrickedVolumeFile::computeBrickExtents(const TileID& tileID, osg::Vec3d& bottomLeft, osg::Vec3d& topRight) const
+{
+    const Level* level = findLevel(tileID);
+    if (!level) return false;
+
+    // each voxel of a level covers 2^(numLevels-1-level) voxels of the full resolution volume along each axis
+    double voxelScale = double(1u << (_levels.size()-1-tileID.level));
+    osg::Vec3d voxelSize(voxelScale/double(_s), voxelScale/double(_t), voxelScale/double(_r));
+
+    bottomLeft.set(double(tileID.x*_brickSize)*voxelSize.x(),
+                   double(tileID.y*_brickSize)*voxelSize.y(),
+                   double(tileID.z*_brickSize)*voxelSize.z());
+
+    // the coarser levels of volumes whose size isn't a power of two extend a little beyond the volume, so clamp to it
+    topRight.set(osg::minimum(double(osg::minimum((tileID.x+1)*_brickSize, level->s))*voxelSize.x(), 1.0),
+                 osg::minimum(double(osg::minimum((tileID.y+1)*_brickSize, level->t))*voxelSize.y(), 1.0),
+                 osg::minimum(double(osg::minimum((tileID.z+1)*_brickSize, level->r))*voxelSize.z(), 1.0));
+
+    return true;
+}
+
+bool BrickedVolumeFile::computeImageExtents(const TileID& tileID, osg::Vec3d& bottomLeft, osg::Vec3d& topRight) const
+{
+    if (!findLevel(tileID)) return false;
+
+    double voxelScale = double(1u << (_levels.size()-1-tileID.level));
+    osg::Vec3d voxelSize(voxelScale/double(_s), voxelScale/double(_t), voxelScale/double(_r));
+
+    unsigned int s, t, r;
+    computeImageSize(tileID, s, t, r);
+
+    bottomLeft.set(double(int(tileID.x*_brickSize)-1)*voxelSize.x(),
+                   double(int(tileID.y*_brickSize)-1)*voxelSize.y(),
+                   double(int(tileID.z*_brickSize)-1)*voxelSize.z());
+
+    topRight.set(bottomLeft.x()+double(s)*voxelSize.x(),
+                 bottomLeft.y()+double(t)*voxelSize.y(),
+                 bottomLeft.z()+double(r)*voxelSize.z());
+
+    return true;
+}
+
+void BrickedVolumeFile::computeImageSize(const TileID& tileID, unsigned int& s, unsigned int& t, unsigned int& r) const
+{
+    const Level& level = _levels[tileID.level];
+    s = osg::minimum(_brickSize, level.s-tileID.x*_brickSize)+2;
+    t = osg::minimum(_brickSize, level.t-tileID.y*_brickSize)+2;
+    r = osg::minimum(_brickSize, level.r-tileID.z*_brickSize)+2;
+}
+
+osg::ref_ptr<osg::Image> BrickedVolumeFile::readBrick(const TileID& tileID)
+{
+    const BrickInfo* info = getBrickInfo(tileID);
+    if (!info || (info->flags & HAS_DATA)==0) return 0;
+
+    if (_brickCache.valid())
+    {
+        osg::ref_ptr<osg::Image> image = _brickCache->getImage(_fileName, tileID);
+        if (image.valid()) return image;
+    }
+
+    unsigned int s, t, r;
+    computeImageSize(tileID, s, t, r);
+
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(s, t, r, _pixelFormat, _dataType);
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileMutex);
+
+        _file.clear();
+        _file.seekg(static_cast<std::streamoff>(info->offset));
+        _file.read(reinterpret_cast<char*>(image->data()), image->getTotalSizeInBytes());
+        if (_file.fail())
+        {
+            OSG_NOTICE<<"BrickedVolumeFile::readBrick() failed reading brick "<<tileID.level<<" "<<tileID.x<<" "<<tileID.y<<" "<<tileID.z
+                      <<" of "<<_fileName<<std::endl;
+            return 0;
+        }
+    }
+
+    if (_brickCache.valid()) _brickCache->addImage(_fileName, tileID, image.get());
+
+    return image;
+}
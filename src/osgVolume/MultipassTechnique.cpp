@@ -211,13 +211,13 @@ MultipassTechnique::MultipassTileData::MultipassTileData(osgUtil::CullVisitor* c
         case(MultipassTechnique::CUBE):
         {
             // no need to set up RTT Cameras;
-            OSG_NOTICE<<"Setting up MultipassTileData for CUBE rendering"<<std::endl;
+            OSG_INFO<<"Setting up MultipassTileData for CUBE rendering"<<std::endl;
 
             break;
         }
         case(MultipassTechnique::HULL):
         {
-            OSG_NOTICE<<"Setting up MultipassTileData for HULL rendering"<<std::endl;
+            OSG_INFO<<"Setting up MultipassTileData for HULL rendering"<<std::endl;
             setUp(frontFaceRttCamera, frontFaceDepthTexture, width, height);
             frontFaceRttCamera->setName("frontFaceRttCamera");
             frontFaceRttCamera->setCullCallback(new RTTCameraCullCallback(this, mpt));
@@ -228,7 +228,7 @@ MultipassTechnique::MultipassTileData::MultipassTileData(osgUtil::CullVisitor* c
         }
         case(MultipassTechnique::CUBE_AND_HULL):
         {
-            OSG_NOTICE<<"Setting up MultipassTileData for CUBE_AND_HULL rendering"<<std::endl;
+            OSG_INFO<<"Setting up MultipassTileData for CUBE_AND_HULL rendering"<<std::endl;
             setUp(frontFaceRttCamera, frontFaceDepthTexture, width, height);
             frontFaceRttCamera->setName("frontFaceRttCamera");
             frontFaceRttCamera->setCullCallback(new RTTCameraCullCallback(this, mpt));
@@ -331,12 +331,19 @@ void MultipassTechnique::MultipassTileData::update(osgUtil::CullVisitor* cv)
 //
 // MultipassTechnique
 //
-MultipassTechnique::MultipassTechnique()
+MultipassTechnique::SharedStateSets::SharedStateSets():
+    propertiesMask(0)
+{
+}
+
+MultipassTechnique::MultipassTechnique():
+    _sharedStateSets(new SharedStateSets)
 {
 }
 
 MultipassTechnique::MultipassTechnique(const MultipassTechnique& fft,const osg::CopyOp& copyop):
-    VolumeTechnique(fft,copyop)
+    VolumeTechnique(fft,copyop),
+    _sharedStateSets(fft._sharedStateSets)
 {
 }
 
@@ -409,7 +416,7 @@ void MultipassTechnique::init()
         return;
     }
 
-    OSG_NOTICE<<"MultipassTechnique::init() Need to set up"<<std::endl;
+    OSG_INFO<<"MultipassTechnique::init() Need to set up"<<std::endl;
 
     CollectPropertiesVisitor cpv(false);
     if (_volumeTile->getLayer()->getProperty())
@@ -506,8 +513,8 @@ void MultipassTechnique::init()
         imageMatrix = layerLocator->getTransform();
     }
 
-    OSG_NOTICE<<"MultipassTechnique::init() : geometryMatrix = "<<geometryMatrix<<std::endl;
-    OSG_NOTICE<<"MultipassTechnique::init() : imageMatrix = "<<imageMatrix<<std::endl;
+    OSG_INFO<<"MultipassTechnique::init() : geometryMatrix = "<<geometryMatrix<<std::endl;
+    OSG_INFO<<"MultipassTechnique::init() : imageMatrix = "<<imageMatrix<<std::endl;
 
     osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
     _volumeRenderStateSet = stateset;
@@ -626,12 +633,12 @@ void MultipassTechnique::init()
         osg::ref_ptr<osg::Uniform> volumeCellSize = new osg::Uniform("volumeCellSize", osg::Vec3(1.0f/static_cast<float>(image_3d->s()),1.0f/static_cast<float>(image_3d->t()),1.0f/static_cast<float>(image_3d->r())));
         stateset->addUniform(volumeCellSize.get());
 
-        OSG_NOTICE<<"Texture Dimensions "<<image_3d->s()<<", "<<image_3d->t()<<", "<<image_3d->r()<<std::endl;
+        OSG_INFO<<"Texture Dimensions "<<image_3d->s()<<", "<<image_3d->t()<<", "<<image_3d->r()<<std::endl;
     }
 
     if (tf)
     {
-        OSG_NOTICE<<"Setting up TransferFunction"<<std::endl;
+        OSG_INFO<<"Setting up TransferFunction"<<std::endl;
 
         float tfScale = 1.0f;
         float tfOffset = 0.0f;
@@ -662,6 +669,35 @@ void MultipassTechnique::init()
 
     }
 
+    {
+        // the program state sets depend only on the properties used, so are built once and shared between the copies
+        // of this technique, as are cloned for each of the many tiles of a paged volume
+        int propertiesMask = tf ? TF_SHADERS : 0;
+        if (cpv._isoProperty.valid()) propertiesMask |= ISO_SHADERS;
+        if (cpv._mipProperty.valid()) propertiesMask |= MIP_SHADERS;
+        if (cpv._lightingProperty.valid()) propertiesMask |= LIT_SHADERS;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sharedStateSets->mutex);
+        if (!_sharedStateSets->frontFaceStateSet || _sharedStateSets->propertiesMask!=propertiesMask)
+        {
+            createStateSets(cpv, tf!=0, _sharedStateSets->stateSetMap, _sharedStateSets->frontFaceStateSet);
+            _sharedStateSets->propertiesMask = propertiesMask;
+        }
+
+        _stateSetMap = _sharedStateSets->stateSetMap;
+        _frontFaceStateSet = _sharedStateSets->frontFaceStateSet;
+    }
+
+    if (cpv._sampleRatioWhenMovingProperty.valid())
+    {
+        _whenMovingStateSet = new osg::StateSet;
+        _whenMovingStateSet->addUniform(cpv._sampleRatioWhenMovingProperty->getUniform(), osg::StateAttribute::OVERRIDE | osg::StateAttribute::ON);
+    }
+
+}
+
+void MultipassTechnique::createStateSets(CollectPropertiesVisitor& cpv, bool useTransferFunction, StateSetMap& stateSetMap, osg::ref_ptr<osg::StateSet>& frontFaceStateSet)
+{
     // creates CullFace attributes to apply to front/back StateSet configurations.
     osg::ref_ptr<osg::CullFace> front_CullFace = new osg::CullFace(osg::CullFace::BACK);
     osg::ref_ptr<osg::CullFace> back_CullFace = new osg::CullFace(osg::CullFace::FRONT);
@@ -683,7 +719,7 @@ void MultipassTechnique::init()
     }
 
     // clear any previous settings
-    _stateSetMap.clear();
+    stateSetMap.clear();
 
 
     // set up the program template for rendering just the cube
@@ -744,15 +780,15 @@ void MultipassTechnique::init()
 
     // set up the rendering of the front face
     {
-        _frontFaceStateSet = new osg::StateSet;
+        frontFaceStateSet = new osg::StateSet;
 
         // cull only the bac faces so we write only the front
-        _frontFaceStateSet->setAttributeAndModes(front_CullFace.get(), osg::StateAttribute::ON|osg::StateAttribute::OVERRIDE);
+        frontFaceStateSet->setAttributeAndModes(front_CullFace.get(), osg::StateAttribute::ON|osg::StateAttribute::OVERRIDE);
 
         // set up the front falce
         osg::ref_ptr<osg::Program> program = new osg::Program;
         program->addShader(main_vertexShader.get());
-        _frontFaceStateSet->setAttribute(program.get(), osg::StateAttribute::ON|osg::StateAttribute::OVERRIDE);
+        frontFaceStateSet->setAttribute(program.get(), osg::StateAttribute::ON|osg::StateAttribute::OVERRIDE);
     }
 
 
@@ -767,13 +803,13 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_standard_frag);
             }
 
-            _stateSetMap[STANDARD_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[STANDARD_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[STANDARD_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[STANDARD_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[STANDARD_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[STANDARD_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
 
         // STANDARD_SHADERS with TransferFunction
-        if (tf)
+        if (useTransferFunction)
         {
             osg::ref_ptr<osg::Shader> accumulateSamplesShader = osgDB::readRefShaderFile(osg::Shader::FRAGMENT, "shaders/volume_accumulateSamples_standard_tf.frag");
             if (!accumulateSamplesShader)
@@ -782,9 +818,9 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_standard_tf_frag);
             }
 
-            _stateSetMap[STANDARD_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[STANDARD_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[STANDARD_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[STANDARD_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[STANDARD_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[STANDARD_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
     }
 
@@ -800,13 +836,13 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_iso_frag);
             }
 
-            _stateSetMap[ISO_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[ISO_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[ISO_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[ISO_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[ISO_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[ISO_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
 
         // ISO_SHADERS with TransferFunction
-        if (tf)
+        if (useTransferFunction)
         {
             osg::ref_ptr<osg::Shader> accumulateSamplesShader = osgDB::readRefShaderFile(osg::Shader::FRAGMENT, "shaders/volume_accumulateSamples_iso_tf.frag");
             if (!accumulateSamplesShader)
@@ -815,9 +851,9 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_iso_tf_frag);
             }
 
-            _stateSetMap[ISO_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[ISO_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[ISO_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[ISO_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[ISO_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[ISO_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
     }
 
@@ -833,13 +869,13 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_mip_frag);
             }
 
-            _stateSetMap[MIP_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[MIP_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[MIP_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[MIP_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[MIP_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[MIP_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
 
         // MIP_SHADERS with TransferFunction
-        if (tf)
+        if (useTransferFunction)
         {
             osg::ref_ptr<osg::Shader> accumulateSamplesShader = osgDB::readRefShaderFile(osg::Shader::FRAGMENT, "shaders/volume_accumulateSamples_mip_tf.frag");
             if (!accumulateSamplesShader)
@@ -848,9 +884,9 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_mip_tf_frag);
             }
 
-            _stateSetMap[MIP_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[MIP_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[MIP_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[MIP_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[MIP_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[MIP_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
     }
 
@@ -866,13 +902,13 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_lit_frag);
             }
 
-            _stateSetMap[LIT_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[LIT_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[LIT_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[LIT_SHADERS|CUBE_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[LIT_SHADERS|HULL_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[LIT_SHADERS|CUBE_AND_HULL_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
 
         // MIP_SHADERS with TransferFunction
-        if (tf)
+        if (useTransferFunction)
         {
             osg::ref_ptr<osg::Shader> accumulateSamplesShader = osgDB::readRefShaderFile(osg::Shader::FRAGMENT, "shaders/volume_accumulateSamples_lit_tf.frag");
             if (!accumulateSamplesShader)
@@ -881,19 +917,11 @@ void MultipassTechnique::init()
                 accumulateSamplesShader = new osg::Shader(osg::Shader::FRAGMENT, volume_accumulateSamples_lit_tf_frag);
             }
 
-            _stateSetMap[LIT_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[LIT_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
-            _stateSetMap[LIT_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[LIT_SHADERS|CUBE_SHADERS|TF_SHADERS] = createStateSet(cube_stateset_prototype.get(), cube_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[LIT_SHADERS|HULL_SHADERS|TF_SHADERS] = createStateSet(hull_stateset_prototype.get(), hull_program_prototype.get(), accumulateSamplesShader.get());
+            stateSetMap[LIT_SHADERS|CUBE_AND_HULL_SHADERS|TF_SHADERS] = createStateSet(cube_and_hull_stateset_prototype.get(), cube_and_hull_program_prototype.get(), accumulateSamplesShader.get());
         }
     }
-
-
-    if (cpv._sampleRatioWhenMovingProperty.valid())
-    {
-        _whenMovingStateSet = new osg::StateSet;
-        _whenMovingStateSet->addUniform(cpv._sampleRatioWhenMovingProperty->getUniform(), osg::StateAttribute::OVERRIDE | osg::StateAttribute::ON);
-    }
-
 }
 
 void MultipassTechnique::update(osgUtil::UpdateVisitor* uv)
@@ -19,6 +19,7 @@
 
 #include <osg/Program>
 #include <osg/TexGen>
+#include <osg/Timer>
 #include <osg/Texture1D>
 #include <osg/Texture2D>
 #include <osg/Texture3D>
@@ -30,12 +31,16 @@
 namespace osgVolume
 {
 
-RayTracedTechnique::RayTracedTechnique()
+RayTracedTechnique::RayTracedTechnique():
+    _brickSize(8),
+    _opacityCutoff(0.0f)
 {
 }
 
 RayTracedTechnique::RayTracedTechnique(const RayTracedTechnique& fft,const osg::CopyOp& copyop):
-    VolumeTechnique(fft,copyop)
+    VolumeTechnique(fft,copyop),
+    _brickSize(fft._brickSize),
+    _opacityCutoff(fft._opacityCutoff)
 {
 }
 
@@ -207,11 +212,11 @@ void RayTracedTechnique::init()
 
         bool enableBlending = false;
 
+        float tfScale = 1.0f;
+        float tfOffset = 0.0f;
+
         if (tf)
         {
-            float tfScale = 1.0f;
-            float tfOffset = 0.0f;
-
             ImageLayer* imageLayer = dynamic_cast<ImageLayer*>(_volumeTile->getLayer());
             if (imageLayer)
             {
@@ -238,6 +243,58 @@ void RayTracedTechnique::init()
 
         }
 
+        // the transfer function maximum intensity projection shader looks up the first channel rather than alpha
+        bool useBrickMap = _brickSize>0 && BrickMap::isSupported(image_3d) &&
+                           !(tf && shadingModel==MaximumIntensityProjection && osg::Image::computeNumComponents(image_3d->getPixelFormat())>1);
+
+        if (useBrickMap)
+        {
+            // only recompute the bricks' range of values when the image has changed, reclassifying them is cheap
+            if (!_brickMap || _brickMap->getSourceImage()!=image_3d ||
+                _brickMap->getSourceModifiedCount()!=image_3d->getModifiedCount() ||
+                _brickMap->getBrickSize()!=_brickSize)
+            {
+                osg::ElapsedTime elapsedTime;
+
+                _brickMap = new BrickMap;
+                _brickMap->compute(image_3d, _brickSize);
+
+                OSG_INFO<<"RayTracedTechnique::init() : computed brick map in "<<elapsedTime.elapsedTime_m()<<"ms"<<std::endl;
+            }
+
+            _brickMap->classify(tf, tfScale, tfOffset);
+
+            OSG_INFO<<"RayTracedTechnique::init() : "<<_brickMap->getNumEmptyBricks()<<" of "
+                    <<_brickMap->getNumBricksS()*_brickMap->getNumBricksT()*_brickMap->getNumBricksR()<<" bricks empty"<<std::endl;
+
+            osg::Texture3D* brickTexture = new osg::Texture3D;
+            brickTexture->setResizeNonPowerOfTwoHint(false);
+            brickTexture->setFilter(osg::Texture3D::MIN_FILTER, osg::Texture3D::NEAREST);
+            brickTexture->setFilter(osg::Texture3D::MAG_FILTER, osg::Texture3D::NEAREST);
+            brickTexture->setWrap(osg::Texture3D::WRAP_R, osg::Texture3D::CLAMP_TO_EDGE);
+            brickTexture->setWrap(osg::Texture3D::WRAP_S, osg::Texture3D::CLAMP_TO_EDGE);
+            brickTexture->setWrap(osg::Texture3D::WRAP_T, osg::Texture3D::CLAMP_TO_EDGE);
+            brickTexture->setImage(_brickMap->getImage());
+
+            float brickSize = static_cast<float>(_brickSize);
+            stateset->setTextureAttributeAndModes(2, brickTexture, osg::StateAttribute::ON);
+            stateset->addUniform(new osg::Uniform("brickTexture", 2));
+            stateset->addUniform(new osg::Uniform("brickMapScale", osg::Vec3(float(image_3d->s())/brickSize, float(image_3d->t())/brickSize, float(image_3d->r())/brickSize)));
+            stateset->addUniform(new osg::Uniform("brickMapSize", osg::Vec3(float(_brickMap->getNumBricksS()), float(_brickMap->getNumBricksT()), float(_brickMap->getNumBricksR()))));
+            stateset->addUniform(new osg::Uniform("brickMapMaximum", _brickMap->getMaximumOpacity()));
+        }
+        else
+        {
+            _brickMap = 0;
+
+            // a zero brickMapSize disables empty space skipping in the shaders
+            stateset->addUniform(new osg::Uniform("brickTexture", 2));
+            stateset->addUniform(new osg::Uniform("brickMapSize", osg::Vec3(0.0f, 0.0f, 0.0f)));
+            stateset->addUniform(new osg::Uniform("brickMapMaximum", 1.0f));
+        }
+
+        stateset->addUniform(new osg::Uniform("opacityCutoff", _opacityCutoff));
+
         if (shadingModel==MaximumIntensityProjection)
         {
             enableBlending = true;
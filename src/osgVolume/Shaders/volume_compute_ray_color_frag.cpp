@@ -5,6 +5,7 @@ char volume_compute_ray_color_frag[] = "#version 110\n"
                                        "uniform vec3 volumeCellSize;\n"
                                        "uniform mat4 tileToImage;\n"
                                        "uniform float SampleRatioValue;\n"
+                                       "uniform bool blendVolumeTiles;\n"
                                        "\n"
                                        "varying mat4 texgen_eyeToTile;\n"
                                        "\n"
@@ -34,6 +35,18 @@ char volume_compute_ray_color_frag[] = "#version 110\n"
                                        "\n"
                                        "    // traverse from front to back\n"
                                        "    vec3 deltaTexCoord=(ts-te).xyz/float(num_iterations-1);\n"
+                                       "    vec3 startTexCoord = te;\n"
+                                       "\n"
+                                       "    // when the tiles of a paged volume are blended sample the middle of each step instead, so that the ray segments\n"
+                                       "    // through the tiles accumulate the same as the whole ray would\n"
+                                       "    if (blendVolumeTiles)\n"
+                                       "    {\n"
+                                       "        num_iterations = int(ceil(length((te-ts).xyz)/density));\n"
+                                       "        if (num_iterations<1) num_iterations = 1;\n"
+                                       "        if (num_iterations>max_iterations) num_iterations = max_iterations;\n"
+                                       "        deltaTexCoord = (ts-te).xyz/float(num_iterations);\n"
+                                       "        startTexCoord = te+deltaTexCoord*0.5;\n"
+                                       "    }\n"
                                        "    float stepLength = length(deltaTexCoord);\n"
                                        "\n"
                                        "    //float scale = 0.5/sampleRatio;\n"
@@ -42,7 +55,7 @@ char volume_compute_ray_color_frag[] = "#version 110\n"
                                        "\n"
                                        "    float cutoff = 1.0-1.0/256.0;\n"
                                        "\n"
-                                       "    fragColor = accumulateSamples(fragColor, ts, te, deltaTexCoord, scale, cutoff, num_iterations);\n"
+                                       "    fragColor = accumulateSamples(fragColor, ts, startTexCoord, deltaTexCoord, scale, cutoff, num_iterations);\n"
                                        "\n"
                                        "    fragColor *= baseColor;\n"
                                        "\n"
@@ -3,12 +3,31 @@ char volume_iso_frag[] = "uniform sampler3D baseTexture;\n"
                          "uniform float TransparencyValue;\n"
                          "uniform float IsoSurfaceValue;\n"
                          "\n"
+                         "uniform sampler3D brickTexture;\n"
+                         "uniform vec3 brickMapScale;\n"
+                         "uniform vec3 brickMapSize;\n"
+                         "\n"
                          "varying vec4 cameraPos;\n"
                          "varying vec4 vertexPos;\n"
                          "varying vec3 lightDirection;\n"
                          "varying mat4 texgen;\n"
                          "varying vec4 baseColor;\n"
                          "\n"
+                         "vec4 brickValues(vec3 texcoord)\n"
+                         "{\n"
+                         "    vec3 brick = clamp(floor(texcoord*brickMapScale), vec3(0.0), brickMapSize-1.0);\n"
+                         "    return texture3D( brickTexture, (brick+0.5)/brickMapSize);\n"
+                         "}\n"
+                         "\n"
+                         "float stepsToLeaveBrick(vec3 texcoord, vec3 deltaTexCoord)\n"
+                         "{\n"
+                         "    vec3 brickCoord = texcoord*brickMapScale;\n"
+                         "    vec3 brickStep = deltaTexCoord*brickMapScale;\n"
+                         "    vec3 brick = clamp(floor(brickCoord), vec3(0.0), brickMapSize-1.0);\n"
+                         "    vec3 steps = abs(brick+step(0.0, brickStep)-brickCoord)/max(abs(brickStep), vec3(1.0e-6));\n"
+                         "    return max(1.0, ceil(min(steps.x, min(steps.y, steps.z))));\n"
+                         "}\n"
+                         "\n"
                          "void main(void)\n"
                          "{ \n"
                          "    vec4 t0 = vertexPos;\n"
@@ -83,6 +102,21 @@ char volume_iso_frag[] = "uniform sampler3D baseTexture;\n"
                          "    \n"
                          "    while(num_iterations>0.0)\n"
                          "    {\n"
+                         "        if (brickMapSize.x>0.0)\n"
+                         "        {\n"
+                         "            vec4 brick = brickValues(texcoord);\n"
+                         "            if ((brick.r>IsoSurfaceValue && previousColor.a>IsoSurfaceValue) ||\n"
+                         "                (brick.g<IsoSurfaceValue && previousColor.a<IsoSurfaceValue))\n"
+                         "            {\n"
+                         "                // the iso surface doesn't pass through this brick so step over it\n"
+                         "                float numSteps = min(stepsToLeaveBrick(texcoord, deltaTexCoord), num_iterations);\n"
+                         "                texcoord += deltaTexCoord*numSteps;\n"
+                         "                num_iterations -= numSteps;\n"
+                         "                previousColor = texture3D( baseTexture, texcoord-deltaTexCoord);\n"
+                         "                continue;\n"
+                         "            }\n"
+                         "        }\n"
+                         "\n"
                          "        vec4 color = texture3D( baseTexture, texcoord);\n"
                          "\n"
                          "        float m = (previousColor.a-IsoSurfaceValue) * (color.a-IsoSurfaceValue);\n"
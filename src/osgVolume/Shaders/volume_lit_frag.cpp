@@ -3,12 +3,32 @@ char volume_lit_frag[] = "uniform sampler3D baseTexture;\n"
                          "uniform float TransparencyValue;\n"
                          "uniform float AlphaFuncValue;\n"
                          "\n"
+                         "uniform sampler3D brickTexture;\n"
+                         "uniform vec3 brickMapScale;\n"
+                         "uniform vec3 brickMapSize;\n"
+                         "uniform float opacityCutoff;\n"
+                         "\n"
                          "varying vec4 cameraPos;\n"
                          "varying vec4 vertexPos;\n"
                          "varying vec3 lightDirection;\n"
                          "varying mat4 texgen;\n"
                          "varying vec4 baseColor;\n"
                          "\n"
+                         "vec4 brickValues(vec3 texcoord)\n"
+                         "{\n"
+                         "    vec3 brick = clamp(floor(texcoord*brickMapScale), vec3(0.0), brickMapSize-1.0);\n"
+                         "    return texture3D( brickTexture, (brick+0.5)/brickMapSize);\n"
+                         "}\n"
+                         "\n"
+                         "float stepsToLeaveBrick(vec3 texcoord, vec3 deltaTexCoord)\n"
+                         "{\n"
+                         "    vec3 brickCoord = texcoord*brickMapScale;\n"
+                         "    vec3 brickStep = deltaTexCoord*brickMapScale;\n"
+                         "    vec3 brick = clamp(floor(brickCoord), vec3(0.0), brickMapSize-1.0);\n"
+                         "    vec3 steps = abs(brick+step(0.0, brickStep)-brickCoord)/max(abs(brickStep), vec3(1.0e-6));\n"
+                         "    return max(1.0, ceil(min(steps.x, min(steps.y, steps.z))));\n"
+                         "}\n"
+                         "\n"
                          "void main(void)\n"
                          "{ \n"
                          "    vec4 t0 = vertexPos;\n"
@@ -74,6 +94,15 @@ char volume_lit_frag[] = "uniform sampler3D baseTexture;\n"
                          "    vec3 deltaTexCoord=(te-t0).xyz/float(num_iterations-1.0);\n"
                          "    vec3 texcoord = t0.xyz;\n"
                          "\n"
+                         "    // with an opacity cutoff march from front to back so that the ray can stop once it's opaque enough\n"
+                         "    bool frontToBack = opacityCutoff>0.0;\n"
+                         "    if (frontToBack)\n"
+                         "    {\n"
+                         "        texcoord = te.xyz;\n"
+                         "        deltaTexCoord = -deltaTexCoord;\n"
+                         "    }\n"
+                         "    float transmittance = 1.0;\n"
+                         "\n"
                          "    float normalSampleDistance = 1.0/512.0;\n"
                          "    vec3 deltaX = vec3(normalSampleDistance, 0.0, 0.0);\n"
                          "    vec3 deltaY = vec3(0.0, normalSampleDistance, 0.0);\n"
@@ -82,6 +111,15 @@ char volume_lit_frag[] = "uniform sampler3D baseTexture;\n"
                          "    vec4 fragColor = vec4(0.0, 0.0, 0.0, 0.0); \n"
                          "    while(num_iterations>0.0)\n"
                          "    {\n"
+                         "        if (brickMapSize.x>0.0 && brickValues(texcoord).b==0.0)\n"
+                         "        {\n"
+                         "            // nothing in this brick is visible so step over it\n"
+                         "            float numSteps = min(stepsToLeaveBrick(texcoord, deltaTexCoord), num_iterations);\n"
+                         "            texcoord += deltaTexCoord*numSteps;\n"
+                         "            num_iterations -= numSteps;\n"
+                         "            continue;\n"
+                         "        }\n"
+                         "\n"
                          "        vec4 color = texture3D( baseTexture, texcoord);\n"
                          "\n"
                          "        float a = color.a;\n"
@@ -105,21 +143,40 @@ char volume_lit_frag[] = "uniform sampler3D baseTexture;\n"
                          "        }\n"
                          "\n"
                          "        float r = color[3]*TransparencyValue;\n"
-                         "        if (r>AlphaFuncValue)\n"
+                         "        if (frontToBack)\n"
                          "        {\n"
-                         "            fragColor.xyz = fragColor.xyz*(1.0-r)+color.xyz*r;\n"
-                         "            fragColor.w += r;\n"
+                         "            if (r>AlphaFuncValue)\n"
+                         "            {\n"
+                         "                float ca = min(r, 1.0);\n"
+                         "                fragColor.xyz += color.xyz*(ca*transmittance);\n"
+                         "                fragColor.w += r;\n"
+                         "                transmittance *= 1.0-ca;\n"
+                         "\n"
+                         "                // stop once the samples further along the ray can barely be seen\n"
+                         "                if (1.0-transmittance>=opacityCutoff) break;\n"
+                         "            }\n"
                          "        }\n"
-                         "\n"
-                         "        if (fragColor.w<color.w)\n"
+                         "        else\n"
                          "        {\n"
-                         "            fragColor = color;\n"
+                         "            if (r>AlphaFuncValue)\n"
+                         "            {\n"
+                         "                fragColor.xyz = fragColor.xyz*(1.0-r)+color.xyz*r;\n"
+                         "                fragColor.w += r;\n"
+                         "            }\n"
+                         "\n"
+                         "            if (fragColor.w<color.w)\n"
+                         "            {\n"
+                         "                fragColor = color;\n"
+                         "            }\n"
                          "        }\n"
                          "        texcoord += deltaTexCoord; \n"
                          "\n"
                          "        --num_iterations;\n"
                          "    }\n"
                          "\n"
+                         "    // scale the front to back color up to the full weight of the back to front compositing\n"
+                         "    if (frontToBack && transmittance<1.0) fragColor.xyz /= 1.0-transmittance;\n"
+                         "\n"
                          "    fragColor.w *= TransparencyValue;\n"
                          "    if (fragColor.w>1.0) fragColor.w = 1.0; \n"
                          "\n"
@@ -3,10 +3,20 @@ char volume_multipass_cube_frag[] = "#version 110\n"
                                     "uniform sampler2D colorTexture;\n"
                                     "uniform sampler2D depthTexture;\n"
                                     "uniform vec4 viewportDimensions;\n"
+                                    "uniform bool blendVolumeTiles;\n"
+                                    "\n"
+                                    "varying mat4 texgen_eyeToTile;\n"
                                     "\n"
                                     "// declare function defined in volume_compute_ray_color.frag\n"
                                     "vec4 computeRayColor(vec4 fragColor, float px, float py, float depth_start, float depth_end);\n"
                                     "\n"
+                                    "bool insideTile(vec2 texcoord, float depth)\n"
+                                    "{\n"
+                                    "    vec4 tile = texgen_eyeToTile * vec4(texcoord*2.0-1.0, depth*2.0-1.0, 1.0);\n"
+                                    "    tile.xyz = tile.xyz / tile.w;\n"
+                                    "    return tile.x>=0.0 && tile.x<=1.0 && tile.y>=0.0 && tile.y<=1.0 && tile.z>=0.0 && tile.z<=1.0;\n"
+                                    "}\n"
+                                    "\n"
                                     "void main(void)\n"
                                     "{\n"
                                     "    vec2 texcoord = vec2((gl_FragCoord.x-viewportDimensions[0])/viewportDimensions[2], (gl_FragCoord.y-viewportDimensions[1])/viewportDimensions[3]);\n"
@@ -14,6 +24,22 @@ char volume_multipass_cube_frag[] = "#version 110\n"
                                     "    float texture_depth = texture2D( depthTexture, texcoord).s;\n"
                                     "    float front_depth = 0.0;\n"
                                     "\n"
+                                    "    if (blendVolumeTiles)\n"
+                                    "    {\n"
+                                    "        // each of the tiles of a paged volume is blended over the scene back to front, accumulating just the part of\n"
+                                    "        // the ray that lies within the tile and in front of the scene\n"
+                                    "        float depth_start = gl_FragCoord.z;\n"
+                                    "        if (texture_depth<depth_start)\n"
+                                    "        {\n"
+                                    "            // the scene is either in the tile or in front of it, so occluding it\n"
+                                    "            if (!insideTile(texcoord, texture_depth)) discard;\n"
+                                    "            depth_start = texture_depth;\n"
+                                    "        }\n"
+                                    "\n"
+                                    "        gl_FragColor = computeRayColor(vec4(0.0,0.0,0.0,0.0), gl_FragCoord.x, gl_FragCoord.y, depth_start, front_depth);\n"
+                                    "        return;\n"
+                                    "    }\n"
+                                    "\n"
                                     "    if (gl_FragCoord.z<texture_depth)\n"
                                     "    {\n"
                                     "        // fragment starts infront of all other scene objects\n"
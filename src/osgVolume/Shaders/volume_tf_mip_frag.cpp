@@ -8,11 +8,31 @@ char volume_tf_mip_frag[] = "uniform sampler3D baseTexture;\n"
                             "uniform float TransparencyValue;\n"
                             "uniform float AlphaFuncValue;\n"
                             "\n"
+                            "uniform sampler3D brickTexture;\n"
+                            "uniform vec3 brickMapScale;\n"
+                            "uniform vec3 brickMapSize;\n"
+                            "uniform float brickMapMaximum;\n"
+                            "\n"
                             "varying vec4 cameraPos;\n"
                             "varying vec4 vertexPos;\n"
                             "varying mat4 texgen;\n"
                             "varying vec4 baseColor;\n"
                             "\n"
+                            "vec4 brickValues(vec3 texcoord)\n"
+                            "{\n"
+                            "    vec3 brick = clamp(floor(texcoord*brickMapScale), vec3(0.0), brickMapSize-1.0);\n"
+                            "    return texture3D( brickTexture, (brick+0.5)/brickMapSize);\n"
+                            "}\n"
+                            "\n"
+                            "float stepsToLeaveBrick(vec3 texcoord, vec3 deltaTexCoord)\n"
+                            "{\n"
+                            "    vec3 brickCoord = texcoord*brickMapScale;\n"
+                            "    vec3 brickStep = deltaTexCoord*brickMapScale;\n"
+                            "    vec3 brick = clamp(floor(brickCoord), vec3(0.0), brickMapSize-1.0);\n"
+                            "    vec3 steps = abs(brick+step(0.0, brickStep)-brickCoord)/max(abs(brickStep), vec3(1.0e-6));\n"
+                            "    return max(1.0, ceil(min(steps.x, min(steps.y, steps.z))));\n"
+                            "}\n"
+                            "\n"
                             "void main(void)\n"
                             "{\n"
                             "    vec4 t0 = vertexPos;\n"
@@ -81,12 +101,25 @@ char volume_tf_mip_frag[] = "uniform sampler3D baseTexture;\n"
                             "    vec4 fragColor = vec4(0.0, 0.0, 0.0, 0.0);\n"
                             "    while(num_iterations>0.0)\n"
                             "    {\n"
+                            "        if (brickMapSize.x>0.0 && brickValues(texcoord).b<=fragColor.w)\n"
+                            "        {\n"
+                            "            // nothing in this brick is brighter than the ray's maximum so step over it\n"
+                            "            float numSteps = min(stepsToLeaveBrick(texcoord, deltaTexCoord), num_iterations);\n"
+                            "            texcoord += deltaTexCoord*numSteps;\n"
+                            "            num_iterations -= numSteps;\n"
+                            "            continue;\n"
+                            "        }\n"
+                            "\n"
                             "        float v = texture3D( baseTexture, texcoord).s * tfScale + tfOffset;\n"
                             "        vec4 color = texture1D( tfTexture, v);\n"
                             "        if (fragColor.w<color.w)\n"
                             "        {\n"
                             "            fragColor = color;\n"
                             "        }\n"
+                            "\n"
+                            "        // nothing further along the ray can be brighter than the maximum of the volume\n"
+                            "        if (fragColor.w>=brickMapMaximum) break;\n"
+                            "\n"
                             "        texcoord += deltaTexCoord;\n"
                             "\n"
                             "        --num_iterations;\n"
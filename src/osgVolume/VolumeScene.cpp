@@ -14,6 +14,7 @@
 #include <osgVolume/VolumeScene>
 #include <osg/Geometry>
 #include <osg/PrimitiveSet>
+#include <osg/BlendFunc>
 #include <osg/Depth>
 #include <osg/Geode>
 #include <osg/ValueObject>
@@ -59,11 +60,19 @@ VolumeScene::ViewData::ViewData()
 
 void VolumeScene::ViewData::clearTiles()
 {
+    // discard the TileData of tiles not visited last frame, as tiles paged out of the scene graph won't be visited again
     for(Tiles::iterator itr = _tiles.begin();
-        itr != _tiles.end();
-        ++itr)
+        itr != _tiles.end();)
     {
-        if (itr->second.valid()) itr->second->active = false;
+        if (itr->second.valid() && itr->second->active)
+        {
+            itr->second->active = false;
+            ++itr;
+        }
+        else
+        {
+            _tiles.erase(itr++);
+        }
     }
 }
 
@@ -293,6 +302,17 @@ void VolumeScene::traverse(osg::NodeVisitor& nv)
         viewData->_viewportDimensionsUniform = new osg::Uniform("viewportDimensions",osg::Vec4(0.0,0.0,1280.0,1024.0));
         viewData->_stateset->addUniform(viewData->_viewportDimensionsUniform.get());
 
+        viewData->_stateset->addUniform(new osg::Uniform("blendVolumeTiles",false));
+
+        // when several tiles are visible, such as the bricks of a paged volume, each tile is blended over the scene
+        // back to front, with each tile's ray segment premultiplied by its alpha so that the segments composite
+        // the same as a single ray through the whole volume, rather than writing the final color of the scene and tile together
+        viewData->_blendTilesStateSet = new osg::StateSet;
+        viewData->_blendTilesStateSet->addUniform(new osg::Uniform("blendVolumeTiles",true));
+        viewData->_blendTilesStateSet->setAttributeAndModes(new osg::BlendFunc(osg::BlendFunc::ONE, osg::BlendFunc::ONE_MINUS_SRC_ALPHA), osg::StateAttribute::ON);
+        viewData->_blendTilesStateSet->setAttributeAndModes(new osg::Depth(osg::Depth::ALWAYS, 0.0, 1.0, false), osg::StateAttribute::ON);
+        viewData->_blendTilesStateSet->setRenderBinDetails(11,"DepthSortedBin");
+
         geode->setStateSet(viewData->_stateset.get());
 
     }
@@ -398,6 +418,16 @@ void VolumeScene::traverse(osg::NodeVisitor& nv)
 
     // for each tile that needs post rendering we need to add it into current RenderStage.
     Tiles& tiles = viewData->_tiles;
+
+    unsigned int numActiveTiles = 0;
+    for(Tiles::iterator itr = tiles.begin();
+        itr != tiles.end();
+        ++itr)
+    {
+        if (itr->second.valid() && itr->second->active) ++numActiveTiles;
+    }
+
+    bool blendTiles = numActiveTiles>1;
     for(Tiles::iterator itr = tiles.begin();
         itr != tiles.end();
         ++itr)
@@ -427,6 +457,12 @@ void VolumeScene::traverse(osg::NodeVisitor& nv)
         cv->pushStateSet(tileData->stateset.get());
         ++numStateSetPushed;
 
+        if (blendTiles)
+        {
+            cv->pushStateSet(viewData->_blendTilesStateSet.get());
+            ++numStateSetPushed;
+        }
+
         osg::NodePath::iterator np_itr = nodePath.begin();
 
         // skip over all nodes above VolumeScene as this will have already been traversed by CullVisitor
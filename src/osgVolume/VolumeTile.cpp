@@ -115,7 +115,23 @@ void VolumeTile::traverse(osg::NodeVisitor& nv)
             }
         }
 
-        _hasBeenTraversal = true;
+        // tiles paged in are first traversed outside of the scene graph, so keep looking until the Volume is found
+        if (_volume)
+        {
+            if (_layer.valid() && !_layer->getProperty() && _volume->getProperty())
+            {
+                _layer->setProperty(_volume->getProperty());
+            }
+
+            if (!_volumeTechnique && _volume->getVolumeTechniquePrototype())
+            {
+                setVolumeTechnique(osg::clone(_volume->getVolumeTechniquePrototype(), osg::CopyOp::DEEP_COPY_ALL));
+            }
+
+            if (getDirty()) init();
+
+            _hasBeenTraversal = true;
+        }
     }
 
     if (nv.getVisitorType()==osg::NodeVisitor::UPDATE_VISITOR &&